@@ -54,3 +54,27 @@ function(TARGET_TEST)
     TARGET_EXE(SOURCES ${TGTTST_SOURCES} LINK_DEPS ${TGTTST_LINK_DEPS})
     add_test(NAME "${TARGET_NAME}" COMMAND "${TARGET_NAME}" DEPENDS "${TARGET_NAME}")
 endfunction()
+
+# Compiles a DictHuffman model file, as written by ModelCache or the tester's --save-models, into a library
+# of read only tables: STRUCT.h in the current binary directory defines the tables and STRUCTCodec, an
+# EmbeddedDictHuffmanCodec which needs no load(). MODEL may be the output of a custom command.
+function(TARGET_EMBEDDED_MODEL)
+    set(oneValueArgs NAME MODEL STRUCT)
+    cmake_parse_arguments(TGTMDL "" "${oneValueArgs}" "" ${ARGN})
+    if (TGTMDL_NAME)
+        set(TARGET_NAME "${TGTMDL_NAME}")
+    else()
+        TARGET_NAME()
+    endif()
+    set(header "${CMAKE_CURRENT_BINARY_DIR}/${TGTMDL_STRUCT}.h")
+    set(source "${CMAKE_CURRENT_BINARY_DIR}/${TGTMDL_STRUCT}.cpp")
+    add_custom_command(
+            OUTPUT "${header}" "${source}"
+            COMMAND codecs-embed "--model=${TGTMDL_MODEL}" "--name=${TGTMDL_STRUCT}"
+                    "--output=${CMAKE_CURRENT_BINARY_DIR}"
+            DEPENDS codecs-embed "${TGTMDL_MODEL}"
+            COMMENT "Compiling the model ${TGTMDL_MODEL} into ${TGTMDL_STRUCT}"
+    )
+    add_library("${TARGET_NAME}" STATIC "${source}" "${header}")
+    target_link_libraries("${TARGET_NAME}" library-Embedded)
+endfunction()
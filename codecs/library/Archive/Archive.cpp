@@ -0,0 +1,184 @@
+#include "Archive.h"
+
+#include <cstring>
+
+namespace Codecs {
+
+    const char ArchiveFormat::MAGIC[4] = {'C', 'D', 'C', 'A'};
+    const uint8_t ArchiveFormat::VERSION;
+    const uint8_t ArchiveFormat::MODEL_EMBEDDED;
+    const uint64_t ArchiveFormat::TRAILER_MAGIC;
+    const size_t ArchiveFormat::TRAILER_SIZE;
+    const size_t ArchiveWriter::WRITE_BUFFER;
+
+    namespace {
+
+        void append_uint64(string& out, uint64_t value) {
+            for (int i = 0; i < 8; ++i) {
+                out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        uint64_t parse_uint64(const string_view& in, size_t pos) {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; ++i) {
+                value |= static_cast<uint64_t>(static_cast<unsigned char>(in[pos + i])) << (8 * i);
+            }
+            return value;
+        }
+
+        // magic, version, codec type, flags, fingerprint
+        const size_t FIXED_HEADER_SIZE = 4 + 1 + 1 + 1 + 8;
+
+    }
+
+    ArchiveWriter::ArchiveWriter(const string& path, CodecType type, const CodecIFace& codec, bool embed_model)
+        : codec(codec)
+        , write_buffer(new char[WRITE_BUFFER])
+        , path(path)
+    {
+        // records are small, so they are written through a large buffer
+        out.rdbuf()->pubsetbuf(write_buffer.get(), WRITE_BUFFER);
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            cthrow("can't create " << path << ": " << strerror(errno));
+        }
+        string model = codec.save();
+        model_fingerprint = Codecs::model_fingerprint(type, model);
+
+        string header(ArchiveFormat::MAGIC, sizeof(ArchiveFormat::MAGIC));
+        header.push_back(static_cast<char>(ArchiveFormat::VERSION));
+        header.push_back(static_cast<char>(type));
+        header.push_back(static_cast<char>(embed_model ? ArchiveFormat::MODEL_EMBEDDED : 0));
+        append_uint64(header, model_fingerprint);
+        if (embed_model) {
+            write_varint(header, model.size());
+            header.append(model);
+        }
+        write(header);
+    }
+
+    ArchiveWriter::~ArchiveWriter() {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+    void ArchiveWriter::add(const string_view& raw) {
+        buffer.clear();
+        codec.encode(buffer, raw);
+        add_encoded(buffer);
+    }
+
+    void ArchiveWriter::add_encoded(const string_view& encoded) {
+        if (finished) {
+            cthrow("archive " << path << " is already finished");
+        }
+        offsets.push_back(position);
+        write(encoded);
+    }
+
+    void ArchiveWriter::finish() {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        offsets.push_back(position);
+
+        string tail((8 - position % 8) % 8, '\0');
+        uint64_t index_offset = position + tail.size();
+        for (uint64_t offset : offsets) {
+            append_uint64(tail, offset);
+        }
+        append_uint64(tail, index_offset);
+        append_uint64(tail, offsets.size() - 1);
+        append_uint64(tail, ArchiveFormat::TRAILER_MAGIC);
+        write(tail);
+        out.close();
+        if (!out) {
+            cthrow("can't write " << path);
+        }
+    }
+
+    void ArchiveWriter::write(const string_view& bytes) {
+        out.write(bytes.data(), bytes.size());
+        if (!out) {
+            cthrow("can't write " << path << ": " << strerror(errno));
+        }
+        position += bytes.size();
+    }
+
+    ArchiveReader::ArchiveReader(const string& path)
+        : file(path)
+    {
+        // point reads must not pull the neighbouring records into the page cache
+        file.advise_random();
+        string_view data = file.view();
+        if (data.size() < FIXED_HEADER_SIZE + 8 + ArchiveFormat::TRAILER_SIZE) {
+            cthrow(path << " is too short for an archive");
+        }
+        if (memcmp(data.data(), ArchiveFormat::MAGIC, sizeof(ArchiveFormat::MAGIC)) != 0) {
+            cthrow(path << " is not an archive");
+        }
+        uint8_t version = static_cast<uint8_t>(data[4]);
+        type = static_cast<CodecType>(static_cast<uint8_t>(data[5]));
+        if (version != ArchiveFormat::VERSION && !(version == 1 && same_payloads_as_v1(type))) {
+            cthrow(path << " has unsupported archive version " << static_cast<int>(version) << " for "
+                        << codec_type_name(type) << " payloads");
+        }
+        embedded = static_cast<uint8_t>(data[6]) & ArchiveFormat::MODEL_EMBEDDED;
+        model_fingerprint = parse_uint64(data, 7);
+
+        size_t trailer = data.size() - ArchiveFormat::TRAILER_SIZE;
+        if (parse_uint64(data, trailer + 16) != ArchiveFormat::TRAILER_MAGIC) {
+            cthrow(path << " has no archive index, the file is truncated or was not finished");
+        }
+        index_offset = parse_uint64(data, trailer);
+        uint64_t records = parse_uint64(data, trailer + 8);
+        if (records >= data.size() || index_offset % 8 || index_offset > trailer
+                || (trailer - index_offset) / 8 != records + 1
+                || (trailer - index_offset) % 8) {
+            cthrow(path << " has a broken archive index");
+        }
+        count = records;
+        index = data.data() + index_offset;
+
+        records_offset = FIXED_HEADER_SIZE;
+        if (embedded) {
+            uint64_t model_size;
+            records_offset = read_varint(model_size, data.substr(0, index_offset), FIXED_HEADER_SIZE);
+            if (model_size > index_offset - records_offset) {
+                cthrow(path << " has a truncated model");
+            }
+            model_bytes = data.substr(records_offset, model_size);
+            records_offset += model_size;
+            if (Codecs::model_fingerprint(type, model_bytes) != model_fingerprint) {
+                cthrow(path << " has a corrupted model");
+            }
+        }
+        if (read_uint64(index) != records_offset || read_uint64(index + 8 * count) > index_offset) {
+            cthrow(path << " has a broken archive index");
+        }
+    }
+
+    ArchiveReader::CodecPtr ArchiveReader::codec(const ModelCache::Factory& factory, ModelCache* cache) const {
+        if (!embedded) {
+            if (!cache) {
+                cthrow("the archive has no embedded model and no model cache is given");
+            }
+            return cache->get(model_fingerprint);
+        }
+        std::unique_ptr<CodecIFace> loaded = factory ? factory(type) : nullptr;
+        if (!loaded) {
+            cthrow("no codec for type " << codec_type_name(type));
+        }
+        loaded->load(model_bytes.to_string());
+        CodecPtr shared(std::move(loaded));
+        if (cache) {
+            cache->insert(type, shared);
+        }
+        return shared;
+    }
+
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <library/Corpus/Corpus.h>
+#include <library/ModelCache/ModelCache.h>
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+
+namespace Codecs {
+
+    // Random access file of records encoded by one model.
+    //
+    //   header   "CDCA", version, codec type, flags, model fingerprint (8 bytes LE),
+    //            if MODEL_EMBEDDED: varint model size and the model as saved by CodecIFace::save()
+    //   records  encoded payloads back to back, no framing
+    //   index    record count + 1 file offsets as 8 byte LE integers, 8 byte aligned;
+    //            record i spans [index[i], index[i + 1])
+    //   trailer  index offset, record count, TRAILER_MAGIC, 8 bytes LE each
+    //
+    // The reader maps the file and finds the index through the fixed size trailer, so reading record i
+    // touches the two index entries and the pages of the record itself and nothing else. The index is
+    // 8 bytes a record and stays resident after a few reads, so a point read from cold storage costs
+    // about one page fault for the payload plus one decode.
+    struct ArchiveFormat {
+        static const char MAGIC[4];
+        // 2 since DictHuffman payloads start with their level; version 1 archives are read when
+        // same_payloads_as_v1() holds for their codec type
+        static const uint8_t VERSION = 2;
+        static const uint8_t MODEL_EMBEDDED = 1;
+        static const uint64_t TRAILER_MAGIC = 0x58444e4941444344ULL;  // "DCDAINDX"
+        static const size_t TRAILER_SIZE = 24;
+    };
+
+    // Streams records into an archive; the index is kept in memory and written by finish().
+    class ArchiveWriter {
+    public:
+        // Without `embed_model` only the model fingerprint is written and readers have to resolve it
+        // through a ModelCache, see ModelCache::store().
+        ArchiveWriter(const string& path, CodecType type, const CodecIFace& codec, bool embed_model = true);
+
+        ArchiveWriter(const ArchiveWriter&) = delete;
+        ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+        // finishes the archive unless finish() was called, errors are lost
+        ~ArchiveWriter();
+
+        void add(const string_view& raw);
+
+        // appends a payload already encoded by the archive's model
+        void add_encoded(const string_view& encoded);
+
+        size_t size() const {
+            return offsets.size();
+        }
+
+        uint64_t fingerprint() const {
+            return model_fingerprint;
+        }
+
+        // writes the index and the trailer and closes the file
+        void finish();
+
+    private:
+        static const size_t WRITE_BUFFER = 1 << 20;
+
+        const CodecIFace& codec;
+        std::unique_ptr<char[]> write_buffer;
+        std::ofstream out;
+        string path;
+        uint64_t model_fingerprint;
+        vector<uint64_t> offsets;
+        uint64_t position = 0;
+        string buffer;
+        bool finished = false;
+
+        void write(const string_view& bytes);
+    };
+
+    class ArchiveReader {
+    public:
+        using CodecPtr = ModelCache::CodecPtr;
+
+        ArchiveReader() = default;
+
+        // throws if the file is not a complete archive
+        explicit ArchiveReader(const string& path);
+
+        size_t size() const {
+            return count;
+        }
+
+        CodecType codec_type() const {
+            return type;
+        }
+
+        uint64_t fingerprint() const {
+            return model_fingerprint;
+        }
+
+        bool has_model() const {
+            return embedded;
+        }
+
+        // the embedded model, empty if there is none
+        string_view model() const {
+            return model_bytes;
+        }
+
+        // for reading the whole archive in order, see MappedFile
+        void advise_sequential() const {
+            file.advise_sequential();
+        }
+
+        // the encoded record i as a view into the mapping, O(1)
+        string_view record(size_t i) const {
+            if (i >= count) {
+                cthrow("record " << i << " out of " << count);
+            }
+            const char* entry = index + 8 * i;
+            uint64_t begin = read_uint64(entry);
+            uint64_t end = read_uint64(entry + 8);
+            if (begin < records_offset || begin > end || end > index_offset) {
+                cthrow("broken index entry for record " << i);
+            }
+            return string_view(file.data() + begin, end - begin);
+        }
+
+        // decodes record i, appending or replacing `raw` the way the codec's decode() does
+        void decode(string& raw, size_t i, const CodecIFace& codec) const {
+            codec.decode(raw, record(i));
+        }
+
+        // The codec for the records: the embedded model loaded by `factory`, or else the model `cache` has
+        // for the fingerprint. An embedded model is registered with `cache` if one is given.
+        CodecPtr codec(const ModelCache::Factory& factory, ModelCache* cache = nullptr) const;
+
+    private:
+        MappedFile file;
+        CodecType type = CodecType::STORED;
+        uint64_t model_fingerprint = 0;
+        bool embedded = false;
+        string_view model_bytes;
+        const char* index = nullptr;
+        uint64_t records_offset = 0;
+        uint64_t index_offset = 0;
+        size_t count = 0;
+
+        static uint64_t read_uint64(const char* in) {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; ++i) {
+                value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+            }
+            return value;
+        }
+    };
+
+}
@@ -0,0 +1,148 @@
+#include <library/Archive/Archive.h>
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/Huffman/Huffman.h>
+#include <library/tests_common/tests_common.h>
+
+#include <fstream>
+
+namespace {
+
+    std::string read_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const std::string& path, const std::string& content) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+
+    // what opening the archive throws, empty if it opens
+    std::string open_error(const std::string& path) {
+        try {
+            Codecs::ArchiveReader reader(path);
+        } catch (const Codecs::CodecException& e) {
+            return e.what();
+        }
+        return "";
+    }
+
+}
+
+TEST(ArchiveTest, RandomAccess) {
+    Codecs::StringVector records = Codecs::lorem_records();
+    records.push_back("");
+    Codecs::HuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(records.begin(), records.end()));
+
+    Codecs::TempDir dir("archive");
+    std::string path = dir.file("records.cda");
+    {
+        Codecs::ArchiveWriter writer(path, Codecs::CodecType::HUFFMAN, codec);
+        for (const auto& record : records) {
+            writer.add(record);
+        }
+        ASSERT_EQ(records.size(), writer.size());
+        writer.finish();
+    }
+
+    Codecs::ArchiveReader reader(path);
+    ASSERT_EQ(records.size(), reader.size());
+    ASSERT_EQ(Codecs::CodecType::HUFFMAN, reader.codec_type());
+    ASSERT_TRUE(reader.has_model());
+    ASSERT_EQ(codec.save(), reader.model().to_string());
+
+    auto loaded = reader.codec(Codecs::make_huffman_codec);
+    for (size_t i = records.size(); i-- > 0;) {
+        std::string encoded;
+        codec.encode(encoded, records[i]);
+        ASSERT_EQ(encoded, reader.record(i).to_string());
+        std::string decoded;
+        reader.decode(decoded, i, *loaded);
+        ASSERT_EQ(records[i], decoded);
+    }
+    ASSERT_THROW(reader.record(records.size()), Codecs::CodecException);
+}
+
+TEST(ArchiveTest, ModelFromCache) {
+    Codecs::HuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    Codecs::TempDir models("archive-models");
+    Codecs::ModelCache cache(models.path(), 1 << 20, Codecs::make_huffman_codec);
+    uint64_t fingerprint = cache.store(Codecs::CodecType::HUFFMAN, codec);
+
+    Codecs::TempDir dir("archive");
+    std::string path = dir.file("fingerprint.cda");
+    {
+        Codecs::ArchiveWriter writer(path, Codecs::CodecType::HUFFMAN, codec, false);
+        ASSERT_EQ(fingerprint, writer.fingerprint());
+        writer.add("lorem ipsum");
+        writer.add("dolor sit amet");
+    }
+
+    Codecs::ArchiveReader reader(path);
+    ASSERT_FALSE(reader.has_model());
+    ASSERT_EQ(fingerprint, reader.fingerprint());
+    ASSERT_THROW(reader.codec(Codecs::make_huffman_codec), Codecs::CodecException);
+
+    auto loaded = reader.codec(Codecs::make_huffman_codec, &cache);
+    std::string decoded;
+    reader.decode(decoded, 1, *loaded);
+    ASSERT_EQ("dolor sit amet", decoded);
+}
+
+TEST(ArchiveTest, RejectsBrokenFiles) {
+    Codecs::HuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    Codecs::TempDir dir("archive");
+    std::string path = dir.file("broken.cda");
+    {
+        Codecs::ArchiveWriter writer(path, Codecs::CodecType::HUFFMAN, codec);
+        for (const auto& record : Codecs::lorem_records()) {
+            writer.add(record);
+        }
+    }
+    std::string content = read_file(path);
+    ASSERT_NO_THROW(Codecs::ArchiveReader{path});
+
+    for (size_t size : {size_t(0), size_t(10), content.size() / 2, content.size() - 1}) {
+        write_file(path, content.substr(0, size));
+        ASSERT_THROW(Codecs::ArchiveReader{path}, Codecs::CodecException) << size;
+    }
+
+    std::string corrupted = content;
+    corrupted[20] ^= 1;
+    write_file(path, corrupted);
+    ASSERT_THROW(Codecs::ArchiveReader{path}, Codecs::CodecException);
+
+    corrupted = content;
+    corrupted[content.size() - 24] ^= 8;
+    write_file(path, corrupted);
+    ASSERT_THROW(Codecs::ArchiveReader{path}, Codecs::CodecException);
+
+    // version 1 archives are read unless their payloads changed since
+    std::string old = content;
+    old[4] = 1;
+    write_file(path, old);
+    ASSERT_EQ("", open_error(path));
+    old[4] = 3;
+    write_file(path, old);
+    ASSERT_NE(std::string::npos, open_error(path).find("unsupported archive version 3"));
+
+    Codecs::DictHuffmanCodec dict_huffman;
+    dict_huffman.learn({Codecs::LOREM_IPSUM});
+    {
+        Codecs::ArchiveWriter writer(path, Codecs::CodecType::DICT_HUFFMAN, dict_huffman);
+        writer.add(Codecs::LOREM_IPSUM);
+    }
+    old = read_file(path);
+    ASSERT_EQ("", open_error(path));
+    old[4] = 1;
+    write_file(path, old);
+    ASSERT_NE(std::string::npos, open_error(path).find("unsupported archive version 1 for dict-huffman"));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
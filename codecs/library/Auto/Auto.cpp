@@ -0,0 +1,293 @@
+#include "Auto.h"
+
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/Factory/Factory.h>
+#include <library/Huffman/Huffman.h>
+#include <library/common/histogram.h>
+#include <library/common/inspect.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace Codecs {
+
+    namespace {
+
+        const size_t CALIBRATION_BYTES = 4 << 20;
+        const size_t CALIBRATION_RECORD_BYTES = 1 << 20;
+
+        void write_double(string& out, double val) {
+            char buff[8];
+            memcpy(buff, &val, 8);
+            out.append(buff, 8);
+        }
+
+        double redundancy(const uint64_t (&counts)[256]) {
+            uint64_t total = 0;
+            for (uint64_t n : counts) {
+                total += n;
+            }
+            return total ? 1.0 - entropy_bits(counts) / (8.0 * total) : 0.0;
+        }
+
+        double read_double(const string& in, size_t& pos) {
+            if (pos + 8 > in.size()) {
+                cthrow("truncated AutoCodec model");
+            }
+            double res;
+            memcpy(&res, in.data() + pos, 8);
+            pos += 8;
+            return res;
+        }
+    }
+
+    const size_t AutoCodec::ESTIMATE_WINDOWS;
+
+    AutoCodec::AutoCodec()
+        : AutoCodec({CodecType::HUFFMAN, CodecType::DICT_HUFFMAN, CodecType::ZLIB})
+    {}
+
+    AutoCodec::AutoCodec(const vector<CodecType>& types, const Options& options)
+        : options(options)
+    {
+        for (CodecType type : types) {
+            codecs.push_back({type, make_codec(type), 1.0, 0.0, 0.0});
+        }
+    }
+
+    void AutoCodec::histogram(const string_view& raw, uint64_t (&counts)[256], double& scale) const {
+        std::fill(std::begin(counts), std::end(counts), 0);
+        size_t window = options.estimate_bytes / ESTIMATE_WINDOWS;
+        if (raw.size() <= options.estimate_bytes || !window) {
+            count_bytes(raw, counts);
+            scale = 1.0;
+            return;
+        }
+        size_t step = (raw.size() - window) / (ESTIMATE_WINDOWS - 1);
+        for (size_t i = 0; i < ESTIMATE_WINDOWS; ++i) {
+            count_bytes(raw.substr(i * step, window), counts);
+        }
+        scale = static_cast<double>(raw.size()) / (window * ESTIMATE_WINDOWS);
+    }
+
+    double AutoCodec::raw_estimate(const Candidate& candidate, const uint64_t (&counts)[256]) const {
+        double bits = 0;
+        switch (candidate.type) {
+            case CodecType::HUFFMAN: {
+                const HuffmanCodec& codec = static_cast<const HuffmanCodec&>(*candidate.codec);
+                for (unsigned c = 0; c < 256; ++c) {
+                    unsigned len = codec.code_length(static_cast<unsigned char>(c));
+                    bits += counts[c] * static_cast<double>(len ? len : codec.escape_length() + 8);
+                }
+                break;
+            }
+            case CodecType::DICT_HUFFMAN: {
+                const DictHuffmanCodec& codec = static_cast<const DictHuffmanCodec&>(*candidate.codec);
+                for (unsigned c = 0; c < 256; ++c) {
+                    if (counts[c]) {
+                        bits += counts[c] * static_cast<double>(codec.byte_code_length(static_cast<unsigned char>(c)));
+                    }
+                }
+                break;
+            }
+            default:
+                bits = entropy_bits(counts);
+                break;
+        }
+        return bits / 8;
+    }
+
+    double AutoCodec::scaled_estimate(const Candidate& candidate, const uint64_t (&counts)[256], double scale) const {
+        double trust = candidate.redundancy > 0 ? std::min(1.0, redundancy(counts) / candidate.redundancy) : 1.0;
+        double factor = 1.0 - (1.0 - candidate.factor) * trust;
+        return raw_estimate(candidate, counts) * scale * factor;
+    }
+
+    double AutoCodec::estimate(const Candidate& candidate, const string_view& raw) const {
+        uint64_t counts[256];
+        double scale;
+        histogram(raw, counts, scale);
+        return scaled_estimate(candidate, counts, scale);
+    }
+
+    CodecType AutoCodec::choose(const string_view& raw) const {
+        CodecType best = CodecType::STORED;
+        double best_size = raw.size() * (1.0 - options.min_gain);
+        if (raw.empty()) {
+            return best;
+        }
+        uint64_t counts[256];
+        double scale;
+        histogram(raw, counts, scale);
+        for (const auto& candidate : codecs) {
+            if (candidate.ns_per_byte > options.cpu_budget_ns_per_byte) {
+                continue;
+            }
+            double size = scaled_estimate(candidate, counts, scale);
+            if (size < best_size) {
+                best_size = size;
+                best = candidate.type;
+            }
+        }
+        return best;
+    }
+
+    void AutoCodec::encode(string& encoded, const string_view& raw) const {
+        CodecType type = choose(raw);
+        encoded.clear();
+        if (type != CodecType::STORED) {
+            for (const auto& candidate : codecs) {
+                if (candidate.type == type) {
+                    string payload;
+                    candidate.codec->encode(payload, raw);
+                    if (payload.size() < raw.size()) {
+                        encoded.reserve(payload.size() + 1);
+                        encoded.push_back(static_cast<char>(type));
+                        encoded.append(payload);
+                        return;
+                    }
+                    break;
+                }
+            }
+        }
+        encoded.reserve(raw.size() + 1);
+        encoded.push_back(static_cast<char>(CodecType::STORED));
+        encoded.append(raw.data(), raw.size());
+    }
+
+    void AutoCodec::decode(string& raw, const string_view& encoded) const {
+        if (encoded.empty()) {
+            cthrow("empty AutoCodec payload");
+        }
+        CodecType type = static_cast<CodecType>(static_cast<uint8_t>(encoded[0]));
+        raw.clear();
+        if (type == CodecType::STORED) {
+            raw.assign(encoded.data() + 1, encoded.size() - 1);
+            return;
+        }
+        for (const auto& candidate : codecs) {
+            if (candidate.type == type) {
+                candidate.codec->decode(raw, encoded.substr(1));
+                return;
+            }
+        }
+        cthrow("record was encoded with codec type " << static_cast<unsigned>(type) << " which is not loaded");
+    }
+
+    string AutoCodec::save() const {
+        string out;
+        out.push_back(static_cast<char>(codecs.size()));
+        for (const auto& candidate : codecs) {
+            out.push_back(static_cast<char>(candidate.type));
+            write_double(out, candidate.factor);
+            write_double(out, candidate.redundancy);
+            write_double(out, candidate.ns_per_byte);
+            string model = candidate.codec->save();
+            write_varint(out, model.size());
+            out.append(model);
+        }
+        return out;
+    }
+
+    void AutoCodec::load(const string& saved) {
+        if (saved.empty()) {
+            cthrow("empty AutoCodec model");
+        }
+        // the candidates are kept unless the whole model loads
+        vector<Candidate> loaded;
+        size_t count = static_cast<unsigned char>(saved[0]);
+        size_t pos = 1;
+        for (size_t i = 0; i < count; ++i) {
+            if (pos >= saved.size()) {
+                cthrow("truncated AutoCodec model");
+            }
+            CodecType type = static_cast<CodecType>(static_cast<uint8_t>(saved[pos++]));
+            double factor = read_double(saved, pos);
+            double redundancy = read_double(saved, pos);
+            double ns_per_byte = read_double(saved, pos);
+            uint64_t size;
+            pos = read_varint(size, saved, pos);
+            if (size > saved.size() - pos) {
+                cthrow("truncated AutoCodec model");
+            }
+            loaded.push_back({type, make_codec(type), factor, redundancy, ns_per_byte});
+            loaded.back().codec->set_load_mode(load_mode);
+            loaded.back().codec->load(saved.substr(pos, size));
+            pos += size;
+        }
+        codecs.swap(loaded);
+    }
+
+    size_t AutoCodec::sample_bytes() const {
+        size_t result = 0;
+        for (const auto& candidate : codecs) {
+            result = std::max(result, candidate.codec->sample_bytes());
+        }
+        return result;
+    }
+
+    void AutoCodec::learn(const StringViewVector& samples) {
+        StringViewVector calibration;
+        size_t calibration_bytes = 0;
+        size_t step = std::max<size_t>(1, samples.size() / 1000);
+        for (size_t i = 0; i < samples.size() && calibration_bytes < CALIBRATION_BYTES; i += step) {
+            calibration.push_back(samples[i].substr(0, CALIBRATION_RECORD_BYTES));
+            calibration_bytes += calibration.back().size();
+        }
+
+        uint64_t calibration_counts[256] = {0};
+        count_bytes(calibration, calibration_counts, 1);
+
+        for (auto& candidate : codecs) {
+            candidate.codec->reset();
+            candidate.codec->learn(samples);
+            candidate.factor = 1.0;
+            candidate.redundancy = 0.0;
+            candidate.ns_per_byte = 0.0;
+
+            double estimated = 0;
+            double actual = 0;
+            std::chrono::nanoseconds spent(0);
+            string encoded;
+            uint64_t counts[256];
+            double scale;
+            for (const auto& record : calibration) {
+                histogram(record, counts, scale);
+                estimated += raw_estimate(candidate, counts) * scale;
+                auto start = std::chrono::high_resolution_clock::now();
+                candidate.codec->encode(encoded, record);
+                spent += std::chrono::high_resolution_clock::now() - start;
+                actual += encoded.size();
+            }
+            if (estimated > 0) {
+                candidate.factor = actual / estimated;
+                candidate.redundancy = redundancy(calibration_counts);
+            }
+            if (calibration_bytes) {
+                candidate.ns_per_byte = static_cast<double>(spent.count()) / calibration_bytes;
+            }
+        }
+    }
+
+    void AutoCodec::reset() {
+        for (auto& candidate : codecs) {
+            candidate.codec->reset();
+            candidate.factor = 1.0;
+            candidate.redundancy = 0.0;
+            candidate.ns_per_byte = 0.0;
+        }
+    }
+
+    bool AutoCodec::inspect(ModelInfo& info) const {
+        info.add_structure("candidates", codecs.size(), heap_bytes(codecs), true, false);
+        for (const auto& candidate : codecs) {
+            ModelInfo nested;
+            if (candidate.codec->inspect(nested)) {
+                info.merge(nested, string(codec_type_name(candidate.type)) + "/");
+            }
+        }
+        return true;
+    }
+
+}
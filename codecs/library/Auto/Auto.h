@@ -0,0 +1,89 @@
+#pragma once
+
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <limits>
+#include <memory>
+
+namespace Codecs {
+
+    struct AutoCodecOptions {
+        // candidates slower than this (measured while learning) are never used
+        double cpu_budget_ns_per_byte = std::numeric_limits<double>::infinity();
+        // how many bytes of a record go into the histogram
+        size_t estimate_bytes = 4096;
+        // a codec has to beat storing by this share of the record size to be used
+        double min_gain = 0.02;
+    };
+
+
+    // Picks the codec with the smallest expected output for every record and prefixes the payload
+    // with one byte holding its CodecType. Records nothing can shrink are stored as is.
+    //
+    // The output size is estimated from a histogram of a few windows of the record, without encoding:
+    // Huffman uses its code lengths directly, DictHuffman the code lengths of its single byte entries
+    // and zlib the order-0 entropy, both scaled by a factor calibrated on the training sample. The factor
+    // is only trusted as much as the record is as redundant (1 - entropy / 8) as the training sample, so
+    // high entropy records are not expected to shrink just because the training data did.
+    class AutoCodec : public CodecIFace {
+    public:
+        using Options = AutoCodecOptions;
+
+        struct Candidate {
+            CodecType type;
+            std::unique_ptr<CodecIFace> codec;
+            double factor;
+            double redundancy;
+            double ns_per_byte;
+        };
+
+        AutoCodec();
+
+        explicit AutoCodec(const vector<CodecType>& types, const Options& options = Options());
+
+        void encode(string& encoded, const string_view& raw) const override;
+
+        void decode(string& raw, const string_view& encoded) const override;
+
+        string save() const override;
+
+        void load(const string&) override;
+
+        size_t sample_bytes() const override;
+
+        void learn(const StringViewVector& samples) override;
+
+        void reset() override;
+
+        // passed on to the candidates
+        void set_load_mode(LoadMode mode) override {
+            load_mode = mode;
+        }
+
+        bool inspect(ModelInfo& info) const override;
+
+        // expected encoded size of `raw` for the candidate, in bytes
+        double estimate(const Candidate& candidate, const string_view& raw) const;
+
+        CodecType choose(const string_view& raw) const;
+
+        const vector<Candidate>& candidates() const {
+            return codecs;
+        }
+
+    private:
+        static const size_t ESTIMATE_WINDOWS = 8;
+
+        Options options;
+        LoadMode load_mode = LoadMode::BOTH;
+        vector<Candidate> codecs;
+
+        void histogram(const string_view& raw, uint64_t (&counts)[256], double& scale) const;
+
+        double raw_estimate(const Candidate& candidate, const uint64_t (&counts)[256]) const;
+
+        double scaled_estimate(const Candidate& candidate, const uint64_t (&counts)[256], double scale) const;
+    };
+
+}
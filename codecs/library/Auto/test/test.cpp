@@ -0,0 +1,100 @@
+#include <library/Auto/Auto.h>
+#include <library/common/frame.h>
+#include <library/tests_common/tests_common.h>
+
+#include <random>
+
+namespace {
+
+    std::string random_bytes(size_t size) {
+        std::mt19937 generator(42);
+        std::string result(size, '\0');
+        for (auto& c : result) {
+            c = static_cast<char>(generator() & 0xFF);
+        }
+        return result;
+    }
+
+}
+
+TEST(AutoCodecTest, Works) {
+    Codecs::AutoCodec codec;
+    Codecs::test_simple(codec);
+};
+
+TEST(AutoCodecTest, StoresIncompressibleRecords) {
+    Codecs::AutoCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+
+    std::string raw = random_bytes(10000);
+    ASSERT_EQ(Codecs::CodecType::STORED, codec.choose(raw));
+    std::string encoded;
+    codec.encode(encoded, raw);
+    ASSERT_EQ(raw.size() + 1, encoded.size());
+    Codecs::test_roundtrip(codec, raw);
+};
+
+TEST(AutoCodecTest, CompressesText) {
+    Codecs::AutoCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+
+    std::string raw = std::string(Codecs::LOREM_IPSUM) + Codecs::LOREM_IPSUM;
+    ASSERT_NE(Codecs::CodecType::STORED, codec.choose(raw));
+    std::string encoded;
+    codec.encode(encoded, raw);
+    ASSERT_LT(encoded.size(), raw.size());
+    Codecs::test_roundtrip(codec, raw);
+
+    // the estimate has to be in the right ballpark for the choice to mean anything
+    for (const auto& candidate : codec.candidates()) {
+        std::string payload;
+        candidate.codec->encode(payload, raw);
+        double estimate = codec.estimate(candidate, raw);
+        ASSERT_LT(estimate, payload.size() * 2.0);
+        ASSERT_GT(estimate, payload.size() * 0.5);
+    }
+};
+
+TEST(AutoCodecTest, RespectsCpuBudget) {
+    Codecs::AutoCodec::Options options;
+    options.cpu_budget_ns_per_byte = 0;
+    Codecs::AutoCodec codec({Codecs::CodecType::HUFFMAN, Codecs::CodecType::ZLIB}, options);
+    codec.learn({Codecs::LOREM_IPSUM});
+    ASSERT_EQ(Codecs::CodecType::STORED, codec.choose(Codecs::LOREM_IPSUM));
+    Codecs::test_roundtrip(codec, Codecs::LOREM_IPSUM);
+};
+
+TEST(AutoCodecTest, KeepsCalibrationOnLoad) {
+    Codecs::AutoCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    Codecs::AutoCodec loaded;
+    loaded.load(codec.save());
+    ASSERT_EQ(codec.candidates().size(), loaded.candidates().size());
+    for (size_t i = 0; i < codec.candidates().size(); ++i) {
+        ASSERT_EQ(codec.candidates()[i].type, loaded.candidates()[i].type);
+        ASSERT_EQ(codec.candidates()[i].factor, loaded.candidates()[i].factor);
+    }
+    std::string encoded, decoded;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    loaded.decode(decoded, encoded);
+    ASSERT_EQ(Codecs::LOREM_IPSUM, decoded);
+
+    // a broken model leaves the loaded one in place: count, then type and three doubles, then the size
+    std::string saved = codec.save();
+    uint64_t size;
+    size_t model = Codecs::read_varint(size, saved, 26);
+    for (uint64_t huge : {~uint64_t(0), ~uint64_t(0) - 20, uint64_t(saved.size())}) {
+        std::string broken = saved.substr(0, 26);
+        Codecs::write_varint(broken, huge);
+        broken += saved.substr(model);
+        ASSERT_THROW(loaded.load(broken), Codecs::CodecException) << huge;
+        ASSERT_EQ(codec.candidates().size(), loaded.candidates().size());
+        loaded.decode(decoded, encoded);
+        ASSERT_EQ(Codecs::LOREM_IPSUM, decoded);
+    }
+};
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
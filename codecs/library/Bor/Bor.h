@@ -2,6 +2,9 @@
 
 #include <algorithm>
 #include <library/common/codec.h>
+#include <library/Bor/CompactTrie.h>
+
+#include <cctype>
 
 #include <cstdint>
 #include <forward_list>
@@ -12,43 +15,64 @@
 
 namespace Codecs {
 
+    enum class BorBoundaries {
+        BYTES,      // substrings start and end at any byte
+        CHARACTERS, // substrings start and end on UTF-8 character boundaries
+        WORDS,      // substrings start and end on word boundaries, see BOR::is_word_char
+    };
+
+    struct BorOptions {
+        // CHARACTERS learns better dictionaries of non ASCII text, at up to twice the trie nodes on CJK
+        BorBoundaries boundaries = BorBoundaries::BYTES;
+        // in characters, bytes for BorBoundaries::BYTES
+        size_t max_length = 11;
+    };
+
     class BOR {
     public:
         typedef std::pair<std::string, double> dict_entry;
+        using Options = BorOptions;
 
-        struct node {
-            bool is_end;
-            std::map<unsigned char, size_t> next;
-            uintmax_t quantity;
-
-            node() : is_end(false), next(), quantity(0) { }
+        explicit BOR(const Options &options = Options()) : options(options) { }
 
-            size_t get_transition(unsigned char symbol) const {
-                auto It = next.find(symbol);
-                if (It != next.end()) {
-                    return It->second;
-                } else {
-                    return 0;
+        // length of the UTF-8 character starting at `pos`, 1 for a byte which doesn't start a valid one;
+        // with `open_end` a character cut by the end of `text` is taken as whole, `text` may go on
+        static size_t char_length(const string_view &text, size_t pos, bool open_end = false) {
+            unsigned char lead = static_cast<unsigned char>(text[pos]);
+            size_t length = lead < 0x80 ? 1 : lead < 0xC2 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 0;
+            if (length < 2) {
+                return 1;
+            }
+            if (pos + length > text.size()) {
+                if (!open_end) {
+                    return 1;
                 }
+                length = text.size() - pos;
             }
-
-            void set_transition(unsigned char symbol, size_t pos) {
-                next[symbol] = pos;
+            for (size_t i = 1; i < length; ++i) {
+                if ((static_cast<unsigned char>(text[pos + i]) & 0xC0) != 0x80) {
+                    return 1;
+                }
             }
+            return length;
+        }
 
-            node(uintmax_t q) : node() {
-                quantity = q;
-            }
-        };
+        // letters, digits, '_' and every non ASCII character, so words of any script are kept whole;
+        // a word boundary lies before and after every other character
+        static bool is_word_char(const string_view &text, size_t pos) {
+            unsigned char c = static_cast<unsigned char>(text[pos]);
+            return c >= 0x80 || isalnum(c) || c == '_';
+        }
 
     private:
-        const uint_fast16_t MAX_SUBSTR_L = 11;
         const double CRITERIA_EPS = 0.00000;
         //const size_t SUBSTR_TO_GET = 600;
 
+        Options options;
         uintmax_t tot_lenth;
-        std::vector<node> bor;
+        CompactTrie bor;
         std::vector<dict_entry> dict;
+        std::vector<bool> unit_chars, unit_ends;
 
         bool criteria(uintmax_t concat_q, uintmax_t prefix_q, uintmax_t last_letter_q, size_t s_lenth) const {
             if (s_lenth == 1) {
@@ -64,67 +88,141 @@ namespace Codecs {
             return concat_p >= 4 * prefix_p * letter_p - CRITERIA_EPS;
         }
 
+        // marks the ends of the characters of `text` in `ends`
+        void character_ends(const string_view &text, std::vector<bool> &ends, bool open_end = false) const {
+            ends.assign(text.size() + 1, false);
+            ends[0] = true;
+            for (size_t pos = 0; pos < text.size();) {
+                pos += options.boundaries == BorBoundaries::BYTES ? 1 : char_length(text, pos, open_end);
+                ends[pos] = true;
+            }
+        }
+
+        // the character ends of `text` which are also word boundaries
+        void word_ends(const string_view &text, const std::vector<bool> &chars, std::vector<bool> &ends) const {
+            ends = chars;
+            bool word = false;
+            for (size_t pos = 0; pos < text.size(); ++pos) {
+                if (!chars[pos]) {
+                    continue;
+                }
+                bool next_word = is_word_char(text, pos);
+                if (word && next_word) {
+                    ends[pos] = false;
+                }
+                word = next_word;
+            }
+        }
+
+        // the unit substrings consist of: a character, or a whole word for BorBoundaries::WORDS;
+        // the last unit of the trie path `text` starts at the returned position, `units` gets the number of them
+        size_t last_unit(const string_view &text, size_t &units) {
+            character_ends(text, unit_chars, true);
+            const std::vector<bool> *bounds = &unit_chars;
+            if (options.boundaries == BorBoundaries::WORDS) {
+                word_ends(text, unit_chars, unit_ends);
+                bounds = &unit_ends;
+            }
+            size_t begin = 0;
+            units = 0;
+            for (size_t pos = 1; pos <= text.size(); ++pos) {
+                if ((*bounds)[pos]) {
+                    ++units;
+                    if (pos != text.size()) {
+                        begin = pos;
+                    }
+                }
+            }
+            return begin;
+        }
+
+        uint32_t find(const string_view &text) const {
+            uint32_t bor_pos = 0;
+            for (char symbol : text) {
+                bor_pos = bor.child(bor_pos, static_cast<unsigned char>(symbol));
+                if (bor_pos == CompactTrie::NONE) {
+                    break;
+                }
+            }
+            return bor_pos;
+        }
+
         void ConstructBor(const StringViewVector &sample) {
-            unsigned char trans;
-            bor.resize(1);
-            bor[0] = node();
-            //uintmax_t memory = 0;
-            //uint_fast16_t node_m = sizeof node();
+            bor.clear();
+            std::vector<bool> chars, words;
             for (auto It_s = sample.begin(); It_s != sample.end(); ++It_s) {
-                for (auto start_pos = It_s->begin(); start_pos != It_s->end(); ++start_pos) {
-                    size_t bor_pos = 0;
+                character_ends(*It_s, chars);
+                const std::vector<bool> *ends = &chars;
+                if (options.boundaries == BorBoundaries::WORDS) {
+                    word_ends(*It_s, chars, words);
+                    ends = &words;
+                }
+                for (size_t start_pos = 0; start_pos != It_s->size(); ++start_pos) {
+                    if (!chars[start_pos]) {
+                        continue;
+                    }
+                    // inside a word only the character itself, so words of any length are covered
+                    size_t max_length = (*ends)[start_pos] ? options.max_length : 1;
+                    uint32_t bor_pos = 0;
                     ++tot_lenth;
-                    size_t next_pos;
-                    for (auto current_pos = start_pos;
-                         current_pos != It_s->end() && current_pos != start_pos + MAX_SUBSTR_L;
-                         ++current_pos) {
-                        trans = static_cast<unsigned char>(*current_pos);
-                        next_pos = bor[bor_pos].get_transition(trans);
-                        if (!next_pos) {
-                            bor[bor_pos].set_transition(trans, bor.size());
-                            next_pos = bor.size();
-                            bor.push_back(node());
+                    size_t length = 0;
+                    for (size_t current_pos = start_pos; current_pos != It_s->size(); ++current_pos) {
+                        bor_pos = bor.add(bor_pos, static_cast<unsigned char>((*It_s)[current_pos]));
+                        if ((*ends)[current_pos + 1] || (chars[current_pos + 1] && max_length == 1)) {
+                            bor[bor_pos].is_end = true;
+                            bor[bor_pos].quantity += 1;
+                        }
+                        if (chars[current_pos + 1] && ++length == max_length) {
+                            break;
                         }
-                        bor_pos = next_pos;
-                        bor[bor_pos].quantity += 1;
                     }
                 }
             }
-            //std::cout << memory << '\n';
         }
 
-        void BorCriteriaDFS(size_t bor_pos, unsigned transision = 0, size_t parent = 0, std::string prefix = "",
-                            size_t layer = 0) {
-            bool cool = bor_pos && criteria(bor[bor_pos].quantity,
-                                            bor[parent].quantity,
-                                            bor[bor[0].get_transition(transision)].quantity,
-                                            layer);
-            if (cool) {
-                dict.push_back({prefix, static_cast<double>(bor[bor_pos].quantity) /
-                                        static_cast<double>(tot_lenth - layer)});
-            }
-            if (cool || !bor_pos) {
-                std::string new_prefix = prefix;
-                new_prefix.push_back(0);
-                size_t next_pos;
-                for (unsigned trans = 0; trans != 256; ++trans) {
-                    next_pos = bor[bor_pos].get_transition(trans);
-                    if (next_pos) {
-                        *new_prefix.rbegin() = static_cast<unsigned char>(trans);
-                        BorCriteriaDFS(next_pos, trans, bor_pos, new_prefix, layer + 1);
+        // `path` holds the nodes of every prefix of `prefix`, `accepted` the lengths of the accepted ones;
+        // a substring is a candidate only if it's an accepted one followed by a single unit
+        void BorCriteriaDFS(uint32_t bor_pos, std::string &prefix, std::vector<uint32_t> &path,
+                            std::vector<bool> &accepted) {
+            bool cool = false;
+            if (bor_pos) {
+                size_t units;
+                size_t begin = last_unit(prefix, units);
+                if (!accepted[begin]) {
+                    return;
+                }
+                if (bor[bor_pos].is_end) {
+                    if (units == 1) {
+                        // single characters always, whole words if they are not unique
+                        cool = options.boundaries != BorBoundaries::WORDS ||
+                               char_length(prefix, 0) == prefix.size() || bor[bor_pos].quantity > 1;
+                    } else {
+                        cool = criteria(bor[bor_pos].quantity, bor[path[begin]].quantity,
+                                        bor[find(string_view(prefix).substr(begin))].quantity, units);
                     }
                 }
+                // every byte gets an entry, so any text can be encoded; the ones which are only there
+                // for that are counted once, a flat fallback is much shorter than a chain of zero weights
+                if (cool || prefix.size() == 1) {
+                    uintmax_t quantity = cool ? bor[bor_pos].quantity : std::max<uintmax_t>(bor[bor_pos].quantity, 1);
+                    dict.push_back({prefix, static_cast<double>(quantity) / static_cast<double>(tot_lenth - units)});
+                }
             }
+            accepted.push_back(cool || !bor_pos);
+            path.push_back(bor_pos);
+            prefix.push_back(0);
+            bor.for_each_child(bor_pos, [&](unsigned char trans, uint32_t next_pos) {
+                *prefix.rbegin() = static_cast<char>(trans);
+                BorCriteriaDFS(next_pos, prefix, path, accepted);
+            });
+            prefix.pop_back();
+            path.pop_back();
+            accepted.pop_back();
         }
 
         void CorrectChars() {
-            size_t next;
             for (unsigned i = 0; i != 256; ++i) {
-                next = bor[0].get_transition(i);
-                if (!next) {
-                    bor[0].set_transition(i, bor.size());
-                    bor.push_back(node(0));
-                }
+                bor.add(0, static_cast<unsigned char>(i));
             }
         }
 
@@ -134,16 +232,27 @@ namespace Codecs {
             return std::move(dict);
         }
 
-        size_t sample_size(size_t) const {
-            return 50000;
+        size_t sample_bytes() const {
+            return 16 << 20;
         };
 
+        // trie nodes built by the last learn()
+        size_t size() const {
+            return bor.size();
+        }
+
+        size_t trie_bytes() const {
+            return bor.heap_bytes();
+        }
+
         void learn(const StringViewVector &sample) {
             tot_lenth = 0;
             ConstructBor(sample);
-            dict.reserve(bor.size() + 1);
             CorrectChars();
-            BorCriteriaDFS(0);
+            std::string prefix;
+            std::vector<uint32_t> path;
+            std::vector<bool> accepted;
+            BorCriteriaDFS(0, prefix, path, accepted);
 
             /*auto compare = [](const dict_entry &x, const dict_entry &y) {
                 if ((x.first.size() == 1) == (y.first.size() == 1)) {
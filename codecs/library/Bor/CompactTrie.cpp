@@ -0,0 +1,99 @@
+#include "CompactTrie.h"
+
+#include <library/common/codec.h>
+
+#include <algorithm>
+
+namespace Codecs {
+
+    const unsigned CompactTrie::INLINE;
+    const uint32_t CompactTrie::NONE;
+
+    size_t CompactTrie::heap_bytes() const {
+        size_t result = blocks.capacity() * sizeof(blocks[0]) + (blocks.size() << BLOCK_BITS) * sizeof(Node);
+        result += wides.capacity() * sizeof(Wide) + pool.capacity() * sizeof(uint32_t);
+        for (const auto &arrays : free_arrays) {
+            result += arrays.capacity() * sizeof(uint32_t);
+        }
+        return result;
+    }
+
+    void CompactTrie::clear() {
+        blocks.clear();
+        count = 0;
+        wides.clear();
+        pool.clear();
+        for (auto &arrays : free_arrays) {
+            arrays.clear();
+        }
+        allocate_node();
+    }
+
+    uint32_t CompactTrie::allocate_node() {
+        if (count == UINT32_MAX) {
+            cthrow("trie is full, " << count << " nodes");
+        }
+        if (!(count & BLOCK_MASK)) {
+            blocks.emplace_back(new Node[BLOCK_MASK + 1]);
+        }
+        return count++;
+    }
+
+    uint32_t CompactTrie::allocate_array(unsigned size_class) {
+        if (!free_arrays[size_class].empty()) {
+            uint32_t offset = free_arrays[size_class].back();
+            free_arrays[size_class].pop_back();
+            return offset;
+        }
+        uint32_t offset = pool.size();
+        pool.resize(pool.size() + (8u << size_class));
+        return offset;
+    }
+
+    uint32_t CompactTrie::insert(uint32_t parent, unsigned char symbol) {
+        uint32_t created = allocate_node();
+        Node &node = (*this)[parent];
+        if (node.size < INLINE) {
+            unsigned pos = node.size;
+            for (; pos && node.symbols[pos - 1] > symbol; --pos) {
+                node.symbols[pos] = node.symbols[pos - 1];
+                node.children[pos] = node.children[pos - 1];
+            }
+            node.symbols[pos] = symbol;
+            node.children[pos] = created;
+            ++node.size;
+            return created;
+        }
+
+        if (node.size == INLINE) {
+            Wide wide = {{0, 0, 0, 0}, allocate_array(0), 8};
+            for (unsigned i = 0; i < INLINE; ++i) {
+                wide.bits[node.symbols[i] >> 6] |= uint64_t(1) << (node.symbols[i] & 63);
+                pool[wide.offset + i] = node.children[i];
+            }
+            node.children[0] = wides.size();
+            wides.push_back(wide);
+        }
+
+        Wide &wide = wides[node.children[0]];
+        if (node.size == wide.capacity) {
+            unsigned size_class = 0;
+            while ((8u << size_class) < wide.capacity) {
+                ++size_class;
+            }
+            uint32_t offset = allocate_array(size_class + 1);
+            std::copy(pool.begin() + wide.offset, pool.begin() + wide.offset + node.size, pool.begin() + offset);
+            free_arrays[size_class].push_back(wide.offset);
+            wide.offset = offset;
+            wide.capacity *= 2;
+        }
+        unsigned rank = wide.rank(symbol);
+        auto begin = pool.begin() + wide.offset;
+        std::copy_backward(begin + rank, begin + node.size, begin + node.size + 1);
+        begin[rank] = created;
+        wide.bits[symbol >> 6] |= uint64_t(1) << (symbol & 63);
+        ++node.size;
+        return created;
+    }
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Codecs {
+
+    // Byte trie for learning. Nodes live in fixed size blocks, so the trie grows without moving them,
+    // and are addressed by 32 bit indices. Up to INLINE children are kept inline in the node; a node
+    // with more gets a bitmap of its symbols and a dense array of the children in symbol order.
+    class CompactTrie {
+    public:
+        static const unsigned INLINE = 4;
+        // child() of a missing transition; the root is node 0 and is nobody's child
+        static const uint32_t NONE = 0;
+
+        struct Node {
+            uint32_t quantity = 0;
+            bool is_end = false;
+
+        private:
+            friend class CompactTrie;
+
+            uint16_t size = 0;
+            unsigned char symbols[INLINE];
+            // with more than INLINE children children[0] is the index in `wides`
+            uint32_t children[INLINE];
+        };
+
+        CompactTrie() {
+            clear();
+        }
+
+        Node &operator[](uint32_t index) {
+            return blocks[index >> BLOCK_BITS][index & BLOCK_MASK];
+        }
+
+        const Node &operator[](uint32_t index) const {
+            return blocks[index >> BLOCK_BITS][index & BLOCK_MASK];
+        }
+
+        uint32_t child(uint32_t parent, unsigned char symbol) const {
+            const Node &node = (*this)[parent];
+            if (node.size <= INLINE) {
+                for (unsigned i = 0; i < node.size; ++i) {
+                    if (node.symbols[i] == symbol) {
+                        return node.children[i];
+                    }
+                }
+                return NONE;
+            }
+            const Wide &wide = wides[node.children[0]];
+            uint64_t bit = uint64_t(1) << (symbol & 63);
+            if (!(wide.bits[symbol >> 6] & bit)) {
+                return NONE;
+            }
+            return pool[wide.offset + wide.rank(symbol)];
+        }
+
+        // the child of `parent` by `symbol`, created if there is none
+        uint32_t add(uint32_t parent, unsigned char symbol) {
+            uint32_t found = child(parent, symbol);
+            return found != NONE ? found : insert(parent, symbol);
+        }
+
+        // calls f(symbol, child) for every child of `parent` in the order of symbols
+        template <typename F>
+        void for_each_child(uint32_t parent, F f) const {
+            const Node &node = (*this)[parent];
+            if (node.size <= INLINE) {
+                for (unsigned i = 0; i < node.size; ++i) {
+                    f(node.symbols[i], node.children[i]);
+                }
+                return;
+            }
+            const Wide &wide = wides[node.children[0]];
+            uint32_t pos = wide.offset;
+            for (unsigned word = 0; word < 4; ++word) {
+                for (uint64_t bits = wide.bits[word]; bits; bits &= bits - 1) {
+                    f(static_cast<unsigned char>(word * 64 + __builtin_ctzll(bits)), pool[pos++]);
+                }
+            }
+        }
+
+        size_t children(uint32_t parent) const {
+            return (*this)[parent].size;
+        }
+
+        // nodes including the root
+        size_t size() const {
+            return count;
+        }
+
+        size_t heap_bytes() const;
+
+        // leaves the root alone
+        void clear();
+
+    private:
+        static const unsigned BLOCK_BITS = 16;
+        static const uint32_t BLOCK_MASK = (1u << BLOCK_BITS) - 1;
+        // dense arrays take 8 << class slots of `pool`
+        static const unsigned SIZE_CLASSES = 6;
+
+        struct Wide {
+            uint64_t bits[4];
+            uint32_t offset;
+            uint32_t capacity;
+
+            // children with a smaller symbol
+            unsigned rank(unsigned char symbol) const {
+                unsigned result = 0;
+                for (unsigned word = 0; word < (symbol >> 6); ++word) {
+                    result += __builtin_popcountll(bits[word]);
+                }
+                return result + __builtin_popcountll(bits[symbol >> 6] & ((uint64_t(1) << (symbol & 63)) - 1));
+            }
+        };
+
+        std::vector<std::unique_ptr<Node[]>> blocks;
+        uint32_t count = 0;
+        std::vector<Wide> wides;
+        std::vector<uint32_t> pool;
+        std::vector<uint32_t> free_arrays[SIZE_CLASSES];
+
+        uint32_t allocate_node();
+
+        uint32_t insert(uint32_t parent, unsigned char symbol);
+
+        uint32_t allocate_array(unsigned size_class);
+    };
+
+}
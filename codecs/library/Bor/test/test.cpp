@@ -1,31 +1,171 @@
 #include <library/Bor/Bor.h>
-#include <experimental/string_view>
-#include <iostream>
-#include <string>
-#include <vector>
-// #include <library/tests_common/tests_common.h>
+#include <library/Synthetic/Synthetic.h>
+#include <library/tests_common/tests_common.h>
 
-/*TEST(HuffmanCodecTest, Works) {
-    Codecs::HuffmanCodec codec;
-    Codecs::TestSimple(codec);
-};
+#include <map>
+#include <random>
+#include <set>
 
-int main(int argc, char **argv) {
-    ::testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
+namespace {
+
+    Codecs::StringVector sample(Codecs::TextKind kind) {
+        Codecs::CorpusGenerator::Options options;
+        options.kind = kind;
+        options.sizes = Codecs::SizeDistribution::log_normal(128, 0.7, 8, 1024);
+        return Codecs::CorpusGenerator(options).records(300);
+    }
+
+    std::vector<Codecs::BOR::dict_entry> learn(const Codecs::StringVector& records, Codecs::BorBoundaries boundaries,
+                                               size_t max_length = 11, size_t* nodes = nullptr) {
+        Codecs::BorOptions options;
+        options.boundaries = boundaries;
+        options.max_length = max_length;
+        Codecs::BOR bor(options);
+        bor.learn(Codecs::StringViewVector(records.begin(), records.end()));
+        if (nodes) {
+            *nodes = bor.size();
+        }
+        return bor.move();
+    }
+
+    // number of characters, 0 if `text` isn't a sequence of whole UTF-8 characters
+    size_t characters(const std::string& text) {
+        size_t count = 0;
+        for (size_t pos = 0; pos < text.size(); ++count) {
+            size_t length = Codecs::BOR::char_length(text, pos);
+            if (length == 1 && static_cast<unsigned char>(text[pos]) >= 0x80) {
+                return 0;
+            }
+            pos += length;
+        }
+        return count;
+    }
+
+    void check_every_byte(const std::vector<Codecs::BOR::dict_entry>& dict) {
+        std::set<unsigned char> bytes;
+        for (const auto& entry : dict) {
+            if (entry.first.size() == 1) {
+                bytes.insert(entry.first[0]);
+            }
+        }
+        ASSERT_EQ(256u, bytes.size());
+    }
+}
+
+TEST(CompactTrieTest, MatchesMap) {
+    Codecs::CompactTrie trie;
+    std::vector<std::map<unsigned char, uint32_t>> reference(1);
+    std::mt19937 random(5);
+    for (int i = 0; i < 200000; ++i) {
+        uint32_t parent = i % 8 ? random() % reference.size() : random() % std::min<size_t>(4, reference.size());
+        // skewed, so some nodes get all 256 children and most only a few
+        unsigned char symbol = parent < 4 ? random() % 256 : random() % (1 + parent % 12);
+        uint32_t child = trie.add(parent, symbol);
+        auto inserted = reference[parent].insert({symbol, child});
+        if (inserted.second) {
+            ASSERT_EQ(reference.size(), child);
+            reference.emplace_back();
+            ++trie[child].quantity;
+        } else {
+            ASSERT_EQ(inserted.first->second, child);
+        }
+    }
+    ASSERT_EQ(reference.size(), trie.size());
+    for (uint32_t node = 0; node < reference.size(); ++node) {
+        ASSERT_EQ(reference[node].size(), trie.children(node));
+        auto It = reference[node].begin();
+        trie.for_each_child(node, [&](unsigned char symbol, uint32_t child) {
+            ASSERT_EQ(It->first, symbol);
+            ASSERT_EQ(It->second, child);
+            ASSERT_EQ(child, trie.child(node, symbol));
+            ++It;
+        });
+        for (unsigned symbol = 0; symbol < 256; ++symbol) {
+            if (!reference[node].count(symbol)) {
+                ASSERT_EQ(Codecs::CompactTrie::NONE, trie.child(node, symbol));
+            }
+        }
+    }
+    ASSERT_EQ(256u, trie.children(0));
+    ASSERT_EQ(1u, trie[1].quantity);
+    ASSERT_LT(trie.heap_bytes(), 64 * trie.size());
+
+    trie.clear();
+    ASSERT_EQ(1u, trie.size());
+    ASSERT_EQ(0u, trie.children(0));
 }
-*/
 
-int main() {
-    Codecs::BOR codec;
+TEST(BorTest, CharLength) {
+    ASSERT_EQ(1u, Codecs::BOR::char_length("a", 0));
+    ASSERT_EQ(2u, Codecs::BOR::char_length("\xD0\xB0", 0));
+    ASSERT_EQ(3u, Codecs::BOR::char_length("\xE4\xB8\x80", 0));
+    ASSERT_EQ(4u, Codecs::BOR::char_length("\xF0\x9F\x98\x80", 0));
+    // continuation byte, cut and broken characters
+    ASSERT_EQ(1u, Codecs::BOR::char_length("\xB0", 0));
+    ASSERT_EQ(1u, Codecs::BOR::char_length("\xE4\xB8", 0));
+    ASSERT_EQ(2u, Codecs::BOR::char_length("\xE4\xB8", 0, true));
+    ASSERT_EQ(1u, Codecs::BOR::char_length("\xD0" "a", 0));
+}
+
+TEST(BorTest, BytesSplitCharacters) {
+    auto dict = learn(sample(Codecs::TextKind::CYRILLIC), Codecs::BorBoundaries::BYTES);
+    check_every_byte(dict);
+    size_t split = 0;
+    for (const auto& entry : dict) {
+        split += entry.first.size() > 1 && !characters(entry.first);
+    }
+    ASSERT_GT(split, 0u);
+}
+
+TEST(BorTest, CharacterBoundaries) {
+    auto records = sample(Codecs::TextKind::MIXED);
+    for (size_t max_length : {4u, 11u}) {
+        auto dict = learn(records, Codecs::BorBoundaries::CHARACTERS, max_length);
+        check_every_byte(dict);
+        size_t longest = 0;
+        for (const auto& entry : dict) {
+            if (entry.first.size() > 1) {
+                size_t count = characters(entry.first);
+                ASSERT_GT(count, 0u) << entry.first;
+                longest = std::max(longest, count);
+            }
+        }
+        ASSERT_EQ(max_length, longest);
+    }
+}
 
-    codec.learn(
-            {"Lorem ipsum dolor sit amet, consectetur ababa adipisicing elit, "
-                     "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua."
-                     "Ut ababa enim ad minim veniam, quis ababac nostrud exercitation ullamco ba laboris"
-                     "nisi ut aliquip ex ea commodo ababa consequat. Duis aute ababa irure dolor in reprehenderit in"
-                     "voluptate velit esse ea cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat"
-                     "non proident, sunt in culpa qui officia deserunt mollit anim id est laborum."});
+TEST(BorTest, WordBoundaries) {
+    auto records = sample(Codecs::TextKind::CYRILLIC);
+    size_t char_nodes, word_nodes;
+    learn(records, Codecs::BorBoundaries::CHARACTERS, 11, &char_nodes);
+    auto dict = learn(records, Codecs::BorBoundaries::WORDS, 11, &word_nodes);
+    ASSERT_LT(word_nodes, char_nodes);
+    check_every_byte(dict);
 
-    return 0;
+    auto boundary = [](const std::string& record, size_t pos) {
+        return pos == 0 || pos == record.size() || !Codecs::BOR::is_word_char(record, pos - 1) ||
+               !Codecs::BOR::is_word_char(record, pos);
+    };
+    size_t words = 0;
+    for (const auto& entry : dict) {
+        const std::string& text = entry.first;
+        if (characters(text) < 2) {
+            continue;
+        }
+        // learned from an occurrence which doesn't cut a word
+        bool whole = false;
+        for (const auto& record : records) {
+            for (size_t pos = record.find(text); pos != std::string::npos && !whole; pos = record.find(text, pos + 1)) {
+                whole = boundary(record, pos) && boundary(record, pos + text.size());
+            }
+        }
+        ASSERT_TRUE(whole) << text;
+        words += text.find(' ') == std::string::npos;
+    }
+    ASSERT_GT(words, 0u);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
 }
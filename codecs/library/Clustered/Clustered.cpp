@@ -0,0 +1,374 @@
+#include "Clustered.h"
+
+#include <library/Factory/Factory.h>
+#include <library/common/histogram.h>
+#include <library/common/inspect.h>
+#include <library/common/stats.h>
+#include <library/common/thread_pool.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace Codecs {
+
+    namespace {
+
+        using Profile = ClusteredCodec::Profile;
+
+        float distance(const Profile& x, const Profile& y) {
+            float result = 0;
+            for (size_t i = 0; i < x.size(); ++i) {
+                float difference = x[i] - y[i];
+                result += difference * difference;
+            }
+            return result;
+        }
+
+        struct Nearest {
+            uint32_t cluster;
+            float distance;
+        };
+
+        Nearest nearest(const Profile& point, const vector<Profile>& centroids) {
+            Nearest result = {0, distance(point, centroids[0])};
+            for (uint32_t cluster = 1; cluster < centroids.size(); ++cluster) {
+                float to_cluster = distance(point, centroids[cluster]);
+                if (to_cluster < result.distance) {
+                    result = {cluster, to_cluster};
+                }
+            }
+            return result;
+        }
+
+        // uniform in [0, 1), the same on every platform
+        double uniform(std::mt19937_64& generator) {
+            return (generator() >> 11) * (1.0 / (uint64_t(1) << 53));
+        }
+
+        // runs `work(begin, end, task)` over about 4 ranges of `size` items per thread of `pool`
+        template <typename Work>
+        size_t run_chunks(WorkStealingPool& pool, size_t size, Work work) {
+            size_t tasks = std::max<size_t>(1, std::min(size, pool.threads() * 4));
+            for (size_t task = 0; task < tasks; ++task) {
+                pool.submit([=, &work]() {
+                    work(size * task / tasks, size * (task + 1) / tasks, task);
+                });
+            }
+            pool.wait();
+            return tasks;
+        }
+
+        // k-means++ seeding: every next centroid is a point drawn with probability proportional to its
+        // squared distance to the centroids so far; stops early if all points are centroids
+        vector<Profile> seed_centroids(const vector<Profile>& points, size_t k, uint64_t seed) {
+            std::mt19937_64 generator(seed);
+            vector<Profile> centroids(1, points[generator() % points.size()]);
+            vector<float> distances(points.size());
+            for (size_t i = 0; i < points.size(); ++i) {
+                distances[i] = distance(points[i], centroids[0]);
+            }
+            while (centroids.size() < k) {
+                double total = 0;
+                for (float to_centroid : distances) {
+                    total += to_centroid;
+                }
+                if (total <= 0) {
+                    break;
+                }
+                double target = uniform(generator) * total;
+                size_t pick = 0;
+                for (; pick + 1 < points.size() && (target -= distances[pick]) >= 0; ++pick) {
+                }
+                centroids.push_back(points[pick]);
+                for (size_t i = 0; i < points.size(); ++i) {
+                    distances[i] = std::min(distances[i], distance(points[i], centroids.back()));
+                }
+            }
+            return centroids;
+        }
+
+        // Lloyd's k-means over `centroids`, returns the cluster of every point. The last step is always an
+        // assignment, so the clusters are the ones the final centroids route to.
+        vector<uint32_t> k_means(const vector<Profile>& points, vector<Profile>& centroids, size_t iterations,
+                                 WorkStealingPool& pool) {
+            const size_t k = centroids.size();
+            vector<uint32_t> assignment(points.size(), UINT32_MAX);
+            vector<float> distances(points.size());
+            // per task: sums and counts of the points of every cluster, and how many points moved
+            size_t max_tasks = std::max<size_t>(1, std::min(points.size(), pool.threads() * 4));
+            vector<vector<std::array<double, 256>>> sums(max_tasks, vector<std::array<double, 256>>(k));
+            vector<vector<uint64_t>> counts(max_tasks, vector<uint64_t>(k));
+            vector<uint64_t> moved(max_tasks);
+
+            for (size_t round = 0;; ++round) {
+                size_t tasks = run_chunks(pool, points.size(), [&](size_t begin, size_t end, size_t task) {
+                    for (auto& sum : sums[task]) {
+                        sum.fill(0);
+                    }
+                    std::fill(counts[task].begin(), counts[task].end(), 0);
+                    moved[task] = 0;
+                    for (size_t i = begin; i < end; ++i) {
+                        Nearest to = nearest(points[i], centroids);
+                        moved[task] += to.cluster != assignment[i];
+                        assignment[i] = to.cluster;
+                        distances[i] = to.distance;
+                        ++counts[task][to.cluster];
+                        for (size_t c = 0; c < 256; ++c) {
+                            sums[task][to.cluster][c] += points[i][c];
+                        }
+                    }
+                });
+                uint64_t changed = 0;
+                for (size_t task = 0; task < tasks; ++task) {
+                    changed += moved[task];
+                }
+                if (!changed || round == iterations) {
+                    return assignment;
+                }
+
+                vector<uint64_t> sizes(k, 0);
+                for (size_t cluster = 0; cluster < k; ++cluster) {
+                    std::array<double, 256> sum;
+                    sum.fill(0);
+                    for (size_t task = 0; task < tasks; ++task) {
+                        sizes[cluster] += counts[task][cluster];
+                        for (size_t c = 0; c < 256; ++c) {
+                            sum[c] += sums[task][cluster][c];
+                        }
+                    }
+                    if (sizes[cluster]) {
+                        for (size_t c = 0; c < 256; ++c) {
+                            centroids[cluster][c] = static_cast<float>(sum[c] / sizes[cluster]);
+                        }
+                    }
+                }
+                // an empty cluster restarts at the point farthest from its centroid
+                for (size_t cluster = 0; cluster < k; ++cluster) {
+                    if (sizes[cluster]) {
+                        continue;
+                    }
+                    size_t far = 0;
+                    for (size_t i = 1; i < points.size(); ++i) {
+                        if (distances[i] > distances[far]) {
+                            far = i;
+                        }
+                    }
+                    centroids[cluster] = points[far];
+                    distances[far] = 0;
+                }
+            }
+        }
+
+        void write_float(string& out, float value) {
+            char bytes[4];
+            memcpy(bytes, &value, 4);
+            out.append(bytes, 4);
+        }
+
+    }
+
+    const size_t ClusteredCodec::MAX_CLUSTERS;
+    const size_t ClusteredCodec::ROUTE_WINDOWS;
+
+    ClusteredCodec::ClusteredCodec(CodecType type, const Options& options)
+        : type(type)
+        , options(options)
+    {
+        if (!options.clusters || options.clusters > MAX_CLUSTERS) {
+            cthrow("ClusteredCodec can train 1 to " << MAX_CLUSTERS << " models, not " << options.clusters);
+        }
+        reset();
+    }
+
+    void ClusteredCodec::profile(const string_view& raw, Profile& out) const {
+        uint64_t counts[256] = {0};
+        size_t window = options.route_bytes / ROUTE_WINDOWS;
+        if (raw.size() <= options.route_bytes || !window) {
+            count_bytes(raw, counts);
+        } else {
+            size_t step = (raw.size() - window) / (ROUTE_WINDOWS - 1);
+            for (size_t i = 0; i < ROUTE_WINDOWS; ++i) {
+                count_bytes(raw.substr(i * step, window), counts);
+            }
+        }
+        uint64_t total = 0;
+        for (uint64_t n : counts) {
+            total += n;
+        }
+        for (size_t c = 0; c < 256; ++c) {
+            out[c] = total ? std::sqrt(static_cast<float>(counts[c]) / total) : 0.0f;
+        }
+    }
+
+    size_t ClusteredCodec::route(const string_view& raw) const {
+        if (centroids.size() == 1) {
+            return 0;
+        }
+        Profile point;
+        profile(raw, point);
+        return nearest(point, centroids).cluster;
+    }
+
+    void ClusteredCodec::encode_with(string& encoded, const string_view& raw, CodecStats* stats) const {
+        size_t cluster = route(raw);
+        string payload;
+        models[cluster]->encode(payload, raw, stats);
+        encoded.clear();
+        encoded.reserve(payload.size() + 1);
+        encoded.push_back(static_cast<char>(cluster));
+        encoded.append(payload);
+        if (stats) {
+            stats->output_bits += 8;
+        }
+    }
+
+    void ClusteredCodec::encode(string& encoded, const string_view& raw) const {
+        encode_with(encoded, raw, nullptr);
+    }
+
+    void ClusteredCodec::encode(string& encoded, const string_view& raw, CodecStats* stats) const {
+        encode_with(encoded, raw, stats);
+    }
+
+    void ClusteredCodec::decode(string& raw, const string_view& encoded) const {
+        if (encoded.empty()) {
+            cthrow("empty ClusteredCodec payload");
+        }
+        size_t cluster = static_cast<unsigned char>(encoded[0]);
+        if (cluster >= models.size()) {
+            cthrow("record was encoded with model " << cluster << " of " << models.size());
+        }
+        raw.clear();
+        models[cluster]->decode(raw, encoded.substr(1));
+    }
+
+    string ClusteredCodec::save() const {
+        string out;
+        out.push_back(static_cast<char>(type));
+        write_varint(out, models.size());
+        for (size_t cluster = 0; cluster < models.size(); ++cluster) {
+            for (float value : centroids[cluster]) {
+                write_float(out, value);
+            }
+            string model = models[cluster]->save();
+            write_varint(out, model.size());
+            out.append(model);
+        }
+        return out;
+    }
+
+    void ClusteredCodec::load(const string& saved) {
+        if (saved.empty()) {
+            cthrow("empty ClusteredCodec model");
+        }
+        CodecType loaded_type = static_cast<CodecType>(static_cast<uint8_t>(saved[0]));
+        uint64_t count;
+        size_t pos = read_varint(count, saved, 1);
+        if (!count || count > MAX_CLUSTERS) {
+            cthrow("bad ClusteredCodec model count " << count);
+        }
+        vector<Profile> loaded_centroids(count);
+        vector<std::unique_ptr<CodecIFace>> loaded_models;
+        for (size_t cluster = 0; cluster < count; ++cluster) {
+            if (saved.size() - pos < sizeof(Profile)) {
+                cthrow("truncated ClusteredCodec model");
+            }
+            memcpy(loaded_centroids[cluster].data(), saved.data() + pos, sizeof(Profile));
+            pos += sizeof(Profile);
+            uint64_t size;
+            pos = read_varint(size, saved, pos);
+            if (size > saved.size() - pos) {
+                cthrow("truncated ClusteredCodec model");
+            }
+            loaded_models.push_back(make_codec(loaded_type));
+            loaded_models.back()->set_load_mode(load_mode);
+            loaded_models.back()->load(saved.substr(pos, size));
+            pos += size;
+        }
+        type = loaded_type;
+        centroids = std::move(loaded_centroids);
+        models = std::move(loaded_models);
+    }
+
+    size_t ClusteredCodec::sample_bytes() const {
+        return models[0]->sample_bytes() * options.clusters;
+    }
+
+    void ClusteredCodec::learn(const StringViewVector& samples) {
+        // empty records tell nothing about any cluster
+        StringViewVector records;
+        for (const auto& sample : samples) {
+            if (!sample.empty()) {
+                records.push_back(sample);
+            }
+        }
+        if (records.empty()) {
+            reset();
+            return;
+        }
+        WorkStealingPool pool(options.threads);
+        vector<Profile> points(records.size());
+        run_chunks(pool, records.size(), [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                profile(records[i], points[i]);
+            }
+        });
+        vector<Profile> learned_centroids = seed_centroids(points, options.clusters, options.seed);
+        vector<uint32_t> assignment = k_means(points, learned_centroids, options.iterations, pool);
+
+        vector<StringViewVector> members(learned_centroids.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            members[assignment[i]].push_back(records[i]);
+        }
+        // nothing routes to a cluster left empty by the last assignment
+        size_t kept = 0;
+        for (size_t cluster = 0; cluster < members.size(); ++cluster) {
+            if (members[cluster].empty()) {
+                continue;
+            }
+            if (kept != cluster) {
+                learned_centroids[kept] = learned_centroids[cluster];
+                members[kept] = std::move(members[cluster]);
+            }
+            ++kept;
+        }
+        learned_centroids.resize(kept);
+        members.resize(kept);
+        vector<std::unique_ptr<CodecIFace>> learned_models;
+        for (size_t cluster = 0; cluster < members.size(); ++cluster) {
+            learned_models.push_back(make_codec(type));
+            learned_models.back()->set_load_mode(load_mode);
+        }
+        for (size_t cluster = 0; cluster < members.size(); ++cluster) {
+            pool.submit([&, cluster]() {
+                learned_models[cluster]->learn(members[cluster]);
+            });
+        }
+        pool.wait();
+        centroids = std::move(learned_centroids);
+        models = std::move(learned_models);
+    }
+
+    void ClusteredCodec::reset() {
+        Profile zero;
+        zero.fill(0);
+        centroids.assign(1, zero);
+        models.clear();
+        models.push_back(make_codec(type));
+        models.back()->set_load_mode(load_mode);
+        models.back()->reset();
+    }
+
+    bool ClusteredCodec::inspect(ModelInfo& info) const {
+        info.add_structure("centroids", centroids.size(), heap_bytes(centroids), true, false);
+        for (size_t cluster = 0; cluster < models.size(); ++cluster) {
+            ModelInfo nested;
+            if (models[cluster]->inspect(nested)) {
+                info.merge(nested, "cluster" + std::to_string(cluster) + "/");
+            }
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <array>
+#include <memory>
+
+namespace Codecs {
+
+    struct ClusteredOptions {
+        // models to train, at most ClusteredCodec::MAX_CLUSTERS; fewer if the sample has fewer records
+        size_t clusters = 4;
+        // k-means rounds, fewer if no record changes its cluster
+        size_t iterations = 20;
+        // how many bytes of a record go into its histogram
+        size_t route_bytes = 4096;
+        // clustering and training threads, 0 for one per core
+        size_t threads = 0;
+        uint64_t seed = 5489;
+    };
+
+    // Trains one model of a codec type per cluster of similar records, so a corpus mixing languages and
+    // formats gets a specialized code for each of them, and every model stays small.
+    //
+    // learn() clusters the sample by byte histograms with k-means, the assignment and update steps split
+    // between threads, and trains the models of the clusters in parallel. encode() routes a record to the
+    // model of the nearest centroid and prefixes the payload of that model with its index byte.
+    //
+    // Histograms are compared by the squared Euclidean distance of the square roots of byte frequencies
+    // (the squared Hellinger distance), so frequent bytes don't drown out the rare ones which tell
+    // scripts and formats apart, and k-means means stay meaningful.
+    //
+    // decode() replaces `raw`, whatever the codec of the models does.
+    class ClusteredCodec : public CodecIFace {
+    public:
+        using Options = ClusteredOptions;
+        using Profile = std::array<float, 256>;
+
+        static const size_t MAX_CLUSTERS = 256;
+        static const size_t ROUTE_WINDOWS = 8;
+
+        explicit ClusteredCodec(CodecType type = CodecType::HUFFMAN, const Options& options = Options());
+
+        void encode(string& encoded, const string_view& raw) const override;
+
+        // the counters of the model the record went to, plus its index byte
+        void encode(string& encoded, const string_view& raw, CodecStats* stats) const override;
+
+        void decode(string& raw, const string_view& encoded) const override;
+
+        string save() const override;
+
+        void load(const string&) override;
+
+        // the sample of every model is what its codec asks for
+        size_t sample_bytes() const override;
+
+        void learn(const StringViewVector& samples) override;
+
+        void reset() override;
+
+        // passed on to the models
+        void set_load_mode(LoadMode mode) override {
+            load_mode = mode;
+        }
+
+        bool inspect(ModelInfo& info) const override;
+
+        // square roots of the byte frequencies of a few windows of `raw`
+        void profile(const string_view& raw, Profile& out) const;
+
+        // index of the model encode() uses for `raw`
+        size_t route(const string_view& raw) const;
+
+        size_t clusters() const {
+            return models.size();
+        }
+
+        const CodecIFace& model(size_t cluster) const {
+            return *models[cluster];
+        }
+
+        CodecType codec_type() const {
+            return type;
+        }
+
+    private:
+        CodecType type;
+        Options options;
+        LoadMode load_mode = LoadMode::BOTH;
+        vector<Profile> centroids;
+        vector<std::unique_ptr<CodecIFace>> models;
+
+        void encode_with(string& encoded, const string_view& raw, CodecStats* stats) const;
+    };
+
+}
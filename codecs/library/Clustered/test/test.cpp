@@ -0,0 +1,107 @@
+#include <library/Clustered/Clustered.h>
+#include <library/Huffman/Huffman.h>
+#include <library/common/inspect.h>
+#include <library/tests_common/tests_common.h>
+
+#include <map>
+
+namespace {
+
+    const Codecs::TextKind KINDS[] = {Codecs::TextKind::ASCII, Codecs::TextKind::CYRILLIC, Codecs::TextKind::JSON};
+
+    // records of one kind each, the kinds taking turns; record i is of kind KINDS[i % 3]
+    Codecs::StringVector mixed_corpus(size_t begin, size_t end) {
+        std::vector<Codecs::StringVector> corpora;
+        for (Codecs::TextKind kind : KINDS) {
+            corpora.push_back(Codecs::test_corpus(kind, end));
+        }
+        Codecs::StringVector result;
+        for (size_t i = begin; i < end; ++i) {
+            result.push_back(corpora[i % 3][i]);
+        }
+        return result;
+    }
+
+}
+
+TEST(ClusteredCodecTest, Works) {
+    Codecs::ClusteredCodec codec;
+    Codecs::test_simple(codec);
+}
+
+TEST(ClusteredCodecTest, WorksWithoutModel) {
+    Codecs::ClusteredCodec codec(Codecs::CodecType::LZ77);
+    ASSERT_EQ(1u, codec.clusters());
+    Codecs::test_roundtrip(codec, "");
+    Codecs::test_roundtrip(codec, Codecs::LOREM_IPSUM);
+    // nothing to cluster
+    codec.learn({"", ""});
+    ASSERT_EQ(1u, codec.clusters());
+    Codecs::test_roundtrip(codec, "a");
+}
+
+TEST(ClusteredCodecTest, RoutesByKind) {
+    auto sample = mixed_corpus(0, 1500);
+    Codecs::StringViewVector views(sample.begin(), sample.end());
+    Codecs::ClusteredOptions options;
+    options.clusters = 3;
+    options.threads = 2;
+    Codecs::ClusteredCodec codec(Codecs::CodecType::HUFFMAN, options);
+    codec.learn(views);
+    ASSERT_EQ(3u, codec.clusters());
+
+    Codecs::HuffmanCodec single;
+    single.learn(views);
+
+    // new records go to the model of their kind
+    auto records = mixed_corpus(1500, 1800);
+    Codecs::StringViewVector tests(records.begin(), records.end());
+    std::map<size_t, size_t> model_of_kind;
+    for (size_t i = 0; i < tests.size(); ++i) {
+        size_t kind = (1500 + i) % 3;
+        size_t model = codec.route(tests[i]);
+        if (!model_of_kind.count(kind)) {
+            model_of_kind[kind] = model;
+        }
+        ASSERT_EQ(model_of_kind[kind], model) << i;
+        Codecs::test_roundtrip(codec, tests[i]);
+    }
+    ASSERT_EQ(3u, model_of_kind.size());
+    ASSERT_NE(model_of_kind[0], model_of_kind[1]);
+    ASSERT_NE(model_of_kind[0], model_of_kind[2]);
+    ASSERT_NE(model_of_kind[1], model_of_kind[2]);
+    ASSERT_LT(Codecs::bits_per_byte(codec, tests) * 1.1, Codecs::bits_per_byte(single, tests));
+}
+
+TEST(ClusteredCodecTest, SaveLoad) {
+    auto sample = mixed_corpus(0, 600);
+    Codecs::StringViewVector views(sample.begin(), sample.end());
+    Codecs::ClusteredCodec codec(Codecs::CodecType::DICT_HUFFMAN);
+    codec.learn(views);
+
+    // the model type comes from the model
+    Codecs::ClusteredCodec loaded;
+    loaded.set_load_mode(Codecs::LoadMode::DECODE);
+    loaded.load(codec.save());
+    ASSERT_EQ(Codecs::CodecType::DICT_HUFFMAN, loaded.codec_type());
+    ASSERT_EQ(codec.clusters(), loaded.clusters());
+    std::string encoded, decoded;
+    for (size_t i = 0; i < 60; ++i) {
+        codec.encode(encoded, sample[i]);
+        loaded.decode(decoded, encoded);
+        ASSERT_EQ(sample[i], decoded);
+    }
+    ASSERT_THROW(loaded.load(codec.save().substr(0, 100)), Codecs::CodecException);
+    encoded[0] = static_cast<char>(codec.clusters());
+    ASSERT_THROW(codec.decode(decoded, encoded), Codecs::CodecException);
+
+    Codecs::ModelInfo info;
+    ASSERT_TRUE(codec.inspect(info));
+    ASSERT_EQ("centroids", info.structures[0].name);
+    ASSERT_GT(info.structures.size(), codec.clusters());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,160 @@
+#include "Corpus.h"
+
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Codecs {
+
+    MappedFile::MappedFile(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            cthrow("can't open " << path << ": " << strerror(errno));
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            cthrow("can't stat " << path << ": " << strerror(errno));
+        }
+        length = info.st_size;
+        if (length) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                cthrow("can't mmap " << path << ": " << strerror(errno));
+            }
+            begin = static_cast<const char*>(mapped);
+        }
+        close(fd);
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            begin = other.begin;
+            length = other.length;
+            other.begin = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        unmap();
+    }
+
+    void MappedFile::unmap() {
+        if (begin) {
+            munmap(const_cast<char*>(begin), length);
+            begin = nullptr;
+            length = 0;
+        }
+    }
+
+    void MappedFile::advise_sequential() const {
+        if (begin) {
+            madvise(const_cast<char*>(begin), length, MADV_SEQUENTIAL);
+            madvise(const_cast<char*>(begin), length, MADV_WILLNEED);
+        }
+    }
+
+    void MappedFile::advise_random() const {
+        if (begin) {
+            madvise(const_cast<char*>(begin), length, MADV_RANDOM);
+        }
+    }
+
+    Corpus::Corpus(const string& path, CorpusFormat format, size_t threads)
+        : mapping(path)
+    {
+        mapping.advise_sequential();
+        if (format == CorpusFormat::LINES) {
+            index_lines(entries, mapping.view(), threads);
+        } else {
+            index_le_uint32(entries, mapping.view());
+        }
+        for (const auto& record : entries) {
+            bytes += record.size();
+        }
+    }
+
+    void Corpus::index_lines(StringViewVector& records, const string_view& data, size_t threads) {
+        records.clear();
+        if (data.empty()) {
+            return;
+        }
+        threads = std::max<size_t>(1, std::min(threads, data.size() / (1 << 20) + 1));
+
+        // every thread collects the line ends of its own chunk, then chunks are stitched in order
+        vector<vector<size_t>> ends(threads);
+        auto scan = [&data, &ends, threads](size_t part) {
+            size_t from = data.size() / threads * part;
+            size_t to = part + 1 == threads ? data.size() : data.size() / threads * (part + 1);
+            const char* base = data.data();
+            const char* pos = base + from;
+            const char* end = base + to;
+            while (pos < end) {
+                const char* found = static_cast<const char*>(memchr(pos, '\n', end - pos));
+                if (!found) {
+                    break;
+                }
+                ends[part].push_back(found - base);
+                pos = found + 1;
+            }
+        };
+        vector<std::thread> workers;
+        for (size_t part = 1; part < threads; ++part) {
+            workers.emplace_back(scan, part);
+        }
+        scan(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        size_t total = 1;
+        for (const auto& part : ends) {
+            total += part.size();
+        }
+        records.reserve(total);
+        size_t start = 0;
+        for (const auto& part : ends) {
+            for (size_t end : part) {
+                records.push_back(data.substr(start, end - start));
+                start = end + 1;
+            }
+        }
+        // like getline, a trailing newline does not start one more empty record
+        if (start < data.size()) {
+            records.push_back(data.substr(start));
+        }
+    }
+
+    void Corpus::index_le_uint32(StringViewVector& records, const string_view& data) {
+        records.clear();
+        size_t pos = 0;
+        while (pos < data.size()) {
+            if (pos + 4 > data.size()) {
+                cthrow("truncated record size at offset " << pos);
+            }
+            uint32_t entry_size = 0;
+            for (int j = 0; j < 4; ++j) {
+                entry_size |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos + j])) << (j * 8);
+            }
+            pos += 4;
+            if (entry_size > data.size() - pos) {
+                cthrow("record at offset " << pos - 4 << " of size " << entry_size << " overruns the file");
+            }
+            records.push_back(data.substr(pos, entry_size));
+            pos += entry_size;
+        }
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <library/common/codec.h>
+
+namespace Codecs {
+
+    // Read-only memory mapping of a whole file.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(const string& path);
+
+        MappedFile(MappedFile&& other) noexcept;
+
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        const char* data() const {
+            return begin;
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+        string_view view() const {
+            return string_view(begin, length);
+        }
+
+        // hints for the page cache, see madvise(2)
+        void advise_sequential() const;
+
+        void advise_random() const;
+
+    private:
+        const char* begin = nullptr;
+        size_t length = 0;
+
+        void unmap();
+    };
+
+    enum class CorpusFormat {
+        LINES,      // records separated by '\n'
+        LE_UINT32,  // every record is prefixed with its size as little endian uint32
+    };
+
+    // Records of a memory mapped test or training file, as string_views into the mapping.
+    // Nothing is copied: the records stay valid as long as the Corpus is alive.
+    class Corpus {
+    public:
+        Corpus() = default;
+
+        // `threads` > 1 splits the index building of LINES files between several threads
+        Corpus(const string& path, CorpusFormat format, size_t threads = 1);
+
+        const StringViewVector& records() const {
+            return entries;
+        }
+
+        size_t size() const {
+            return entries.size();
+        }
+
+        const string_view& operator[](size_t i) const {
+            return entries[i];
+        }
+
+        uint64_t total_bytes() const {
+            return bytes;
+        }
+
+        const MappedFile& file() const {
+            return mapping;
+        }
+
+        static void index_lines(StringViewVector& records, const string_view& data, size_t threads);
+
+        static void index_le_uint32(StringViewVector& records, const string_view& data);
+
+    private:
+        MappedFile mapping;
+        StringViewVector entries;
+        uint64_t bytes = 0;
+    };
+
+}
@@ -0,0 +1,84 @@
+#include <library/Corpus/Corpus.h>
+#include <library/tests_common/tests_common.h>
+
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+    std::string temp_file(const std::string& content) {
+        char path[] = "/tmp/corpus-XXXXXX";
+        int fd = mkstemp(path);
+        close(fd);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+        return path;
+    }
+
+    std::string le_record(const std::string& record) {
+        std::string out;
+        for (int j = 0; j < 4; ++j) {
+            out.push_back(static_cast<char>((record.size() >> (8 * j)) & 0xFF));
+        }
+        return out + record;
+    }
+
+}
+
+TEST(CorpusTest, Lines) {
+    Codecs::Corpus corpus(temp_file("first\n\nthird line\nlast"), Codecs::CorpusFormat::LINES);
+    ASSERT_EQ(4u, corpus.size());
+    ASSERT_EQ("first", corpus[0].to_string());
+    ASSERT_EQ("", corpus[1].to_string());
+    ASSERT_EQ("third line", corpus[2].to_string());
+    ASSERT_EQ("last", corpus[3].to_string());
+    ASSERT_EQ(19u, corpus.total_bytes());
+
+    Codecs::Corpus trailing(temp_file("a\nb\n"), Codecs::CorpusFormat::LINES);
+    ASSERT_EQ(2u, trailing.size());
+
+    Codecs::Corpus empty(temp_file(""), Codecs::CorpusFormat::LINES);
+    ASSERT_EQ(0u, empty.size());
+}
+
+TEST(CorpusTest, ParallelIndexMatchesSerial) {
+    std::string data;
+    for (size_t i = 0; i < 100000; ++i) {
+        data.append(std::string(i % 57, 'x') + std::to_string(i) + "\n");
+    }
+    Codecs::StringViewVector serial, parallel;
+    Codecs::Corpus::index_lines(serial, data, 1);
+    for (size_t threads : {2, 3, 8}) {
+        Codecs::Corpus::index_lines(parallel, data, threads);
+        ASSERT_EQ(serial.size(), parallel.size());
+        for (size_t i = 0; i < serial.size(); ++i) {
+            ASSERT_EQ(serial[i].data(), parallel[i].data());
+            ASSERT_EQ(serial[i].size(), parallel[i].size());
+        }
+    }
+    ASSERT_EQ(100000u, serial.size());
+}
+
+TEST(CorpusTest, LittleEndianSizes) {
+    std::string big(70000, 'z');
+    Codecs::Corpus corpus(temp_file(le_record("abc") + le_record("") + le_record(big) + le_record("a\nb")),
+                          Codecs::CorpusFormat::LE_UINT32);
+    ASSERT_EQ(4u, corpus.size());
+    ASSERT_EQ("abc", corpus[0].to_string());
+    ASSERT_EQ("", corpus[1].to_string());
+    ASSERT_EQ(big, corpus[2].to_string());
+    ASSERT_EQ("a\nb", corpus[3].to_string());
+}
+
+TEST(CorpusTest, RejectsTruncatedFiles) {
+    std::string truncated = le_record("abcdef");
+    truncated.resize(truncated.size() - 1);
+    ASSERT_THROW(Codecs::Corpus(temp_file(truncated), Codecs::CorpusFormat::LE_UINT32), Codecs::CodecException);
+    ASSERT_THROW(Codecs::Corpus("/nonexistent/corpus", Codecs::CorpusFormat::LINES), Codecs::CodecException);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
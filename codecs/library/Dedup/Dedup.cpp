@@ -0,0 +1,185 @@
+#include "Dedup.h"
+
+#include <library/common/inspect.h>
+
+namespace Codecs {
+
+    const size_t DedupCache::ENTRY_OVERHEAD;
+
+    DedupCache::DedupCache(size_t budget_bytes, size_t shard_count) {
+        size_t count = 1;
+        while (count < shard_count) {
+            count <<= 1;
+        }
+        shard_budget = budget_bytes / count;
+        shard_mask = count - 1;
+        shards.reset(new Shard[count]);
+    }
+
+    bool DedupCache::find(const Hash128& hash, const string_view& key, string& out) {
+        Shard& shard = shard_of(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto found = shard.index.find(hash);
+        if (found == shard.index.end() || string_view(shard.slots[found->second].key) != key) {
+            ++shard.misses;
+            return false;
+        }
+        Slot& slot = shard.slots[found->second];
+        slot.referenced = true;
+        out.assign(slot.value);
+        ++shard.hits;
+        return true;
+    }
+
+    void DedupCache::insert(const Hash128& hash, const string_view& key, const string_view& value) {
+        size_t charge = key.size() + value.size() + ENTRY_OVERHEAD;
+        if (charge > shard_budget) {
+            return;
+        }
+        Shard& shard = shard_of(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        // another thread missed on the same record and got here first, or another record collides
+        if (shard.index.count(hash)) {
+            return;
+        }
+        while (shard.bytes + charge > shard_budget) {
+            evict_one(shard);
+        }
+        size_t position;
+        if (shard.free_slots.empty()) {
+            position = shard.slots.size();
+            shard.slots.push_back(Slot());
+        } else {
+            position = shard.free_slots.back();
+            shard.free_slots.pop_back();
+        }
+        Slot& slot = shard.slots[position];
+        slot.hash = hash;
+        slot.key.assign(key.data(), key.size());
+        slot.value.assign(value.data(), value.size());
+        slot.used = true;
+        // a new entry has to be looked up again before it is worth a second chance
+        slot.referenced = false;
+        shard.index.emplace(hash, position);
+        shard.bytes += charge;
+        ++shard.insertions;
+    }
+
+    void DedupCache::evict_one(Shard& shard) {
+        // the hand clears reference bits until it finds an entry nobody used since its last pass
+        for (;; shard.hand = (shard.hand + 1) % shard.slots.size()) {
+            Slot& slot = shard.slots[shard.hand];
+            if (!slot.used) {
+                continue;
+            }
+            if (slot.referenced) {
+                slot.referenced = false;
+                continue;
+            }
+            shard.bytes -= slot.key.size() + slot.value.size() + ENTRY_OVERHEAD;
+            shard.index.erase(slot.hash);
+            string().swap(slot.key);
+            string().swap(slot.value);
+            slot.used = false;
+            shard.free_slots.push_back(shard.hand);
+            ++shard.evictions;
+            shard.hand = (shard.hand + 1) % shard.slots.size();
+            return;
+        }
+    }
+
+    void DedupCache::clear() {
+        for (size_t i = 0; i <= shard_mask; ++i) {
+            Shard& shard = shards[i];
+            std::lock_guard<std::mutex> guard(shard.lock);
+            shard.index.clear();
+            shard.slots.clear();
+            shard.free_slots.clear();
+            shard.hand = 0;
+            shard.bytes = 0;
+        }
+    }
+
+    DedupCache::Stats DedupCache::stats() const {
+        Stats result = Stats();
+        for (size_t i = 0; i <= shard_mask; ++i) {
+            const Shard& shard = shards[i];
+            std::lock_guard<std::mutex> guard(shard.lock);
+            result.hits += shard.hits;
+            result.misses += shard.misses;
+            result.insertions += shard.insertions;
+            result.evictions += shard.evictions;
+            result.entries += shard.index.size();
+            result.bytes += shard.bytes;
+        }
+        return result;
+    }
+
+    DedupCodec::DedupCodec(std::unique_ptr<CodecIFace> codec, const Options& options)
+        : codec(std::move(codec))
+        , options(options)
+        , encode_cache(options.encode_bytes, options.shards)
+        , decode_cache(options.decode_bytes, options.shards)
+    {
+        if (!this->codec) {
+            cthrow("DedupCodec needs a codec to wrap");
+        }
+    }
+
+    void DedupCodec::encode(string& encoded, const string_view& raw) const {
+        if (!options.encode_bytes || raw.size() > options.max_record_bytes) {
+            codec->encode(encoded, raw);
+            return;
+        }
+        Hash128 hash = hash128(raw);
+        if (encode_cache.find(hash, raw, encoded)) {
+            return;
+        }
+        codec->encode(encoded, raw);
+        encode_cache.insert(hash, raw, encoded);
+    }
+
+    void DedupCodec::decode(string& raw, const string_view& encoded) const {
+        raw.clear();
+        if (!options.decode_bytes || encoded.size() > options.max_record_bytes) {
+            codec->decode(raw, encoded);
+            return;
+        }
+        Hash128 hash = hash128(encoded);
+        if (decode_cache.find(hash, encoded, raw)) {
+            return;
+        }
+        codec->decode(raw, encoded);
+        decode_cache.insert(hash, encoded, raw);
+    }
+
+    void DedupCodec::load(const string& model) {
+        codec->load(model);
+        encode_cache.clear();
+        decode_cache.clear();
+    }
+
+    void DedupCodec::learn(const StringViewVector& samples) {
+        codec->learn(samples);
+        encode_cache.clear();
+        decode_cache.clear();
+    }
+
+    void DedupCodec::reset() {
+        codec->reset();
+        encode_cache.clear();
+        decode_cache.clear();
+    }
+
+    bool DedupCodec::inspect(ModelInfo& info) const {
+        if (!codec->inspect(info)) {
+            return false;
+        }
+        DedupCache::Stats encodes = encode_cache.stats();
+        DedupCache::Stats decodes = decode_cache.stats();
+        info.add_structure("dedup encode cache", encodes.entries, encodes.bytes, true, false);
+        info.add_structure("dedup decode cache", decodes.entries, decodes.bytes, false, true);
+        return true;
+    }
+
+}
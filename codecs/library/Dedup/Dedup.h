@@ -0,0 +1,144 @@
+#pragma once
+
+#include <library/common/codec.h>
+#include <library/common/hash.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace Codecs {
+
+    // Maps inputs to outputs within a byte budget, indexed by 128 bit hashes of the inputs. An entry
+    // keeps its input and a hit compares it, so inputs which collide are only a miss. The keys are
+    // spread over shards with a lock each, so threads rarely wait for each other; every shard evicts
+    // with CLOCK (second chance), which costs a flag per lookup instead of the list moves of LRU.
+    class DedupCache {
+    public:
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t insertions;
+            uint64_t evictions;
+            size_t entries;
+            size_t bytes;
+        };
+
+        // `shards` is rounded up to a power of two; every shard gets an equal share of the budget
+        explicit DedupCache(size_t budget_bytes, size_t shards = 16);
+
+        // copies the cached output of `key`, whose hash is `hash`, into `out`, which keeps its capacity
+        bool find(const Hash128& hash, const string_view& key, string& out);
+
+        // entries larger than the budget of a shard are not kept; a key whose hash is taken by another
+        // one is not kept either
+        void insert(const Hash128& hash, const string_view& key, const string_view& value);
+
+        void clear();
+
+        Stats stats() const;
+
+        // charged besides the key and the value: the slot and the hash map node
+        static const size_t ENTRY_OVERHEAD = 64;
+
+    private:
+        struct Slot {
+            Hash128 hash;
+            string key;
+            string value;
+            bool used;
+            bool referenced;
+        };
+
+        struct Shard {
+            mutable std::mutex lock;
+            std::unordered_map<Hash128, size_t> index;
+            vector<Slot> slots;
+            vector<size_t> free_slots;
+            size_t hand = 0;
+            size_t bytes = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t insertions = 0;
+            uint64_t evictions = 0;
+        };
+
+        size_t shard_budget;
+        size_t shard_mask;
+        std::unique_ptr<Shard[]> shards;
+
+        Shard& shard_of(const Hash128& hash) {
+            return shards[hash.low & shard_mask];
+        }
+
+        static void evict_one(Shard& shard);
+    };
+
+    struct DedupOptions {
+        // budgets of the encode and decode caches, 0 turns a side off
+        size_t encode_bytes = 32 << 20;
+        size_t decode_bytes = 32 << 20;
+        size_t shards = 16;
+        // longer records go straight to the codec, they rarely repeat and would flush the cache
+        size_t max_record_bytes = 64 << 10;
+    };
+
+    // Any codec behind a DedupCache for each direction: a record seen before costs a hash of it and
+    // a copy of the cached result instead of a full encode or decode. Encode is keyed on the raw
+    // record and decode on the payload, both compared in full on a hit.
+    //
+    // decode() replaces `raw`, whatever the wrapped codec does. load(), learn() and reset() change the
+    // model and drop both caches.
+    class DedupCodec : public CodecIFace {
+    public:
+        using Options = DedupOptions;
+
+        explicit DedupCodec(std::unique_ptr<CodecIFace> codec, const Options& options = Options());
+
+        void encode(string& encoded, const string_view& raw) const override;
+
+        void decode(string& raw, const string_view& encoded) const override;
+
+        string save() const override {
+            return codec->save();
+        }
+
+        void load(const string& model) override;
+
+        size_t sample_bytes() const override {
+            return codec->sample_bytes();
+        }
+
+        void learn(const StringViewVector& samples) override;
+
+        void reset() override;
+
+        void set_load_mode(LoadMode mode) override {
+            codec->set_load_mode(mode);
+        }
+
+        // the wrapped codec plus the cached outputs
+        bool inspect(ModelInfo& info) const override;
+
+        const CodecIFace& wrapped() const {
+            return *codec;
+        }
+
+        DedupCache::Stats encode_stats() const {
+            return encode_cache.stats();
+        }
+
+        DedupCache::Stats decode_stats() const {
+            return decode_cache.stats();
+        }
+
+    private:
+        std::unique_ptr<CodecIFace> codec;
+        Options options;
+        mutable DedupCache encode_cache;
+        mutable DedupCache decode_cache;
+    };
+
+}
@@ -0,0 +1,140 @@
+#include <library/Dedup/Dedup.h>
+#include <library/Huffman/Huffman.h>
+#include <library/tests_common/tests_common.h>
+
+#include <thread>
+
+namespace {
+
+    std::unique_ptr<Codecs::DedupCodec> lorem_dedup(const Codecs::DedupOptions &options = Codecs::DedupOptions()) {
+        std::unique_ptr<Codecs::DedupCodec> codec(
+                new Codecs::DedupCodec(std::unique_ptr<Codecs::CodecIFace>(new Codecs::HuffmanCodec()), options));
+        codec->learn({Codecs::LOREM_IPSUM});
+        return codec;
+    }
+
+    // all of them 3 bytes long
+    std::string key(size_t i) {
+        return std::to_string(100 + i);
+    }
+
+    Codecs::Hash128 hash(size_t i) {
+        return Codecs::hash128(key(i));
+    }
+
+}
+
+TEST(DedupCodecTest, Works) {
+    Codecs::DedupCodec codec(std::unique_ptr<Codecs::CodecIFace>(new Codecs::HuffmanCodec()));
+    Codecs::test_simple(codec);
+}
+
+TEST(DedupCodecTest, RepeatedRecordsHit) {
+    std::unique_ptr<Codecs::DedupCodec> codec = lorem_dedup();
+    const Codecs::CodecIFace &plain = codec->wrapped();
+    Codecs::StringVector records = Codecs::lorem_records();
+    std::string expected, encoded, decoded;
+    for (int round = 0; round < 3; ++round) {
+        for (const auto &record : records) {
+            plain.encode(expected, record);
+            codec->encode(encoded, record);
+            ASSERT_EQ(expected, encoded);
+            decoded = "garbage";
+            codec->decode(decoded, encoded);
+            ASSERT_EQ(record, decoded);
+        }
+    }
+    Codecs::DedupCache::Stats encodes = codec->encode_stats();
+    ASSERT_EQ(2 * records.size(), encodes.hits);
+    ASSERT_EQ(records.size(), encodes.misses);
+    ASSERT_EQ(records.size(), encodes.entries);
+    ASSERT_EQ(2 * records.size(), codec->decode_stats().hits);
+
+    // a new model drops what the old one encoded
+    codec->learn({"abracadabra"});
+    codec->encode(encoded, records[0]);
+    ASSERT_EQ(1u, codec->encode_stats().entries);
+    codec->wrapped().encode(expected, records[0]);
+    ASSERT_EQ(expected, encoded);
+}
+
+TEST(DedupCodecTest, LongRecordsBypass) {
+    Codecs::DedupOptions options;
+    options.max_record_bytes = 10;
+    std::unique_ptr<Codecs::DedupCodec> codec = lorem_dedup(options);
+    std::string encoded;
+    codec->encode(encoded, "dolor sit amet");
+    codec->encode(encoded, "dolor sit amet");
+    ASSERT_EQ(0u, codec->encode_stats().hits + codec->encode_stats().misses);
+}
+
+TEST(DedupCodecTest, ConcurrentUse) {
+    std::unique_ptr<Codecs::DedupCodec> codec = lorem_dedup();
+    Codecs::StringVector records = Codecs::lorem_records();
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (size_t t = 0; t < failures.size(); ++t) {
+        threads.emplace_back([&, t] {
+            std::string expected, encoded, decoded;
+            for (size_t i = 0; i < 2000; ++i) {
+                const std::string &record = records[(i * 7 + t) % records.size()];
+                codec->encode(encoded, record);
+                codec->wrapped().encode(expected, record);
+                codec->decode(decoded, encoded);
+                failures[t] += encoded != expected || decoded != record;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(std::vector<int>(failures.size(), 0), failures);
+}
+
+TEST(DedupCacheTest, ClockKeepsHotEntries) {
+    const size_t value_size = 100;
+    const size_t budget = 10 * (3 + value_size + Codecs::DedupCache::ENTRY_OVERHEAD);
+    Codecs::DedupCache cache(budget, 1);
+    std::string value(value_size, 'v'), out;
+    cache.insert(hash(0), key(0), value);
+    for (size_t i = 1; i < 100; ++i) {
+        ASSERT_TRUE(cache.find(hash(0), key(0), out));
+        cache.insert(hash(i), key(i), value);
+        Codecs::DedupCache::Stats stats = cache.stats();
+        ASSERT_LE(stats.bytes, budget);
+    }
+    ASSERT_TRUE(cache.find(hash(0), key(0), out));
+    ASSERT_EQ(value, out);
+    ASSERT_TRUE(cache.find(hash(99), key(99), out));
+    ASSERT_FALSE(cache.find(hash(50), key(50), out));
+
+    Codecs::DedupCache::Stats stats = cache.stats();
+    ASSERT_EQ(10u, stats.entries);
+    ASSERT_EQ(90u, stats.evictions);
+
+    // values over the budget are not kept
+    cache.insert(hash(1000), key(1000), std::string(budget, 'x'));
+    ASSERT_FALSE(cache.find(hash(1000), key(1000), out));
+    cache.clear();
+    ASSERT_EQ(0u, cache.stats().entries);
+}
+
+TEST(DedupCacheTest, CollisionsMiss) {
+    Codecs::DedupCache cache(1 << 20);
+    std::string out = "untouched";
+    cache.insert(hash(0), key(0), "first");
+    ASSERT_FALSE(cache.find(hash(0), key(1), out));
+    ASSERT_EQ("untouched", out);
+    // the first key keeps the slot
+    cache.insert(hash(0), key(1), "second");
+    ASSERT_FALSE(cache.find(hash(0), key(1), out));
+    ASSERT_TRUE(cache.find(hash(0), key(0), out));
+    ASSERT_EQ("first", out);
+    ASSERT_EQ(2u, cache.stats().misses);
+    ASSERT_EQ(1u, cache.stats().entries);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <library/common/codec.h>
+#include <library/common/frame.h>
+#include <library/common/inspect.h>
+#include <library/common/model_side.h>
+#include <library/common/stats.h>
 #include <library/Huffman/Huffman.h>
 #include <library/Bor/Bor.h>
 
@@ -11,10 +15,24 @@
 #include <map>
 #include <math.h>
 #include <iostream>
+#include <limits>
 #include <queue>
 
 namespace Codecs {
 
+    // Speed/ratio presets of DictHuffmanCodec. All of them use the same trained model, the level is the
+    // first byte of a payload, so a decoder handles any of them. Payloads from before the level byte
+    // can't be told apart from these, frames and archives of version 1 holding them are rejected.
+    enum class DictHuffmanLevel : uint8_t {
+        // byte aligned entry indices, one byte for the most frequent entries and two for the others;
+        // decoding is a copy per index, no bit I/O
+        FAST = 0,
+        // greedy longest match, Huffman coded entries
+        HUFFMAN = 1,
+        // the parse with the fewest bits, Huffman coded entries; decodes as fast as HUFFMAN
+        OPTIMAL = 2,
+    };
+
     class DictHuffmanCodec : public CodecIFace {
     public:
         struct node {
@@ -32,7 +50,7 @@ namespace Codecs {
             bool is_leaf;
             size_t dict_n;
 
-            search_node() : next(), is_leaf(false) { }
+            search_node() : next(), is_leaf(false), dict_n(0) { }
 
             size_t get_transition(unsigned char symbol) const {
                 auto It = next.find(symbol);
@@ -47,18 +65,64 @@ namespace Codecs {
                 next[symbol] = pos;
             }
 
+            size_t transitions() const {
+                return next.size();
+            }
+
+            // heap bytes of one transition
+            static size_t transition_bytes() {
+#ifdef __GLIBCXX__
+                return sizeof(std::_Rb_tree_node<std::pair<const unsigned char, size_t>>);
+#else
+                return 3 * sizeof(void *) + sizeof(int) + sizeof(std::pair<const unsigned char, size_t>);
+#endif
+            }
+
             search_node &operator=(const search_node &) = default;
         };
+        // entries with one byte indices at DictHuffmanLevel::FAST
+        static const size_t FAST_SHORT = 128;
+        // entries DictHuffmanLevel::FAST can use, the most frequent ones plus every single unit
+        static const size_t FAST_ENTRIES = FAST_SHORT + (1 << 15);
+
         //const unsigned MAX_CODE_L = 15;
+        DictHuffmanCodec() = default;
+
+        explicit DictHuffmanCodec(DictHuffmanLevel level) : level(level) { }
+
+        // `options` only affect learn(), a saved model doesn't depend on them, nor on the level
+        explicit DictHuffmanCodec(const BorOptions &options, DictHuffmanLevel level = DictHuffmanLevel::HUFFMAN)
+                : options(options), level(level) { }
+
     private:
         const double APPROX_RATIO = 0.5;
+        // bytes the fast decoder copies at once, entries up to this long take one fixed size copy
+        static const size_t FAST_COPY = 16;
 
+        BorOptions options;
+        DictHuffmanLevel level = DictHuffmanLevel::HUFFMAN;
+        LoadMode load_mode = LoadMode::BOTH;
         std::vector<std::string> dict;
-        vector<node> code_tree;
-        node tree_root;
-        vector<vector<bool>> precounted;
-        vector<search_node> search_tree;
         vector<double> frequencies;
+        // the decoder side, built from the frequencies by load() or on first use
+        mutable vector<node> code_tree;
+        mutable node tree_root;
+        ModelSide decoder;
+        // the encoder side
+        mutable vector<vector<bool>> precounted;
+        mutable vector<search_node> search_tree;
+        ModelSide encoder;
+        // DictHuffmanLevel::FAST, the sides built on first use: the entries of the fast indices back to
+        // back in an arena padded for FAST_COPY; the dictionary entry of every fast index and a trie of
+        // them whose leaves hold fast indices
+        mutable vector<uint32_t> fast_dict;
+        mutable string fast_arena;
+        mutable vector<uint32_t> fast_offsets;
+        mutable size_t fast_longest = 0;
+        ModelSide fast_decoder;
+        mutable vector<uint32_t> fast_entries;
+        mutable vector<search_node> fast_search_tree;
+        ModelSide fast_encoder;
 
         struct queue_node {
             size_t index;
@@ -66,50 +130,183 @@ namespace Codecs {
             size_t rank;
         };
 
-        void expand_search_tree(size_t str_number) {
+        void expand_search_tree(vector<search_node> &tree, const string &entry, size_t leaf) const {
             size_t bor_pos = 0;
             size_t next_pos;
-            for (char symbol : dict[str_number]) {
+            for (char symbol : entry) {
                 unsigned char transition = static_cast<unsigned char>(symbol);
-                next_pos = search_tree[bor_pos].get_transition(transition);
+                next_pos = tree[bor_pos].get_transition(transition);
                 if (!next_pos) {
-                    search_tree[bor_pos].set_transition(transition, search_tree.size());
-                    next_pos = search_tree.size();
-                    search_tree.push_back(search_node());
+                    tree[bor_pos].set_transition(transition, tree.size());
+                    next_pos = tree.size();
+                    tree.push_back(search_node());
                 }
                 bor_pos = next_pos;
             }
-            search_tree[bor_pos].is_leaf = true;
-            search_tree[bor_pos].dict_n = str_number;
+            tree[bor_pos].is_leaf = true;
+            tree[bor_pos].dict_n = leaf;
         }
 
-        void construct_search_tree() {
+        void construct_search_tree() const {
             search_tree.resize(1);
             search_tree[0] = search_node();
             for (size_t i = 1; i != dict.size(); ++i) {
-                expand_search_tree(i);
+                expand_search_tree(search_tree, dict[i], i);
+            }
+        }
+
+        // dictionary entries of the fast indices, most frequent first: every single byte entry, so any
+        // text still parses, and the most frequent others that fit
+        vector<uint32_t> select_fast_entries() const {
+            vector<uint32_t> selected;
+            vector<uint32_t> others;
+            for (size_t i = 1; i < dict.size(); ++i) {
+                (dict[i].size() == 1 ? selected : others).push_back(i);
+            }
+            auto by_frequency = [this](uint32_t x, uint32_t y) {
+                return frequencies[x] > frequencies[y] || (frequencies[x] == frequencies[y] && x < y);
+            };
+            size_t room = FAST_ENTRIES - selected.size();
+            if (others.size() > room) {
+                std::nth_element(others.begin(), others.begin() + room, others.end(), by_frequency);
+                others.resize(room);
+            }
+            selected.insert(selected.end(), others.begin(), others.end());
+            std::sort(selected.begin(), selected.end(), by_frequency);
+            return selected;
+        }
+
+        void make_fast_decoder() const {
+            fast_dict = select_fast_entries();
+            fast_arena.clear();
+            fast_offsets.assign(1, 0);
+            fast_longest = 0;
+            for (uint32_t entry : fast_dict) {
+                fast_arena += dict[entry];
+                fast_longest = std::max(fast_longest, dict[entry].size());
+                fast_offsets.push_back(fast_arena.size());
             }
+            fast_arena.append(FAST_COPY, '\0');
         }
 
-        void code_tree_DFS(size_t pos, vector<bool> prefix = vector<bool>()) {
-            if (code_tree[pos].is_leaf) {
-                precounted[code_tree[pos].dict_n] = prefix;
+        void make_fast_encoder() const {
+            fast_entries = select_fast_entries();
+            fast_search_tree.assign(1, search_node());
+            for (size_t i = 0; i < fast_entries.size(); ++i) {
+                expand_search_tree(fast_search_tree, dict[fast_entries[i]], i);
+            }
+        }
+
+        void code_tree_DFS(const vector<node> &tree, size_t pos, vector<bool> prefix = vector<bool>()) const {
+            if (tree[pos].is_leaf) {
+                precounted[tree[pos].dict_n] = prefix;
             } else {
                 vector<bool> new_prefix = prefix;
                 new_prefix.push_back(false);
-                if (code_tree[pos].left) {
-                    code_tree_DFS(code_tree[pos].left, new_prefix);
+                if (tree[pos].left) {
+                    code_tree_DFS(tree, tree[pos].left, new_prefix);
                 }
                 *new_prefix.rbegin() = true;
-                if (code_tree[pos].right) {
-                    code_tree_DFS(code_tree[pos].right, new_prefix);
+                if (tree[pos].right) {
+                    code_tree_DFS(tree, tree[pos].right, new_prefix);
+                }
+            }
+        }
+
+        void compile_codes(const vector<node> &tree) const {
+            precounted.assign(dict.size(), vector<bool>());
+            code_tree_DFS(tree, 0);
+        }
+
+        // Huffman tree of the dictionary entries by frequency, the root copied to tree[0]
+        void build_code_tree(vector<node> &tree) const {
+            auto compare = [](const queue_node &x, const queue_node &y) -> bool { return x.frequency > y.frequency; };
+            std::priority_queue<queue_node, vector<queue_node>, decltype(compare)> q(compare);
+            tree.clear();
+            tree.reserve(2 * dict.size());
+            tree.push_back({0, 0, true, 0});
+            for (size_t j = 1; j < dict.size(); ++j) {
+                tree.push_back({0, 0, true, j});
+                q.push({j, frequencies[j], 1});
+            }
+
+            queue_node top_one, top_second;
+            while (q.size() > 1) {
+                top_one = q.top();
+                q.pop();
+                top_second = q.top();
+                q.pop();
+
+                q.push({tree.size(), top_one.frequency + top_second.frequency,
+                        std::max(top_one.rank, top_second.rank) + 1});
+                if (top_one.rank > top_second.rank) {
+                    tree.push_back({top_one.index, top_second.index, false, 0});
+                } else {
+                    tree.push_back({top_second.index, top_one.index, false, 0});
                 }
             }
+            if (!q.empty()) {
+                tree[0] = tree[q.top().index];
+            }
         }
 
-        void compile_codes() {
-            precounted.resize(dict.size());
-            code_tree_DFS(0);
+        void make_decoder() const {
+            build_code_tree(code_tree);
+            tree_root = code_tree[0];
+        }
+
+        // the tree is rebuilt rather than shared, a lazy decoder may be building code_tree meanwhile
+        void make_encoder() const {
+            vector<node> tree;
+            build_code_tree(tree);
+            compile_codes(tree);
+            construct_search_tree();
+        }
+
+        // builds the sides `mode` asks for now, see LoadMode
+        void make_sides(LoadMode mode) {
+            code_tree.clear();
+            precounted.clear();
+            search_tree.clear();
+            decoder.reset(ModelSide::of(mode, false));
+            encoder.reset(ModelSide::of(mode, true));
+            // few payloads are fast ones, so their structures are always built on first use
+            clear_fast();
+            fast_decoder.reset(ModelSide::of(mode, false) == ModelSide::MISSING ? ModelSide::MISSING : ModelSide::LAZY);
+            fast_encoder.reset(ModelSide::of(mode, true) == ModelSide::MISSING ? ModelSide::MISSING : ModelSide::LAZY);
+            if (mode == LoadMode::BOTH) {
+                make_decoder();
+                compile_codes(code_tree);
+                construct_search_tree();
+            } else if (mode == LoadMode::ENCODE) {
+                make_encoder();
+            } else if (mode == LoadMode::DECODE) {
+                make_decoder();
+            }
+        }
+
+        void require_encoder() const {
+            encoder.require("encoder", [this] { make_encoder(); });
+        }
+
+        void require_decoder() const {
+            decoder.require("decoder", [this] { make_decoder(); });
+        }
+
+        void require_fast_encoder() const {
+            fast_encoder.require("encoder", [this] { make_fast_encoder(); });
+        }
+
+        void require_fast_decoder() const {
+            fast_decoder.require("decoder", [this] { make_fast_decoder(); });
+        }
+
+        void clear_fast() {
+            fast_dict.clear();
+            fast_arena.clear();
+            fast_offsets.clear();
+            fast_entries.clear();
+            fast_search_tree.clear();
         }
 
         void serialize_64(std::ostream &out, uint64_t val) const {
@@ -182,36 +379,178 @@ namespace Codecs {
             }
         }
 
-    public:
-        void encode(string &encoded, const string_view &raw) const override {
-            BinString out;
-            out.reserve_char(raw.size() * APPROX_RATIO);
-            size_t pos;
-            size_t last_start = 0;
-            unsigned char transition;
-            while (true) {
-                pos = 0;
-                for (size_t i = last_start; i < raw.size(); ++i) {
-                    transition = static_cast<unsigned char>(raw[i]);
-                    if (!search_tree[pos].get_transition(transition)) {
-                        out.extend(precounted[search_tree[pos].dict_n]);
-                        pos = 0;
-                        last_start = i;
+        struct match {
+            size_t entry;
+            size_t end;
+            // the walk went past the end of the entry, or hit the end of the text
+            bool fallback;
+        };
+
+        // longest entry of `tree` at `start`; entries need not be prefix closed, so the walk remembers
+        // the last entry it passed and falls back to it
+        match longest_match(const vector<search_node> &tree, const string_view &raw, size_t start,
+                            uint64_t &steps) const {
+            size_t pos = 0;
+            match result = {0, start, false};
+            size_t i = start;
+            for (; i < raw.size(); ++i) {
+                pos = tree[pos].get_transition(static_cast<unsigned char>(raw[i]));
+                ++steps;
+                if (!pos) {
+                    break;
+                }
+                if (tree[pos].is_leaf) {
+                    result.entry = tree[pos].dict_n;
+                    result.end = i + 1;
+                }
+            }
+            result.fallback = i == raw.size() || result.end != i;
+            return result;
+        }
+
+        // the entries of the cheapest parse of `raw` in code bits, ties going to longer entries
+        void optimal_parse(const string_view &raw, vector<uint32_t> &entries, uint64_t &steps) const {
+            const uint64_t UNREACHABLE = std::numeric_limits<uint64_t>::max();
+            size_t n = raw.size();
+            // cheapest bits from every position to the end, and the entry starting it
+            vector<uint64_t> cost(n + 1, UNREACHABLE);
+            vector<uint32_t> choice(n, 0);
+            vector<uint32_t> choice_end(n, 0);
+            cost[n] = 0;
+            for (size_t start = n; start-- > 0;) {
+                size_t pos = 0;
+                for (size_t i = start; i < n; ++i) {
+                    pos = search_tree[pos].get_transition(static_cast<unsigned char>(raw[i]));
+                    ++steps;
+                    if (!pos) {
+                        break;
+                    }
+                    if (search_tree[pos].is_leaf && cost[i + 1] != UNREACHABLE) {
+                        size_t entry = search_tree[pos].dict_n;
+                        uint64_t bits = precounted[entry].size() + cost[i + 1];
+                        if (bits <= cost[start]) {
+                            cost[start] = bits;
+                            choice[start] = entry;
+                            choice_end[start] = i + 1;
+                        }
                     }
-                    pos = search_tree[pos].get_transition(transition);
                 }
-                if (last_start < raw.size()) {
-                    transition = static_cast<unsigned char>(raw[last_start]);
-                    out.extend(precounted[search_tree[search_tree[0].get_transition(transition)].dict_n]);
-                    ++last_start;
-                } else {
-                    break;
+            }
+            if (n && cost[0] == UNREACHABLE) {
+                cthrow("the DictHuffmanCodec dictionary can't spell the text");
+            }
+            entries.clear();
+            for (size_t start = 0; start < n; start = choice_end[start]) {
+                entries.push_back(choice[start]);
+            }
+        }
+
+        template <bool Count>
+        void encode_entries(string &encoded, const string_view &raw, CodecStats *stats) const {
+            require_encoder();
+            BinString out(string(1, static_cast<char>(level)));
+            out.reserve_char(raw.size() * APPROX_RATIO + 1);
+            uint64_t steps = 0;
+            uint64_t fallbacks = 0;
+            uint64_t symbols = 0;
+            uint64_t bits = 8;
+            if (Count && stats->dict_usage.size() < dict.size()) {
+                stats->dict_usage.resize(dict.size(), 0);
+            }
+            auto emit = [&](size_t entry) {
+                out.extend(precounted[entry]);
+                if (Count) {
+                    ++symbols;
+                    bits += precounted[entry].size();
+                    ++stats->dict_usage[entry];
+                }
+            };
+            if (level == DictHuffmanLevel::OPTIMAL) {
+                static thread_local vector<uint32_t> entries;
+                optimal_parse(raw, entries, steps);
+                for (uint32_t entry : entries) {
+                    emit(entry);
+                }
+            } else {
+                size_t start = 0;
+                while (start < raw.size()) {
+                    match found = longest_match(search_tree, raw, start, steps);
+                    if (found.end == start) {
+                        cthrow("the DictHuffmanCodec dictionary can't spell the text");
+                    }
+                    emit(found.entry);
+                    fallbacks += found.fallback;
+                    start = found.end;
                 }
             }
             encoded = out.move();
-        };
+            if (Count) {
+                ++stats->calls;
+                stats->input_bytes += raw.size();
+                stats->output_bits += bits;
+                stats->symbols += symbols;
+                stats->trie_steps += steps;
+                stats->fallbacks += fallbacks;
+            }
+        }
 
-        void decode(string &raw, const string_view &encoded) const override {
+        // the level byte, the raw size and an index per entry: FAST_SHORT one byte ones, then two byte
+        // ones with the high bit of the first byte set
+        template <bool Count>
+        void encode_fast(string &encoded, const string_view &raw, CodecStats *stats) const {
+            require_fast_encoder();
+            encoded.clear();
+            encoded.reserve(raw.size() / 2 + 11);
+            encoded.push_back(static_cast<char>(DictHuffmanLevel::FAST));
+            write_varint(encoded, raw.size());
+            uint64_t steps = 0;
+            uint64_t fallbacks = 0;
+            uint64_t symbols = 0;
+            if (Count && stats->dict_usage.size() < dict.size()) {
+                stats->dict_usage.resize(dict.size(), 0);
+            }
+            size_t start = 0;
+            while (start < raw.size()) {
+                match found = longest_match(fast_search_tree, raw, start, steps);
+                if (found.end == start) {
+                    cthrow("the DictHuffmanCodec dictionary can't spell the text");
+                }
+                size_t index = found.entry;
+                if (index < FAST_SHORT) {
+                    encoded.push_back(static_cast<char>(index));
+                } else {
+                    index -= FAST_SHORT;
+                    encoded.push_back(static_cast<char>(0x80 | (index >> 8)));
+                    encoded.push_back(static_cast<char>(index & 0xFF));
+                }
+                if (Count) {
+                    ++symbols;
+                    fallbacks += found.fallback;
+                    ++stats->dict_usage[fast_entries[found.entry]];
+                }
+                start = found.end;
+            }
+            if (Count) {
+                ++stats->calls;
+                stats->input_bytes += raw.size();
+                stats->output_bits += 8 * encoded.size();
+                stats->symbols += symbols;
+                stats->trie_steps += steps;
+                stats->fallbacks += fallbacks;
+            }
+        }
+
+        template <bool Count>
+        void encode_level(string &encoded, const string_view &raw, CodecStats *stats) const {
+            if (level == DictHuffmanLevel::FAST) {
+                encode_fast<Count>(encoded, raw, stats);
+            } else {
+                encode_entries<Count>(encoded, raw, stats);
+            }
+        }
+
+        void decode_bits(string &raw, const string_view &encoded) const {
+            require_decoder();
             bool buffer[8];
             unsigned char symbol;
             node current = tree_root;
@@ -234,8 +573,109 @@ namespace Codecs {
                     }
                 }
             }
+        }
+
+        // a copy of FAST_COPY bytes per index, the output over allocated by as much
+        void decode_fast(string &raw, const string_view &encoded) const {
+            require_fast_decoder();
+            uint64_t size;
+            size_t pos = read_varint(size, encoded);
+            if (size > (encoded.size() - pos) * fast_longest) {
+                cthrow("corrupted DictHuffmanCodec payload, size " << size);
+            }
+            size_t begin = raw.size();
+            raw.resize(begin + size + FAST_COPY);
+            char *out = &raw[begin];
+            char *end = out + size;
+            const unsigned char *in = reinterpret_cast<const unsigned char *>(encoded.data()) + pos;
+            const unsigned char *in_end = reinterpret_cast<const unsigned char *>(encoded.data()) + encoded.size();
+            const char *arena = fast_arena.data();
+            const uint32_t *offsets = fast_offsets.data();
+            const size_t entries = fast_offsets.size() - 1;
+            while (out < end) {
+                if (in == in_end) {
+                    cthrow("truncated DictHuffmanCodec payload");
+                }
+                size_t index = *in++;
+                if (index & 0x80) {
+                    if (in == in_end) {
+                        cthrow("truncated DictHuffmanCodec payload");
+                    }
+                    index = FAST_SHORT + ((index & 0x7F) << 8 | *in++);
+                }
+                if (index >= entries) {
+                    cthrow("corrupted DictHuffmanCodec payload, index " << index);
+                }
+                size_t length = offsets[index + 1] - offsets[index];
+                if (length > static_cast<size_t>(end - out)) {
+                    cthrow("corrupted DictHuffmanCodec payload, it is longer than " << size);
+                }
+                if (length <= FAST_COPY) {
+                    memcpy(out, arena + offsets[index], FAST_COPY);
+                } else {
+                    memcpy(out, arena + offsets[index], length);
+                }
+                out += length;
+            }
+            if (in != in_end) {
+                cthrow("corrupted DictHuffmanCodec payload, it is shorter than " << size);
+            }
+            raw.resize(begin + size);
+        }
+
+    public:
+        void encode(string &encoded, const string_view &raw) const override {
+            if (STATS_ENABLED) {
+                StatsRegistry::Local local(CodecType::DICT_HUFFMAN);
+                encode_level<true>(encoded, raw, &local.stats());
+            } else {
+                encode_level<false>(encoded, raw, nullptr);
+            }
         };
 
+        // also adds the counters of this call to `stats`
+        void encode(string &encoded, const string_view &raw, CodecStats *stats) const override {
+            if (!stats) {
+                encode(encoded, raw);
+                return;
+            }
+            if (!STATS_ENABLED) {
+                encode_level<true>(encoded, raw, stats);
+                return;
+            }
+            CodecStats call;
+            encode_level<true>(encoded, raw, &call);
+            StatsRegistry::add(CodecType::DICT_HUFFMAN, call);
+            stats->merge(call);
+        }
+
+        // a payload of any level
+        void decode(string &raw, const string_view &encoded) const override {
+            if (encoded.empty()) {
+                cthrow("empty DictHuffmanCodec payload");
+            }
+            unsigned char payload_level = static_cast<unsigned char>(encoded[0]);
+            switch (static_cast<DictHuffmanLevel>(payload_level)) {
+                case DictHuffmanLevel::FAST:
+                    decode_fast(raw, encoded.substr(1));
+                    return;
+                case DictHuffmanLevel::HUFFMAN:
+                case DictHuffmanLevel::OPTIMAL:
+                    decode_bits(raw, encoded.substr(1));
+                    return;
+            }
+            cthrow("unknown DictHuffmanCodec level " << static_cast<unsigned>(payload_level));
+        };
+
+        // the level of the payloads encode() writes
+        void set_level(DictHuffmanLevel new_level) {
+            level = new_level;
+        }
+
+        DictHuffmanLevel get_level() const {
+            return level;
+        }
+
         std::ostream &save(std::ostream &out) const {
             for (size_t i = 1; i < dict.size(); ++i) {
                 out << static_cast<unsigned char>(dict[i].size());
@@ -260,96 +700,132 @@ namespace Codecs {
         };
 
         void load(std::istream &in) {
-            auto compare = [](const queue_node &x, const queue_node &y) -> bool { return x.frequency > y.frequency; };
-            std::priority_queue<queue_node, vector<queue_node>, decltype(compare)> q(compare);
-            {
-                size_t str_l;
-                char buffer[50];
-                double frequency;
-                dict.resize(1);
-                code_tree.resize(1);
-                for (size_t j = 0; in.good(); ++j) {
-                    code_tree.push_back({0, 0, true, j + 1});
-                    str_l = static_cast<unsigned char>(in.get());
-                    if (!str_l) {
-                        break;
-                    }
-                    in.read(buffer, str_l);
-
-                    dict.push_back(std::string(buffer, str_l));
-                    frequency = deserialize_double(in);
-                    q.push({j + 1, frequency, 1});
+            dict.resize(1);
+            frequencies.resize(1);
+            string entry;
+            while (in.good()) {
+                size_t str_l = static_cast<unsigned char>(in.get());
+                if (!str_l) {
+                    break;
                 }
+                entry.resize(str_l);
+                in.read(&entry[0], str_l);
+                dict.push_back(entry);
+                frequencies.push_back(deserialize_double(in));
             }
+            make_sides(load_mode);
+        }
 
-            queue_node top_one, top_second;
-            while (q.size() > 1) {
-                top_one = q.top();
-                q.pop();
-                top_second = q.top();
-                q.pop();
+        // the training trie grows with the sample, this keeps it to a few hundred MB
+        size_t sample_bytes() const override {
+            return 16 << 20;
+        };
 
-                q.push({code_tree.size(), top_one.frequency + top_second.frequency,
-                        std::max(top_one.rank, top_second.rank) + 1});
-                if (top_one.rank > top_second.rank) {
-                    code_tree.push_back({top_one.index, top_second.index, false, 0});
-                } else {
-                    code_tree.push_back({top_second.index, top_one.index, false, 0});
-                }
+        void learn(const StringViewVector &samples) {
+            Codecs::BOR explorer(options);
+            explorer.learn(samples);
+            std::vector<std::pair<std::string, double>> stat = explorer.move();
+            dict.resize(stat.size() + 1);
+            frequencies.resize(stat.size() + 1);
+            for (size_t j = 0; j < stat.size(); ++j) {
+                dict[j + 1] = std::move(stat[j].first);
+                frequencies[j + 1] = stat[j].second;
             }
-            code_tree[0] = code_tree[q.top().index];
-            tree_root = code_tree[0];
+            make_sides(LoadMode::BOTH);
+        }
 
-            compile_codes();
-            construct_search_tree();
+        void set_load_mode(LoadMode mode) override {
+            load_mode = mode;
         }
 
-        size_t sample_size(size_t) const override {
-            return sample_size();
-        };
+        // entry 0 is unused, dict_usage of CodecStats is indexed the same way
+        const vector<string> &dictionary() const {
+            return dict;
+        }
 
-        size_t sample_size() const {
-            return 30000;
-        };
+        // code of a dictionary entry, first bit first
+        const vector<bool> &entry_code(size_t entry) const {
+            require_encoder();
+            return precounted[entry];
+        }
 
-        void learn(const StringViewVector &samples) {
-            auto compare = [](const queue_node &x, const queue_node &y) -> bool { return x.frequency > y.frequency; };
-            std::priority_queue<queue_node, vector<queue_node>, decltype(compare)> q(compare);
-            {
-                Codecs::BOR explorer;
-                explorer.learn(samples);
-                std::vector<std::pair<std::string, double>> stat = explorer.move();
-                dict.resize(stat.size() + 1);
-                code_tree.resize(stat.size() + 1);
-                frequencies.resize(stat.size() + 1);
-                for (size_t j = 0; j < stat.size(); ++j) {
-                    code_tree[j + 1] = {0, 0, true, j + 1};
-                    dict[j + 1] = std::move(stat[j].first);
-                    frequencies[j + 1] = stat[j].second;
-                    q.push({j + 1, stat[j].second, 1});
-                }
+        // dictionary entry of every DictHuffmanLevel::FAST index, from whichever side the model has
+        const vector<uint32_t> &fast_dictionary() const {
+            if (fast_decoder.missing()) {
+                require_fast_encoder();
+                return fast_entries;
             }
+            require_fast_decoder();
+            return fast_dict;
+        }
 
-            queue_node top_one, top_second;
-            while (q.size() > 1) {
-                top_one = q.top();
-                q.pop();
-                top_second = q.top();
-                q.pop();
+        // the Huffman tree decode() walks: tree[0] is the root and a leaf holds its dictionary entry; a
+        // model loaded without the decoder structures builds one for the call
+        void decoding_tree(vector<node> &tree) const {
+            if (decoder.missing()) {
+                build_code_tree(tree);
+                return;
+            }
+            require_decoder();
+            tree = code_tree;
+        }
 
-                q.push({code_tree.size(), top_one.frequency + top_second.frequency,
-                        std::max(top_one.rank, top_second.rank) + 1});
-                if (top_one.rank > top_second.rank) {
-                    code_tree.push_back({top_one.index, top_second.index, false, 0});
-                } else {
-                    code_tree.push_back({top_second.index, top_one.index, false, 0});
+        // code length of the single byte dictionary entry, every byte has one
+        unsigned byte_code_length(unsigned char symbol) const {
+            require_encoder();
+            return precounted[search_tree[search_tree[0].get_transition(symbol)].dict_n].size();
+        }
+
+        // describes the sides built so far, a lazy side that is not used yet takes no memory
+        bool inspect(ModelInfo &info) const override {
+            bool has_tree = decoder.ready();
+            bool has_codes = encoder.ready();
+            size_t dict_bytes = heap_bytes(dict);
+            for (const auto &entry : dict) {
+                dict_bytes += heap_bytes(entry);
+            }
+            size_t codes_bytes = 0;
+            size_t transitions = 0;
+            if (has_codes) {
+                codes_bytes = heap_bytes(precounted);
+                for (const auto &code : precounted) {
+                    codes_bytes += heap_bytes(code);
+                }
+                for (const auto &node : search_tree) {
+                    transitions += node.transitions();
                 }
             }
-            code_tree[0] = code_tree[q.top().index];
-            tree_root = code_tree[0];
-
-            compile_codes();
-            construct_search_tree();
+            info.add_structure("dict", dict.size(), dict_bytes, false, true);
+            info.add_structure("code_tree", has_tree ? code_tree.size() : 0, has_tree ? heap_bytes(code_tree) : 0,
+                               false, true);
+            info.add_structure("precounted", has_codes ? precounted.size() : 0, codes_bytes, true, false);
+            info.add_structure("search_tree", has_codes ? search_tree.size() : 0,
+                               has_codes ? heap_bytes(search_tree) : 0, true, false);
+            info.add_structure("search_tree map nodes", transitions,
+                               transitions * search_node::transition_bytes(), true, false);
+            info.add_structure("frequencies", frequencies.size(), heap_bytes(frequencies), false, false);
+            bool has_fast_decoder = fast_decoder.ready();
+            bool has_fast_encoder = fast_encoder.ready();
+            info.add_structure("fast_arena", has_fast_decoder ? fast_arena.size() : 0,
+                               has_fast_decoder ? heap_bytes(fast_arena) + heap_bytes(fast_offsets) + heap_bytes(fast_dict) : 0,
+                               false, true);
+            info.add_structure("fast_search_tree", has_fast_encoder ? fast_search_tree.size() : 0,
+                               has_fast_encoder ? heap_bytes(fast_search_tree) + heap_bytes(fast_entries) : 0,
+                               true, false);
+            // a decoder only process has the lengths in its tree
+            std::vector<uint32_t> lengths(dict.size(), 0);
+            if (has_codes) {
+                for (size_t i = 1; i < dict.size() && i < precounted.size(); ++i) {
+                    lengths[i] = precounted[i].size();
+                }
+            } else if (has_tree && !code_tree.empty() && dict.size() > 1) {
+                lenth_DFS(lengths, tree_root);
+            }
+            for (size_t i = 1; i < dict.size() && (has_codes || has_tree); ++i) {
+                info.add_code(lengths[i]);
+                info.entries.push_back({dict[i], i < frequencies.size() ? frequencies[i] : 0.0, lengths[i]});
+            }
+            return true;
         }
 
         void reset() override {
@@ -357,6 +833,12 @@ namespace Codecs {
             search_tree.clear();
             dict.clear();
             precounted.clear();
+            frequencies.clear();
+            clear_fast();
+            decoder.reset(ModelSide::READY);
+            encoder.reset(ModelSide::READY);
+            fast_decoder.reset(ModelSide::LAZY);
+            fast_encoder.reset(ModelSide::LAZY);
         };
     };
 
@@ -1,5 +1,6 @@
 #include <library/DictHuffman/DictHuffman.h>
 #include <library/Huffman/Huffman.h>
+#include <library/Synthetic/Synthetic.h>
 #include <experimental/string_view>
 #include <chrono>
 #include <fstream>
@@ -7,26 +8,27 @@
 #include <iterator>
 
 
-int main() {
+int main(int argc, char* argv[]) {
     Codecs::DictHuffmanCodec codec;
-    size_t sample_size = codec.sample_size();
+    size_t sample_bytes = codec.sample_bytes();
 
+    // the records of a file given as the argument, otherwise a synthetic mixed language corpus
+    Codecs::CorpusGenerator::Options options;
+    options.kind = Codecs::TextKind::MIXED;
+    options.sizes = Codecs::SizeDistribution::log_normal(128, 0.7, 8, 4096);
+    Codecs::CorpusGenerator generator(options);
     std::ifstream in;
-    in.open("/home/dmitry/compression-project/test-data/data1");
-
-    std::vector<std::experimental::string_view> sample;
-    sample.reserve(sample_size);
-    std::string buffer;
-    for (size_t i = 0;i < sample_size && getline(in, buffer); ++i) {
-        sample.push_back(buffer);
-        buffer.clear();
+    if (argc > 1) {
+        in.open(argv[1]);
     }
 
-    std::ofstream deb("/home/dmitry/compression-project/test-data/simple.txt", std::ios::trunc);
-    for (size_t j = 0; j < sample.size(); ++j) {
-        deb << sample[j];
+    std::vector<std::string> records;
+    std::string buffer;
+    for (size_t i = 0, bytes = 0; bytes < sample_bytes && (argc > 1 ? static_cast<bool>(getline(in, buffer)) : true); ++i) {
+        records.push_back(argc > 1 ? buffer : generator.record(i));
+        bytes += records.back().size();
     }
-    deb.close();
+    std::vector<std::experimental::string_view> sample(records.begin(), records.end());
 
     std::cout << "Start Learning" << std::endl;
     auto start = std::chrono::high_resolution_clock::now();
@@ -35,8 +37,13 @@ int main() {
     auto finish = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
     std::cout << "Learning Finished for " << duration << " nanoseconds.\n Start encoding" << std::endl;
-    std::istreambuf_iterator<char> eos;
-    std::string raw(std::istreambuf_iterator<char>(in), eos);
+    std::string raw;
+    if (argc > 1) {
+        std::istreambuf_iterator<char> eos;
+        raw.assign(std::istreambuf_iterator<char>(in), eos);
+    } else {
+        generator.generate(raw, 300000, records.size());
+    }
     raw.resize(300000);
     std::string enc;
     codec.encode(enc, raw);
@@ -1,37 +1,215 @@
 #include <library/DictHuffman/DictHuffman.h>
-#include <experimental/string_view>
-#include <iostream>
-#include <string>
-#include <vector>
-// #include <library/tests_common/tests_common.h>
+#include <library/tests_common/tests_common.h>
 
-/*TEST(HuffmanCodecTest, Works) {
-    Codecs::HuffmanCodec codec;
-    Codecs::TestSimple(codec);
-};
+#include <map>
+#include <thread>
 
-int main(int argc, char **argv) {
-    ::testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
+TEST(DictHuffmanCodecTest, Works) {
+    Codecs::DictHuffmanCodec codec;
+    Codecs::test_simple(codec);
 }
-*/
 
-int main() {
+TEST(DictHuffmanCodecTest, RepeatedWords) {
     Codecs::DictHuffmanCodec codec;
-
     std::string raw = "Lorem ipsum dolor sit amet, consectetur ababa adipisicing elit, "
             "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua."
             "Ut ababa enim ad minim veniam, quis ababac nostrud exercitation ullamco ba laboris"
             "nisi ut aliquip ex ea commodo ababa consequat. Duis aute ababa irure dolor in reprehenderit in"
             "voluptate velit esse ea cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat"
             "non proident, sunt in culpa qui officia deserunt mollit anim id est laborum.";
-
     codec.learn({raw});
-    std::string enc;
-    std::string dec;
-    codec.encode(enc, raw);
-    codec.decode(dec, enc);
-    std::cout << raw << '\n' << dec << '\n';
+    Codecs::test_roundtrip(codec, raw);
+}
+
+TEST(DictHuffmanCodecTest, CharacterBoundaries) {
+    std::string raw = "Съешь же ещё этих мягких французских булок, да выпей чаю. "
+            "日本語のテキストも少し。 Съешь же ещё этих булок. 日本語のテキスト";
+    for (auto boundaries : {Codecs::BorBoundaries::CHARACTERS, Codecs::BorBoundaries::WORDS}) {
+        Codecs::BorOptions options;
+        options.boundaries = boundaries;
+        Codecs::DictHuffmanCodec codec(options);
+        codec.learn({raw});
+        Codecs::test_roundtrip(codec, raw);
+        // entries which aren't prefixes of each other and bytes never seen in learning
+        Codecs::test_roundtrip(codec, "Съешь ещё чаю, ёж! \xD0 \xFF日本");
+        std::string encoded;
+        codec.encode(encoded, raw);
+        ASSERT_LT(encoded.size(), raw.size() / 3);
+    }
+}
+
+TEST(DictHuffmanCodecTest, CallStats) {
+    Codecs::DictHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(1, Codecs::LOREM_IPSUM));
+
+    Codecs::CodecStats stats;
+    std::string raw = "dolor sit amet, dolor sit amet";
+    std::string plain, counted;
+    codec.encode(plain, raw);
+    codec.encode(counted, raw, &stats);
+    ASSERT_EQ(plain, counted);
+    ASSERT_EQ(1u, stats.calls);
+    ASSERT_EQ(raw.size(), stats.input_bytes);
+    ASSERT_EQ(0u, stats.escapes);
+    ASSERT_GE(stats.trie_steps, raw.size());
+    ASSERT_GE(stats.fallbacks, 1u);
+    ASSERT_EQ((stats.output_bits + 7) / 8, counted.size());
+
+    // the used entries spell the record
+    ASSERT_EQ(codec.dictionary().size(), stats.dict_usage.size());
+    uint64_t symbols = 0, bytes = 0;
+    for (size_t i = 0; i < stats.dict_usage.size(); ++i) {
+        symbols += stats.dict_usage[i];
+        bytes += stats.dict_usage[i] * codec.dictionary()[i].size();
+    }
+    ASSERT_EQ(stats.symbols, symbols);
+    ASSERT_EQ(raw.size(), bytes);
+    ASSERT_LT(stats.symbols, raw.size());
+}
+
+TEST(DictHuffmanCodecTest, Inspect) {
+    Codecs::DictHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(1, Codecs::LOREM_IPSUM));
+    Codecs::DictHuffmanCodec loaded;
+    loaded.load(codec.save());
+
+    for (const Codecs::DictHuffmanCodec *model : {&codec, &loaded}) {
+        Codecs::ModelInfo info;
+        ASSERT_TRUE(model->inspect(info));
+        ASSERT_EQ(model->dictionary().size() - 1, info.entries.size());
+        ASSERT_GT(info.encode_path_bytes(), 0u);
+        ASSERT_GT(info.decode_path_bytes(), 0u);
+        uint64_t codes = 0;
+        for (uint64_t count : info.code_lengths) {
+            codes += count;
+        }
+        ASSERT_EQ(info.entries.size(), codes);
+        // frequencies survive save and load
+        ASSERT_GT(info.sorted_entries(Codecs::ModelInfo::EntryOrder::FREQUENCY)[0].frequency, 0.0);
+    }
+    ASSERT_EQ(codec.save(), loaded.save());
+}
+
+TEST(DictHuffmanCodecTest, LoadModes) {
+    Codecs::DictHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(1, Codecs::LOREM_IPSUM));
+    std::string raw = "Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris";
+    std::string encoded;
+    codec.encode(encoded, raw);
+
+    Codecs::DictHuffmanCodec encoder;
+    encoder.set_load_mode(Codecs::LoadMode::ENCODE);
+    encoder.load(codec.save());
+    std::string out;
+    encoder.encode(out, raw);
+    ASSERT_EQ(encoded, out);
+    ASSERT_THROW(encoder.decode(out, encoded), Codecs::CodecException);
+
+    Codecs::DictHuffmanCodec decoder;
+    decoder.set_load_mode(Codecs::LoadMode::DECODE);
+    decoder.load(codec.save());
+    out.clear();
+    decoder.decode(out, encoded);
+    ASSERT_EQ(raw, out);
+    ASSERT_THROW(decoder.encode(out, raw), Codecs::CodecException);
+    Codecs::ModelInfo info;
+    ASSERT_TRUE(decoder.inspect(info));
+    ASSERT_EQ(0u, info.encode_path_bytes());
+    ASSERT_EQ(decoder.dictionary().size() - 1, info.entries.size());
+    ASSERT_EQ(codec.save(), decoder.save());
+
+    // both sides built once, on first use, by whichever thread comes first
+    Codecs::DictHuffmanCodec lazy;
+    lazy.set_load_mode(Codecs::LoadMode::LAZY);
+    lazy.load(codec.save());
+    Codecs::ModelInfo before;
+    ASSERT_TRUE(lazy.inspect(before));
+    ASSERT_EQ(0u, before.encode_path_bytes());
+    std::vector<std::string> encodes(4), decodes(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < encodes.size(); ++i) {
+        threads.emplace_back([&, i] {
+            lazy.encode(encodes[i], raw);
+            lazy.decode(decodes[i], encoded);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < encodes.size(); ++i) {
+        ASSERT_EQ(encoded, encodes[i]);
+        ASSERT_EQ(raw, decodes[i]);
+    }
+    Codecs::ModelInfo after;
+    ASSERT_TRUE(lazy.inspect(after));
+    ASSERT_GT(after.encode_path_bytes(), 0u);
+    ASSERT_GT(after.decode_path_bytes(), before.decode_path_bytes());
+}
+
+TEST(DictHuffmanCodecTest, Levels) {
+    const Codecs::DictHuffmanLevel LEVELS[] = {Codecs::DictHuffmanLevel::FAST, Codecs::DictHuffmanLevel::HUFFMAN,
+                                               Codecs::DictHuffmanLevel::OPTIMAL};
+    Codecs::DictHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(1, Codecs::LOREM_IPSUM));
+    std::string model = codec.save();
+    Codecs::StringVector inputs = Codecs::lorem_records();
+    inputs.push_back("");
+    inputs.push_back(Codecs::LOREM_IPSUM);
+    inputs.push_back("Съешь же ещё этих мягких французских булок");
+    std::string bytes;
+    for (int i = 0; i < 1000; ++i) {
+        bytes.push_back(static_cast<char>(i * 37));
+    }
+    inputs.push_back(bytes);
 
-    return 0;
+    // one model for all levels, and a decoder reads payloads of any level
+    Codecs::DictHuffmanCodec decoder;
+    decoder.set_load_mode(Codecs::LoadMode::DECODE);
+    decoder.load(model);
+    std::map<Codecs::DictHuffmanLevel, size_t> sizes;
+    for (auto level : LEVELS) {
+        codec.set_level(level);
+        ASSERT_EQ(model, codec.save());
+        for (const auto &raw : inputs) {
+            Codecs::CodecStats stats;
+            std::string encoded, decoded = "prefix";
+            codec.encode(encoded, raw, &stats);
+            ASSERT_EQ(static_cast<char>(level), encoded[0]);
+            ASSERT_EQ((stats.output_bits + 7) / 8, encoded.size());
+            decoder.decode(decoded, encoded);
+            ASSERT_EQ("prefix" + raw, decoded);
+            sizes[level] += encoded.size();
+        }
+    }
+    ASSERT_LE(sizes[Codecs::DictHuffmanLevel::OPTIMAL], sizes[Codecs::DictHuffmanLevel::HUFFMAN]);
+    ASSERT_LT(sizes[Codecs::DictHuffmanLevel::HUFFMAN], sizes[Codecs::DictHuffmanLevel::FAST]);
+
+    // frequent entries take a byte
+    Codecs::DictHuffmanCodec fast(Codecs::DictHuffmanLevel::FAST);
+    fast.load(model);
+    Codecs::CodecStats stats;
+    std::string encoded;
+    fast.encode(encoded, Codecs::LOREM_IPSUM, &stats);
+    ASSERT_LT(encoded.size(), stats.symbols * 3 / 2);
+    Codecs::ModelInfo info;
+    ASSERT_TRUE(fast.inspect(info));
+    ASSERT_EQ("fast_search_tree", info.structures.back().name);
+    ASSERT_GT(info.structures.back().heap_bytes, 0u);
+}
+
+TEST(DictHuffmanCodecTest, CorruptedPayload) {
+    Codecs::DictHuffmanCodec codec(Codecs::DictHuffmanLevel::FAST);
+    codec.learn(Codecs::StringViewVector(1, Codecs::LOREM_IPSUM));
+    // the level byte and the size
+    Codecs::test_corrupted_payloads(codec, Codecs::LOREM_IPSUM, 3);
+    std::string encoded, decoded;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    ASSERT_THROW(codec.decode(decoded, encoded + "x"), Codecs::CodecException);
+    ASSERT_THROW(codec.decode(decoded, ""), Codecs::CodecException);
+    ASSERT_THROW(codec.decode(decoded, "\x03"), Codecs::CodecException);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
 }
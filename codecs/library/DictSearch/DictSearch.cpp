@@ -0,0 +1,232 @@
+#include "DictSearch.h"
+
+#include <library/common/canonical_huffman.h>
+#include <library/common/frame.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace Codecs {
+
+    const unsigned DictHuffmanSearch::TABLE_BITS;
+
+    DictHuffmanSearch::DictHuffmanSearch(const DictHuffmanCodec& codec, const string& pattern)
+            : codec(codec), needle(pattern) {
+        if (needle.empty()) {
+            cthrow("an empty pattern is found everywhere");
+        }
+        const vector<string>& dict = codec.dictionary();
+        if (dict.size() < 3) {
+            cthrow("the model has no dictionary to search with");
+        }
+
+        // state i has the first i bytes of the pattern matched, the last state is a match and goes on
+        // like the longest proper border of the pattern
+        const size_t size = needle.size();
+        byte_automaton.assign((size + 1) * 256, 0);
+        byte_automaton[static_cast<unsigned char>(needle[0])] = 1;
+        uint32_t border = 0;
+        for (size_t i = 1; i <= size; ++i) {
+            std::copy_n(byte_automaton.begin() + border * 256, 256, byte_automaton.begin() + i * 256);
+            if (i < size) {
+                unsigned char byte = static_cast<unsigned char>(needle[i]);
+                byte_automaton[i * 256 + byte] = i + 1;
+                border = step(border, byte);
+            }
+        }
+        cells.resize(size + 1);
+
+        lengths.resize(dict.size());
+        for (size_t i = 0; i < dict.size(); ++i) {
+            lengths[i] = dict[i].size();
+        }
+
+        // the decoder's code tree flattened, node n has its children at 2n and 2n + 1
+        vector<DictHuffmanCodec::node> nodes;
+        codec.decoding_tree(nodes);
+        tree.assign(2, Slot{0, 0});
+        unsigned max_length = 0;
+        // (codec node, node, depth) of the nodes whose children are still to place
+        vector<std::tuple<size_t, uint32_t, uint32_t>> pending = {std::make_tuple(0, 0, 0)};
+        while (!pending.empty()) {
+            size_t from;
+            uint32_t node, depth;
+            std::tie(from, node, depth) = pending.back();
+            pending.pop_back();
+            if (nodes[from].is_leaf) {
+                cthrow("the code tree has no inner nodes");
+            }
+            for (unsigned bit = 0; bit < 2; ++bit) {
+                const DictHuffmanCodec::node& child = nodes[bit ? nodes[from].right : nodes[from].left];
+                if (child.is_leaf) {
+                    tree[2 * node + bit] = Slot{static_cast<uint32_t>(child.dict_n), depth + 1};
+                    max_length = std::max(max_length, depth + 1);
+                } else {
+                    uint32_t next = tree.size() / 2;
+                    tree[2 * node + bit] = Slot{next, 0};
+                    tree.resize(tree.size() + 2, Slot{0, 0});
+                    pending.emplace_back(bit ? nodes[from].right : nodes[from].left, next, depth + 1);
+                }
+            }
+        }
+
+        // codes up to table_bits long take one lookup, longer ones go on from the node reached
+        table_bits = std::min(TABLE_BITS, max_length);
+        table.resize(size_t(1) << table_bits);
+        for (size_t prefix = 0; prefix < table.size(); ++prefix) {
+            uint32_t node = 0;
+            Slot slot = {0, 0};
+            for (unsigned i = 0; i < table_bits; ++i) {
+                slot = tree[2 * node + ((prefix >> (table_bits - 1 - i)) & 1)];
+                if (slot.length || !slot.target) {
+                    break;
+                }
+                node = slot.target;
+            }
+            table[prefix] = slot;
+        }
+    }
+
+    uint32_t DictHuffmanSearch::cell(uint32_t state, uint32_t entry) {
+        vector<uint32_t>& row = cells[state];
+        if (row.empty()) {
+            row.assign(lengths.size(), 0);
+        }
+        uint32_t& result = row[entry];
+        if (!result) {
+            const uint32_t match = needle.size();
+            bool matched = false;
+            for (char byte : codec.dictionary()[entry]) {
+                state = step(state, static_cast<unsigned char>(byte));
+                matched |= state == match;
+            }
+            result = (state + 1) << 1 | matched;
+        }
+        return result;
+    }
+
+    template <typename Report>
+    bool DictHuffmanSearch::place(uint32_t state, uint32_t entry, uint64_t offset, Report report) const {
+        const string& text = codec.dictionary()[entry];
+        for (size_t i = 0; i < text.size(); ++i) {
+            state = step(state, static_cast<unsigned char>(text[i]));
+            if (state == needle.size() && !report(offset + i + 1 - needle.size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Report>
+    void DictHuffmanSearch::scan(const string_view& encoded, Report report) {
+        if (encoded.empty()) {
+            cthrow("empty DictHuffmanCodec payload");
+        }
+        unsigned char level = static_cast<unsigned char>(encoded[0]);
+        switch (static_cast<DictHuffmanLevel>(level)) {
+            case DictHuffmanLevel::FAST:
+                scan_fast(encoded.substr(1), report);
+                return;
+            case DictHuffmanLevel::HUFFMAN:
+            case DictHuffmanLevel::OPTIMAL:
+                scan_bits(encoded.substr(1), report);
+                return;
+        }
+        cthrow("unknown DictHuffmanCodec level " << static_cast<unsigned>(level));
+    }
+
+    // the symbols DictHuffmanCodec::decode() finds, a code cut by the end of the payload is padding
+    template <typename Report>
+    void DictHuffmanSearch::scan_bits(const string_view& bits, Report report) {
+        const size_t total = bits.size() * 8;
+        size_t bit = 0;
+        uint32_t state = 0;
+        uint64_t offset = 0;
+        while (bit < total) {
+            Slot slot = table[msb_window(bits, bit) >> (64 - table_bits)];
+            size_t end = bit + slot.length;
+            if (!slot.length) {
+                if (!slot.target) {
+                    return;
+                }
+                end = bit + table_bits;
+                while (!slot.length) {
+                    if (end >= total) {
+                        return;
+                    }
+                    unsigned value = (static_cast<unsigned char>(bits[end >> 3]) >> (7 - (end & 7))) & 1;
+                    ++end;
+                    slot = tree[2 * slot.target + value];
+                    if (!slot.length && !slot.target) {
+                        return;
+                    }
+                }
+            }
+            if (end > total) {
+                return;
+            }
+            bit = end;
+            uint32_t next = cell(state, slot.target);
+            if ((next & 1) && !place(state, slot.target, offset, report)) {
+                return;
+            }
+            state = (next >> 1) - 1;
+            offset += lengths[slot.target];
+        }
+    }
+
+    // checks the indices as DictHuffmanCodec::decode() does
+    template <typename Report>
+    void DictHuffmanSearch::scan_fast(const string_view& indices, Report report) {
+        const vector<uint32_t>& fast_dict = codec.fast_dictionary();
+        uint64_t size;
+        size_t pos = read_varint(size, indices);
+        uint32_t state = 0;
+        uint64_t offset = 0;
+        while (offset < size) {
+            if (pos == indices.size()) {
+                cthrow("truncated DictHuffmanCodec payload");
+            }
+            size_t index = static_cast<unsigned char>(indices[pos++]);
+            if (index & 0x80) {
+                if (pos == indices.size()) {
+                    cthrow("truncated DictHuffmanCodec payload");
+                }
+                index = DictHuffmanCodec::FAST_SHORT + ((index & 0x7F) << 8 | static_cast<unsigned char>(indices[pos++]));
+            }
+            if (index >= fast_dict.size()) {
+                cthrow("corrupted DictHuffmanCodec payload, index " << index);
+            }
+            uint32_t entry = fast_dict[index];
+            if (lengths[entry] > size - offset) {
+                cthrow("corrupted DictHuffmanCodec payload, it is longer than " << size);
+            }
+            uint32_t next = cell(state, entry);
+            if ((next & 1) && !place(state, entry, offset, report)) {
+                return;
+            }
+            state = (next >> 1) - 1;
+            offset += lengths[entry];
+        }
+        if (pos != indices.size()) {
+            cthrow("corrupted DictHuffmanCodec payload, it is shorter than " << size);
+        }
+    }
+
+    void DictHuffmanSearch::find(const string_view& encoded, vector<uint64_t>& offsets) {
+        scan(encoded, [&offsets](uint64_t offset) {
+            offsets.push_back(offset);
+            return true;
+        });
+    }
+
+    bool DictHuffmanSearch::contains(const string_view& encoded) {
+        bool found = false;
+        scan(encoded, [&found](uint64_t) {
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/common/codec.h>
+
+namespace Codecs {
+
+    // Finds a literal pattern in DictHuffmanCodec payloads without decoding them to text.
+    //
+    // The model fixes which dictionary entries a payload is made of, so the pattern is compiled into a
+    // KMP automaton over entries rather than bytes: the state after an entry is looked up in a table of
+    // (state, entry) cells, filled on first use, and only an entry which completes a match is walked
+    // byte by byte to place it. A payload is scanned by symbol, a table lookup per Huffman code or a
+    // byte or two per index at DictHuffmanLevel::FAST, and the only text it touches is of those entries.
+    //
+    // The cells are filled as payloads are scanned, so a search is not shared between threads; copies
+    // are cheap until they have scanned something.
+    class DictHuffmanSearch {
+    public:
+        // bits of a Huffman code the first lookup decodes
+        static const unsigned TABLE_BITS = 12;
+
+        // `codec` has to outlive the search and keep its model, loaded in any LoadMode; the Huffman codes
+        // are read off DictHuffmanCodec::decoding_tree()
+        DictHuffmanSearch(const DictHuffmanCodec& codec, const string& pattern);
+
+        // appends the offsets in the record `encoded` decodes to of every occurrence of the pattern,
+        // overlapping ones included, in order
+        void find(const string_view& encoded, vector<uint64_t>& offsets);
+
+        // stops at the first occurrence
+        bool contains(const string_view& encoded);
+
+        const string& pattern() const {
+            return needle;
+        }
+
+    private:
+        // a decode table slot or a code tree node: an entry and the code length, or a node to go on from
+        struct Slot {
+            uint32_t target;
+            uint32_t length;  // 0 for a node
+        };
+
+        const DictHuffmanCodec& codec;
+        string needle;
+        // KMP over bytes, (state, byte) -> state for the states of 0..size-1 matched bytes
+        vector<uint32_t> byte_automaton;
+        // entry lengths, and the code tree of the Huffman levels with a table of its first TABLE_BITS
+        vector<uint32_t> lengths;
+        vector<Slot> table;
+        vector<Slot> tree;
+        unsigned table_bits = 0;
+        // state after an entry from a state, rows allocated on first visit of their state:
+        // 0 if not known yet, otherwise (state + 1) << 1 | whether the entry completes a match
+        vector<vector<uint32_t>> cells;
+
+        uint32_t step(uint32_t state, unsigned char byte) const {
+            return byte_automaton[state * 256 + byte];
+        }
+
+        uint32_t cell(uint32_t state, uint32_t entry);
+
+        // reports the matches the entry at `offset` completes, false to stop
+        template <typename Report>
+        bool place(uint32_t state, uint32_t entry, uint64_t offset, Report report) const;
+
+        template <typename Report>
+        void scan(const string_view& encoded, Report report);
+
+        template <typename Report>
+        void scan_bits(const string_view& bits, Report report);
+
+        template <typename Report>
+        void scan_fast(const string_view& indices, Report report);
+    };
+
+}
@@ -0,0 +1,112 @@
+#include <library/DictSearch/DictSearch.h>
+#include <library/tests_common/tests_common.h>
+
+namespace {
+
+    const Codecs::DictHuffmanLevel LEVELS[] = {Codecs::DictHuffmanLevel::FAST, Codecs::DictHuffmanLevel::HUFFMAN,
+                                               Codecs::DictHuffmanLevel::OPTIMAL};
+
+    std::vector<uint64_t> occurrences(const std::string& text, const std::string& pattern) {
+        std::vector<uint64_t> result;
+        for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+            result.push_back(pos);
+        }
+        return result;
+    }
+
+}
+
+TEST(DictHuffmanSearchTest, FindsWhatDecodingFinds) {
+    auto records = Codecs::test_corpus(Codecs::TextKind::MIXED, 140);
+    Codecs::DictHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(records.begin(), records.begin() + 100));
+
+    // patterns from new records, so they start and end inside entries
+    records.erase(records.begin(), records.begin() + 100);
+    records.push_back("");
+    std::vector<std::string> patterns = {" ", "e", "the", "zzzz", "\xFF"};
+    for (size_t i = 0; i < 10; ++i) {
+        const std::string& record = records[i];
+        for (size_t length : {2, 5, 13, 40}) {
+            if (record.size() > length) {
+                patterns.push_back(record.substr((i * 7919) % (record.size() - length), length));
+            }
+        }
+    }
+
+    for (auto level : LEVELS) {
+        codec.set_level(level);
+        for (const auto& pattern : patterns) {
+            Codecs::DictHuffmanSearch search(codec, pattern);
+            for (const auto& record : records) {
+                std::string encoded;
+                codec.encode(encoded, record);
+                std::vector<uint64_t> found;
+                search.find(encoded, found);
+                ASSERT_EQ(occurrences(record, pattern), found) << pattern;
+                ASSERT_EQ(!found.empty(), search.contains(encoded));
+            }
+        }
+    }
+}
+
+TEST(DictHuffmanSearchTest, OverlappingMatches) {
+    Codecs::DictHuffmanCodec codec;
+    codec.learn({"ababa abab baba aaaa ababab"});
+    std::string raw = "abababa aaaaa babab";
+    for (auto level : LEVELS) {
+        codec.set_level(level);
+        std::string encoded;
+        codec.encode(encoded, raw);
+        for (const char* pattern : {"aba", "aa", "ababa", "a", "abababa aaaaa babab", "abababa aaaaa babab!"}) {
+            Codecs::DictHuffmanSearch search(codec, pattern);
+            std::vector<uint64_t> found = {42};
+            search.find(encoded, found);
+            std::vector<uint64_t> expected = occurrences(raw, pattern);
+            expected.insert(expected.begin(), 42);
+            ASSERT_EQ(expected, found) << pattern;
+        }
+    }
+}
+
+TEST(DictHuffmanSearchTest, Errors) {
+    Codecs::DictHuffmanCodec codec(Codecs::DictHuffmanLevel::FAST);
+    codec.learn({Codecs::LOREM_IPSUM});
+    ASSERT_THROW(Codecs::DictHuffmanSearch(codec, ""), Codecs::CodecException);
+    ASSERT_THROW(Codecs::DictHuffmanSearch(Codecs::DictHuffmanCodec(), "a"), Codecs::CodecException);
+
+    Codecs::DictHuffmanSearch search(codec, "dolor");
+    std::string encoded;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    std::vector<uint64_t> found;
+    ASSERT_THROW(search.find(encoded.substr(0, encoded.size() / 2), found), Codecs::CodecException);
+    ASSERT_THROW(search.find("", found), Codecs::CodecException);
+    ASSERT_THROW(search.find("\x03", found), Codecs::CodecException);
+
+}
+
+TEST(DictHuffmanSearchTest, LoadModes) {
+    Codecs::DictHuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    std::string raw = "dolore magna, dolor sit amet";
+    for (auto mode : {Codecs::LoadMode::BOTH, Codecs::LoadMode::LAZY, Codecs::LoadMode::ENCODE,
+                      Codecs::LoadMode::DECODE}) {
+        Codecs::DictHuffmanCodec loaded;
+        loaded.set_load_mode(mode);
+        loaded.load(codec.save());
+        Codecs::DictHuffmanSearch search(loaded, "dolor");
+        for (auto level : LEVELS) {
+            codec.set_level(level);
+            std::string encoded;
+            codec.encode(encoded, raw);
+            std::vector<uint64_t> found;
+            search.find(encoded, found);
+            ASSERT_EQ(occurrences(raw, "dolor"), found) << static_cast<int>(mode);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,222 @@
+#include "DriftMonitor.h"
+
+#include <algorithm>
+#include <time.h>
+
+namespace Codecs {
+
+    namespace {
+
+        // CPU time of the calling thread, so a busy machine doesn't eat into the retraining budget
+        double thread_cpu_seconds() {
+            timespec now;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+            return now.tv_sec + now.tv_nsec * 1e-9;
+        }
+
+    }
+
+    DriftMonitor::DriftMonitor(CodecType type, CodecPtr codec, ModelCache& cache, ModelCache::Factory factory,
+                               const Options& options)
+        : type(type)
+        , cache(cache)
+        , factory(std::move(factory))
+        , options(options)
+        , records(0)
+        , window_raw(0)
+        , window_encoded(0)
+        , window_escapes(0)
+        , window_symbols(0)
+        , collecting(false)
+        , retraining_runs(false)
+        , next_retrain(std::chrono::steady_clock::now())
+    {
+        if (!options.window_records) {
+            cthrow("the drift window needs at least one record");
+        }
+        publish(std::move(codec));
+    }
+
+    DriftMonitor::~DriftMonitor() {
+        wait();
+    }
+
+    void DriftMonitor::publish(CodecPtr codec) {
+        if (options.store_models) {
+            cache.store(type, *codec);
+        }
+        uint64_t fingerprint = cache.insert(type, codec);
+        std::atomic_store(&current, std::shared_ptr<const Model>(new Model{fingerprint, std::move(codec)}));
+    }
+
+    void DriftMonitor::encode(string& framed, const string_view& raw) {
+        std::shared_ptr<const Model> model = std::atomic_load(&current);
+        uint64_t record = records.fetch_add(1) + 1;
+        string payload;
+        if (options.probe_every && record % options.probe_every == 0 && probe_lock.try_lock()) {
+            std::lock_guard<std::mutex> guard(probe_lock, std::adopt_lock);
+            // the probe keeps its dict_usage between calls, only the counters are taken
+            model->codec->encode(payload, raw, &probe);
+            window_escapes += probe.escapes + probe.fallbacks;
+            window_symbols += probe.symbols;
+            probe.escapes = probe.fallbacks = probe.symbols = 0;
+        } else {
+            model->codec->encode(payload, raw);
+        }
+        framed.clear();
+        framed.reserve(FrameHeader::MAX_SIZE + payload.size());
+        write_frame_header(framed, {type, model->fingerprint, raw.size()});
+        framed.append(payload);
+
+        window_raw += raw.size();
+        window_encoded += payload.size();
+        bool window_done = record % options.window_records == 0;
+        if (window_done || collecting.load()) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (collecting.load()) {
+                collect_locked(raw);
+            }
+            if (window_done) {
+                close_window_locked(window_raw.exchange(0), window_encoded.exchange(0),
+                                    window_escapes.exchange(0), window_symbols.exchange(0));
+            }
+        }
+    }
+
+    void DriftMonitor::close_window_locked(uint64_t raw, uint64_t encoded, uint64_t escapes, uint64_t symbols) {
+        double ratio = raw ? static_cast<double>(encoded) / raw : 0.0;
+        double escape_rate = symbols ? static_cast<double>(escapes) / symbols : 0.0;
+        ++counters.windows;
+        counters.last_ratio = ratio;
+        counters.last_escape_rate = escape_rate;
+        if (!has_baseline) {
+            counters.baseline_ratio = ratio;
+            counters.baseline_escape_rate = escape_rate;
+            has_baseline = true;
+            drifting = 0;
+            return;
+        }
+        if (collecting.load() || retraining_runs.load()) {
+            return;
+        }
+        bool drift = ratio > counters.baseline_ratio * (1 + options.ratio_drift)
+                     || escape_rate > counters.baseline_escape_rate + options.escape_drift;
+        drifting = drift ? drifting + 1 : 0;
+        if (drifting < options.patience || std::chrono::steady_clock::now() < next_retrain) {
+            return;
+        }
+        drifting = 0;
+        ReservoirOptions sample_options;
+        sample_options.budget_bytes = std::min<uint64_t>(options.sample_bytes,
+                                                         std::atomic_load(&current)->codec->sample_bytes());
+        sample_options.seed = counters.windows;
+        sampler.reset(new ReservoirSampler(sample_options));
+        holdout.clear();
+        holdout_size = 0;
+        collected = 0;
+        collecting = true;
+    }
+
+    void DriftMonitor::collect_locked(const string_view& raw) {
+        ++collected;
+        if (options.holdout_every && collected % options.holdout_every == 0) {
+            if (holdout_size + raw.size() <= options.holdout_bytes) {
+                holdout.push_back(raw.to_string());
+                holdout_size += raw.size();
+            }
+        } else {
+            sampler->add(raw);
+        }
+        if (collected < options.collect_records) {
+            return;
+        }
+        collecting = false;
+        // the last retraining has finished, its thread is done or about to be
+        if (retraining.joinable()) {
+            retraining.join();
+        }
+        retraining_runs = true;
+        retraining = std::thread(&DriftMonitor::retrain, this, std::move(sampler), std::move(holdout),
+                                 std::atomic_load(&current)->codec);
+        holdout = StringVector();
+    }
+
+    void DriftMonitor::retrain(std::unique_ptr<ReservoirSampler> sample, StringVector held_out, CodecPtr competitor) {
+        double start = thread_cpu_seconds();
+        bool failed = false;
+        bool better = false;
+        uint64_t raw = 0, candidate_size = 0, competitor_size = 0;
+        try {
+            std::unique_ptr<CodecIFace> candidate = factory(type);
+            if (!candidate) {
+                cthrow("no codec for type " << static_cast<unsigned>(type));
+            }
+            candidate->learn(sample->sample());
+            sample.reset();
+
+            string encoded;
+            for (const auto& record : held_out) {
+                raw += record.size();
+                candidate->encode(encoded, record);
+                candidate_size += encoded.size();
+                competitor->encode(encoded, record);
+                competitor_size += encoded.size();
+            }
+            better = raw && candidate_size < competitor_size * (1 - options.min_gain);
+            if (better) {
+                publish(CodecPtr(std::move(candidate)));
+            }
+        } catch (const std::exception&) {
+            failed = true;
+        }
+        double seconds = thread_cpu_seconds() - start;
+
+        std::lock_guard<std::mutex> guard(lock);
+        ++counters.retrains;
+        counters.learn_seconds = seconds;
+        if (failed) {
+            ++counters.failed;
+        } else {
+            counters.candidate_ratio = raw ? static_cast<double>(candidate_size) / raw : 0.0;
+            counters.current_ratio = raw ? static_cast<double>(competitor_size) / raw : 0.0;
+            if (better) {
+                ++counters.published;
+                // the next window is the baseline of the new model
+                has_baseline = false;
+            } else {
+                ++counters.rejected;
+            }
+        }
+        next_retrain = std::chrono::steady_clock::now()
+                       + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                               std::chrono::duration<double>(seconds / options.cpu_share));
+        retraining_runs = false;
+    }
+
+    uint64_t DriftMonitor::fingerprint() const {
+        return std::atomic_load(&current)->fingerprint;
+    }
+
+    DriftMonitor::CodecPtr DriftMonitor::codec() const {
+        return std::atomic_load(&current)->codec;
+    }
+
+    DriftMonitor::Stats DriftMonitor::stats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        Stats result = counters;
+        result.records = records.load();
+        return result;
+    }
+
+    void DriftMonitor::wait() {
+        std::thread running;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running = std::move(retraining);
+        }
+        if (running.joinable()) {
+            running.join();
+        }
+    }
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <library/ModelCache/ModelCache.h>
+#include <library/common/codec.h>
+#include <library/common/sample.h>
+#include <library/common/stats.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Codecs {
+
+    struct DriftOptions {
+        // records per measurement window; the first window of a model is its baseline
+        size_t window_records = 10000;
+        // a window drifts when its ratio is this share worse than the baseline...
+        double ratio_drift = 0.05;
+        // ...or its escape and fallback rate (per code written) this much higher
+        double escape_drift = 0.02;
+        // consecutive drifting windows that start a retraining
+        size_t patience = 2;
+        // one record in this many is encoded with counters, for the escape rate
+        size_t probe_every = 64;
+        // records collected for a retraining, every holdout_every-th of them is kept for validation
+        size_t collect_records = 40000;
+        size_t holdout_every = 10;
+        // memory budget: bytes of training sample and of held-out records; the sample is also kept to
+        // what the codec asks for, see CodecIFace::sample_bytes()
+        uint64_t sample_bytes = 16 << 20;
+        uint64_t holdout_bytes = 4 << 20;
+        // CPU budget: after a retraining that took t seconds the next one starts no earlier than
+        // t / cpu_share seconds later, so retraining takes at most this share of one core
+        double cpu_share = 0.1;
+        // the candidate is published if it encodes the held-out records this share smaller
+        double min_gain = 0.01;
+        // write published models to the model directory of the cache, so they survive eviction
+        bool store_models = true;
+    };
+
+    // Encodes through the current model of a codec type and watches the compression it gets. When
+    // the ratio or the escape rate drifts away from what the model did at first, the monitor samples
+    // the following records, trains a new model on a background thread and publishes it if it does
+    // better on held-out records than the current one.
+    //
+    // Payloads are framed (see frame.h) with the fingerprint of the model that wrote them and models
+    // are published into a ModelCache, so records written by any earlier model still decode through
+    // the cache.
+    class DriftMonitor {
+    public:
+        using Options = DriftOptions;
+        using CodecPtr = ModelCache::CodecPtr;
+
+        struct Stats {
+            uint64_t records;
+            uint64_t windows;
+            double baseline_ratio;       // encoded / raw bytes
+            double baseline_escape_rate; // escapes and fallbacks per code
+            double last_ratio;
+            double last_escape_rate;
+            uint64_t retrains;
+            uint64_t published;
+            uint64_t rejected;
+            uint64_t failed;
+            double learn_seconds;        // of the last retraining
+            double candidate_ratio;      // of the last candidate and of the model it competed with,
+            double current_ratio;        // on the held-out records
+        };
+
+        // `factory` makes the untrained codecs learning new models
+        DriftMonitor(CodecType type, CodecPtr codec, ModelCache& cache, ModelCache::Factory factory,
+                     const Options& options = Options());
+
+        DriftMonitor(const DriftMonitor&) = delete;
+        DriftMonitor& operator=(const DriftMonitor&) = delete;
+
+        // waits for a running retraining
+        ~DriftMonitor();
+
+        void encode(string& framed, const string_view& raw);
+
+        void decode(string& raw, const string_view& framed) const {
+            cache.decode(raw, framed);
+        }
+
+        // the model encode() uses now
+        uint64_t fingerprint() const;
+
+        CodecPtr codec() const;
+
+        Stats stats() const;
+
+        // returns when no retraining runs
+        void wait();
+
+    private:
+        struct Model {
+            uint64_t fingerprint;
+            CodecPtr codec;
+        };
+
+        CodecType type;
+        ModelCache& cache;
+        ModelCache::Factory factory;
+        Options options;
+
+        // swapped with std::atomic_load/store when a model is published
+        std::shared_ptr<const Model> current;
+
+        // the current window, counted without taking the lock
+        std::atomic<uint64_t> records;
+        std::atomic<uint64_t> window_raw;
+        std::atomic<uint64_t> window_encoded;
+        std::atomic<uint64_t> window_escapes;
+        std::atomic<uint64_t> window_symbols;
+        std::atomic<bool> collecting;
+        std::atomic<bool> retraining_runs;
+
+        mutable std::mutex lock;
+        Stats counters = Stats();
+        bool has_baseline = false;
+        size_t drifting = 0;
+        size_t collected = 0;
+        std::unique_ptr<ReservoirSampler> sampler;
+        StringVector holdout;
+        uint64_t holdout_size = 0;
+        std::chrono::steady_clock::time_point next_retrain;
+
+        // one record in probe_every is counted, by whichever thread gets the probe
+        std::mutex probe_lock;
+        CodecStats probe;
+
+        std::thread retraining;
+
+        void publish(CodecPtr codec);
+
+        void close_window_locked(uint64_t raw, uint64_t encoded, uint64_t escapes, uint64_t symbols);
+
+        void collect_locked(const string_view& raw);
+
+        void retrain(std::unique_ptr<ReservoirSampler> sample, StringVector held_out, CodecPtr competitor);
+    };
+
+}
@@ -0,0 +1,112 @@
+#include <library/DriftMonitor/DriftMonitor.h>
+#include <library/Huffman/Huffman.h>
+#include <library/tests_common/tests_common.h>
+
+#include <random>
+
+namespace {
+
+    std::shared_ptr<const Codecs::CodecIFace> lorem_model() {
+        std::shared_ptr<Codecs::HuffmanCodec> codec(new Codecs::HuffmanCodec());
+        codec->learn({Codecs::LOREM_IPSUM});
+        return codec;
+    }
+
+    // digits and capitals the lorem model has to escape
+    std::string drifted_record(std::mt19937 &generator) {
+        const std::string alphabet = "0123456789ABCDEF";
+        std::string record;
+        for (int i = 0; i < 200; ++i) {
+            record.push_back(alphabet[generator() % (i % 3 ? 4 : alphabet.size())]);
+        }
+        return record;
+    }
+
+    Codecs::DriftOptions small_windows() {
+        Codecs::DriftOptions options;
+        options.window_records = 100;
+        options.patience = 1;
+        options.collect_records = 500;
+        options.holdout_every = 5;
+        options.cpu_share = 1;
+        return options;
+    }
+
+}
+
+TEST(DriftMonitorTest, RetrainsOnDrift) {
+    Codecs::TempDir dir("drift-monitor");
+    Codecs::ModelCache cache(dir.path(), 1 << 20, Codecs::make_huffman_codec);
+    Codecs::DriftMonitor monitor(Codecs::CodecType::HUFFMAN, lorem_model(), cache, Codecs::make_huffman_codec, small_windows());
+    uint64_t first = monitor.fingerprint();
+
+    Codecs::StringVector lorem = Codecs::lorem_records();
+    std::string framed, decoded;
+    for (size_t i = 0; i < 300; ++i) {
+        monitor.encode(framed, lorem[i % lorem.size()]);
+    }
+    monitor.wait();
+    Codecs::DriftMonitor::Stats stats = monitor.stats();
+    ASSERT_EQ(3u, stats.windows);
+    ASSERT_EQ(0u, stats.retrains);
+    ASSERT_EQ(first, monitor.fingerprint());
+    std::string old_frame = framed;
+
+    std::mt19937 generator(1);
+    std::string raw = drifted_record(generator);
+    std::string before;
+    monitor.encode(before, raw);
+    // one drifting window, then the records collected for retraining
+    for (size_t i = 0; i < 600; ++i) {
+        monitor.encode(framed, drifted_record(generator));
+    }
+    monitor.wait();
+    stats = monitor.stats();
+    ASSERT_EQ(1u, stats.retrains);
+    ASSERT_EQ(1u, stats.published);
+    ASSERT_GT(stats.last_escape_rate, stats.baseline_escape_rate);
+    ASSERT_LT(stats.candidate_ratio, stats.current_ratio);
+    ASSERT_NE(first, monitor.fingerprint());
+
+    std::string after;
+    monitor.encode(after, raw);
+    ASSERT_LT(after.size(), before.size());
+    // frames of every model decode, the stored ones also from a fresh cache
+    for (const std::string *frame : {&old_frame, &before, &after}) {
+        monitor.decode(decoded, *frame);
+    }
+    ASSERT_EQ(raw, decoded);
+    cache.clear();
+    monitor.decode(decoded, before);
+    ASSERT_EQ(raw, decoded);
+}
+
+TEST(DriftMonitorTest, KeepsModelThatIsNotBeaten) {
+    Codecs::TempDir dir("drift-monitor");
+    Codecs::ModelCache cache(dir.path(), 1 << 20, Codecs::make_huffman_codec);
+    Codecs::DriftOptions options = small_windows();
+    options.min_gain = 0.99;
+    Codecs::DriftMonitor monitor(Codecs::CodecType::HUFFMAN, lorem_model(), cache, Codecs::make_huffman_codec, options);
+    uint64_t first = monitor.fingerprint();
+
+    Codecs::StringVector lorem = Codecs::lorem_records();
+    std::mt19937 generator(2);
+    std::string framed;
+    for (size_t i = 0; i < 100; ++i) {
+        monitor.encode(framed, lorem[i % lorem.size()]);
+    }
+    for (size_t i = 0; i < 600; ++i) {
+        monitor.encode(framed, drifted_record(generator));
+    }
+    monitor.wait();
+    Codecs::DriftMonitor::Stats stats = monitor.stats();
+    ASSERT_EQ(1u, stats.retrains);
+    ASSERT_EQ(1u, stats.rejected);
+    ASSERT_EQ(0u, stats.published);
+    ASSERT_EQ(first, monitor.fingerprint());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
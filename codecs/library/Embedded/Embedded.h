@@ -0,0 +1,201 @@
+#pragma once
+
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/common/canonical_huffman.h>
+#include <library/common/codec.h>
+#include <library/common/inspect.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Codecs {
+
+    // DictHuffmanCodec with the model compiled in, see write_embedded_model() and TARGET_EMBEDDED_MODEL
+    // in cmake/common.cmake. `Tables` is a generated struct of static constexpr tables:
+    //
+    //   ENTRIES                      dictionary entries + 1, entry 0 is unused as in DictHuffmanCodec
+    //   ARENA, OFFSETS[ENTRIES + 1]  entry i is ARENA[OFFSETS[i], OFFSETS[i + 1])
+    //   CODES, LENGTHS[ENTRIES]      code of entry i, MSB first; codes longer than 56 bits are kept in
+    //                                LONG_CODES[CODES[i]...] as 32 bit pieces, the last one holding the rest
+    //   MAX_LENGTH                   the longest code
+    //   DECODE_TABLE[1 << TABLE_BITS]  for every TABLE_BITS bit prefix either
+    //                                entry << 8 | length << 1 | 1, or the code tree node it leads to << 1
+    //   DECODE_TREE[2 * nodes]       children of code tree node n at 2n (bit 0) and 2n + 1 (bit 1),
+    //                                encoded as entry << 1 | 1 for leaves and node << 1 otherwise
+    //   TRIE_ROOT[256]               matcher node of every first byte, 0 for none
+    //   TRIE_FIRST[TRIE_NODES + 1]   node n has transitions TRIE_SYMBOLS/TRIE_TARGETS[TRIE_FIRST[n], TRIE_FIRST[n + 1]),
+    //                                sorted by symbol
+    //   TRIE_ENTRY[TRIE_NODES]       the dictionary entry a node spells, 0 for none
+    //   MODEL, MODEL_SIZE            the model as DictHuffmanCodec::save() writes it
+    //
+    // Payloads are bit for bit the ones of DictHuffmanCodec with the same model at DictHuffmanLevel::HUFFMAN,
+    // so either side can be replaced; OPTIMAL payloads decode too, FAST ones need DictHuffmanCodec. The
+    // tables are read only data, so nothing is built at startup and processes share them.
+    template <typename Tables>
+    class EmbeddedDictHuffmanCodec : public CodecIFace {
+    public:
+        void encode(string &encoded, const string_view &raw) const override {
+            encoded.clear();
+            encoded.reserve(raw.size() / 2 + 9);
+            encoded.push_back(static_cast<char>(DictHuffmanLevel::HUFFMAN));
+            uint64_t buffer = 0;
+            unsigned bits = 0;
+            size_t start = 0;
+            while (start < raw.size()) {
+                // greedy longest match, falling back to the last entry passed
+                uint32_t node = Tables::TRIE_ROOT[static_cast<unsigned char>(raw[start])];
+                uint32_t entry = 0;
+                size_t entry_end = start;
+                for (size_t i = start + 1; node; ++i) {
+                    if (Tables::TRIE_ENTRY[node]) {
+                        entry = Tables::TRIE_ENTRY[node];
+                        entry_end = i;
+                    }
+                    if (i == raw.size()) {
+                        break;
+                    }
+                    node = transition(node, static_cast<unsigned char>(raw[i]));
+                }
+                if (!entry) {
+                    cthrow("no dictionary entry for byte " << static_cast<unsigned>(static_cast<unsigned char>(raw[start])));
+                }
+                unsigned length = Tables::LENGTHS[entry];
+                if (length <= 56) {
+                    put(encoded, buffer, bits, Tables::CODES[entry], length);
+                } else {
+                    for (uint64_t piece = Tables::CODES[entry]; length; ++piece) {
+                        unsigned count = std::min(length, 32u);
+                        put(encoded, buffer, bits, Tables::LONG_CODES[piece], count);
+                        length -= count;
+                    }
+                }
+                start = entry_end;
+            }
+            if (bits) {
+                encoded.push_back(static_cast<char>(buffer << (8 - bits)));
+            }
+        }
+
+        // appends to `raw`, as DictHuffmanCodec does
+        void decode(string &raw, const string_view &encoded) const override {
+            if (encoded.empty()) {
+                cthrow("empty DictHuffmanCodec payload");
+            }
+            unsigned char level = static_cast<unsigned char>(encoded[0]);
+            if (level == static_cast<unsigned char>(DictHuffmanLevel::FAST)) {
+                cthrow("an embedded codec decodes the Huffman coded levels only");
+            }
+            if (level != static_cast<unsigned char>(DictHuffmanLevel::HUFFMAN)
+                && level != static_cast<unsigned char>(DictHuffmanLevel::OPTIMAL)) {
+                cthrow("unknown DictHuffmanCodec level " << static_cast<unsigned>(level));
+            }
+            decode_bits(raw, encoded.substr(1));
+        }
+
+        string save() const override {
+            return string(Tables::MODEL, Tables::MODEL_SIZE);
+        }
+
+        // the model is compiled in; loading the same model again is allowed and does nothing
+        void load(const string &model) override {
+            if (model != save()) {
+                cthrow("the model of an embedded codec can't be replaced");
+            }
+        }
+
+        size_t sample_bytes() const override {
+            return 0;
+        }
+
+        void learn(const StringViewVector &) override {
+            cthrow("an embedded codec can't learn");
+        }
+
+        void reset() override {
+            cthrow("an embedded codec can't be reset");
+        }
+
+        // the tables are static, they are reported at their size so the cache fit stays meaningful
+        bool inspect(ModelInfo &info) const override {
+            info.add_structure("arena", Tables::OFFSETS[Tables::ENTRIES], sizeof(Tables::ARENA), false, true);
+            info.add_structure("offsets", Tables::ENTRIES + 1, sizeof(Tables::OFFSETS), false, true);
+            info.add_structure("codes", Tables::ENTRIES,
+                               sizeof(Tables::CODES) + sizeof(Tables::LENGTHS) + sizeof(Tables::LONG_CODES), true, false);
+            info.add_structure("decode_table", sizeof(Tables::DECODE_TABLE) / sizeof(Tables::DECODE_TABLE[0]),
+                               sizeof(Tables::DECODE_TABLE), false, true);
+            info.add_structure("decode_tree", sizeof(Tables::DECODE_TREE) / sizeof(Tables::DECODE_TREE[0]),
+                               sizeof(Tables::DECODE_TREE), false, true);
+            info.add_structure("trie", sizeof(Tables::TRIE_ENTRY) / sizeof(Tables::TRIE_ENTRY[0]),
+                               sizeof(Tables::TRIE_ROOT) + sizeof(Tables::TRIE_FIRST) + sizeof(Tables::TRIE_SYMBOLS)
+                               + sizeof(Tables::TRIE_TARGETS) + sizeof(Tables::TRIE_ENTRY), true, false);
+            for (uint32_t i = 1; i < Tables::ENTRIES; ++i) {
+                info.add_code(Tables::LENGTHS[i]);
+                info.entries.push_back({string(Tables::ARENA + Tables::OFFSETS[i], Tables::ARENA + Tables::OFFSETS[i + 1]),
+                                        0.0, Tables::LENGTHS[i]});
+            }
+            return true;
+        }
+
+    private:
+        void decode_bits(string &raw, const string_view &encoded) const {
+            const size_t total = encoded.size() * 8;
+            size_t bit = 0;
+            // every symbol starting here ends within the input, so no bounds checks are needed
+            while (total - bit >= Tables::MAX_LENGTH && encoded.size() - (bit >> 3) >= 8) {
+                uint64_t window = peek_msb(encoded.data() + (bit >> 3)) << (bit & 7);
+                uint32_t entry = Tables::DECODE_TABLE[window >> (64 - Tables::TABLE_BITS)];
+                if (entry & 1) {
+                    append(raw, entry >> 8);
+                    bit += (entry >> 1) & 0x7F;
+                    continue;
+                }
+                // the window holds at least 57 bits, enough for all but very long codes
+                window <<= Tables::TABLE_BITS;
+                bit += Tables::TABLE_BITS;
+                uint32_t next = entry;
+                for (unsigned used = Tables::TABLE_BITS; !(next & 1); ++used, ++bit, window <<= 1) {
+                    if (used == 57) {
+                        window = msb_window(encoded, bit);
+                        used = 0;
+                    }
+                    next = Tables::DECODE_TREE[(next & ~1u) + (window >> 63)];
+                }
+                append(raw, next >> 1);
+            }
+            // the last symbols and the padding bit by bit, as DictHuffmanCodec::decode() walks its tree
+            uint32_t node = 0;
+            for (; bit < total; ++bit) {
+                unsigned value = (static_cast<unsigned char>(encoded[bit >> 3]) >> (7 - (bit & 7))) & 1;
+                uint32_t next = Tables::DECODE_TREE[2 * node + value];
+                if (next & 1) {
+                    append(raw, next >> 1);
+                    node = 0;
+                } else {
+                    node = next >> 1;
+                }
+            }
+        }
+
+        static uint32_t transition(uint32_t node, unsigned char symbol) {
+            for (uint32_t i = Tables::TRIE_FIRST[node]; i < Tables::TRIE_FIRST[node + 1]; ++i) {
+                if (Tables::TRIE_SYMBOLS[i] >= symbol) {
+                    return Tables::TRIE_SYMBOLS[i] == symbol ? Tables::TRIE_TARGETS[i] : 0;
+                }
+            }
+            return 0;
+        }
+
+        static void put(string &encoded, uint64_t &buffer, unsigned &bits, uint64_t code, unsigned length) {
+            buffer = (buffer << length) | code;
+            bits += length;
+            for (; bits >= 8; bits -= 8) {
+                encoded.push_back(static_cast<char>(buffer >> (bits - 8)));
+            }
+        }
+
+        static void append(string &raw, uint32_t entry) {
+            raw.append(Tables::ARENA + Tables::OFFSETS[entry], Tables::OFFSETS[entry + 1] - Tables::OFFSETS[entry]);
+        }
+    };
+
+}
@@ -0,0 +1,229 @@
+#include "generate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <queue>
+
+namespace Codecs {
+
+    namespace {
+
+        const unsigned MAX_TABLE_BITS = 11;
+        // codes are written through a 64 bit buffer holding up to 7 pending bits, longer ones in pieces
+        const unsigned MAX_WORD_CODE = 56;
+        const unsigned MAX_CODE_LENGTH = 255;
+        const uint32_t NO_CHILD = ~0u;
+
+        // a static constexpr array in the struct and its definition in the source
+        struct TableWriter {
+            const string &name;
+            std::ostream &header;
+            std::ostream &source;
+
+            template <typename T>
+            void array(const char *type, const char *table, const vector<T> &values) {
+                // zero length arrays are not C++, empty tables get a dummy element
+                size_t size = std::max<size_t>(values.size(), 1);
+                header << "    static constexpr " << type << ' ' << table << '[' << size << "] = {";
+                for (size_t i = 0; i < values.size(); ++i) {
+                    header << (i % 16 ? " " : "\n        ") << static_cast<uint64_t>(values[i])
+                           << (sizeof(T) == 8 ? "ULL" : "") << (i + 1 < values.size() ? "," : "");
+                }
+                header << (values.empty() ? "0" : "\n    ") << "};\n";
+                source << "constexpr " << type << ' ' << name << "::" << table << "[];\n";
+            }
+
+            void bytes(const char *table, const string &value) {
+                header << "    static constexpr char " << table << "[] =";
+                for (size_t line = 0; line < value.size() || line == 0; line += 64) {
+                    header << "\n        \"";
+                    for (size_t i = line; i < std::min(value.size(), line + 64); ++i) {
+                        unsigned char c = static_cast<unsigned char>(value[i]);
+                        // octal escapes take at most 3 digits, so the next character can't extend them;
+                        // '?' is escaped against trigraphs
+                        if (c < 0x20 || c >= 0x7F || c == '"' || c == '\\' || c == '?') {
+                            const char digits[] = {'\\', static_cast<char>('0' + (c >> 6)),
+                                                   static_cast<char>('0' + ((c >> 3) & 7)),
+                                                   static_cast<char>('0' + (c & 7))};
+                            header.write(digits, 4);
+                        } else {
+                            header << static_cast<char>(c);
+                        }
+                    }
+                    header << '"';
+                }
+                header << ";\n";
+                source << "constexpr char " << name << "::" << table << "[];\n";
+            }
+
+            void constant(const char *type, const char *constant, uint64_t value) {
+                header << "    static constexpr " << type << ' ' << constant << " = " << value << ";\n";
+                source << "constexpr " << type << ' ' << name << "::" << constant << ";\n";
+            }
+        };
+
+        struct CodeTree {
+            // children of node n at 2n and 2n + 1 in the DECODE_TREE encoding
+            vector<uint32_t> children{NO_CHILD, NO_CHILD};
+
+            void add(const vector<bool> &code, uint32_t entry) {
+                uint32_t node = 0;
+                for (size_t i = 0; i + 1 < code.size(); ++i) {
+                    uint32_t child = children[2 * node + code[i]];
+                    if (child == NO_CHILD) {
+                        child = static_cast<uint32_t>(children.size() / 2) << 1;
+                        children[2 * node + code[i]] = child;
+                        children.push_back(NO_CHILD);
+                        children.push_back(NO_CHILD);
+                    } else if (child & 1) {
+                        cthrow("the codes are not a prefix code");
+                    }
+                    node = child >> 1;
+                }
+                uint32_t &leaf = children[2 * node + code.back()];
+                if (leaf != NO_CHILD) {
+                    cthrow("the codes are not a prefix code");
+                }
+                leaf = entry << 1 | 1;
+            }
+        };
+
+    }
+
+    void write_embedded_model(const DictHuffmanCodec &codec, const string &name, const string &header_include,
+                              std::ostream &header, std::ostream &source) {
+        const vector<string> &dict = codec.dictionary();
+        if (dict.size() < 3) {
+            cthrow("the model has " << (dict.size() ? dict.size() - 1 : 0) << " dictionary entries, at least 2 are needed");
+        }
+
+        string arena;
+        vector<uint32_t> offsets{0, 0};
+        vector<uint64_t> codes{0};
+        vector<uint8_t> lengths{0};
+        vector<uint32_t> long_codes;
+        unsigned max_length = 0;
+        CodeTree tree;
+        for (size_t i = 1; i < dict.size(); ++i) {
+            arena += dict[i];
+            offsets.push_back(static_cast<uint32_t>(arena.size()));
+            const vector<bool> &code = codec.entry_code(i);
+            if (code.empty() || code.size() > MAX_CODE_LENGTH) {
+                cthrow("entry " << i << " has a code of " << code.size() << " bits, 1 to " << MAX_CODE_LENGTH
+                       << " are supported");
+            }
+            if (code.size() <= MAX_WORD_CODE) {
+                uint64_t value = 0;
+                for (bool bit : code) {
+                    value = value << 1 | bit;
+                }
+                codes.push_back(value);
+            } else {
+                codes.push_back(long_codes.size());
+                for (size_t chunk = 0; chunk < code.size(); chunk += 32) {
+                    uint32_t value = 0;
+                    for (size_t bit = chunk; bit < std::min(code.size(), chunk + 32); ++bit) {
+                        value = value << 1 | code[bit];
+                    }
+                    long_codes.push_back(value);
+                }
+            }
+            lengths.push_back(static_cast<uint8_t>(code.size()));
+            max_length = std::max<unsigned>(max_length, code.size());
+            tree.add(code, static_cast<uint32_t>(i));
+        }
+        if (std::count(tree.children.begin(), tree.children.end(), NO_CHILD)) {
+            cthrow("the code tree is not full");
+        }
+
+        unsigned table_bits = std::min(max_length, MAX_TABLE_BITS);
+        vector<uint32_t> decode_table(size_t(1) << table_bits);
+        for (uint32_t prefix = 0; prefix < decode_table.size(); ++prefix) {
+            uint32_t next = 0;
+            unsigned length = 0;
+            while (length < table_bits && !(next & 1)) {
+                next = tree.children[(next & ~1u) + ((prefix >> (table_bits - 1 - length)) & 1)];
+                ++length;
+            }
+            decode_table[prefix] = next & 1 ? (next >> 1) << 8 | length << 1 | 1 : next;
+        }
+
+        // the matcher; a later entry spelling the same string wins, as in DictHuffmanCodec
+        vector<std::map<unsigned char, uint32_t>> trie(1);
+        vector<uint32_t> trie_entry(1, 0);
+        for (size_t i = 1; i < dict.size(); ++i) {
+            uint32_t node = 0;
+            for (char c : dict[i]) {
+                auto inserted = trie[node].emplace(static_cast<unsigned char>(c), static_cast<uint32_t>(trie.size()));
+                node = inserted.first->second;
+                if (inserted.second) {
+                    trie.emplace_back();
+                    trie_entry.push_back(0);
+                }
+            }
+            trie_entry[node] = static_cast<uint32_t>(i);
+        }
+        // breadth first numbering keeps the nodes near the root together
+        vector<uint32_t> order;
+        vector<uint32_t> number(trie.size());
+        std::queue<uint32_t> queue;
+        queue.push(0);
+        while (!queue.empty()) {
+            uint32_t node = queue.front();
+            queue.pop();
+            number[node] = static_cast<uint32_t>(order.size());
+            order.push_back(node);
+            for (const auto &child : trie[node]) {
+                queue.push(child.second);
+            }
+        }
+        vector<uint32_t> trie_root(256, 0);
+        for (const auto &child : trie[0]) {
+            trie_root[child.first] = number[child.second];
+        }
+        vector<uint32_t> trie_first{0, 0};
+        vector<unsigned char> trie_symbols;
+        vector<uint32_t> trie_targets;
+        vector<uint32_t> trie_entries{0};
+        for (size_t n = 1; n < order.size(); ++n) {
+            for (const auto &child : trie[order[n]]) {
+                trie_symbols.push_back(child.first);
+                trie_targets.push_back(number[child.second]);
+            }
+            trie_first.push_back(static_cast<uint32_t>(trie_symbols.size()));
+            trie_entries.push_back(trie_entry[order[n]]);
+        }
+
+        string model = codec.save();
+
+        header << "#pragma once\n\n"
+               << "// Generated by codecs-embed from a DictHuffman model, do not edit.\n\n"
+               << "#include <library/Embedded/Embedded.h>\n\n"
+               << "#include <cstdint>\n\n"
+               << "struct " << name << " {\n";
+        source << "// Generated by codecs-embed from a DictHuffman model, do not edit.\n\n"
+               << "#include \"" << header_include << "\"\n\n";
+        TableWriter tables{name, header, source};
+        tables.constant("uint32_t", "ENTRIES", dict.size());
+        tables.bytes("ARENA", arena);
+        tables.array("uint32_t", "OFFSETS", offsets);
+        tables.array("uint64_t", "CODES", codes);
+        tables.array("uint8_t", "LENGTHS", lengths);
+        tables.array("uint32_t", "LONG_CODES", long_codes);
+        tables.constant("unsigned", "MAX_LENGTH", max_length);
+        tables.constant("unsigned", "TABLE_BITS", table_bits);
+        tables.array("uint32_t", "DECODE_TABLE", decode_table);
+        tables.array("uint32_t", "DECODE_TREE", tree.children);
+        tables.array("uint32_t", "TRIE_ROOT", trie_root);
+        tables.array("uint32_t", "TRIE_FIRST", trie_first);
+        tables.array("unsigned char", "TRIE_SYMBOLS", trie_symbols);
+        tables.array("uint32_t", "TRIE_TARGETS", trie_targets);
+        tables.array("uint32_t", "TRIE_ENTRY", trie_entries);
+        tables.bytes("MODEL", model);
+        tables.constant("size_t", "MODEL_SIZE", model.size());
+        header << "};\n\n"
+               << "using " << name << "Codec = Codecs::EmbeddedDictHuffmanCodec<" << name << ">;\n";
+    }
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/common/codec.h>
+
+#include <ostream>
+
+namespace Codecs {
+
+    // Writes the tables of EmbeddedDictHuffmanCodec for the model of `codec` as the struct `name`.
+    // `header` gets the tables with their values, so code including it sees their sizes and contents,
+    // and the alias <name>Codec; `source` gets the definitions of the static members and includes the
+    // header as `header_include`. Throws for models the tables can't represent.
+    void write_embedded_model(const DictHuffmanCodec &codec, const string &name, const string &header_include,
+                              std::ostream &header, std::ostream &source);
+
+}
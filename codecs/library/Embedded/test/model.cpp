@@ -0,0 +1,54 @@
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/common/frame.h>
+#include <library/tests_common/tests_common.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+    bool write_model(const char *path, const std::string &model) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.put(static_cast<char>(Codecs::CodecType::DICT_HUFFMAN));
+        out.write(model.data(), model.size());
+        return out.good();
+    }
+
+    // Every byte and the words of the lorem ipsum, in the format of DictHuffmanCodec::save(), with
+    // frequencies halving from entry to entry: the code tree degenerates into a chain, and the longest
+    // codes take more than a machine word.
+    std::string skewed_model() {
+        std::vector<std::string> entries;
+        for (int c = 0; c < 256; ++c) {
+            entries.push_back(std::string(1, static_cast<char>(c)));
+        }
+        for (const char *word : {"Lorem", "ipsum", "dolor", " sit", " amet", ", consectetur"}) {
+            entries.push_back(word);
+        }
+        std::string model;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            model.push_back(static_cast<char>(entries[i].size()));
+            model += entries[i];
+            double frequency = std::ldexp(1.0, -static_cast<int>(std::min<size_t>(i, 90)));
+            char bytes[8];
+            memcpy(bytes, &frequency, 8);
+            model.append(bytes, 8);
+        }
+        model.push_back(0);
+        return model;
+    }
+
+}
+
+// Writes a DictHuffman model trained on the lorem ipsum records to argv[1] and a hand made model with
+// very long codes to argv[2], in the ModelCache format.
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        return 1;
+    }
+    Codecs::StringVector records = Codecs::lorem_records();
+    Codecs::DictHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(records.begin(), records.end()));
+    return write_model(argv[1], codec.save()) && write_model(argv[2], skewed_model()) ? 0 : 1;
+}
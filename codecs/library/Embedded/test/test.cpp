@@ -0,0 +1,103 @@
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/Embedded/test/LoremModel.h>
+#include <library/Embedded/test/SkewedModel.h>
+#include <library/tests_common/tests_common.h>
+
+#include <random>
+
+namespace {
+
+    template <typename Codec>
+    Codecs::DictHuffmanCodec runtime_codec() {
+        Codecs::DictHuffmanCodec codec;
+        codec.load(Codec().save());
+        return codec;
+    }
+
+    std::string random_bytes(std::mt19937 &generator, size_t size) {
+        std::string bytes(size, 0);
+        for (auto &c : bytes) {
+            c = static_cast<char>(generator());
+        }
+        return bytes;
+    }
+
+    template <typename Codec>
+    class EmbeddedTest : public ::testing::Test {
+    };
+
+    typedef ::testing::Types<LoremModelCodec, SkewedModelCodec> EmbeddedCodecs;
+
+}
+
+TYPED_TEST_CASE(EmbeddedTest, EmbeddedCodecs);
+
+TYPED_TEST(EmbeddedTest, SameOutputAsRuntimeCodec) {
+    TypeParam embedded;
+    Codecs::DictHuffmanCodec runtime = runtime_codec<TypeParam>();
+    std::mt19937 generator(5);
+    Codecs::StringVector inputs = Codecs::lorem_records();
+    inputs.push_back("");
+    inputs.push_back(Codecs::LOREM_IPSUM);
+    inputs.push_back("Съешь же ещё этих мягких французских булок");
+    for (size_t size : {1, 7, 8, 9, 100, 5000}) {
+        inputs.push_back(random_bytes(generator, size));
+    }
+    for (const auto &raw : inputs) {
+        std::string expected;
+        runtime.encode(expected, raw);
+        std::string encoded = "stale";
+        embedded.encode(encoded, raw);
+        ASSERT_EQ(expected, encoded) << raw;
+
+        std::string decoded = "prefix";
+        embedded.decode(decoded, encoded);
+        ASSERT_EQ("prefix" + raw, decoded);
+    }
+}
+
+TYPED_TEST(EmbeddedTest, DecodesArbitraryBitsLikeRuntimeCodec) {
+    TypeParam embedded;
+    Codecs::DictHuffmanCodec runtime = runtime_codec<TypeParam>();
+    std::mt19937 generator(11);
+    const char huffman = static_cast<char>(Codecs::DictHuffmanLevel::HUFFMAN);
+    for (size_t size = 0; size < 200; ++size) {
+        std::string encoded = huffman + random_bytes(generator, size);
+        std::string expected;
+        runtime.decode(expected, encoded);
+        std::string decoded;
+        embedded.decode(decoded, encoded);
+        ASSERT_EQ(expected, decoded) << size;
+    }
+    // fast payloads and unknown levels
+    std::string decoded;
+    for (char level : {'\x00', '\x03', '\xFF'}) {
+        ASSERT_THROW(embedded.decode(decoded, level + random_bytes(generator, 10)), Codecs::CodecException);
+    }
+    ASSERT_THROW(embedded.decode(decoded, ""), Codecs::CodecException);
+}
+
+TYPED_TEST(EmbeddedTest, ModelIsFixed) {
+    TypeParam embedded;
+    ASSERT_NO_THROW(embedded.load(embedded.save()));
+    ASSERT_THROW(embedded.load("other"), Codecs::CodecException);
+    ASSERT_THROW(embedded.learn({"text"}), Codecs::CodecException);
+
+    Codecs::ModelInfo info;
+    ASSERT_TRUE(embedded.inspect(info));
+    ASSERT_EQ(runtime_codec<TypeParam>().dictionary().size() - 1, info.entries.size());
+}
+
+TEST(EmbeddedTablesTest, Sizes) {
+    // the lorem model's codes are about as long as the table is wide, the skewed model has codes longer
+    // than a machine word
+    ASSERT_LE(LoremModel::TABLE_BITS, LoremModel::MAX_LENGTH);
+    ASSERT_LT(LoremModel::MAX_LENGTH, 16u);
+    ASSERT_GT(SkewedModel::MAX_LENGTH, 64u);
+    ASSERT_EQ(SkewedModel::ENTRIES, runtime_codec<SkewedModelCodec>().dictionary().size());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
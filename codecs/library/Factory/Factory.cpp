@@ -0,0 +1,28 @@
+#include "Factory.h"
+
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/Huffman/Huffman.h>
+#include <library/Lz77/Lz77.h>
+#include <library/WordHuffman/WordHuffman.h>
+#include <library/zlib/zlib.h>
+
+namespace Codecs {
+
+    std::unique_ptr<CodecIFace> make_codec(CodecType type) {
+        switch (type) {
+            case CodecType::HUFFMAN:
+                return std::unique_ptr<CodecIFace>(new HuffmanCodec());
+            case CodecType::DICT_HUFFMAN:
+                return std::unique_ptr<CodecIFace>(new DictHuffmanCodec());
+            case CodecType::ZLIB:
+                return std::unique_ptr<CodecIFace>(new ZlibDictCodec());
+            case CodecType::LZ77:
+                return std::unique_ptr<CodecIFace>(new Lz77Codec());
+            case CodecType::WORD_HUFFMAN:
+                return std::unique_ptr<CodecIFace>(new WordHuffmanCodec());
+            default:
+                cthrow("no single-model codec for type " << static_cast<unsigned>(type));
+        }
+    }
+
+}
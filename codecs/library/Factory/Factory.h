@@ -0,0 +1,15 @@
+#pragma once
+
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <memory>
+
+namespace Codecs {
+
+    // A codec with default options for models of a single-model CodecType, the ones composite codecs
+    // (AutoCodec, ClusteredCodec) wrap and save by type. Throws for STORED and the composite types;
+    // tools pick codecs by name from the CodecRegistry.
+    std::unique_ptr<CodecIFace> make_codec(CodecType type);
+
+}
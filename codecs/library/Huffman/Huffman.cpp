@@ -1,5 +1,7 @@
 #include <library/Huffman/Huffman.h>
 #include <library/common/codec.h>
+#include <library/common/histogram.h>
+#include <library/common/stats.h>
 #include <algorithm>
 #include <bitset>
 #include <functional>
@@ -94,7 +96,7 @@ namespace Codecs {
     //Codec implementation
     //private:
     void HuffmanCodec::InplaceSymbols(vector<node> &tree, size_t v, const vector<unsigned char> &chars_list,
-                                      size_t &p, size_t target_level, size_t level = 0) {
+                                      size_t &p, size_t target_level, size_t level = 0) const {
         if (p >= chars_list.size())
             return;
         if (level == target_level && tree[v].is_leaf) {
@@ -122,7 +124,7 @@ namespace Codecs {
         }
     }
 
-    void HuffmanCodec::MakeCodeTree() {
+    void HuffmanCodec::MakeCodeTree(vector<node> &tree) const {
         unsigned m = 0;
         for (unsigned len : codeLenths) {
             m = std::max(m, len);
@@ -139,31 +141,30 @@ namespace Codecs {
             ++max_layer;
         }
 
-        code_tree.resize(static_cast<size_t>(std::pow(2, max_layer + 1)));
-        for (size_t i = 1; i < code_tree.size(); ++i) {
-            code_tree[i].left = 2 * i;
-            code_tree[i].right = 2 * i + 1;
-            code_tree[i].is_leaf = true;
-            code_tree[i].is_escape = false;
-            code_tree[i].leaf_value = 0;
+        tree.resize(static_cast<size_t>(std::pow(2, max_layer + 1)));
+        for (size_t i = 1; i < tree.size(); ++i) {
+            tree[i].left = 2 * i;
+            tree[i].right = 2 * i + 1;
+            tree[i].is_leaf = true;
+            tree[i].is_escape = false;
+            tree[i].leaf_value = 0;
         }
 
         size_t p = 1;
         for (unsigned level = 0; level < max_layer; ++level) {
-            code_tree[p].is_leaf = false;
-            p = code_tree[p].left;
+            tree[p].is_leaf = false;
+            p = tree[p].left;
         }
-        code_tree[p].is_escape = true;
+        tree[p].is_escape = true;
 
         for (size_t j = chars_by_layer.size() - 1; j > 0; --j) {
             size_t next_char_to_place = 0;
-            InplaceSymbols(code_tree, 1, chars_by_layer[j], next_char_to_place, j);
+            InplaceSymbols(tree, 1, chars_by_layer[j], next_char_to_place, j);
         }
-        tree_root = code_tree[1];
     }
 
     void HuffmanCodec::MakeCodes(const vector<node> &tree, size_t pos, vector<bool> prefix,
-                                 vector<vector<bool>> &out, vector<bool> &escape_code) {
+                                 vector<vector<bool>> &out, vector<bool> &escape_code) const {
         if (tree[pos].is_escape) {
             escape_code = prefix;
         } else if (tree[pos].is_leaf) {
@@ -177,27 +178,99 @@ namespace Codecs {
         }
     }
 
-    void HuffmanCodec::MakeCodes() {
-        precounted.resize(256);
-        MakeCodes(code_tree, 1, {}, precounted, escape_code);
+    void HuffmanCodec::MakeCodes(const vector<node> &tree) const {
+        precounted.assign(256, vector<bool>());
+        escape_code.clear();
+        MakeCodes(tree, 1, {}, precounted, escape_code);
+    }
+
+    void HuffmanCodec::MakeDecoder() const {
+        MakeCodeTree(code_tree);
+        tree_root = code_tree[1];
+    }
+
+    // the tree is rebuilt rather than shared, a lazy decoder may be building code_tree meanwhile
+    void HuffmanCodec::MakeEncoder() const {
+        vector<node> tree;
+        MakeCodeTree(tree);
+        MakeCodes(tree);
+    }
+
+    void HuffmanCodec::MakeSides(LoadMode mode) {
+        code_tree.clear();
+        precounted.clear();
+        escape_code.clear();
+        decoder.reset(ModelSide::of(mode, false));
+        encoder.reset(ModelSide::of(mode, true));
+        if (mode == LoadMode::BOTH) {
+            MakeDecoder();
+            MakeCodes(code_tree);
+        } else if (mode == LoadMode::ENCODE) {
+            MakeEncoder();
+        } else if (mode == LoadMode::DECODE) {
+            MakeDecoder();
+        }
     }
 
     //public:
-    void HuffmanCodec::encode(string &encoded, const string_view &raw) const {
+    template <bool Count>
+    void HuffmanCodec::encode_symbols(string &encoded, const string_view &raw, CodecStats *stats) const {
+        RequireEncoder();
         BinString enc;
+        uint64_t escapes = 0;
+        uint64_t bits = 0;
         for (char c : raw) {
             unsigned char symbol = static_cast<unsigned char>(c);
             if (precounted[symbol].size()) {
                 enc.extend(precounted[symbol]);
+                if (Count) {
+                    bits += precounted[symbol].size();
+                }
             } else {
                 enc.extend(escape_code);
                 enc.push_back(symbol);
+                if (Count) {
+                    ++escapes;
+                    bits += escape_code.size() + 8;
+                }
             }
         }
         encoded = enc.move();
+        if (Count) {
+            ++stats->calls;
+            stats->input_bytes += raw.size();
+            stats->symbols += raw.size();
+            stats->escapes += escapes;
+            stats->output_bits += bits;
+        }
+    }
+
+    void HuffmanCodec::encode(string &encoded, const string_view &raw) const {
+        if (STATS_ENABLED) {
+            StatsRegistry::Local local(CodecType::HUFFMAN);
+            encode_symbols<true>(encoded, raw, &local.stats());
+        } else {
+            encode_symbols<false>(encoded, raw, nullptr);
+        }
+    }
+
+    void HuffmanCodec::encode(string &encoded, const string_view &raw, CodecStats *stats) const {
+        if (!stats) {
+            encode(encoded, raw);
+            return;
+        }
+        if (!STATS_ENABLED) {
+            encode_symbols<true>(encoded, raw, stats);
+            return;
+        }
+        CodecStats call;
+        encode_symbols<true>(encoded, raw, &call);
+        StatsRegistry::add(CodecType::HUFFMAN, call);
+        stats->merge(call);
     }
 
     void HuffmanCodec::decode(string &raw, const string_view &encoded) const {
+        RequireDecoder();
         node current_node = tree_root;
         bool code[8];
         vector<bool> escape_buffer;
@@ -280,22 +353,17 @@ namespace Codecs {
             codeLenths[symbol] = lenth;
         }
 
-        MakeCodeTree();
-        MakeCodes();
+        MakeSides(load_mode);
     }
 
-    size_t HuffmanCodec::sample_size(size_t) const {
-        return 100000;
+    // byte counts settle long before this
+    size_t HuffmanCodec::sample_bytes() const {
+        return 4 << 20;
     }
 
     void HuffmanCodec::learn(const StringViewVector &samples) {
-        vector<unsigned long long> frequencies(256, 0);
-        for (auto It = samples.begin(); It != samples.end(); ++It) {
-            for (auto It_s = (*It).begin(); It_s != (*It).end(); ++It_s) {
-                unsigned char symbol = static_cast<unsigned char>(*It_s);
-                frequencies[symbol] += 1;
-            }
-        }
+        ByteCounts frequencies = {0};
+        count_bytes(samples, frequencies);
 
         vector<node> tree;
         std::priority_queue<std::pair<unsigned long long, size_t>,
@@ -309,21 +377,20 @@ namespace Codecs {
         }
 
         while (q.size() > 1) {
-            std::pair<unsigned long, size_t> first;
-            std::pair<unsigned long, size_t> second;
+            std::pair<unsigned long long, size_t> first;
+            std::pair<unsigned long long, size_t> second;
             first = q.top();
             q.pop();
             second = q.top();
             q.pop();
             tree.push_back({first.second, second.second, false, 0, false});
-            q.push({first.first + first.second, tree.size() - 1});
+            q.push({first.first + second.first, tree.size() - 1});
         }
 
         codeLenths = std::vector<unsigned>(256, 0);
 
         CountLenths(tree, codeLenths, tree.size() - 1);
-        MakeCodeTree();
-        MakeCodes();
+        MakeSides(LoadMode::BOTH);
     }
 
     void HuffmanCodec::reset() {
@@ -331,5 +398,36 @@ namespace Codecs {
         code_tree.resize(0);
         precounted.resize(0);
         escape_code.resize(0);
+        decoder.reset(ModelSide::READY);
+        encoder.reset(ModelSide::READY);
+    }
+
+    // describes the sides built so far, a lazy side that is not used yet takes no memory
+    bool HuffmanCodec::inspect(ModelInfo &info) const {
+        bool has_tree = decoder.ready();
+        bool has_codes = encoder.ready();
+        size_t codes_bytes = 0;
+        if (has_codes) {
+            codes_bytes = heap_bytes(precounted);
+            for (const auto &code : precounted) {
+                codes_bytes += heap_bytes(code);
+            }
+        }
+        info.add_structure("code_lengths", codeLenths.size(), heap_bytes(codeLenths), false, false);
+        info.add_structure("code_tree", has_tree ? code_tree.size() : 0, has_tree ? heap_bytes(code_tree) : 0, false, true);
+        info.add_structure("precounted", has_codes ? precounted.size() : 0, codes_bytes, true, false);
+        info.add_structure("escape_code", has_codes ? escape_code.size() : 0,
+                           has_codes ? heap_bytes(escape_code) : 0, true, false);
+        for (size_t symbol = 0; has_codes && symbol < precounted.size(); ++symbol) {
+            unsigned length = precounted[symbol].size();
+            if (length) {
+                info.add_code(length);
+                info.entries.push_back({string(1, static_cast<char>(symbol)), 0.0, length});
+            }
+        }
+        if (has_codes && !escape_code.empty()) {
+            info.add_code(escape_code.size());
+        }
+        return true;
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <library/common/codec.h>
+#include <library/common/inspect.h>
+#include <library/common/model_side.h>
+#include <library/common/stats.h>
 
 namespace Codecs {
 
@@ -49,37 +52,80 @@ namespace Codecs {
         const unsigned MAX_CODE_L = 9;
         const unsigned BITS_PER_SYMBOL_IN_DICT = 5;
     private:
+        LoadMode load_mode = LoadMode::BOTH;
         vector<unsigned> codeLenths;
-        vector<node> code_tree;
-        node tree_root;
-        vector<vector<bool>> precounted;
-        vector<bool> escape_code;
+        // the decoder side, built from codeLenths by load() or on first use
+        mutable vector<node> code_tree;
+        mutable node tree_root;
+        ModelSide decoder;
+        // the encoder side
+        mutable vector<vector<bool>> precounted;
+        mutable vector<bool> escape_code;
+        ModelSide encoder;
 
         void InplaceSymbols(vector<node> &, size_t, const vector<unsigned char> &,
-                            size_t &, size_t, size_t);
+                            size_t &, size_t, size_t) const;
 
         void CountLenths(const vector<node> &, std::vector<unsigned> &, size_t, unsigned);
 
-        void MakeCodeTree();
+        void MakeCodeTree(vector<node> &tree) const;
 
-        void MakeCodes(const vector<node> &, size_t, vector<bool>, vector<vector<bool>> &, vector<bool> &);
+        void MakeCodes(const vector<node> &, size_t, vector<bool>, vector<vector<bool>> &, vector<bool> &) const;
 
-        void MakeCodes();
+        void MakeCodes(const vector<node> &tree) const;
+
+        void MakeDecoder() const;
+
+        void MakeEncoder() const;
+
+        // builds the sides `mode` asks for now, see LoadMode
+        void MakeSides(LoadMode mode);
+
+        void RequireEncoder() const {
+            encoder.require("encoder", [this] { MakeEncoder(); });
+        }
+
+        void RequireDecoder() const {
+            decoder.require("decoder", [this] { MakeDecoder(); });
+        }
+
+        template <bool Count>
+        void encode_symbols(string &encoded, const string_view &raw, CodecStats *stats) const;
 
     public:
         void encode(string &encoded, const string_view &raw) const override;
 
+        // also adds the counters of this call to `stats`
+        void encode(string &encoded, const string_view &raw, CodecStats *stats) const override;
+
         void decode(string &raw, const string_view &encoded) const override;
 
         string save() const override;
 
         void load(const string &) override;
 
-        size_t sample_size(size_t) const override;
+        size_t sample_bytes() const override;
 
         void learn(const StringViewVector &samples) override;
 
         void reset() override;
+
+        void set_load_mode(LoadMode mode) override {
+            load_mode = mode;
+        }
+
+        bool inspect(ModelInfo &info) const override;
+
+        // 0 for symbols which are sent through the escape code
+        unsigned code_length(unsigned char symbol) const {
+            RequireEncoder();
+            return precounted.empty() ? 0 : precounted[symbol].size();
+        }
+
+        unsigned escape_length() const {
+            RequireEncoder();
+            return escape_code.size();
+        }
     };
 
 } //  namespace Huffman
@@ -1,53 +1,129 @@
 #include <library/Huffman/Huffman.h>
-#include <experimental/string_view>
-#include <iostream>
-#include <string>
-#include <vector>
-// #include <library/tests_common/tests_common.h>
+#include <library/tests_common/tests_common.h>
 
-/*TEST(HuffmanCodecTest, Works) {
+#include <thread>
+
+TEST(HuffmanCodecTest, Works) {
     Codecs::HuffmanCodec codec;
-    Codecs::TestSimple(codec);
-};
+    Codecs::test_simple(codec);
+}
 
-int main(int argc, char **argv) {
-    ::testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
+TEST(HuffmanCodecTest, LoadedModelEncodesTheSame) {
+    Codecs::HuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    std::string simple_raw = "Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris";
+
+    Codecs::HuffmanCodec other;
+    other.load(codec.save());
+    std::string code, code_new;
+    codec.encode(code, simple_raw);
+    other.encode(code_new, simple_raw);
+    ASSERT_EQ(code, code_new);
 }
-*/
 
-int main() {
+TEST(HuffmanCodecTest, LoadModes) {
     Codecs::HuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    std::string raw = "Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris\xFF";
+    std::string encoded;
+    codec.encode(encoded, raw);
 
-    codec.learn(
-            {"Lorem ipsum dolor sit amet, consectetur adipisicing elit, "
-                     "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua."
-                     "Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris"
-                     "nisi ut aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in"
-                     "voluptate velit esse cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat"
-                     "non proident, sunt in culpa qui officia deserunt mollit anim id est laborum."});
+    Codecs::HuffmanCodec encoder;
+    encoder.set_load_mode(Codecs::LoadMode::ENCODE);
+    encoder.load(codec.save());
+    std::string out;
+    encoder.encode(out, raw);
+    ASSERT_EQ(encoded, out);
+    ASSERT_THROW(encoder.decode(out, encoded), Codecs::CodecException);
 
-    std::string simple_raw = "Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris";
+    Codecs::HuffmanCodec decoder;
+    decoder.set_load_mode(Codecs::LoadMode::DECODE);
+    decoder.load(codec.save());
+    out.clear();
+    decoder.decode(out, encoded);
+    ASSERT_EQ(raw, out);
+    ASSERT_THROW(decoder.code_length('a'), Codecs::CodecException);
 
-    std::string code;
-    codec.encode(code, simple_raw);
-    std::string decoded;
-    codec.decode(decoded, code);
-    std::cout << ((decoded == simple_raw) ? ("Matched") : ("Didn't matched")) << '\n' << simple_raw
-    << "\nCompression ratio: " << static_cast<double>(simple_raw.size()) / static_cast<double>(code.size())
-    << '\n' << decoded;
+    Codecs::HuffmanCodec lazy;
+    lazy.set_load_mode(Codecs::LoadMode::LAZY);
+    lazy.load(codec.save());
+    std::vector<std::string> decodes(4);
+    std::vector<std::thread> threads;
+    for (auto &decoded : decodes) {
+        threads.emplace_back([&] { lazy.decode(decoded, encoded); });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &decoded : decodes) {
+        ASSERT_EQ(raw, decoded);
+    }
+    ASSERT_EQ(codec.code_length('e'), lazy.code_length('e'));
+}
 
-    Codecs::HuffmanCodec other;
-    other.load(codec.save());
+TEST(HuffmanCodecTest, CallStats) {
+    Codecs::HuffmanCodec codec;
+    codec.learn({"aaaaaaaabbbbcc"});
 
-    std::string code_new;
-    other.encode(code_new, simple_raw);
-    std::cout << "\n\nDictionary copied ";
-    if (code_new == code)
-        std::cout << "successfully";
-    else
-        std::cout << "with erorrs";
-    std::cout << std::endl;
-
-    return 0;
+    Codecs::CodecStats stats;
+    std::string plain, counted;
+    codec.encode(plain, "abcxyz");
+    codec.encode(counted, "abcxyz", &stats);
+    ASSERT_EQ(plain, counted);
+    ASSERT_EQ(1u, stats.calls);
+    ASSERT_EQ(6u, stats.input_bytes);
+    ASSERT_EQ(6u, stats.symbols);
+    uint64_t escapes = 0, bits = 0;
+    for (char c : std::string("abcxyz")) {
+        unsigned length = codec.code_length(c);
+        escapes += length == 0;
+        bits += length ? length : codec.escape_length() + 8;
+    }
+    ASSERT_GE(escapes, 3u);
+    ASSERT_EQ(escapes, stats.escapes);
+    ASSERT_EQ(bits, stats.output_bits);
+    ASSERT_EQ((bits + 7) / 8, counted.size());
+
+    codec.encode(counted, "xx", &stats);
+    ASSERT_EQ(2u, stats.calls);
+    ASSERT_EQ(escapes + 2, stats.escapes);
+    ASSERT_TRUE(stats.dict_usage.empty());
+}
+
+TEST(HuffmanCodecTest, ThreadLocalStats) {
+    Codecs::HuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    Codecs::StatsRegistry::reset();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&codec]() {
+            std::string encoded;
+            for (int i = 0; i < 100; ++i) {
+                codec.encode(encoded, Codecs::LOREM_IPSUM);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Codecs::CodecStats stats = Codecs::StatsRegistry::snapshot(Codecs::CodecType::HUFFMAN);
+    ASSERT_EQ(Codecs::STATS_ENABLED ? 400u : 0u, stats.calls);
+    ASSERT_EQ(0u, Codecs::StatsRegistry::snapshot(Codecs::CodecType::DICT_HUFFMAN).calls);
+}
+
+TEST(HuffmanCodecTest, CodesFollowFrequencies) {
+    Codecs::HuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    // space and 'e' are the most frequent, 'q' and 'x' among the rarest
+    ASSERT_LT(codec.code_length(' '), codec.code_length('q'));
+    ASSERT_LE(codec.code_length('e'), codec.code_length('x'));
+    std::string encoded;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    // order-0 entropy of the text is about 4.1 bits per byte
+    ASSERT_LT(encoded.size(), std::string(Codecs::LOREM_IPSUM).size() * 4.5 / 8);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
 }
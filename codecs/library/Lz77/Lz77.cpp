@@ -0,0 +1,522 @@
+#include "Lz77.h"
+
+#include <library/common/frame.h>
+#include <library/common/inspect.h>
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+namespace Codecs {
+
+    namespace {
+
+        const unsigned HASH_BITS = 15;
+        const size_t HASH_SIZE = size_t(1) << HASH_BITS;
+        const uint32_t NO_POS = UINT32_MAX;
+
+        // wild copies of decode() write up to this many bytes past the end of a match
+        const size_t COPY_SLACK = 8;
+        // every code is at least a bit and a match takes two, so a payload byte decodes to at most
+        // four matches
+        const uint64_t MAX_EXPANSION = 4 * Lz77Codec::MAX_MATCH;
+        // chains of longer records are released when the record is done, not kept by the thread
+        const size_t KEPT_POSITIONS = size_t(1) << 20;
+
+        // dictionary building: segments are scored by the sample frequencies of their DMER byte substrings
+        const size_t DMER = 8;
+        const size_t SEGMENT = 128;
+        const unsigned DMER_HASH_BITS = 20;
+
+        uint32_t hash4(const char* p) {
+            uint32_t value;
+            memcpy(&value, p, 4);
+            return (value * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        uint32_t dmer_hash(const char* p) {
+            uint64_t value;
+            memcpy(&value, p, 8);
+            return static_cast<uint32_t>((value * 0x9E3779B97F4A7C15ull) >> (64 - DMER_HASH_BITS));
+        }
+
+        // length of the common prefix of `a` and `b`, at most `limit`
+        size_t common_length(const char* a, const char* b, size_t limit) {
+            size_t length = 0;
+            while (length + 8 <= limit) {
+                uint64_t x, y;
+                memcpy(&x, a + length, 8);
+                memcpy(&y, b + length, 8);
+                if (x != y) {
+                    return length + (__builtin_ctzll(x ^ y) >> 3);
+                }
+                length += 8;
+            }
+            while (length < limit && a[length] == b[length]) {
+                ++length;
+            }
+            return length;
+        }
+
+        // Hash heads and chains of the record being parsed, per thread. A head belongs to the current
+        // record only if its generation matches, so nothing is cleared between records.
+        struct RecordChains {
+            struct Head {
+                uint32_t generation;
+                uint32_t pos;
+            };
+
+            vector<Head> heads;
+            vector<uint32_t> prev;
+            uint32_t generation = 0;
+
+            void start(size_t size) {
+                if (++generation == 0 || heads.empty()) {
+                    heads.assign(HASH_SIZE, {0, 0});
+                    generation = 1;
+                }
+                if (prev.size() < size) {
+                    prev.resize(size);
+                }
+            }
+
+            void finish() {
+                if (prev.size() > KEPT_POSITIONS) {
+                    vector<uint32_t>().swap(prev);
+                }
+            }
+        };
+
+        thread_local RecordChains record_chains;
+
+        class SegmentScorer {
+        public:
+            explicit SegmentScorer(const StringViewVector& samples)
+                : counts(size_t(1) << DMER_HASH_BITS, 0)
+            {
+                for (const auto& sample : samples) {
+                    for (size_t pos = 0; pos + DMER <= sample.size(); ++pos) {
+                        ++counts[dmer_hash(sample.data() + pos)];
+                    }
+                }
+            }
+
+            // occurrences of the distinct substrings of `segment` elsewhere in the sample
+            uint64_t score(const string_view& segment) {
+                uint64_t result = 0;
+                seen.clear();
+                for (size_t pos = 0; pos + DMER <= segment.size(); ++pos) {
+                    uint32_t hash = dmer_hash(segment.data() + pos);
+                    if (counts[hash]) {
+                        result += counts[hash] - 1;
+                        seen.push_back({hash, counts[hash]});
+                        counts[hash] = 0;
+                    }
+                }
+                for (const auto& entry : seen) {
+                    counts[entry.first] = entry.second;
+                }
+                return result;
+            }
+
+            // the substrings of a picked segment are worth nothing to the next ones
+            void take(const string_view& segment) {
+                for (size_t pos = 0; pos + DMER <= segment.size(); ++pos) {
+                    counts[dmer_hash(segment.data() + pos)] = 0;
+                }
+            }
+
+        private:
+            vector<uint32_t> counts;
+            vector<std::pair<uint32_t, uint32_t>> seen;
+        };
+
+        // greedy pick of the best segments; scores only go down as segments are picked,
+        // so a popped segment which still beats the next best after rescoring is the best one
+        string build_dictionary(const StringViewVector& samples, size_t max_size) {
+            struct Candidate {
+                uint64_t score;
+                string_view segment;
+
+                bool operator<(const Candidate& other) const {
+                    return score < other.score;
+                }
+            };
+
+            SegmentScorer scorer(samples);
+            std::priority_queue<Candidate> queue;
+            for (const auto& sample : samples) {
+                for (size_t begin = 0; begin + DMER <= sample.size(); begin += SEGMENT / 2) {
+                    string_view segment = sample.substr(begin, SEGMENT);
+                    uint64_t score = scorer.score(segment);
+                    if (score) {
+                        queue.push({score, segment});
+                    }
+                }
+            }
+
+            vector<string_view> picked;
+            size_t total = 0;
+            while (!queue.empty() && total < max_size) {
+                Candidate best = queue.top();
+                queue.pop();
+                best.score = scorer.score(best.segment);
+                if (!best.score) {
+                    continue;
+                }
+                if (!queue.empty() && best.score < queue.top().score) {
+                    queue.push(best);
+                    continue;
+                }
+                string_view segment = best.segment.substr(0, max_size - total);
+                scorer.take(segment);
+                picked.push_back(segment);
+                total += segment.size();
+            }
+
+            string result;
+            result.reserve(total);
+            for (auto It = picked.rbegin(); It != picked.rend(); ++It) {
+                result.append(It->data(), It->size());
+            }
+            return result;
+        }
+
+        class CodeWriter {
+        public:
+            CodeWriter(string& out, const CanonicalHuffman& literals, const CanonicalHuffman& offsets)
+                : out(out)
+                , literals(literals)
+                , offsets(offsets)
+            {}
+
+            void literal(unsigned char symbol) {
+                literals.write(out, symbol);
+            }
+
+            void match(uint32_t length, uint32_t offset) {
+                uint32_t value = length - Lz77Codec::MIN_MATCH;
+                unsigned code = Lz77Codec::value_code(value);
+                literals.write(out, 256 + code);
+                out.write(value - Lz77Codec::value_base(code), Lz77Codec::value_extra_bits(code));
+                value = offset - 1;
+                code = Lz77Codec::value_code(value);
+                offsets.write(out, code);
+                out.write(value - Lz77Codec::value_base(code), Lz77Codec::value_extra_bits(code));
+            }
+
+            void flush() {
+                out.flush();
+            }
+
+        private:
+            BitWriter out;
+            const CanonicalHuffman& literals;
+            const CanonicalHuffman& offsets;
+        };
+
+        struct CodeCounter {
+            vector<uint64_t> literals = vector<uint64_t>(Lz77Codec::LITERAL_CODES, 0);
+            vector<uint64_t> offsets = vector<uint64_t>(Lz77Codec::VALUE_CODES, 0);
+
+            void literal(unsigned char symbol) {
+                ++literals[symbol];
+            }
+
+            void match(uint32_t length, uint32_t offset) {
+                ++literals[256 + Lz77Codec::value_code(length - Lz77Codec::MIN_MATCH)];
+                ++offsets[Lz77Codec::value_code(offset - 1)];
+            }
+        };
+
+        // every symbol keeps a code, so any record can be encoded
+        CanonicalHuffman smoothed_code(vector<uint64_t> frequencies) {
+            for (auto& frequency : frequencies) {
+                ++frequency;
+            }
+            return CanonicalHuffman(CanonicalHuffman::build_lengths(frequencies));
+        }
+    }
+
+    const size_t Lz77Codec::MAX_DICT_SIZE;
+    const size_t Lz77Codec::MIN_MATCH;
+    const size_t Lz77Codec::MAX_MATCH;
+    const unsigned Lz77Codec::MAX_CHAIN;
+    const unsigned Lz77Codec::VALUE_CODES;
+    const unsigned Lz77Codec::LITERAL_CODES;
+
+    // values below 16 are codes of their own, the rest are coded by their highest two bits
+    unsigned Lz77Codec::value_code(uint32_t value) {
+        if (value < 16) {
+            return value;
+        }
+        unsigned high = 31 - __builtin_clz(value);
+        return 16 + (high - 4) * 2 + ((value >> (high - 1)) & 1);
+    }
+
+    unsigned Lz77Codec::value_extra_bits(unsigned code) {
+        return code < 16 ? 0 : (code - 16) / 2 + 3;
+    }
+
+    uint32_t Lz77Codec::value_base(unsigned code) {
+        if (code < 16) {
+            return code;
+        }
+        unsigned extra = value_extra_bits(code);
+        return (2 + (code & 1)) << extra;
+    }
+
+    Lz77Codec::Lz77Codec() {
+        reset();
+    }
+
+    void Lz77Codec::build_chains() {
+        dict_head.assign(HASH_SIZE, NO_POS);
+        dict_prev.assign(dict.size(), NO_POS);
+        for (size_t pos = 0; pos + MIN_MATCH <= dict.size(); ++pos) {
+            uint32_t hash = hash4(dict.data() + pos);
+            dict_prev[pos] = dict_head[hash];
+            dict_head[hash] = pos;
+        }
+    }
+
+    template <typename Sink>
+    void Lz77Codec::parse(const string_view& raw, Sink& sink) const {
+        const char* data = raw.data();
+        const size_t size = raw.size();
+        const uint32_t base = dict.size();
+        if (size > NO_POS - base) {
+            cthrow("record of " << size << " bytes is too big for Lz77Codec");
+        }
+        RecordChains& chains = record_chains;
+        chains.start(size);
+
+        auto head = [&](uint32_t hash) {
+            const RecordChains::Head& head = chains.heads[hash];
+            return head.generation == chains.generation ? head.pos : dict_head[hash];
+        };
+        auto insert = [&](size_t pos) {
+            if (pos + MIN_MATCH <= size) {
+                uint32_t hash = hash4(data + pos);
+                chains.prev[pos] = head(hash);
+                chains.heads[hash] = {chains.generation, static_cast<uint32_t>(base + pos)};
+            }
+        };
+        // window positions below `base` are in the dictionary, which goes on with the record
+        auto match_length = [&](uint32_t candidate, size_t pos) -> size_t {
+            if (candidate >= base) {
+                return common_length(data + (candidate - base), data + pos, size - pos);
+            }
+            size_t in_dict = base - candidate;
+            size_t length = common_length(dict.data() + candidate, data + pos, std::min(in_dict, size - pos));
+            if (length == in_dict) {
+                length += common_length(data, data + pos + length, size - pos - length);
+            }
+            return length;
+        };
+        auto find = [&](size_t pos) {
+            Match best = {0, 0};
+            if (pos + MIN_MATCH > size) {
+                return best;
+            }
+            uint32_t candidate = head(hash4(data + pos));
+            for (unsigned chain = 0; candidate != NO_POS && chain < MAX_CHAIN; ++chain) {
+                size_t length = std::min(match_length(candidate, pos), MAX_MATCH);
+                if (length > best.length) {
+                    best = {static_cast<uint32_t>(length), static_cast<uint32_t>(base + pos - candidate)};
+                    if (pos + length == size || length == MAX_MATCH) {
+                        break;
+                    }
+                }
+                candidate = candidate >= base ? chains.prev[candidate - base] : dict_prev[candidate];
+            }
+            return best;
+        };
+
+        size_t pos = 0;
+        while (pos < size) {
+            Match match = find(pos);
+            insert(pos);
+            if (match.length < MIN_MATCH) {
+                sink.literal(static_cast<unsigned char>(data[pos]));
+                ++pos;
+                continue;
+            }
+            // lazy matching: a longer match one byte later is worth a literal
+            while (pos + 1 < size) {
+                Match next = find(pos + 1);
+                if (next.length <= match.length) {
+                    break;
+                }
+                sink.literal(static_cast<unsigned char>(data[pos]));
+                insert(++pos);
+                match = next;
+            }
+            sink.match(match.length, match.offset);
+            size_t end = pos + match.length;
+            while (++pos < end) {
+                insert(pos);
+            }
+        }
+        chains.finish();
+    }
+
+    void Lz77Codec::encode(string& encoded, const string_view& raw) const {
+        encoded.clear();
+        write_varint(encoded, raw.size());
+        CodeWriter writer(encoded, literals, offsets);
+        parse(raw, writer);
+        writer.flush();
+    }
+
+    void Lz77Codec::decode(string& raw, const string_view& encoded) const {
+        uint64_t size;
+        size_t header = read_varint(size, encoded);
+        // the size comes from the payload, it can't be more than the codes can spell
+        if (size > (encoded.size() - header) * MAX_EXPANSION) {
+            cthrow("corrupted Lz77Codec payload: size " << size);
+        }
+        raw.resize(size + COPY_SLACK);
+        char* const begin = &raw[0];
+        char* const end = begin + size;
+        char* out = begin;
+        const char* const dict_end = dict.data() + dict.size();
+        BitReader in(encoded.data() + header, encoded.data() + encoded.size());
+        while (out < end) {
+            in.refill();
+            unsigned symbol = literals.read(in);
+            // a refill is good for four literals
+            while (symbol < 256) {
+                *out++ = static_cast<char>(symbol);
+                if (out == end) {
+                    break;
+                }
+                if (in.available() < CanonicalHuffman::MAX_LENGTH) {
+                    in.refill();
+                }
+                symbol = literals.read(in);
+            }
+            if (symbol < 256) {
+                break;
+            }
+            symbol -= 256;
+            if (symbol >= VALUE_CODES) {
+                cthrow("corrupted Lz77Codec payload: bad literal code");
+            }
+            in.refill();
+            size_t length = value_base(symbol) + in.read(value_extra_bits(symbol)) + MIN_MATCH;
+            in.refill();
+            unsigned code = offsets.read(in);
+            if (code >= VALUE_CODES) {
+                cthrow("corrupted Lz77Codec payload: bad offset code");
+            }
+            size_t offset = value_base(code) + in.read(value_extra_bits(code)) + 1;
+            size_t done = out - begin;
+            if (length > static_cast<size_t>(end - out) || offset > done + dict.size()) {
+                cthrow("corrupted Lz77Codec payload: match of " << length << " at " << offset);
+            }
+
+            if (offset > done) {
+                // starts in the dictionary, may go on at the record start
+                const char* from = dict_end - (offset - done);
+                size_t count = std::min<size_t>(length, dict_end - from);
+                memcpy(out, from, count);
+                out += count;
+                length -= count;
+            }
+            const char* from = out - offset;
+            if (offset >= 8) {
+                for (size_t i = 0; i < length; i += 8) {
+                    memcpy(out + i, from + i, 8);
+                }
+            } else {
+                for (size_t i = 0; i < length; ++i) {
+                    out[i] = from[i];
+                }
+            }
+            out += length;
+        }
+        if (in.overrun_input()) {
+            cthrow("truncated Lz77Codec payload");
+        }
+        raw.resize(size);
+    }
+
+    string Lz77Codec::save() const {
+        string out;
+        write_varint(out, dict.size());
+        out.append(dict);
+        literals.save(out);
+        offsets.save(out);
+        return out;
+    }
+
+    void Lz77Codec::load(const string& saved) {
+        uint64_t dict_size;
+        size_t pos = read_varint(dict_size, saved);
+        if (dict_size > MAX_DICT_SIZE || dict_size > saved.size() - pos) {
+            cthrow("bad Lz77Codec dictionary size " << dict_size);
+        }
+        string loaded_dict = saved.substr(pos, dict_size);
+        pos += dict_size;
+        CanonicalHuffman loaded_literals = CanonicalHuffman::load(saved, pos);
+        CanonicalHuffman loaded_offsets = CanonicalHuffman::load(saved, pos);
+        if (loaded_literals.symbols() != LITERAL_CODES || loaded_offsets.symbols() != VALUE_CODES) {
+            cthrow("bad Lz77Codec code sizes");
+        }
+        for (unsigned symbol = 0; symbol < LITERAL_CODES; ++symbol) {
+            if (!loaded_literals.length(symbol) || (symbol < VALUE_CODES && !loaded_offsets.length(symbol))) {
+                cthrow("Lz77Codec model has no code for symbol " << symbol);
+            }
+        }
+        dict = std::move(loaded_dict);
+        literals = std::move(loaded_literals);
+        offsets = std::move(loaded_offsets);
+        build_chains();
+    }
+
+    size_t Lz77Codec::sample_bytes() const {
+        return 16 << 20;
+    }
+
+    void Lz77Codec::train_codes(const StringViewVector& samples) {
+        CodeCounter counter;
+        for (const auto& sample : samples) {
+            parse(sample, counter);
+        }
+        literals = smoothed_code(counter.literals);
+        offsets = smoothed_code(counter.offsets);
+    }
+
+    void Lz77Codec::learn(const StringViewVector& samples) {
+        dict = build_dictionary(samples, MAX_DICT_SIZE);
+        build_chains();
+        train_codes(samples);
+    }
+
+    void Lz77Codec::reset() {
+        dict.clear();
+        build_chains();
+        literals = smoothed_code(vector<uint64_t>(LITERAL_CODES, 0));
+        offsets = smoothed_code(vector<uint64_t>(VALUE_CODES, 0));
+    }
+
+    bool Lz77Codec::inspect(ModelInfo& info) const {
+        info.add_structure("dict", dict.size(), heap_bytes(dict), true, true);
+        info.add_structure("dict_chains", dict_head.size() + dict_prev.size(),
+                           heap_bytes(dict_head) + heap_bytes(dict_prev), true, false);
+        info.add_structure("literal_code", literals.symbols(), literals.heap_bytes(), true, true);
+        info.add_structure("offset_code", offsets.symbols(), offsets.heap_bytes(), true, true);
+        for (unsigned symbol = 0; symbol < literals.symbols(); ++symbol) {
+            info.add_code(literals.length(symbol));
+            if (symbol < 256) {
+                info.entries.push_back({string(1, static_cast<char>(symbol)), 0.0, literals.length(symbol)});
+            }
+        }
+        for (unsigned symbol = 0; symbol < offsets.symbols(); ++symbol) {
+            info.add_code(offsets.length(symbol));
+        }
+        return true;
+    }
+
+}
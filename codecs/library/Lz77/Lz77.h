@@ -0,0 +1,77 @@
+#pragma once
+
+#include <library/common/canonical_huffman.h>
+#include <library/common/codec.h>
+
+#include <cstdint>
+
+namespace Codecs {
+
+    // LZ77 over a learned content dictionary which prefills the history window of every record.
+    //
+    // learn() picks up to MAX_DICT_SIZE bytes of record segments which share the most 8 byte substrings
+    // with the rest of the sample, the most valuable ones at the end, where offsets are the shortest.
+    // Matches are found by hash chains; the chains through the dictionary are built once per model.
+    // The payload is the raw length followed by a bit stream of a literal/length code, deflate style,
+    // and an offset code, both canonical Huffman codes trained on the sample.
+    class Lz77Codec : public CodecIFace {
+    public:
+        static const size_t MAX_DICT_SIZE = 65536;
+        static const size_t MIN_MATCH = 4;
+        // longer repeats take several matches, which bounds what a payload byte can decode to
+        static const size_t MAX_MATCH = 65536;
+        static const unsigned MAX_CHAIN = 32;
+
+        // lengths and offsets are sent as one of VALUE_CODES codes followed by extra bits
+        static const unsigned VALUE_CODES = 72;
+        static const unsigned LITERAL_CODES = 256 + VALUE_CODES;
+
+        static unsigned value_code(uint32_t value);
+
+        static unsigned value_extra_bits(unsigned code);
+
+        static uint32_t value_base(unsigned code);
+
+        Lz77Codec();
+
+        void encode(string& encoded, const string_view& raw) const override;
+        void decode(string& raw, const string_view& encoded) const override;
+
+        string save() const override;
+
+        void load(const string&) override;
+
+        size_t sample_bytes() const override;
+
+        void learn(const StringViewVector& samples) override;
+
+        void reset() override;
+
+        bool inspect(ModelInfo& info) const override;
+
+        const string& dictionary() const {
+            return dict;
+        }
+
+    private:
+        string dict;
+        // newest dictionary position by hash and the previous one with the same hash
+        vector<uint32_t> dict_head;
+        vector<uint32_t> dict_prev;
+        CanonicalHuffman literals;
+        CanonicalHuffman offsets;
+
+        struct Match {
+            uint32_t length;
+            uint32_t offset;
+        };
+
+        template <typename Sink>
+        void parse(const string_view& raw, Sink& sink) const;
+
+        void build_chains();
+
+        void train_codes(const StringViewVector& samples);
+    };
+
+}
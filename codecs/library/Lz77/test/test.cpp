@@ -0,0 +1,100 @@
+#include <library/Lz77/Lz77.h>
+#include <library/common/frame.h>
+#include <library/common/inspect.h>
+#include <library/tests_common/tests_common.h>
+
+TEST(Lz77CodecTest, Works) {
+    Codecs::Lz77Codec codec;
+    Codecs::test_simple(codec);
+    ASSERT_FALSE(codec.dictionary().empty());
+    ASSERT_LE(codec.dictionary().size(), Codecs::Lz77Codec::MAX_DICT_SIZE);
+}
+
+TEST(Lz77CodecTest, WorksWithoutModel) {
+    Codecs::Lz77Codec codec;
+    Codecs::test_roundtrip(codec, "");
+    Codecs::test_roundtrip(codec, "a");
+    Codecs::test_roundtrip(codec, Codecs::LOREM_IPSUM);
+    Codecs::test_roundtrip(codec, std::string(100000, 'x'));
+    // longer than MAX_MATCH, so a run of several matches
+    Codecs::test_roundtrip(codec, "ab" + std::string(3 * Codecs::Lz77Codec::MAX_MATCH + 5, 'x') + "ab");
+}
+
+TEST(Lz77CodecTest, ValueCodes) {
+    for (uint32_t value : {0u, 1u, 15u, 16u, 17u, 23u, 24u, 31u, 32u, 1000u, 65535u, 1u << 20, UINT32_MAX}) {
+        unsigned code = Codecs::Lz77Codec::value_code(value);
+        ASSERT_LT(code, Codecs::Lz77Codec::VALUE_CODES) << value;
+        uint32_t base = Codecs::Lz77Codec::value_base(code);
+        ASSERT_LE(base, value);
+        ASSERT_LT(static_cast<uint64_t>(value - base), uint64_t(1) << Codecs::Lz77Codec::value_extra_bits(code)) << value;
+    }
+}
+
+TEST(Lz77CodecTest, DictionaryWindow) {
+    auto corpus = Codecs::test_corpus(Codecs::TextKind::JSON, 2300);
+    Codecs::Lz77Codec codec;
+    codec.learn(Codecs::StringViewVector(corpus.begin(), corpus.begin() + 2000));
+
+    Codecs::Lz77Codec empty;
+    size_t raw_size = 0, encoded_size = 0, empty_size = 0;
+    std::string encoded;
+    for (size_t i = 2000; i < corpus.size(); ++i) {
+        const std::string& record = corpus[i];
+        Codecs::test_roundtrip(codec, record);
+        codec.encode(encoded, record);
+        encoded_size += encoded.size();
+        empty.encode(encoded, record);
+        empty_size += encoded.size();
+        raw_size += record.size();
+    }
+    ASSERT_LT(encoded_size * 2, empty_size);
+    ASSERT_LT(encoded_size * 3, raw_size);
+}
+
+TEST(Lz77CodecTest, MatchesAcrossDictionaryEnd) {
+    Codecs::Lz77Codec codec;
+    std::string repeated = "the quick brown fox jumps over the lazy dog, ";
+    codec.learn({repeated + repeated});
+    // a match which starts in the dictionary and goes on into the record
+    std::string raw = codec.dictionary().substr(codec.dictionary().size() - 10) + "abcabcabcabcabcabc" + repeated;
+    Codecs::test_roundtrip(codec, raw);
+    Codecs::test_roundtrip(codec, repeated + repeated + repeated);
+}
+
+TEST(Lz77CodecTest, SaveLoad) {
+    auto sample = Codecs::test_corpus(Codecs::TextKind::MIXED, 500);
+    Codecs::Lz77Codec codec;
+    codec.learn(Codecs::StringViewVector(sample.begin(), sample.end()));
+    Codecs::Lz77Codec loaded;
+    loaded.load(codec.save());
+    ASSERT_EQ(codec.dictionary(), loaded.dictionary());
+    std::string encoded, decoded;
+    for (size_t i = 0; i < 50; ++i) {
+        codec.encode(encoded, sample[i]);
+        loaded.decode(decoded, encoded);
+        ASSERT_EQ(sample[i], decoded);
+    }
+    ASSERT_THROW(loaded.load(codec.save().substr(0, 100)), Codecs::CodecException);
+
+    Codecs::ModelInfo info;
+    ASSERT_TRUE(codec.inspect(info));
+    ASSERT_LE(info.max_code_length(), Codecs::CanonicalHuffman::MAX_LENGTH);
+}
+
+TEST(Lz77CodecTest, CorruptedPayload) {
+    Codecs::Lz77Codec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    Codecs::test_corrupted_payloads(codec, Codecs::LOREM_IPSUM, 2);
+
+    // a size the codes can't spell is rejected before anything is allocated
+    std::string encoded, decoded, huge;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    Codecs::write_varint(huge, uint64_t(1) << 60);
+    huge += encoded.substr(2);
+    ASSERT_THROW(codec.decode(decoded, huge), Codecs::CodecException);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,233 @@
+#include "ModelCache.h"
+
+#include <library/common/inspect.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+
+namespace Codecs {
+
+    ModelCache::ModelCache(const string& model_dir, size_t memory_budget, Factory factory)
+        : model_dir(model_dir)
+        , memory_budget(memory_budget)
+        , factory(std::move(factory))
+    {}
+
+    ModelCache::~ModelCache() {
+        for (auto& prefetch : prefetches) {
+            prefetch.wait();
+        }
+    }
+
+    ModelCache& ModelCache::global() {
+        static ModelCache cache;
+        return cache;
+    }
+
+    void ModelCache::configure(const string& dir, size_t budget, Factory new_factory) {
+        std::lock_guard<std::mutex> guard(lock);
+        model_dir = dir;
+        memory_budget = budget;
+        factory = std::move(new_factory);
+        evict_locked();
+    }
+
+    size_t ModelCache::footprint(const CodecIFace& codec, size_t saved_size) {
+        ModelInfo info;
+        return codec.inspect(info) ? std::max(info.heap_bytes(), saved_size) : saved_size;
+    }
+
+    string ModelCache::model_path(uint64_t fingerprint) const {
+        std::ostringstream path;
+        path << model_dir << "/" << std::hex << std::setw(16) << std::setfill('0') << fingerprint << ".model";
+        return path.str();
+    }
+
+    uint64_t ModelCache::store(CodecType type, const CodecIFace& codec) {
+        string model = codec.save();
+        uint64_t fingerprint = model_fingerprint(type, model);
+        string path = model_path(fingerprint);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.put(static_cast<char>(type));
+        out.write(model.data(), model.size());
+        if (!out.good()) {
+            cthrow("can't write model " << path);
+        }
+        return fingerprint;
+    }
+
+    uint64_t ModelCache::insert(CodecType type, CodecPtr codec) {
+        string model = codec->save();
+        uint64_t fingerprint = model_fingerprint(type, model);
+        std::lock_guard<std::mutex> guard(lock);
+        size_t charge = footprint(*codec, model.size());
+        put_locked({fingerprint, type, std::move(codec), charge});
+        evict_locked();
+        return fingerprint;
+    }
+
+    std::shared_ptr<ModelCache::Entry> ModelCache::load_entry(uint64_t fingerprint) const {
+        string path = model_path(fingerprint);
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            cthrow("unknown model " << std::hex << fingerprint << ": can't open " << path);
+        }
+        string model((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (model.empty()) {
+            cthrow("empty model file " << path);
+        }
+        CodecType type = static_cast<CodecType>(static_cast<uint8_t>(model[0]));
+        model.erase(0, 1);
+        if (model_fingerprint(type, model) != fingerprint) {
+            cthrow("model file " << path << " does not match its fingerprint");
+        }
+        if (!factory) {
+            cthrow("model cache has no codec factory");
+        }
+        std::unique_ptr<CodecIFace> codec = factory(type);
+        if (!codec) {
+            cthrow("no codec for type " << static_cast<unsigned>(type));
+        }
+        codec->load(model);
+        size_t charge = footprint(*codec, model.size());
+        return std::make_shared<Entry>(Entry{fingerprint, type, CodecPtr(std::move(codec)), charge});
+    }
+
+    ModelCache::Entry ModelCache::acquire(uint64_t fingerprint) {
+        LoadResult pending;
+        std::promise<std::shared_ptr<Entry>> promise;
+        bool owner = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto It = index.find(fingerprint);
+            if (It != index.end()) {
+                lru.splice(lru.begin(), lru, It->second);
+                ++counters.hits;
+                return *It->second;
+            }
+            ++counters.misses;
+            auto loadIt = loading.find(fingerprint);
+            if (loadIt != loading.end()) {
+                pending = loadIt->second;
+            } else {
+                pending = promise.get_future().share();
+                loading.emplace(fingerprint, pending);
+                owner = true;
+            }
+        }
+        if (!owner) {
+            return *pending.get();
+        }
+
+        std::shared_ptr<Entry> entry;
+        try {
+            entry = load_entry(fingerprint);
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                loading.erase(fingerprint);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            put_locked(Entry(*entry));
+            evict_locked();
+            loading.erase(fingerprint);
+            ++counters.loads;
+        }
+        promise.set_value(entry);
+        return *entry;
+    }
+
+    ModelCache::CodecPtr ModelCache::get(uint64_t fingerprint) {
+        return acquire(fingerprint).codec;
+    }
+
+    CodecType ModelCache::type_of(uint64_t fingerprint) {
+        return acquire(fingerprint).type;
+    }
+
+    void ModelCache::prefetch(uint64_t fingerprint) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (index.count(fingerprint) || loading.count(fingerprint)) {
+            return;
+        }
+        prefetches.remove_if([](const std::future<void>& f) {
+            return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+        prefetches.push_back(std::async(std::launch::async, [this, fingerprint]() {
+            try {
+                acquire(fingerprint);
+            } catch (const CodecException&) {
+                // the error is reported again by the get() that actually needs the model
+            }
+        }));
+    }
+
+    void ModelCache::put_locked(Entry&& entry) {
+        auto It = index.find(entry.fingerprint);
+        if (It != index.end()) {
+            memory_used -= It->second->charge;
+            lru.erase(It->second);
+        }
+        memory_used += entry.charge;
+        lru.push_front(std::move(entry));
+        index[lru.front().fingerprint] = lru.begin();
+    }
+
+    void ModelCache::evict_locked() {
+        // the most recently used model always stays, even if it alone exceeds the budget
+        while (memory_used > memory_budget && lru.size() > 1) {
+            memory_used -= lru.back().charge;
+            index.erase(lru.back().fingerprint);
+            lru.pop_back();
+            ++counters.evictions;
+        }
+    }
+
+    void ModelCache::encode(string& framed, uint64_t fingerprint, const string_view& raw) {
+        Entry entry = acquire(fingerprint);
+        string payload;
+        entry.codec->encode(payload, raw);
+        framed.clear();
+        framed.reserve(FrameHeader::MAX_SIZE + payload.size());
+        write_frame_header(framed, {entry.type, fingerprint, raw.size()});
+        framed.append(payload);
+    }
+
+    void ModelCache::decode(string& raw, const string_view& framed) {
+        FrameHeader header;
+        size_t offset = read_frame_header(header, framed);
+        Entry entry = acquire(header.fingerprint);
+        if (entry.type != header.codec_type) {
+            cthrow("frame codec type " << static_cast<unsigned>(header.codec_type)
+                   << " does not match model type " << static_cast<unsigned>(entry.type));
+        }
+        // the length is only checked afterwards, a corrupt frame may claim anything
+        raw.clear();
+        entry.codec->decode(raw, framed.substr(offset));
+        if (raw.size() != header.original_length) {
+            cthrow("decoded " << raw.size() << " bytes, frame says " << header.original_length);
+        }
+    }
+
+    ModelCache::Stats ModelCache::stats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        Stats result = counters;
+        result.memory_used = memory_used;
+        result.models = lru.size();
+        return result;
+    }
+
+    void ModelCache::clear() {
+        std::lock_guard<std::mutex> guard(lock);
+        lru.clear();
+        index.clear();
+        memory_used = 0;
+    }
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace Codecs {
+
+    // Resolves model fingerprints (see frame.h) to loaded codecs.
+    //
+    // Models live in `model_dir` as "<fingerprint in hex>.model" files holding the codec type byte
+    // followed by CodecIFace::save() output. Loaded models are kept in LRU order and evicted once the
+    // total charge exceeds the memory budget; a model is charged its heap footprint as reported by
+    // CodecIFace::inspect(). Concurrent requests for a model that is not loaded yet wait for a single
+    // load instead of each reading the file.
+    class ModelCache {
+    public:
+        using CodecPtr = std::shared_ptr<const CodecIFace>;
+        using Factory = std::function<std::unique_ptr<CodecIFace>(CodecType)>;
+
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t loads;
+            uint64_t evictions;
+            size_t memory_used;
+            size_t models;
+        };
+
+        ModelCache() = default;
+
+        ModelCache(const string& model_dir, size_t memory_budget, Factory factory);
+
+        ModelCache(const ModelCache&) = delete;
+        ModelCache& operator=(const ModelCache&) = delete;
+
+        ~ModelCache();
+
+        static ModelCache& global();
+
+        void configure(const string& model_dir, size_t memory_budget, Factory factory);
+
+        // Writes the model into the model directory and returns its fingerprint.
+        uint64_t store(CodecType type, const CodecIFace& codec);
+
+        // Registers an already loaded model without touching the model directory.
+        uint64_t insert(CodecType type, CodecPtr codec);
+
+        CodecPtr get(uint64_t fingerprint);
+
+        CodecType type_of(uint64_t fingerprint);
+
+        // Starts loading the model in background so that the first get() does not block on disk.
+        void prefetch(uint64_t fingerprint);
+
+        void encode(string& framed, uint64_t fingerprint, const string_view& raw);
+
+        void decode(string& raw, const string_view& framed);
+
+        Stats stats() const;
+
+        void clear();
+
+    private:
+        struct Entry {
+            uint64_t fingerprint;
+            CodecType type;
+            CodecPtr codec;
+            size_t charge;
+        };
+
+        using LoadResult = std::shared_future<std::shared_ptr<Entry>>;
+
+        string model_dir;
+        size_t memory_budget = 256 << 20;
+        Factory factory;
+
+        mutable std::mutex lock;
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        std::unordered_map<uint64_t, LoadResult> loading;
+        size_t memory_used = 0;
+        Stats counters = Stats();
+        std::list<std::future<void>> prefetches;
+
+        string model_path(uint64_t fingerprint) const;
+
+        static size_t footprint(const CodecIFace& codec, size_t saved_size);
+
+        std::shared_ptr<Entry> load_entry(uint64_t fingerprint) const;
+
+        Entry acquire(uint64_t fingerprint);
+
+        void put_locked(Entry&& entry);
+
+        void evict_locked();
+    };
+
+}
@@ -0,0 +1,116 @@
+#include <library/ModelCache/ModelCache.h>
+#include <library/Huffman/Huffman.h>
+#include <library/tests_common/tests_common.h>
+
+#include <thread>
+
+namespace {
+
+    Codecs::HuffmanCodec trained(const std::string& text) {
+        Codecs::HuffmanCodec codec;
+        codec.learn({text});
+        return codec;
+    }
+
+}
+
+TEST(FrameHeaderTest, Roundtrip) {
+    Codecs::FrameHeader header{Codecs::CodecType::DICT_HUFFMAN, 0x0123456789abcdefULL, 1234567};
+    std::string out;
+    Codecs::write_frame_header(out, header);
+    out.append("payload");
+
+    Codecs::FrameHeader parsed;
+    size_t offset = Codecs::read_frame_header(parsed, out);
+    ASSERT_EQ(header.codec_type, parsed.codec_type);
+    ASSERT_EQ(header.fingerprint, parsed.fingerprint);
+    ASSERT_EQ(header.original_length, parsed.original_length);
+    ASSERT_EQ("payload", out.substr(offset));
+    ASSERT_THROW(Codecs::read_frame_header(parsed, "payload"), Codecs::CodecException);
+
+    // version 1 frames are read unless their payloads changed since
+    out[0] = static_cast<char>(Codecs::FrameHeader::FRAME_MAGIC_V1);
+    ASSERT_THROW(Codecs::read_frame_header(parsed, out), Codecs::CodecException);
+    out[1] = static_cast<char>(Codecs::CodecType::HUFFMAN);
+    ASSERT_EQ(offset, Codecs::read_frame_header(parsed, out));
+    ASSERT_EQ(Codecs::CodecType::HUFFMAN, parsed.codec_type);
+}
+
+TEST(ModelCacheTest, DecodesFramesOfSeveralGenerations) {
+    Codecs::TempDir dir("model-cache");
+    Codecs::ModelCache cache(dir.path(), 1 << 20, Codecs::make_huffman_codec);
+    Codecs::HuffmanCodec first = trained(Codecs::LOREM_IPSUM);
+    Codecs::HuffmanCodec second = trained("abracadabra, abracadabra");
+    uint64_t first_id = cache.store(Codecs::CodecType::HUFFMAN, first);
+    uint64_t second_id = cache.store(Codecs::CodecType::HUFFMAN, second);
+    ASSERT_NE(first_id, second_id);
+
+    std::string raw = "Ut enim ad minim veniam, quis nostrud exercitation";
+    std::string framed_first, framed_second, decoded;
+    cache.encode(framed_first, first_id, raw);
+    cache.encode(framed_second, second_id, raw);
+
+    cache.decode(decoded, framed_first);
+    ASSERT_EQ(raw, decoded);
+    cache.decode(decoded, framed_second);
+    ASSERT_EQ(raw, decoded);
+
+    // a frame whose length is corrupt
+    std::string lying;
+    Codecs::write_frame_header(lying, {Codecs::CodecType::HUFFMAN, first_id, uint64_t(1) << 62});
+    Codecs::FrameHeader header;
+    lying.append(framed_first.substr(Codecs::read_frame_header(header, framed_first)));
+    ASSERT_THROW(cache.decode(decoded, lying), Codecs::CodecException);
+
+    auto stats = cache.stats();
+    ASSERT_EQ(2u, stats.loads);
+    ASSERT_EQ(2u, stats.models);
+}
+
+TEST(ModelCacheTest, EvictsLeastRecentlyUsed) {
+    Codecs::TempDir dir("model-cache");
+    Codecs::ModelCache writer(dir.path(), 1 << 20, Codecs::make_huffman_codec);
+    uint64_t a = writer.store(Codecs::CodecType::HUFFMAN, trained(Codecs::LOREM_IPSUM));
+    uint64_t b = writer.store(Codecs::CodecType::HUFFMAN, trained("abracadabra"));
+
+    Codecs::ModelCache cache(dir.path(), 1, Codecs::make_huffman_codec);
+    cache.get(a);
+    cache.get(b);
+    auto stats = cache.stats();
+    ASSERT_EQ(1u, stats.models);
+    ASSERT_EQ(1u, stats.evictions);
+    cache.get(b);
+    ASSERT_EQ(1u, cache.stats().hits);
+}
+
+TEST(ModelCacheTest, ConcurrentMissesLoadOnce) {
+    Codecs::TempDir dir("model-cache");
+    Codecs::ModelCache cache(dir.path(), 1 << 20, Codecs::make_huffman_codec);
+    uint64_t id = cache.store(Codecs::CodecType::HUFFMAN, trained(Codecs::LOREM_IPSUM));
+    cache.prefetch(id);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 8; ++i) {
+        workers.emplace_back([&cache, id]() {
+            std::string framed, decoded;
+            cache.encode(framed, id, "dolore magna aliqua");
+            cache.decode(decoded, framed);
+            ASSERT_EQ("dolore magna aliqua", decoded);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ASSERT_EQ(1u, cache.stats().loads);
+}
+
+TEST(ModelCacheTest, UnknownModel) {
+    Codecs::TempDir dir("model-cache");
+    Codecs::ModelCache cache(dir.path(), 1 << 20, Codecs::make_huffman_codec);
+    ASSERT_THROW(cache.get(42), Codecs::CodecException);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
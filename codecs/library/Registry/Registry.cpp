@@ -0,0 +1,121 @@
+#include "Registry.h"
+
+#include <library/Auto/Auto.h>
+#include <library/Clustered/Clustered.h>
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/Huffman/Huffman.h>
+#include <library/Lz77/Lz77.h>
+#include <library/WordHuffman/WordHuffman.h>
+#include <library/zlib/zlib.h>
+
+namespace Codecs {
+
+    namespace {
+        template <typename Codec>
+        std::unique_ptr<CodecIFace> make() {
+            return std::unique_ptr<CodecIFace>(new Codec());
+        }
+    }
+
+    CodecRegistry& CodecRegistry::instance() {
+        static CodecRegistry* registry = []() {
+            CodecRegistry* result = new CodecRegistry();
+            result->add("huffman", CodecType::HUFFMAN, make<HuffmanCodec>);
+            result->add("dict-huffman", CodecType::DICT_HUFFMAN, make<DictHuffmanCodec>);
+            // same payload format as "dict-huffman", the dictionary is learned from whole characters or words
+            result->add("dict-huffman-chars", CodecType::DICT_HUFFMAN, []() {
+                BorOptions options;
+                options.boundaries = BorBoundaries::CHARACTERS;
+                return std::unique_ptr<CodecIFace>(new DictHuffmanCodec(options));
+            }, false);
+            result->add("dict-huffman-words", CodecType::DICT_HUFFMAN, []() {
+                BorOptions options;
+                options.boundaries = BorBoundaries::WORDS;
+                return std::unique_ptr<CodecIFace>(new DictHuffmanCodec(options));
+            }, false);
+            // the other levels of "dict-huffman", its decoder reads them all
+            result->add("dict-huffman-fast", CodecType::DICT_HUFFMAN, []() {
+                return std::unique_ptr<CodecIFace>(new DictHuffmanCodec(DictHuffmanLevel::FAST));
+            }, false);
+            result->add("dict-huffman-optimal", CodecType::DICT_HUFFMAN, []() {
+                return std::unique_ptr<CodecIFace>(new DictHuffmanCodec(DictHuffmanLevel::OPTIMAL));
+            }, false);
+            result->add("zlib", CodecType::ZLIB, make<ZlibDictCodec>);
+            // same payload format as "zlib" with an empty dictionary
+            result->add("zlib-nodict", CodecType::ZLIB, make<ZlibNoDictCodec>, false);
+            result->add("auto", CodecType::AUTO, make<AutoCodec>);
+            result->add("lz77", CodecType::LZ77, make<Lz77Codec>);
+            result->add("word-huffman", CodecType::WORD_HUFFMAN, make<WordHuffmanCodec>);
+            result->add("clustered", CodecType::CLUSTERED, make<ClusteredCodec>);
+            // same payload format as "clustered", the models are DictHuffman ones
+            result->add("clustered-dict-huffman", CodecType::CLUSTERED, []() {
+                return std::unique_ptr<CodecIFace>(new ClusteredCodec(CodecType::DICT_HUFFMAN));
+            }, false);
+            return result;
+        }();
+        return *registry;
+    }
+
+    void CodecRegistry::add(const string& name, CodecType type, Factory factory, bool canonical) {
+        std::lock_guard<std::mutex> guard(lock);
+        codecs[name] = {type, std::move(factory)};
+        if (canonical) {
+            canonical_names[type] = name;
+        }
+    }
+
+    const CodecRegistry::Entry& CodecRegistry::find(const string& name) const {
+        auto It = codecs.find(name);
+        if (It == codecs.end()) {
+            std::ostringstream known;
+            for (const auto& codec : codecs) {
+                known << " " << codec.first;
+            }
+            cthrow("unknown codec '" << name << "', known codecs:" << known.str());
+        }
+        return It->second;
+    }
+
+    bool CodecRegistry::contains(const string& name) const {
+        std::lock_guard<std::mutex> guard(lock);
+        return codecs.count(name) != 0;
+    }
+
+    std::unique_ptr<CodecIFace> CodecRegistry::create(const string& name) const {
+        std::lock_guard<std::mutex> guard(lock);
+        return find(name).factory();
+    }
+
+    std::unique_ptr<CodecIFace> CodecRegistry::create(CodecType type) const {
+        std::lock_guard<std::mutex> guard(lock);
+        auto It = canonical_names.find(type);
+        if (It == canonical_names.end()) {
+            cthrow("no codec registered for type " << static_cast<unsigned>(type));
+        }
+        return find(It->second).factory();
+    }
+
+    string CodecRegistry::name_of(CodecType type) const {
+        std::lock_guard<std::mutex> guard(lock);
+        auto It = canonical_names.find(type);
+        if (It == canonical_names.end()) {
+            cthrow("no codec registered for type " << static_cast<unsigned>(type));
+        }
+        return It->second;
+    }
+
+    CodecType CodecRegistry::type_of(const string& name) const {
+        std::lock_guard<std::mutex> guard(lock);
+        return find(name).type;
+    }
+
+    vector<string> CodecRegistry::names() const {
+        std::lock_guard<std::mutex> guard(lock);
+        vector<string> result;
+        for (const auto& codec : codecs) {
+            result.push_back(codec.first);
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Codecs {
+
+    // Name -> factory map of the available codecs, so tools can pick codecs at run time.
+    // instance() comes with every codec of this library registered; CodecType lets
+    // the ModelCache and framed payloads find the codec of a stored model.
+    class CodecRegistry {
+    public:
+        using Factory = std::function<std::unique_ptr<CodecIFace>()>;
+
+        static CodecRegistry& instance();
+
+        // `canonical` codecs are the ones create(CodecType) returns for stored models of their type
+        void add(const string& name, CodecType type, Factory factory, bool canonical = true);
+
+        bool contains(const string& name) const;
+
+        std::unique_ptr<CodecIFace> create(const string& name) const;
+
+        std::unique_ptr<CodecIFace> create(CodecType type) const;
+
+        CodecType type_of(const string& name) const;
+
+        // canonical name of the codec type
+        string name_of(CodecType type) const;
+
+        vector<string> names() const;
+
+    private:
+        struct Entry {
+            CodecType type;
+            Factory factory;
+        };
+
+        mutable std::mutex lock;
+        std::map<string, Entry> codecs;
+        std::map<CodecType, string> canonical_names;
+
+        const Entry& find(const string& name) const;
+    };
+
+}
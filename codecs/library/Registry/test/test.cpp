@@ -0,0 +1,37 @@
+#include <library/Registry/Registry.h>
+#include <library/tests_common/tests_common.h>
+
+TEST(CodecRegistryTest, BuiltinCodecsWork) {
+    auto& registry = Codecs::CodecRegistry::instance();
+    ASSERT_GE(registry.names().size(), 5u);
+    for (const auto& name : registry.names()) {
+        auto codec = registry.create(name);
+        ASSERT_TRUE(codec != nullptr) << name;
+        Codecs::test_simple(*codec);
+    }
+}
+
+TEST(CodecRegistryTest, CreatesByType) {
+    auto& registry = Codecs::CodecRegistry::instance();
+    auto trained = registry.create("zlib");
+    trained->learn({Codecs::LOREM_IPSUM});
+
+    auto loaded = registry.create(registry.type_of("zlib"));
+    loaded->load(trained->save());
+    std::string encoded, decoded;
+    trained->encode(encoded, Codecs::LOREM_IPSUM);
+    loaded->decode(decoded, encoded);
+    ASSERT_EQ(Codecs::LOREM_IPSUM, decoded);
+}
+
+TEST(CodecRegistryTest, UnknownCodec) {
+    auto& registry = Codecs::CodecRegistry::instance();
+    ASSERT_FALSE(registry.contains("lzma"));
+    ASSERT_THROW(registry.create("lzma"), Codecs::CodecException);
+    ASSERT_THROW(registry.create(static_cast<Codecs::CodecType>(200)), Codecs::CodecException);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,468 @@
+#include "Synthetic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+
+namespace Codecs {
+
+    const size_t CorpusGenerator::SUCCESSORS;
+    const size_t CorpusGenerator::VOCABULARY_SIZE;
+
+    namespace {
+
+        enum Language {
+            ENGLISH = 0, RUSSIAN = 1, CHINESE = 2
+        };
+
+        const vector<const char*> ENGLISH_WORDS = {
+                "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be",
+                "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have",
+                "an", "had", "they", "you", "were", "their", "one", "all", "we", "can", "her", "has", "there",
+                "been", "if", "more", "when", "will", "would", "who", "so", "no", "compression", "record",
+                "dictionary", "encoded", "service", "request", "response", "status", "value", "error",
+                "timestamp", "user", "session", "message", "payload", "server", "client", "latency"};
+        const vector<const char*> ENGLISH_ONSETS = {
+                "b", "c", "d", "f", "g", "h", "l", "m", "n", "p", "r", "s", "t", "v", "w", "st", "tr", "ch",
+                "sh", "th", "pr", "br", "cl", "gr", "pl", "sp", "wh", ""};
+        const vector<const char*> ENGLISH_VOWELS = {"a", "e", "i", "o", "u", "ea", "ou", "io", "ai", "ee", "y"};
+        const vector<const char*> ENGLISH_CODAS = {
+                "", "", "n", "r", "s", "t", "l", "nd", "st", "ng", "ck", "rt", "m", "ss", "tion", "ment", "ed"};
+
+        const vector<const char*> RUSSIAN_WORDS = {
+                "и", "в", "не", "на", "я", "что", "тот", "быть", "с", "а", "весь",
+                "это", "как", "она", "по", "но", "они", "к", "у", "ты", "из", "мы",
+                "за", "вы", "так", "же", "от", "сказать", "этот", "который",
+                "мочь", "человек", "о", "один", "ещё", "бы", "такой",
+                "только", "себя", "сжатие", "словарь", "запись", "сервер",
+                "запрос", "ответ", "ошибка", "время", "данные"};
+        const vector<const char*> RUSSIAN_ONSETS = {
+                "б", "в", "г", "д", "ж", "з", "к", "л", "м", "н", "п", "р", "с", "т", "ф",
+                "х", "ц", "ч", "ш", "щ", "ст", "пр", "кр", "тр", "бл", "сл", "дв", ""};
+        const vector<const char*> RUSSIAN_VOWELS = {
+                "а", "е", "и", "о", "у", "ы", "я", "ю", "ё", "э"};
+        const vector<const char*> RUSSIAN_CODAS = {
+                "", "", "й", "н", "т", "л", "р", "ст", "ск", "ть", "м", "ого", "ами",
+                "ение", "ный"};
+
+        const vector<const char*> CHINESE_WORDS = {
+                "的", "是", "在", "不", "了", "有", "和", "人", "这", "中", "大", "为", "上",
+                "个", "国", "中文", "数据", "压缩", "字典", "服务器", "请求", "响应",
+                "错误", "时间", "用户"};
+        const uint32_t CJK_FIRST = 0x4E00;
+        const uint32_t CJK_COUNT = 0x9FA5 - 0x4E00 + 1;
+        const size_t CJK_CHARACTERS = 2500;
+
+        const vector<const char*> JSON_LEVELS = {"info", "debug", "warn", "error", "fatal"};
+        const vector<const char*> JSON_STATUSES = {"200", "404", "201", "500", "301", "204", "400", "503"};
+
+        void append_utf8(string& out, uint32_t code) {
+            if (code < 0x80) {
+                out.push_back(static_cast<char>(code));
+            } else if (code < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        }
+
+        vector<double> zipf_weights(size_t n) {
+            vector<double> cumulative(n);
+            double total = 0;
+            for (size_t i = 0; i < n; ++i) {
+                total += 1.0 / (i + 1);
+                cumulative[i] = total;
+            }
+            return cumulative;
+        }
+
+        size_t pick(const vector<double>& cumulative, CorpusGenerator::Random& random) {
+            double u = random.uniform() * cumulative.back();
+            size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+            return std::min(i, cumulative.size() - 1);
+        }
+
+        const char* pick(const vector<const char*>& list, CorpusGenerator::Random& random) {
+            return list[random.below(list.size())];
+        }
+
+        // small lists are Zipf distributed as well, the first entries are the common ones
+        const char* pick_zipf(const vector<const char*>& list, CorpusGenerator::Random& random) {
+            static const vector<double> cumulative = zipf_weights(16);
+            double u = random.uniform() * cumulative[list.size() - 1];
+            size_t i = std::upper_bound(cumulative.begin(), cumulative.begin() + list.size(), u) - cumulative.begin();
+            return list[std::min(i, list.size() - 1)];
+        }
+
+        // log2(e) with 32 fraction bits
+        const int64_t LOG2_E = 6196328019;
+
+        // 2^f for f in [0, 1), both with 32 fraction bits, by the series of e^(f ln 2) in integers
+        uint64_t exp2_fraction(uint64_t f) {
+            const uint64_t LN_2 = 2977044472;
+            uint64_t x = (f * LN_2) >> 32;
+            uint64_t term = uint64_t(1) << 32;
+            uint64_t sum = term;
+            for (uint64_t n = 1; term; ++n) {
+                term = ((term * x) >> 32) / n;
+                sum += term;
+            }
+            return sum;
+        }
+
+        uint64_t record_seed(uint64_t seed, uint64_t index) {
+            return CorpusGenerator::Random(seed * 0x9E3779B97F4A7C15ull + index).next();
+        }
+
+        size_t parse_size(const string& value, const string& spec) {
+            try {
+                size_t used = 0;
+                unsigned long long size = std::stoull(value, &used);
+                if (used == value.size()) {
+                    return size;
+                }
+            } catch (const std::logic_error&) {
+            }
+            cthrow("bad size '" << value << "' in size distribution '" << spec << "'");
+        }
+
+        double parse_double(const string& value, const string& spec) {
+            try {
+                size_t used = 0;
+                double parsed = std::stod(value, &used);
+                if (used == value.size()) {
+                    return parsed;
+                }
+            } catch (const std::logic_error&) {
+            }
+            cthrow("bad number '" << value << "' in size distribution '" << spec << "'");
+        }
+
+    }
+
+    const char* text_kind_name(TextKind kind) {
+        switch (kind) {
+            case TextKind::ASCII:
+                return "ascii";
+            case TextKind::CYRILLIC:
+                return "cyrillic";
+            case TextKind::CJK:
+                return "cjk";
+            case TextKind::MIXED:
+                return "mixed";
+            case TextKind::JSON:
+                return "json";
+            case TextKind::BINARY:
+                return "binary";
+        }
+        return "unknown";
+    }
+
+    bool parse_text_kind(const string& name, TextKind& kind) {
+        for (TextKind candidate : {TextKind::ASCII, TextKind::CYRILLIC, TextKind::CJK, TextKind::MIXED,
+                                   TextKind::JSON, TextKind::BINARY}) {
+            if (name == text_kind_name(candidate)) {
+                kind = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    SizeDistribution SizeDistribution::fixed(size_t size) {
+        SizeDistribution sizes;
+        sizes.shape = FIXED;
+        sizes.min = sizes.max = size;
+        sizes.median = size;
+        return sizes;
+    }
+
+    SizeDistribution SizeDistribution::uniform(size_t min, size_t max) {
+        if (min > max) {
+            cthrow("empty size range [" << min << ", " << max << "]");
+        }
+        SizeDistribution sizes;
+        sizes.shape = UNIFORM;
+        sizes.min = min;
+        sizes.max = max;
+        return sizes;
+    }
+
+    SizeDistribution SizeDistribution::log_normal(double median, double sigma, size_t min, size_t max) {
+        if (min > max || median <= 0 || sigma < 0) {
+            cthrow("bad log-normal size distribution: median " << median << ", sigma " << sigma
+                   << ", range [" << min << ", " << max << "]");
+        }
+        SizeDistribution sizes;
+        sizes.shape = LOG_NORMAL;
+        sizes.median = median;
+        sizes.sigma = sigma;
+        sizes.min = min;
+        sizes.max = max;
+        return sizes;
+    }
+
+    SizeDistribution SizeDistribution::parse(const string& spec) {
+        StringVector parts;
+        std::istringstream in(spec);
+        string part;
+        while (getline(in, part, ':')) {
+            parts.push_back(part);
+        }
+        if (parts.size() == 2 && parts[0] == "fixed") {
+            return fixed(parse_size(parts[1], spec));
+        }
+        if (parts.size() == 3 && parts[0] == "uniform") {
+            return uniform(parse_size(parts[1], spec), parse_size(parts[2], spec));
+        }
+        if ((parts.size() == 3 || parts.size() == 5) && parts[0] == "lognormal") {
+            SizeDistribution defaults = log_normal(1, 0);
+            return log_normal(parse_double(parts[1], spec), parse_double(parts[2], spec),
+                              parts.size() == 5 ? parse_size(parts[3], spec) : defaults.min,
+                              parts.size() == 5 ? parse_size(parts[4], spec) : defaults.max);
+        }
+        cthrow("unknown size distribution '" << spec
+               << "', use fixed:N, uniform:MIN:MAX or lognormal:MEDIAN:SIGMA[:MIN:MAX]");
+    }
+
+    CorpusGenerator::CorpusGenerator(const Options& options)
+        : opts(options)
+    {
+        build_vocabularies();
+    }
+
+    void CorpusGenerator::build_vocabularies() {
+        languages.resize(3);
+        for (size_t language = ENGLISH; language <= CHINESE; ++language) {
+            Vocabulary& vocabulary = languages[language];
+            Random random(opts.seed ^ (0xC0DEC5ull << (8 * language)));
+            const vector<const char*>& base = language == ENGLISH ? ENGLISH_WORDS :
+                                              language == RUSSIAN ? RUSSIAN_WORDS : CHINESE_WORDS;
+            std::set<string> seen(base.begin(), base.end());
+            vocabulary.words.assign(base.begin(), base.end());
+            vocabulary.spaces = language != CHINESE;
+
+            vector<double> characters = zipf_weights(CJK_CHARACTERS);
+            while (vocabulary.words.size() < VOCABULARY_SIZE) {
+                string word;
+                if (language == CHINESE) {
+                    for (size_t length = 1 + random.below(3); length > 0; --length) {
+                        // spread the frequent characters over the whole block
+                        uint32_t rank = static_cast<uint32_t>(pick(characters, random));
+                        append_utf8(word, CJK_FIRST + (rank * 2654435761u) % CJK_COUNT);
+                    }
+                } else {
+                    const auto& onsets = language == ENGLISH ? ENGLISH_ONSETS : RUSSIAN_ONSETS;
+                    const auto& vowels = language == ENGLISH ? ENGLISH_VOWELS : RUSSIAN_VOWELS;
+                    const auto& codas = language == ENGLISH ? ENGLISH_CODAS : RUSSIAN_CODAS;
+                    for (size_t syllables = 1 + random.below(3); syllables > 0; --syllables) {
+                        word.append(pick(onsets, random)).append(pick(vowels, random));
+                    }
+                    word.append(pick(codas, random));
+                }
+                if (seen.insert(word).second) {
+                    vocabulary.words.push_back(word);
+                }
+            }
+
+            vocabulary.cumulative = zipf_weights(vocabulary.words.size());
+            vocabulary.successors.resize(vocabulary.words.size() * SUCCESSORS);
+            for (auto& successor : vocabulary.successors) {
+                successor = static_cast<uint32_t>(pick(vocabulary.cumulative, random));
+            }
+        }
+    }
+
+    size_t CorpusGenerator::pick_size(Random& random) const {
+        const SizeDistribution& sizes = opts.sizes;
+        switch (sizes.shape) {
+            case SizeDistribution::FIXED:
+                return sizes.max;
+            case SizeDistribution::UNIFORM:
+                return sizes.min + random.below(sizes.max - sizes.min + 1);
+            case SizeDistribution::LOG_NORMAL: {
+                // in fixed point with 32 fraction bits, libm results differ in the last bits between
+                // implementations; the normal deviate is the sum of 12 uniform ones minus 6 (Irwin-Hall)
+                int64_t normal = -(int64_t(6) << 32);
+                for (int i = 0; i < 6; ++i) {
+                    uint64_t bits = random.next();
+                    normal += (bits >> 32) + (bits & 0xFFFFFFFFu);
+                }
+                int64_t sigma = std::llround(sizes.sigma * 65536.0);
+                __int128 exponent = (__int128(normal) * sigma >> 16) * LOG2_E >> 32;
+                __int128 whole = exponent >= 0 ? exponent >> 32 : -((-exponent + 0xFFFFFFFFu) >> 32);
+                uint64_t fraction = static_cast<uint64_t>(exponent - (whole << 32));
+                int shift = static_cast<int>(std::max<__int128>(-1100, std::min<__int128>(1100, whole)));
+                double size = std::round(std::ldexp(sizes.median * exp2_fraction(fraction), shift - 32));
+                return static_cast<size_t>(std::max<double>(sizes.min, std::min<double>(sizes.max, size)));
+            }
+        }
+        return sizes.max;
+    }
+
+    void CorpusGenerator::sentence(string& out, const Vocabulary& language, Random& random) const {
+        size_t words = 4 + random.below(14);
+        size_t word = pick(language.cumulative, random);
+        for (size_t i = 0; i < words; ++i) {
+            size_t start = out.size();
+            if (language.spaces && random.below(40) == 0) {
+                out.append(std::to_string(random.below(10000)));
+            } else {
+                out.append(language.words[word]);
+            }
+            if (i == 0 && out[start] >= 'a' && out[start] <= 'z') {
+                out[start] = static_cast<char>(out[start] - 'a' + 'A');
+            }
+            if (i + 1 < words) {
+                if (random.below(8) == 0) {
+                    out.append(language.spaces ? ", " : "，");
+                } else if (language.spaces) {
+                    out.push_back(' ');
+                }
+            }
+            // order-1 Markov step: usually one of the word's successors, otherwise any word
+            if (random.below(2)) {
+                size_t choice = 0;
+                while (choice + 1 < SUCCESSORS && random.below(2)) {
+                    ++choice;
+                }
+                word = language.successors[word * SUCCESSORS + choice];
+            } else {
+                word = pick(language.cumulative, random);
+            }
+        }
+        if (language.spaces) {
+            size_t end = random.below(10);
+            out.append(end == 0 ? "? " : end == 1 ? "! " : ". ");
+        } else {
+            out.append("。");
+        }
+    }
+
+    void CorpusGenerator::json_object(string& out, Random& random) const {
+        const Vocabulary& english = languages[ENGLISH];
+        uint64_t id = random.next() % 100000000;
+        out.append("{\"id\":").append(std::to_string(id))
+           .append(",\"ts\":").append(std::to_string(1461000000 + random.below(100000000)))
+           .append(",\"level\":\"").append(pick_zipf(JSON_LEVELS, random))
+           .append("\",\"user\":\"").append(english.words[pick(english.cumulative, random)])
+           .append(std::to_string(random.below(1000)))
+           .append("\",\"status\":").append(pick_zipf(JSON_STATUSES, random))
+           .append(",\"latency_ms\":").append(std::to_string(random.below(2000)))
+           .append(",\"path\":\"/api/v1/").append(english.words[pick(english.cumulative, random)])
+           .append("/").append(english.words[pick(english.cumulative, random)])
+           .append("\",\"tags\":[");
+        for (size_t tags = random.below(4), i = 0; i < tags; ++i) {
+            out.append(i ? ",\"" : "\"").append(english.words[pick(english.cumulative, random)]).append("\"");
+        }
+        out.append("],\"message\":\"");
+        sentence(out, english, random);
+        out.back() = '"';
+        out.append("}");
+    }
+
+    void CorpusGenerator::generate(string& out, size_t size, uint64_t seed) const {
+        Random random(seed);
+        size_t start = out.size();
+        out.reserve(start + size + 64);
+        if (opts.kind == TextKind::BINARY) {
+            for (size_t i = 0; i < size; ++i) {
+                char byte = static_cast<char>(random.next());
+                while (opts.line_safe && byte == '\n') {
+                    byte = static_cast<char>(random.next());
+                }
+                out.push_back(byte);
+            }
+            return;
+        }
+        bool first = true;
+        while (out.size() - start < size) {
+            switch (opts.kind) {
+                case TextKind::ASCII:
+                    sentence(out, languages[ENGLISH], random);
+                    break;
+                case TextKind::CYRILLIC:
+                    sentence(out, languages[RUSSIAN], random);
+                    break;
+                case TextKind::CJK:
+                    sentence(out, languages[CHINESE], random);
+                    break;
+                case TextKind::MIXED: {
+                    size_t language = random.below(20);
+                    sentence(out, languages[language < 9 ? ENGLISH : language < 16 ? RUSSIAN : CHINESE], random);
+                    break;
+                }
+                case TextKind::JSON:
+                    out.append(first ? "[" : ",");
+                    json_object(out, random);
+                    break;
+                case TextKind::BINARY:
+                    break;
+            }
+            first = false;
+        }
+        // do not cut a multi-byte character in half
+        size_t end = start + size;
+        while (end > start && end < out.size() && (static_cast<unsigned char>(out[end]) & 0xC0) == 0x80) {
+            --end;
+        }
+        out.resize(end);
+    }
+
+    string CorpusGenerator::record(uint64_t index) const {
+        Random random(record_seed(opts.seed, index));
+        size_t size = pick_size(random);
+        string out;
+        generate(out, size, random.next());
+        return out;
+    }
+
+    StringVector CorpusGenerator::records(size_t count) const {
+        StringVector result;
+        result.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            result.push_back(record(i));
+        }
+        return result;
+    }
+
+    StringVector CorpusGenerator::records_of_total_size(uint64_t bytes) const {
+        StringVector result;
+        for (uint64_t total = 0, i = 0; total < bytes; ++i) {
+            result.push_back(record(i));
+            total += std::max<size_t>(result.back().size(), 1);
+        }
+        return result;
+    }
+
+    void write_record(std::ostream& out, const string_view& record, CorpusFormat format) {
+        if (format == CorpusFormat::LINES) {
+            if (record.find('\n') != string_view::npos) {
+                cthrow("a record with a line break can't be written as a line");
+            }
+            out.write(record.data(), record.size());
+            out.put('\n');
+        } else {
+            if (record.size() > UINT32_MAX) {
+                cthrow("record of " << record.size() << " bytes doesn't fit the uint32 size prefix");
+            }
+            char size[4];
+            for (int i = 0; i < 4; ++i) {
+                size[i] = static_cast<char>((record.size() >> (8 * i)) & 0xFF);
+            }
+            out.write(size, 4);
+            out.write(record.data(), record.size());
+        }
+    }
+
+    void write_corpus(std::ostream& out, const StringVector& records, CorpusFormat format) {
+        for (const auto& record : records) {
+            write_record(out, record, format);
+        }
+    }
+
+}
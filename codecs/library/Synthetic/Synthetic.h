@@ -0,0 +1,144 @@
+#pragma once
+
+#include <library/Corpus/Corpus.h>
+#include <library/common/codec.h>
+
+#include <cstdint>
+#include <ostream>
+
+namespace Codecs {
+
+    enum class TextKind {
+        ASCII,      // English-like words
+        CYRILLIC,   // Russian-like words, two byte UTF-8 characters
+        CJK,        // CJK ideographs without spaces, three byte UTF-8 characters
+        MIXED,      // sentences of the three above interleaved
+        JSON,       // JSON-like log records
+        BINARY,     // uniformly random bytes, incompressible
+    };
+
+    const char* text_kind_name(TextKind kind);
+
+    // returns false for an unknown name
+    bool parse_text_kind(const string& name, TextKind& kind);
+
+    struct SizeDistribution {
+        enum Shape {
+            FIXED,      // always `max`
+            UNIFORM,    // uniform in [min, max]
+            LOG_NORMAL, // exp(N(log(median), sigma)) clamped to [min, max], N cut at 6 sigma
+        };
+
+        Shape shape = LOG_NORMAL;
+        size_t min = 16;
+        size_t max = 1 << 20;
+        double median = 1024;
+        double sigma = 1.0;
+
+        static SizeDistribution fixed(size_t size);
+
+        static SizeDistribution uniform(size_t min, size_t max);
+
+        static SizeDistribution log_normal(double median, double sigma, size_t min = 1, size_t max = 1 << 24);
+
+        // "fixed:N", "uniform:MIN:MAX" or "lognormal:MEDIAN:SIGMA[:MIN:MAX]"
+        static SizeDistribution parse(const string& spec);
+    };
+
+    struct CorpusGeneratorOptions {
+        TextKind kind = TextKind::ASCII;
+        uint64_t seed = 1;
+        SizeDistribution sizes;
+        // never put '\n' into a record, so the records can be written as CorpusFormat::LINES
+        bool line_safe = true;
+    };
+
+    // Deterministic synthetic records: the same options give byte-identical records on every
+    // platform with IEEE 754 doubles, since nothing depends on the std distributions, on libm or on
+    // the host; record sizes are drawn in fixed point.
+    // Text is an order-1 Markov chain over a Zipf distributed vocabulary, built from the seed.
+    // Records are independent of each other, record(i) can be produced in any order or in parallel.
+    class CorpusGenerator {
+    public:
+        using Options = CorpusGeneratorOptions;
+
+        explicit CorpusGenerator(const Options& options = Options());
+
+        // record `index` of the corpus, its size follows options.sizes
+        string record(uint64_t index) const;
+
+        // text of exactly `size` bytes (less by at most 3 bytes if a character would be cut) drawn with `seed`
+        void generate(string& out, size_t size, uint64_t seed) const;
+
+        string generate(size_t size, uint64_t seed) const {
+            string out;
+            generate(out, size, seed);
+            return out;
+        }
+
+        // records 0..count-1
+        StringVector records(size_t count) const;
+
+        // records 0, 1, ... until they reach `bytes` in total
+        StringVector records_of_total_size(uint64_t bytes) const;
+
+        const Options& options() const {
+            return opts;
+        }
+
+        class Random {
+        public:
+            explicit Random(uint64_t seed)
+                : state(seed)
+            {}
+
+            // splitmix64
+            uint64_t next() {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            }
+
+            // [0, 1)
+            double uniform() {
+                return (next() >> 11) * (1.0 / 9007199254740992.0);
+            }
+
+            size_t below(size_t n) {
+                return static_cast<size_t>(uniform() * n);
+            }
+
+        private:
+            uint64_t state;
+        };
+
+    private:
+        struct Vocabulary {
+            StringVector words;
+            vector<double> cumulative;   // Zipf weights of `words`
+            vector<uint32_t> successors; // SUCCESSORS likely next words for every word
+            bool spaces = true;          // false for CJK
+        };
+
+        static const size_t SUCCESSORS = 4;
+        static const size_t VOCABULARY_SIZE = 4096;
+
+        Options opts;
+        vector<Vocabulary> languages;
+
+        void build_vocabularies();
+
+        size_t pick_size(Random& random) const;
+
+        void sentence(string& out, const Vocabulary& language, Random& random) const;
+
+        void json_object(string& out, Random& random) const;
+    };
+
+    // writes the records in the format the tester and Corpus read
+    void write_corpus(std::ostream& out, const StringVector& records, CorpusFormat format);
+
+    void write_record(std::ostream& out, const string_view& record, CorpusFormat format);
+
+}
@@ -0,0 +1,160 @@
+#include <library/Synthetic/Synthetic.h>
+#include <library/tests_common/tests_common.h>
+
+#include <cmath>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+    Codecs::CorpusGenerator::Options options(Codecs::TextKind kind, uint64_t seed = 7) {
+        Codecs::CorpusGenerator::Options result;
+        result.kind = kind;
+        result.seed = seed;
+        result.sizes = Codecs::SizeDistribution::log_normal(512, 1.0, 1, 8192);
+        return result;
+    }
+
+    const Codecs::TextKind ALL_KINDS[] = {Codecs::TextKind::ASCII, Codecs::TextKind::CYRILLIC,
+                                          Codecs::TextKind::CJK, Codecs::TextKind::MIXED,
+                                          Codecs::TextKind::JSON, Codecs::TextKind::BINARY};
+
+    bool valid_utf8(const std::string& text) {
+        for (size_t i = 0; i < text.size(); ) {
+            unsigned char c = text[i];
+            size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+            if (!length || i + length > text.size()) {
+                return false;
+            }
+            for (size_t j = 1; j < length; ++j) {
+                if ((static_cast<unsigned char>(text[i + j]) & 0xC0) != 0x80) {
+                    return false;
+                }
+            }
+            i += length;
+        }
+        return true;
+    }
+
+    // order-0 entropy in bits per byte
+    double entropy(const Codecs::StringVector& records) {
+        double counts[256] = {};
+        double total = 0;
+        for (const auto& record : records) {
+            for (unsigned char c : record) {
+                ++counts[c];
+                ++total;
+            }
+        }
+        double bits = 0;
+        for (double count : counts) {
+            if (count) {
+                bits -= count / total * std::log2(count / total);
+            }
+        }
+        return bits;
+    }
+
+}
+
+TEST(SyntheticTest, Deterministic) {
+    for (auto kind : ALL_KINDS) {
+        Codecs::CorpusGenerator first(options(kind)), second(options(kind)), other(options(kind, 8));
+        Codecs::StringVector records = first.records(50);
+        ASSERT_EQ(records, second.records(50)) << Codecs::text_kind_name(kind);
+        ASSERT_NE(records, other.records(50)) << Codecs::text_kind_name(kind);
+        // records do not depend on the order they are produced in
+        ASSERT_EQ(records[42], second.record(42));
+    }
+}
+
+TEST(SyntheticTest, Sizes) {
+    auto fixed = options(Codecs::TextKind::ASCII);
+    fixed.sizes = Codecs::SizeDistribution::fixed(1000);
+    for (const auto& record : Codecs::CorpusGenerator(fixed).records(20)) {
+        ASSERT_EQ(1000u, record.size());
+    }
+
+    auto uniform = options(Codecs::TextKind::CJK);
+    uniform.sizes = Codecs::SizeDistribution::parse("uniform:100:200");
+    for (const auto& record : Codecs::CorpusGenerator(uniform).records(100)) {
+        // a character on the boundary is dropped rather than cut
+        ASSERT_GE(record.size(), 98u);
+        ASSERT_LE(record.size(), 200u);
+    }
+
+    auto log_normal = options(Codecs::TextKind::BINARY);
+    log_normal.sizes = Codecs::SizeDistribution::parse("lognormal:1000:0.5:10:100000");
+    Codecs::StringVector records = Codecs::CorpusGenerator(log_normal).records(1001);
+    std::vector<size_t> sizes;
+    for (const auto& record : records) {
+        sizes.push_back(record.size());
+    }
+    // fixed point, so the same on every platform
+    std::vector<size_t> first(sizes.begin(), sizes.begin() + 8);
+    ASSERT_EQ(std::vector<size_t>({754, 705, 493, 471, 1623, 702, 447, 1512}), first);
+    std::nth_element(sizes.begin(), sizes.begin() + 500, sizes.end());
+    ASSERT_NEAR(1000.0, sizes[500], 100.0);
+
+    ASSERT_THROW(Codecs::SizeDistribution::parse("uniform:10"), Codecs::CodecException);
+    ASSERT_THROW(Codecs::SizeDistribution::parse("fixed:ten"), Codecs::CodecException);
+    ASSERT_THROW(Codecs::SizeDistribution::parse("uniform:20:10"), Codecs::CodecException);
+}
+
+TEST(SyntheticTest, Content) {
+    for (auto kind : ALL_KINDS) {
+        Codecs::StringVector records = Codecs::CorpusGenerator(options(kind)).records(200);
+        for (const auto& record : records) {
+            ASSERT_EQ(std::string::npos, record.find('\n')) << Codecs::text_kind_name(kind);
+            if (kind != Codecs::TextKind::BINARY) {
+                ASSERT_TRUE(valid_utf8(record)) << Codecs::text_kind_name(kind);
+            }
+        }
+        double bits = entropy(records);
+        if (kind == Codecs::TextKind::BINARY) {
+            ASSERT_GT(bits, 7.9);
+        } else {
+            ASSERT_LT(bits, 6.5) << Codecs::text_kind_name(kind);
+        }
+    }
+    std::string cjk = Codecs::CorpusGenerator(options(Codecs::TextKind::CJK)).generate(3000, 1);
+    ASSERT_EQ(std::string::npos, cjk.find(' '));
+    ASSERT_EQ(0u, Codecs::CorpusGenerator(options(Codecs::TextKind::JSON)).generate(3000, 1).find("[{\"id\":"));
+}
+
+TEST(SyntheticTest, ReadBackByCorpus) {
+    Codecs::StringVector records = Codecs::CorpusGenerator(options(Codecs::TextKind::MIXED)).records(300);
+    records.push_back("");
+    for (auto format : {Codecs::CorpusFormat::LINES, Codecs::CorpusFormat::LE_UINT32}) {
+        char path[] = "/tmp/synthetic-XXXXXX";
+        close(mkstemp(path));
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            Codecs::write_corpus(out, records, format);
+        }
+        Codecs::Corpus corpus(path, format);
+        ASSERT_EQ(records.size(), corpus.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            ASSERT_EQ(records[i], corpus[i].to_string());
+        }
+        unlink(path);
+    }
+    std::ostringstream out;
+    ASSERT_THROW(Codecs::write_record(out, "a\nb", Codecs::CorpusFormat::LINES), Codecs::CodecException);
+}
+
+TEST(SyntheticTest, KindNames) {
+    for (auto kind : ALL_KINDS) {
+        Codecs::TextKind parsed;
+        ASSERT_TRUE(Codecs::parse_text_kind(Codecs::text_kind_name(kind), parsed));
+        ASSERT_EQ(kind, parsed);
+    }
+    Codecs::TextKind parsed;
+    ASSERT_FALSE(Codecs::parse_text_kind("klingon", parsed));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
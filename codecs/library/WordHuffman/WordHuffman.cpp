@@ -0,0 +1,465 @@
+#include "WordHuffman.h"
+
+#include <library/Bor/Bor.h>
+#include <library/common/frame.h>
+#include <library/common/inspect.h>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace Codecs {
+
+    namespace {
+
+        const uint64_t ONES = 0x0101010101010101ull;
+        const uint64_t HIGH = 0x8080808080808080ull;
+
+        // high bit of every byte of `v` (7 bit bytes) which is in [low, high]
+        uint64_t bytes_in_range(uint64_t v, unsigned char low, unsigned char high) {
+            uint64_t at_least_low = v + (0x80 - low) * ONES;
+            uint64_t above_high = v + (0x7F - high) * ONES;
+            return at_least_low & ~above_high & HIGH;
+        }
+
+        // bit i is set if byte i of the 8 at `p` is a word character, as BOR::is_word_char decides
+        unsigned word_bits(const char* p) {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            uint64_t v = word & ~HIGH;
+            uint64_t underscore = v ^ ('_' * ONES);
+            uint64_t hits = (word & HIGH)
+                            | bytes_in_range(v | 0x20 * ONES, 'a', 'z')
+                            | bytes_in_range(v, '0', '9')
+                            | (~(underscore + 0x7F * ONES) & HIGH);
+            // gathers the high bits into the top byte, byte i to bit i
+            return static_cast<unsigned>(((hits >> 7) * 0x0102040810204080ull) >> 56);
+        }
+
+        // word character bits of `text`, bit i of mask[i / 64] for text[i]
+        void word_mask(const string_view& text, vector<uint64_t>& mask) {
+            const size_t size = text.size();
+            mask.assign(size / 64 + 1, 0);
+            size_t pos = 0;
+            for (; pos + 8 <= size; pos += 8) {
+                mask[pos >> 6] |= static_cast<uint64_t>(word_bits(text.data() + pos)) << (pos & 63);
+            }
+            if (pos < size) {
+                char tail[8] = {0};
+                memcpy(tail, text.data() + pos, size - pos);
+                mask[pos >> 6] |= static_cast<uint64_t>(word_bits(tail)) << (pos & 63);
+            }
+        }
+
+        thread_local vector<uint64_t> record_mask;
+
+        // Calls `token(begin, end, spaced)` for the tokens of `text` in order: a run of word characters
+        // with the space after it, if any, which makes `spaced`, or a run of other characters, both cut
+        // at MAX_TOKEN_LENGTH bytes.
+        template <typename Callback>
+        void tokenize(const string_view& text, Callback&& token) {
+            const size_t size = text.size();
+            vector<uint64_t>& mask = record_mask;
+            word_mask(text, mask);
+            // the first position from `pos` on which is (not) a word character, `size` if there is none
+            auto run_end = [&](size_t pos, bool word) {
+                size_t block = pos >> 6;
+                uint64_t bits = (word ? ~mask[block] : mask[block]) >> (pos & 63);
+                if (bits) {
+                    return std::min(size, pos + __builtin_ctzll(bits));
+                }
+                for (++block; block < mask.size(); ++block) {
+                    bits = word ? ~mask[block] : mask[block];
+                    if (bits) {
+                        return std::min(size, (block << 6) + __builtin_ctzll(bits));
+                    }
+                }
+                return size;
+            };
+            size_t pos = 0;
+            while (pos < size) {
+                bool word = (mask[pos >> 6] >> (pos & 63)) & 1;
+                size_t end = std::min(run_end(pos, word), pos + WordHuffmanCodec::MAX_TOKEN_LENGTH);
+                bool spaced = word && end < size && end - pos < WordHuffmanCodec::MAX_TOKEN_LENGTH && text[end] == ' ';
+                if (spaced) {
+                    ++end;
+                }
+                token(pos, end, spaced);
+                pos = end;
+            }
+        }
+
+        uint32_t token_hash(const string_view& token) {
+            // FNV-1a
+            uint32_t hash = 2166136261u;
+            for (char c : token) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+            }
+            return hash;
+        }
+
+        struct SymbolCounter {
+            vector<uint64_t> frequencies;
+
+            void symbol(unsigned symbol) {
+                ++frequencies[symbol];
+            }
+
+            void spelled() {}
+        };
+
+        template <bool Count>
+        class SymbolWriter {
+        public:
+            SymbolWriter(string& out, const CanonicalHuffman& code)
+                : out(out)
+                , code(code)
+            {}
+
+            void symbol(unsigned symbol) {
+                code.write(out, symbol);
+                if (Count) {
+                    ++symbols;
+                    bits += code.length(symbol);
+                }
+            }
+
+            void spelled() {
+                if (Count) {
+                    ++fallbacks;
+                }
+            }
+
+            void flush() {
+                out.flush();
+            }
+
+            uint64_t symbols = 0;
+            uint64_t bits = 0;
+            uint64_t fallbacks = 0;
+
+        private:
+            BitWriter out;
+            const CanonicalHuffman& code;
+        };
+    }
+
+    const size_t WordHuffmanCodec::MAX_TOKEN_LENGTH;
+    const size_t WordHuffmanCodec::VOCABULARY_SIZE;
+    const uint64_t WordHuffmanCodec::MIN_COUNT;
+
+    WordHuffmanCodec::WordHuffmanCodec() {
+        reset();
+    }
+
+    void WordHuffmanCodec::build(const StringVector& vocabulary, const vector<uint8_t>& lengths) {
+        if (vocabulary.size() > VOCABULARY_SIZE) {
+            cthrow("vocabulary of " << vocabulary.size() << " tokens is over " << VOCABULARY_SIZE);
+        }
+        if (lengths.size() != 256 + vocabulary.size()) {
+            cthrow("WordHuffmanCodec needs " << 256 + vocabulary.size() << " codes, got " << lengths.size());
+        }
+        CanonicalHuffman built_code(lengths);
+        for (unsigned symbol = 0; symbol < 256; ++symbol) {
+            if (!built_code.length(symbol)) {
+                cthrow("WordHuffmanCodec model has no code for byte " << symbol);
+            }
+        }
+
+        string built_arena;
+        vector<uint32_t> built_offsets;
+        built_offsets.reserve(lengths.size() + 1);
+        for (unsigned byte = 0; byte < 256; ++byte) {
+            built_offsets.push_back(built_arena.size());
+            built_arena.push_back(static_cast<char>(byte));
+        }
+        for (const auto& token : vocabulary) {
+            if (token.size() < 2 || token.size() > MAX_TOKEN_LENGTH) {
+                cthrow("bad WordHuffmanCodec token length " << token.size());
+            }
+            built_offsets.push_back(built_arena.size());
+            built_arena.append(token);
+        }
+        built_offsets.push_back(built_arena.size());
+        built_arena.append(MAX_TOKEN_LENGTH, '\0');
+        if (built_arena.size() >= (size_t(1) << 32)) {
+            cthrow("WordHuffmanCodec vocabulary is too big");
+        }
+
+        size_t slots = 1;
+        while (slots < 2 * vocabulary.size()) {
+            slots <<= 1;
+        }
+        vector<uint32_t> built_index(slots, 0);
+        for (uint32_t symbol = 256; symbol < lengths.size(); ++symbol) {
+            string_view token(built_arena.data() + built_offsets[symbol], built_offsets[symbol + 1] - built_offsets[symbol]);
+            for (size_t slot = token_hash(token) & (slots - 1);; slot = (slot + 1) & (slots - 1)) {
+                if (!built_index[slot]) {
+                    built_index[slot] = symbol;
+                    break;
+                }
+                const uint32_t other = built_index[slot];
+                if (string_view(built_arena.data() + built_offsets[other], built_offsets[other + 1] - built_offsets[other]) == token) {
+                    cthrow("token '" << escape_bytes(token.to_string()) << "' is twice in the vocabulary");
+                }
+            }
+        }
+
+        vector<uint64_t> built_table(size_t(1) << CanonicalHuffman::MAX_LENGTH, 0);
+        for (uint32_t symbol = 0; symbol < lengths.size(); ++symbol) {
+            unsigned length = lengths[symbol];
+            if (!length) {
+                continue;
+            }
+            uint64_t entry = static_cast<uint64_t>(built_offsets[symbol]) << 16
+                             | (built_offsets[symbol + 1] - built_offsets[symbol]) << 8 | length;
+            for (uint32_t fill = built_code.code(symbol); fill < built_table.size(); fill += uint32_t(1) << length) {
+                built_table[fill] = entry;
+            }
+        }
+
+        arena = std::move(built_arena);
+        offsets = std::move(built_offsets);
+        index = std::move(built_index);
+        code = std::move(built_code);
+        decode_table = std::move(built_table);
+    }
+
+    unsigned WordHuffmanCodec::find(const string_view& token) const {
+        if (token.size() == 1) {
+            return static_cast<unsigned char>(token[0]);
+        }
+        const size_t mask = index.size() - 1;
+        for (size_t slot = token_hash(token) & mask;; slot = (slot + 1) & mask) {
+            uint32_t symbol = index[slot];
+            if (!symbol) {
+                return 0;
+            }
+            if (offsets[symbol + 1] - offsets[symbol] == token.size()
+                && !memcmp(arena.data() + offsets[symbol], token.data(), token.size())) {
+                return symbol;
+            }
+        }
+    }
+
+    template <typename Sink>
+    void WordHuffmanCodec::parse(const string_view& raw, Sink& sink) const {
+        // UTF-8 characters of the vocabulary, the rest byte by byte
+        auto spell = [&](const string_view& piece) {
+            sink.spelled();
+            for (size_t pos = 0; pos < piece.size();) {
+                size_t length = BOR::char_length(piece, pos);
+                unsigned symbol = length > 1 ? find(piece.substr(pos, length)) : 0;
+                if (symbol) {
+                    sink.symbol(symbol);
+                    pos += length;
+                } else {
+                    sink.symbol(static_cast<unsigned char>(piece[pos]));
+                    ++pos;
+                }
+            }
+        };
+        tokenize(raw, [&](size_t begin, size_t end, bool spaced) {
+            string_view token = raw.substr(begin, end - begin);
+            unsigned symbol = find(token);
+            if (symbol) {
+                sink.symbol(symbol);
+                return;
+            }
+            if (!spaced) {
+                spell(token);
+                return;
+            }
+            string_view word = token.substr(0, token.size() - 1);
+            symbol = find(word);
+            if (symbol) {
+                sink.symbol(symbol);
+            } else {
+                spell(word);
+            }
+            sink.symbol(' ');
+        });
+    }
+
+    template <bool Count>
+    void WordHuffmanCodec::encode_tokens(string& encoded, const string_view& raw, CodecStats* stats) const {
+        encoded.clear();
+        write_varint(encoded, raw.size());
+        SymbolWriter<Count> writer(encoded, code);
+        parse(raw, writer);
+        writer.flush();
+        if (Count) {
+            ++stats->calls;
+            stats->input_bytes += raw.size();
+            stats->output_bits += encoded.size() * 8;
+            stats->symbols += writer.symbols;
+            stats->fallbacks += writer.fallbacks;
+        }
+    }
+
+    void WordHuffmanCodec::encode(string& encoded, const string_view& raw) const {
+        if (STATS_ENABLED) {
+            StatsRegistry::Local local(CodecType::WORD_HUFFMAN);
+            encode_tokens<true>(encoded, raw, &local.stats());
+        } else {
+            encode_tokens<false>(encoded, raw, nullptr);
+        }
+    }
+
+    void WordHuffmanCodec::encode(string& encoded, const string_view& raw, CodecStats* stats) const {
+        if (!stats) {
+            encode(encoded, raw);
+            return;
+        }
+        if (!STATS_ENABLED) {
+            encode_tokens<true>(encoded, raw, stats);
+            return;
+        }
+        CodecStats call;
+        encode_tokens<true>(encoded, raw, &call);
+        StatsRegistry::add(CodecType::WORD_HUFFMAN, call);
+        stats->merge(call);
+    }
+
+    void WordHuffmanCodec::decode(string& raw, const string_view& encoded) const {
+        uint64_t size;
+        size_t header = read_varint(size, encoded);
+        // a code takes a bit at least and spells MAX_TOKEN_LENGTH bytes at most
+        if (size > (encoded.size() - header) * 8 * MAX_TOKEN_LENGTH) {
+            cthrow("corrupted WordHuffmanCodec payload, it can't spell " << size << " bytes");
+        }
+        raw.resize(size + MAX_TOKEN_LENGTH);
+        char* out = &raw[0];
+        char* const end = out + size;
+        const char* const tokens = arena.data();
+        BitReader in(encoded.data() + header, encoded.data() + encoded.size());
+        while (out < end) {
+            in.refill();
+            // a refill is good for four codes
+            for (unsigned i = 0; i < 4 && out < end; ++i) {
+                uint64_t entry = decode_table[in.peek(CanonicalHuffman::MAX_LENGTH)];
+                unsigned length = (entry >> 8) & 0xFF;
+                if (!(entry & 0xFF) || length > static_cast<size_t>(end - out)) {
+                    cthrow("corrupted WordHuffmanCodec payload");
+                }
+                in.skip(entry & 0xFF);
+                memcpy(out, tokens + (entry >> 16), MAX_TOKEN_LENGTH);
+                out += length;
+            }
+        }
+        if (in.overrun_input()) {
+            cthrow("truncated WordHuffmanCodec payload");
+        }
+        raw.resize(size);
+    }
+
+    string WordHuffmanCodec::save() const {
+        string out;
+        write_varint(out, vocabulary_size());
+        for (unsigned symbol = 256; symbol + 1 < offsets.size(); ++symbol) {
+            string_view value = token(symbol);
+            write_varint(out, value.size());
+            out.append(value.data(), value.size());
+        }
+        code.save(out);
+        return out;
+    }
+
+    void WordHuffmanCodec::load(const string& saved) {
+        uint64_t count;
+        size_t pos = read_varint(count, saved);
+        if (count > VOCABULARY_SIZE) {
+            cthrow("bad WordHuffmanCodec vocabulary size " << count);
+        }
+        StringVector vocabulary;
+        vocabulary.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t length;
+            pos = read_varint(length, saved, pos);
+            if (length > saved.size() - pos) {
+                cthrow("truncated WordHuffmanCodec vocabulary");
+            }
+            vocabulary.push_back(saved.substr(pos, length));
+            pos += length;
+        }
+        CanonicalHuffman loaded_code = CanonicalHuffman::load(saved, pos);
+        build(vocabulary, loaded_code.code_lengths());
+    }
+
+    size_t WordHuffmanCodec::sample_bytes() const {
+        return 16 << 20;
+    }
+
+    void WordHuffmanCodec::learn(const StringViewVector& samples) {
+        // tokens by the sample bytes they cover, multibyte characters too for the spelled tokens
+        std::unordered_map<string_view, uint64_t> counts;
+        for (const auto& sample : samples) {
+            tokenize(sample, [&](size_t begin, size_t end, bool) {
+                if (end - begin > 1) {
+                    ++counts[sample.substr(begin, end - begin)];
+                }
+            });
+            for (size_t pos = 0; pos < sample.size();) {
+                size_t length = BOR::char_length(sample, pos);
+                if (length > 1) {
+                    ++counts[sample.substr(pos, length)];
+                }
+                pos += length;
+            }
+        }
+        vector<std::pair<uint64_t, string_view>> candidates;
+        for (const auto& count : counts) {
+            if (count.second >= MIN_COUNT) {
+                candidates.push_back({count.second * count.first.size(), count.first});
+            }
+        }
+        size_t picked = std::min(candidates.size(), VOCABULARY_SIZE);
+        std::partial_sort(candidates.begin(), candidates.begin() + picked, candidates.end(),
+                          [](const std::pair<uint64_t, string_view>& x, const std::pair<uint64_t, string_view>& y) {
+                              return x.first != y.first ? x.first > y.first : x.second < y.second;
+                          });
+        StringVector vocabulary;
+        for (size_t i = 0; i < picked; ++i) {
+            vocabulary.push_back(candidates[i].second.to_string());
+        }
+        build(vocabulary, vector<uint8_t>(256 + vocabulary.size(), CanonicalHuffman::MAX_LENGTH));
+
+        // the codes come from how the vocabulary is used; tokens nobody uses, such as characters of the
+        // words which made it, are dropped, which doesn't change how the other ones are used
+        SymbolCounter counter;
+        counter.frequencies.assign(256 + vocabulary.size(), 0);
+        for (const auto& sample : samples) {
+            parse(sample, counter);
+        }
+        StringVector used;
+        vector<uint64_t> frequencies(counter.frequencies.begin(), counter.frequencies.begin() + 256);
+        for (auto& frequency : frequencies) {
+            ++frequency;
+        }
+        for (size_t i = 0; i < vocabulary.size(); ++i) {
+            if (counter.frequencies[256 + i]) {
+                used.push_back(std::move(vocabulary[i]));
+                frequencies.push_back(counter.frequencies[256 + i]);
+            }
+        }
+        build(used, CanonicalHuffman::build_lengths(frequencies));
+    }
+
+    void WordHuffmanCodec::reset() {
+        build(StringVector(), vector<uint8_t>(256, 8));
+    }
+
+    bool WordHuffmanCodec::inspect(ModelInfo& info) const {
+        info.add_structure("arena", arena.size(), heap_bytes(arena), true, true);
+        info.add_structure("offsets", offsets.size(), heap_bytes(offsets), true, false);
+        info.add_structure("index", index.size(), heap_bytes(index), true, false);
+        info.add_structure("code", code.symbols(), code.heap_bytes(), true, false);
+        info.add_structure("decode_table", decode_table.size(), heap_bytes(decode_table), false, true);
+        for (unsigned symbol = 0; symbol < code.symbols(); ++symbol) {
+            info.add_code(code.length(symbol));
+            info.entries.push_back({token(symbol).to_string(), 0.0, code.length(symbol)});
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <library/common/canonical_huffman.h>
+#include <library/common/codec.h>
+#include <library/common/stats.h>
+
+#include <cstdint>
+
+namespace Codecs {
+
+    // Token codec for natural-language text.
+    //
+    // Records are split into tokens: a run of word characters (letters, digits, '_' and every non ASCII
+    // byte, see BOR::is_word_char) together with the space after it, or a run of other characters.
+    // learn() keeps the VOCABULARY_SIZE tokens covering the most sample bytes. A token which is not in the
+    // vocabulary is written as its word without the space, if that one is, or else spelled by UTF-8
+    // characters of the vocabulary and single bytes.
+    //
+    // The 256 bytes and the vocabulary tokens share one canonical Huffman code. The payload is the raw
+    // length followed by the codes; decode() maps every MAX_LENGTH bit prefix to a token of the string
+    // arena with one table lookup and a fixed size copy.
+    class WordHuffmanCodec : public CodecIFace {
+    public:
+        static const size_t MAX_TOKEN_LENGTH = 32;
+        static const size_t VOCABULARY_SIZE = (size_t(1) << CanonicalHuffman::MAX_LENGTH) - 256;
+        // a token has to be seen this many times to get into the vocabulary
+        static const uint64_t MIN_COUNT = 2;
+
+        WordHuffmanCodec();
+
+        void encode(string& encoded, const string_view& raw) const override;
+
+        // also adds the counters of this call to `stats`, fallbacks are the tokens spelled by characters
+        void encode(string& encoded, const string_view& raw, CodecStats* stats) const override;
+
+        void decode(string& raw, const string_view& encoded) const override;
+
+        string save() const override;
+
+        void load(const string&) override;
+
+        size_t sample_bytes() const override;
+
+        void learn(const StringViewVector& samples) override;
+
+        void reset() override;
+
+        bool inspect(ModelInfo& info) const override;
+
+        size_t vocabulary_size() const {
+            return offsets.size() - 1 - 256;
+        }
+
+        // symbols below 256 are single bytes
+        string_view token(unsigned symbol) const {
+            return string_view(arena.data() + offsets[symbol], offsets[symbol + 1] - offsets[symbol]);
+        }
+
+    private:
+        // the bytes and then the vocabulary, symbol s is arena[offsets[s], offsets[s + 1]);
+        // MAX_TOKEN_LENGTH zero bytes follow, so decode() can copy a whole token length every time
+        string arena;
+        vector<uint32_t> offsets;
+        // open addressing index of the vocabulary, 0 for free slots
+        vector<uint32_t> index;
+        CanonicalHuffman code;
+        // token arena offset << 16 | token length << 8 | code length for every MAX_LENGTH bit prefix,
+        // 0 for the ones no code starts with
+        vector<uint64_t> decode_table;
+
+        void build(const StringVector& vocabulary, const vector<uint8_t>& lengths);
+
+        // the symbol of `token`, 0 if it is longer than a byte and not in the vocabulary
+        unsigned find(const string_view& token) const;
+
+        template <typename Sink>
+        void parse(const string_view& raw, Sink& sink) const;
+
+        template <bool Count>
+        void encode_tokens(string& encoded, const string_view& raw, CodecStats* stats) const;
+    };
+
+}
@@ -0,0 +1,121 @@
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/WordHuffman/WordHuffman.h>
+#include <library/common/frame.h>
+#include <library/common/inspect.h>
+#include <library/tests_common/tests_common.h>
+
+#include <set>
+
+namespace {
+
+    std::set<std::string> vocabulary(const Codecs::WordHuffmanCodec& codec) {
+        std::set<std::string> result;
+        for (unsigned symbol = 256; symbol < 256 + codec.vocabulary_size(); ++symbol) {
+            result.insert(codec.token(symbol).to_string());
+        }
+        return result;
+    }
+
+}
+
+TEST(WordHuffmanCodecTest, Works) {
+    Codecs::WordHuffmanCodec codec;
+    Codecs::test_simple(codec);
+    ASSERT_GT(codec.vocabulary_size(), 0u);
+    ASSERT_LE(codec.vocabulary_size(), Codecs::WordHuffmanCodec::VOCABULARY_SIZE);
+}
+
+TEST(WordHuffmanCodecTest, WorksWithoutModel) {
+    Codecs::WordHuffmanCodec codec;
+    Codecs::test_roundtrip(codec, "");
+    Codecs::test_roundtrip(codec, "a");
+    Codecs::test_roundtrip(codec, Codecs::LOREM_IPSUM);
+    std::string bytes;
+    for (int i = 0; i < 1000; ++i) {
+        bytes.push_back(static_cast<char>(i * 37));
+    }
+    Codecs::test_roundtrip(codec, bytes);
+}
+
+TEST(WordHuffmanCodecTest, Tokens) {
+    Codecs::WordHuffmanCodec codec;
+    std::string text = "ab_9\xC3\xA9 cd, ab_9\xC3\xA9 cd, \xE2\x80\x94\xE2\x80\x94 xyz";
+    codec.learn({text});
+    std::set<std::string> expected = {"ab_9\xC3\xA9 ", "cd", ", ", "\xE2\x80\x94"};
+    ASSERT_EQ(expected, vocabulary(codec));
+
+    // "\xC3\xA9" is only seen inside a token of the vocabulary, so it is not used and dropped;
+    // unknown words are spelled, known words come without their space, long runs are cut
+    for (const char* raw : {"cd cd", "ab_9\xC3\xA9", "zz ab_9\xC3\xA9 , cd,, ", "\xC3\xA9\xC3", "\xE2\x80\x94\xE2"}) {
+        Codecs::test_roundtrip(codec, raw);
+    }
+    Codecs::test_roundtrip(codec, std::string(100, 'q') + " " + std::string(100, '.') + std::string(33, 'q') + " cd");
+}
+
+TEST(WordHuffmanCodecTest, BeatsDictHuffmanOnProse) {
+    auto corpus = Codecs::test_corpus(Codecs::TextKind::ASCII, 3300);
+    Codecs::StringViewVector views(corpus.begin(), corpus.begin() + 3000);
+    Codecs::WordHuffmanCodec words;
+    words.learn(views);
+    Codecs::DictHuffmanCodec substrings;
+    substrings.learn(views);
+
+    Codecs::StringViewVector tests(corpus.begin() + 3000, corpus.end());
+    for (const auto& record : tests) {
+        Codecs::test_roundtrip(words, record);
+    }
+    ASSERT_LT(Codecs::bits_per_byte(words, tests), Codecs::bits_per_byte(substrings, tests));
+
+    Codecs::CodecStats stats;
+    std::string encoded;
+    for (const auto& record : tests) {
+        words.encode(encoded, record, &stats);
+    }
+    ASSERT_EQ(300u, stats.calls);
+    // far fewer codes than bytes, most of them whole tokens
+    ASSERT_LT(stats.symbols * 3, stats.input_bytes);
+    ASSERT_LT(stats.fallbacks * 10, stats.symbols);
+}
+
+TEST(WordHuffmanCodecTest, SaveLoad) {
+    auto sample = Codecs::test_corpus(Codecs::TextKind::ASCII, 500);
+    Codecs::WordHuffmanCodec codec;
+    codec.learn(Codecs::StringViewVector(sample.begin(), sample.end()));
+    Codecs::WordHuffmanCodec loaded;
+    loaded.load(codec.save());
+    ASSERT_EQ(vocabulary(codec), vocabulary(loaded));
+    ASSERT_EQ(codec.save(), loaded.save());
+    std::string encoded, decoded;
+    for (size_t i = 0; i < 50; ++i) {
+        codec.encode(encoded, sample[i]);
+        loaded.decode(decoded, encoded);
+        ASSERT_EQ(sample[i], decoded);
+    }
+    ASSERT_THROW(loaded.load(codec.save().substr(0, 100)), Codecs::CodecException);
+
+    Codecs::ModelInfo info;
+    ASSERT_TRUE(codec.inspect(info));
+    ASSERT_LE(info.max_code_length(), Codecs::CanonicalHuffman::MAX_LENGTH);
+    ASSERT_EQ(256 + codec.vocabulary_size(), info.entries.size());
+}
+
+TEST(WordHuffmanCodecTest, CorruptedPayload) {
+    Codecs::WordHuffmanCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    Codecs::test_corrupted_payloads(codec, Codecs::LOREM_IPSUM, 2);
+
+    // a size the codes can't spell is rejected before anything is allocated
+    std::string encoded, decoded;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    for (uint64_t size : {uint64_t(1) << 30, uint64_t(1) << 33, uint64_t(1) << 60}) {
+        std::string huge;
+        Codecs::write_varint(huge, size);
+        huge += encoded.substr(2, 5);
+        ASSERT_THROW(codec.decode(decoded, huge), Codecs::CodecException) << size;
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
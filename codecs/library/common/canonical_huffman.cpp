@@ -0,0 +1,145 @@
+#include "canonical_huffman.h"
+#include "frame.h"
+
+#include <algorithm>
+
+namespace Codecs {
+
+    const unsigned CanonicalHuffman::MAX_LENGTH;
+
+    vector<uint8_t> CanonicalHuffman::build_lengths(const vector<uint64_t>& frequencies, unsigned max_length) {
+        if (max_length > MAX_LENGTH) {
+            cthrow("code length limit " << max_length << " is over " << MAX_LENGTH);
+        }
+        vector<uint8_t> result(frequencies.size(), 0);
+        vector<uint32_t> order;
+        for (uint32_t symbol = 0; symbol < frequencies.size(); ++symbol) {
+            if (frequencies[symbol]) {
+                order.push_back(symbol);
+            }
+        }
+        if (order.empty()) {
+            return result;
+        }
+        if (order.size() == 1) {
+            result[order[0]] = 1;
+            return result;
+        }
+        if (order.size() > (size_t(1) << max_length)) {
+            cthrow(order.size() << " symbols don't fit into " << max_length << " bit codes");
+        }
+        std::stable_sort(order.begin(), order.end(), [&frequencies](uint32_t x, uint32_t y) {
+            return frequencies[x] < frequencies[y];
+        });
+
+        // two queue Huffman: leaves in `order`, inner nodes are created in nondecreasing weight order
+        size_t leaves = order.size();
+        vector<uint64_t> weight(2 * leaves - 1);
+        vector<uint32_t> parent(2 * leaves - 1);
+        for (size_t i = 0; i < leaves; ++i) {
+            weight[i] = frequencies[order[i]];
+        }
+        size_t next_leaf = 0;
+        size_t next_inner = leaves;
+        for (size_t inner = leaves; inner < weight.size(); ++inner) {
+            size_t children[2];
+            for (size_t& child : children) {
+                if (next_leaf < leaves && (next_inner == inner || weight[next_leaf] <= weight[next_inner])) {
+                    child = next_leaf++;
+                } else {
+                    child = next_inner++;
+                }
+            }
+            weight[inner] = weight[children[0]] + weight[children[1]];
+            parent[children[0]] = parent[children[1]] = inner;
+        }
+        vector<unsigned> depth(weight.size(), 0);
+        for (size_t node = weight.size() - 1; node-- > 0;) {
+            depth[node] = depth[parent[node]] + 1;
+        }
+
+        // clamp to max_length, then pay the Kraft sum back by lengthening the longest codes that are still short,
+        // the rarest symbols first
+        uint64_t kraft = 0;
+        const uint64_t one = uint64_t(1) << max_length;
+        for (size_t i = 0; i < leaves; ++i) {
+            depth[i] = std::min(depth[i], max_length);
+            kraft += one >> depth[i];
+        }
+        while (kraft > one) {
+            size_t pick = leaves;
+            for (size_t i = 0; i < leaves; ++i) {
+                if (depth[i] < max_length && (pick == leaves || depth[i] > depth[pick])) {
+                    pick = i;
+                }
+            }
+            kraft -= one >> (depth[pick] + 1);
+            ++depth[pick];
+        }
+        for (size_t i = 0; i < leaves; ++i) {
+            result[order[i]] = static_cast<uint8_t>(depth[i]);
+        }
+        return result;
+    }
+
+    CanonicalHuffman::CanonicalHuffman(const vector<uint8_t>& code_lengths)
+        : lengths(code_lengths)
+        , codes(code_lengths.size(), 0)
+    {
+        if (lengths.size() >= (size_t(1) << 24)) {
+            cthrow("too many symbols: " << lengths.size());
+        }
+        unsigned count[MAX_LENGTH + 1] = {0};
+        for (uint8_t length : lengths) {
+            if (length > MAX_LENGTH) {
+                cthrow("code length " << static_cast<unsigned>(length) << " is over " << MAX_LENGTH);
+            }
+            ++count[length];
+        }
+        count[0] = 0;
+        uint32_t next[MAX_LENGTH + 2] = {0};
+        uint64_t kraft = 0;
+        for (unsigned length = 1; length <= MAX_LENGTH; ++length) {
+            next[length + 1] = (next[length] + count[length]) << 1;
+            kraft += static_cast<uint64_t>(count[length]) << (MAX_LENGTH - length);
+        }
+        if (kraft > (uint64_t(1) << MAX_LENGTH)) {
+            cthrow("code lengths oversubscribe the code space");
+        }
+
+        const uint32_t unused = static_cast<uint32_t>(lengths.size()) << 8 | MAX_LENGTH;
+        table.assign(size_t(1) << MAX_LENGTH, unused);
+        for (uint32_t symbol = 0; symbol < lengths.size(); ++symbol) {
+            unsigned length = lengths[symbol];
+            if (!length) {
+                continue;
+            }
+            uint32_t code = next[length]++;
+            uint32_t reversed = 0;
+            for (unsigned bit = 0; bit < length; ++bit) {
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            }
+            codes[symbol] = static_cast<uint16_t>(reversed);
+            for (uint32_t fill = reversed; fill < table.size(); fill += uint32_t(1) << length) {
+                table[fill] = symbol << 8 | length;
+            }
+        }
+    }
+
+    void CanonicalHuffman::save(string& out) const {
+        write_varint(out, lengths.size());
+        out.append(lengths.begin(), lengths.end());
+    }
+
+    CanonicalHuffman CanonicalHuffman::load(const string_view& in, size_t& pos) {
+        uint64_t size;
+        pos = read_varint(size, in, pos);
+        if (size > in.size() - pos) {
+            cthrow("truncated code lengths");
+        }
+        vector<uint8_t> lengths(in.begin() + pos, in.begin() + pos + size);
+        pos += size;
+        return CanonicalHuffman(lengths);
+    }
+
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace Codecs {
+
+    // LSB first bit stream writer, appends whole bytes to `out`
+    class BitWriter {
+    public:
+        explicit BitWriter(string& out)
+            : out(out)
+        {}
+
+        // `count` <= 32, `value` < 2^count
+        void write(uint64_t value, unsigned count) {
+            buffer |= value << bits;
+            bits += count;
+            if (bits >= 32) {
+                char bytes[4];
+                uint32_t low = static_cast<uint32_t>(buffer);
+                for (unsigned i = 0; i < 4; ++i) {
+                    bytes[i] = static_cast<char>(low >> (8 * i));
+                }
+                out.append(bytes, 4);
+                buffer >>= 32;
+                bits -= 32;
+            }
+        }
+
+        // pads the last byte with zero bits
+        void flush() {
+            for (; bits > 0; bits = bits > 8 ? bits - 8 : 0) {
+                out.push_back(static_cast<char>(buffer));
+                buffer >>= 8;
+            }
+            buffer = 0;
+        }
+
+    private:
+        string& out;
+        uint64_t buffer = 0;
+        unsigned bits = 0;
+    };
+
+    // LSB first bit stream reader, reads zero bits past the end of the input
+    class BitReader {
+    public:
+        BitReader(const char* begin, const char* end)
+            : pos(begin)
+            , end(end)
+        {
+            refill();
+        }
+
+        // at least 56 bits are available after a refill
+        void refill() {
+            if (end - pos >= 8) {
+                uint64_t word;
+                memcpy(&word, pos, 8);
+                buffer |= word << bits;
+                pos += (63 - bits) >> 3;
+                bits |= 56;
+                return;
+            }
+            while (bits <= 56) {
+                if (pos < end) {
+                    buffer |= static_cast<uint64_t>(static_cast<unsigned char>(*pos++)) << bits;
+                } else {
+                    ++overrun;
+                }
+                bits += 8;
+            }
+        }
+
+        uint64_t peek(unsigned count) const {
+            return buffer & ((uint64_t(1) << count) - 1);
+        }
+
+        void skip(unsigned count) {
+            buffer >>= count;
+            bits -= count;
+        }
+
+        // `count` <= 56, refill() must have been called since `count` more bits were consumed
+        uint64_t read(unsigned count) {
+            uint64_t value = peek(count);
+            skip(count);
+            return value;
+        }
+
+        unsigned available() const {
+            return bits;
+        }
+
+        // true if more bits were consumed than the input has
+        bool overrun_input() const {
+            return overrun * 8 > bits;
+        }
+
+    private:
+        const char* pos;
+        const char* end;
+        uint64_t buffer = 0;
+        unsigned bits = 0;
+        size_t overrun = 0;
+    };
+
+    // 8 bytes MSB first, for decoders of MSB first codes such as DictHuffmanCodec's
+    inline uint64_t peek_msb(const char* in) {
+        uint64_t word;
+        memcpy(&word, in, 8);
+        return __builtin_bswap64(word);
+    }
+
+    // at least 57 bits of `bits` from `bit` on, MSB first, zeros past the end; `bit` must be within `bits`
+    inline uint64_t msb_window(const string_view& bits, size_t bit) {
+        size_t pos = bit >> 3;
+        if (bits.size() - pos >= 8) {
+            return peek_msb(bits.data() + pos) << (bit & 7);
+        }
+        char bytes[8] = {0};
+        memcpy(bytes, bits.data() + pos, bits.size() - pos);
+        return peek_msb(bytes) << (bit & 7);
+    }
+
+    // Canonical prefix code of at most MAX_LENGTH bits per symbol, written LSB first, decoded by a single table lookup.
+    class CanonicalHuffman {
+    public:
+        static const unsigned MAX_LENGTH = 12;
+
+        CanonicalHuffman() = default;
+
+        // code lengths from symbol frequencies, symbols with zero frequency get no code
+        static vector<uint8_t> build_lengths(const vector<uint64_t>& frequencies, unsigned max_length = MAX_LENGTH);
+
+        // throws on lengths which don't make a prefix code
+        explicit CanonicalHuffman(const vector<uint8_t>& lengths);
+
+        void write(BitWriter& out, unsigned symbol) const {
+            out.write(codes[symbol], lengths[symbol]);
+        }
+
+        // the reader must have at least MAX_LENGTH bits available
+        unsigned read(BitReader& in) const {
+            uint32_t entry = table[in.peek(MAX_LENGTH)];
+            in.skip(entry & 0xFF);
+            return entry >> 8;
+        }
+
+        size_t symbols() const {
+            return lengths.size();
+        }
+
+        unsigned length(unsigned symbol) const {
+            return lengths[symbol];
+        }
+
+        // bit reversed, as write() puts it
+        uint32_t code(unsigned symbol) const {
+            return codes[symbol];
+        }
+
+        const vector<uint8_t>& code_lengths() const {
+            return lengths;
+        }
+
+        // the number of symbols followed by one byte per code length
+        void save(string& out) const;
+
+        // reads what save() wrote at `pos` and moves `pos` past it
+        static CanonicalHuffman load(const string_view& in, size_t& pos);
+
+        size_t heap_bytes() const {
+            return lengths.capacity() + codes.capacity() * sizeof(codes[0]) + table.capacity() * sizeof(table[0]);
+        }
+
+    private:
+        vector<uint8_t> lengths;
+        // bit reversed, so they can be written LSB first
+        vector<uint16_t> codes;
+        // symbol << 8 | length for every MAX_LENGTH bit prefix, symbols() for the ones no code starts with
+        vector<uint32_t> table;
+    };
+
+}
@@ -1 +1,15 @@
 #include "codec.h"
+#include "stats.h"
+
+namespace Codecs {
+
+    void CodecIFace::encode(string& encoded, const string_view& raw, CodecStats* stats) const {
+        encode(encoded, raw);
+        if (stats) {
+            ++stats->calls;
+            stats->input_bytes += raw.size();
+            stats->output_bits += encoded.size() * 8;
+        }
+    }
+
+}
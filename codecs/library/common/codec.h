@@ -6,7 +6,9 @@
 #include <experimental/string_view>
 
 #include <exception>
+#include <iterator>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <sstream>
 #include <functional>
@@ -50,27 +52,57 @@ namespace Codecs {
     } while (false)
 #endif
 
+    struct ModelInfo;
+    struct CodecStats;
+
+    // What load() builds besides the model itself. Codecs keep separate structures for encoding and
+    // decoding; a process that only does one of them needs only half of them. LAZY builds each side
+    // on its first use, once, even if several threads use it at the same time.
+    enum class LoadMode {
+        BOTH,
+        ENCODE,
+        DECODE,
+        LAZY
+    };
+
     class CodecIFace {
     public:
         virtual void encode(string& encoded, const string_view& raw) const = 0;
+        // also adds the counters of this call to `stats`, see stats.h; by default only calls and sizes
+        virtual void encode(string& encoded, const string_view& raw, CodecStats* stats) const;
         virtual void decode(string& raw, const string_view& encoded) const = 0;
 
         virtual string save() const = 0;
         virtual void load(const string&) = 0;
 
-        virtual size_t sample_size(size_t records_total) const = 0;
+        // bytes of training data learn() wants, see ReservoirSampler
+        virtual size_t sample_bytes() const = 0;
         virtual void learn(const StringViewVector& all_samples) = 0;
 
         virtual void reset() = 0;
 
+        // applies to the following load() calls; codecs whose sides share everything ignore it
+        virtual void set_load_mode(LoadMode) {}
+
+        // describes the loaded model, see inspect.h; false if the codec can't
+        virtual bool inspect(ModelInfo&) const {
+            return false;
+        }
+
         virtual ~CodecIFace() {}
 
+        // one pass over the records, which may come from an input iterator; records of a forward range
+        // stay put while it trains, so they are sampled without copies
         template <typename Iter>
-        static void train(CodecIFace& codec, Iter begin, Iter end, size_t pop_size) {
-            StringViewVector vec;
+        static void train(CodecIFace& codec, Iter begin, Iter end, ReservoirOptions options = ReservoirOptions()) {
+            using Traits = std::iterator_traits<Iter>;
             codec.reset();
-            select_sample(vec, begin, end, codec.sample_size(pop_size));
-            codec.learn(vec);
+            options.budget_bytes = codec.sample_bytes();
+            options.keep_views |= std::is_reference<typename Traits::reference>::value
+                    && std::is_base_of<std::forward_iterator_tag, typename Traits::iterator_category>::value;
+            ReservoirSampler sampler(options);
+            sampler.add(begin, end);
+            codec.learn(sampler.sample());
         }
     };
 
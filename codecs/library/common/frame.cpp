@@ -0,0 +1,100 @@
+#include "frame.h"
+
+namespace Codecs {
+
+    const char* codec_type_name(CodecType type) {
+        switch (type) {
+            case CodecType::STORED:
+                return "stored";
+            case CodecType::HUFFMAN:
+                return "huffman";
+            case CodecType::DICT_HUFFMAN:
+                return "dict-huffman";
+            case CodecType::ZLIB:
+                return "zlib";
+            case CodecType::AUTO:
+                return "auto";
+            case CodecType::LZ77:
+                return "lz77";
+            case CodecType::WORD_HUFFMAN:
+                return "word-huffman";
+            case CodecType::CLUSTERED:
+                return "clustered";
+        }
+        return "unknown";
+    }
+
+    bool same_payloads_as_v1(CodecType type) {
+        switch (type) {
+            case CodecType::DICT_HUFFMAN:
+            case CodecType::AUTO:
+            case CodecType::CLUSTERED:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    const uint8_t FrameHeader::FRAME_MAGIC;
+    const uint8_t FrameHeader::FRAME_MAGIC_V1;
+    const size_t FrameHeader::MAX_SIZE;
+
+    uint64_t model_fingerprint(CodecType type, const string_view& model) {
+        // FNV-1a over the codec type followed by the serialized model
+        uint64_t hash = 14695981039346656037ULL;
+        const uint64_t prime = 1099511628211ULL;
+        hash ^= static_cast<uint8_t>(type);
+        hash *= prime;
+        for (char c : model) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= prime;
+        }
+        return hash;
+    }
+
+    void write_varint(string& out, uint64_t value) {
+        while (value > 0x7F) {
+            out.push_back(static_cast<char>(0x80 | (value & 0x7F)));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    size_t read_varint(uint64_t& value, const string_view& in, size_t pos) {
+        value = 0;
+        for (unsigned shift = 0; pos < in.size() && shift < 64; shift += 7) {
+            unsigned char c = static_cast<unsigned char>(in[pos++]);
+            value |= static_cast<uint64_t>(c & 0x7F) << shift;
+            if (!(c & 0x80)) {
+                return pos;
+            }
+        }
+        cthrow("truncated varint");
+    }
+
+    void write_frame_header(string& out, const FrameHeader& header) {
+        out.push_back(static_cast<char>(FrameHeader::FRAME_MAGIC));
+        out.push_back(static_cast<char>(header.codec_type));
+        for (int i = 0; i < 8; ++i) {
+            out.push_back(static_cast<char>((header.fingerprint >> (8 * i)) & 0xFF));
+        }
+        write_varint(out, header.original_length);
+    }
+
+    size_t read_frame_header(FrameHeader& header, const string_view& framed) {
+        uint8_t magic = framed.empty() ? 0 : static_cast<uint8_t>(framed[0]);
+        if (framed.size() < 10 || (magic != FrameHeader::FRAME_MAGIC && magic != FrameHeader::FRAME_MAGIC_V1)) {
+            cthrow("not a framed payload");
+        }
+        header.codec_type = static_cast<CodecType>(static_cast<uint8_t>(framed[1]));
+        if (magic == FrameHeader::FRAME_MAGIC_V1 && !same_payloads_as_v1(header.codec_type)) {
+            cthrow("framed " << codec_type_name(header.codec_type) << " payload of version 1, it is not read any more");
+        }
+        header.fingerprint = 0;
+        for (int i = 0; i < 8; ++i) {
+            header.fingerprint |= static_cast<uint64_t>(static_cast<unsigned char>(framed[2 + i])) << (8 * i);
+        }
+        return read_varint(header.original_length, framed, 10);
+    }
+
+}
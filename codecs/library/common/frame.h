@@ -0,0 +1,54 @@
+#pragma once
+
+#include "codec.h"
+
+#include <cstdint>
+
+namespace Codecs {
+
+    enum class CodecType : uint8_t {
+        STORED = 0,
+        HUFFMAN = 1,
+        DICT_HUFFMAN = 2,
+        ZLIB = 3,
+        AUTO = 4,
+        LZ77 = 5,
+        WORD_HUFFMAN = 6,
+        CLUSTERED = 7,
+    };
+
+    // canonical codec name of the type, "unknown" for unknown types
+    const char* codec_type_name(CodecType type);
+
+    // Whether payloads of the type are as they were in version 1 of frames and archives. DictHuffman
+    // payloads start with their DictHuffmanLevel since version 2; AUTO and CLUSTERED ones may hold them.
+    bool same_payloads_as_v1(CodecType type);
+
+    // Optional self-describing header put in front of an encoded payload:
+    //   1 byte   FRAME_MAGIC, which is also the version
+    //   1 byte   codec type
+    //   8 bytes  model fingerprint, little endian
+    //   varint   original (raw) length
+    struct FrameHeader {
+        static const uint8_t FRAME_MAGIC = 0xD0;
+        // version 1, read for the types whose payloads haven't changed since
+        static const uint8_t FRAME_MAGIC_V1 = 0xCF;
+        static const size_t MAX_SIZE = 1 + 1 + 8 + 10;
+
+        CodecType codec_type;
+        uint64_t fingerprint;
+        uint64_t original_length;
+    };
+
+    uint64_t model_fingerprint(CodecType type, const string_view& model);
+
+    void write_frame_header(string& out, const FrameHeader& header);
+
+    // Parses the header from the beginning of `framed` and returns the number of bytes it occupies.
+    size_t read_frame_header(FrameHeader& header, const string_view& framed);
+
+    void write_varint(string& out, uint64_t value);
+
+    size_t read_varint(uint64_t& value, const string_view& in, size_t pos = 0);
+
+}
@@ -0,0 +1,48 @@
+#include "hash.h"
+
+#include <cstring>
+
+namespace Codecs {
+
+    namespace {
+
+        const uint64_t P0 = 0xa0761d6478bd642fULL;
+        const uint64_t P1 = 0xe7037ed1a0b428dbULL;
+        const uint64_t P2 = 0x8ebc6af09c88c6e3ULL;
+        const uint64_t P3 = 0x589965cc75374cc3ULL;
+
+        // both halves of the product folded together with the factors, so a zero factor, which input
+        // bytes can make, doesn't wipe out the state and the other factor
+        inline uint64_t mix(uint64_t a, uint64_t b) {
+            __uint128_t product = static_cast<__uint128_t>(a) * b;
+            return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64) ^ a ^ b;
+        }
+
+        inline uint64_t read64(const char* in) {
+            uint64_t value;
+            memcpy(&value, in, 8);
+            return value;
+        }
+
+    }
+
+    Hash128 hash128(const string_view& data, uint64_t seed) {
+        uint64_t a = seed ^ P0;
+        uint64_t b = mix(seed ^ P1, data.size() ^ P2);
+        const char* in = data.data();
+        size_t left = data.size();
+        for (; left >= 16; in += 16, left -= 16) {
+            uint64_t w0 = read64(in);
+            uint64_t w1 = read64(in + 8);
+            a = mix(w0 ^ a ^ P1, w1 ^ P2);
+            b = mix(w1 ^ b ^ P3, w0 ^ P0);
+        }
+        // the length is in `b`, so zero padding doesn't make different inputs equal
+        char tail[16] = {0};
+        memcpy(tail, in, left);
+        a = mix(read64(tail) ^ a ^ P1, read64(tail + 8) ^ P2);
+        b = mix(read64(tail + 8) ^ b ^ P3, read64(tail) ^ P0);
+        return {mix(a ^ P3, b ^ P0), mix(b ^ P2, a ^ P1)};
+    }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "codec.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace Codecs {
+
+    struct Hash128 {
+        uint64_t low;
+        uint64_t high;
+
+        bool operator==(const Hash128& other) const {
+            return low == other.low && high == other.high;
+        }
+
+        bool operator!=(const Hash128& other) const {
+            return !(*this == other);
+        }
+    };
+
+    // Fast non-cryptographic hash: two 64 bit lanes fed 16 bytes at a time through 64x64->128 bit
+    // multiplications. It spreads keys well, but collisions can be crafted, so whoever keys on it
+    // compares the keys too.
+    Hash128 hash128(const string_view& data, uint64_t seed = 0);
+
+}
+
+namespace std {
+
+    template <>
+    struct hash<Codecs::Hash128> {
+        size_t operator()(const Codecs::Hash128& value) const {
+            return static_cast<size_t>(value.high);
+        }
+    };
+
+}
@@ -0,0 +1,148 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace Codecs {
+
+    namespace {
+
+        const size_t SUB_HISTOGRAMS = 4;
+        // the 32-bit sub-histogram counters can't overflow within a block
+        const size_t BLOCK_BYTES = size_t(1) << 30;
+        // work unit of the parallel count
+        const size_t TASK_BYTES = size_t(1) << 20;
+
+        void count_block(const unsigned char* data, size_t size, ByteCounts& counts) {
+            uint32_t sub[SUB_HISTOGRAMS][256];
+            memset(sub, 0, sizeof(sub));
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                uint64_t first, second;
+                memcpy(&first, data + i, 8);
+                memcpy(&second, data + i + 8, 8);
+                for (unsigned shift = 0; shift < 64; shift += 16) {
+                    ++sub[0][(first >> shift) & 0xFF];
+                    ++sub[1][(first >> (shift + 8)) & 0xFF];
+                    ++sub[2][(second >> shift) & 0xFF];
+                    ++sub[3][(second >> (shift + 8)) & 0xFF];
+                }
+            }
+            for (; i < size; ++i) {
+                ++sub[0][data[i]];
+            }
+            for (size_t c = 0; c < 256; ++c) {
+                counts[c] += static_cast<uint64_t>(sub[0][c]) + sub[1][c] + sub[2][c] + sub[3][c];
+            }
+        }
+
+        struct Task {
+            size_t first_record;
+            size_t last_record;  // exclusive
+            size_t begin;        // byte range of a single split record, when first_record + 1 == last_record
+            size_t end;
+        };
+
+    }
+
+    void count_bytes(const string_view& data, ByteCounts& counts) {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(data.data());
+        for (size_t pos = 0; pos < data.size(); pos += BLOCK_BYTES) {
+            count_block(begin + pos, std::min(BLOCK_BYTES, data.size() - pos), counts);
+        }
+    }
+
+    void count_bytes(const StringViewVector& records, ByteCounts& counts, size_t threads) {
+        uint64_t total = 0;
+        for (const auto& record : records) {
+            total += record.size();
+        }
+        if (!threads) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min<uint64_t>(threads, total / TASK_BYTES + 1);
+        if (threads <= 1) {
+            for (const auto& record : records) {
+                count_bytes(record, counts);
+            }
+            return;
+        }
+
+        // runs of small records and slices of large ones, about TASK_BYTES each
+        vector<Task> tasks;
+        size_t run_start = 0, run_bytes = 0;
+        for (size_t i = 0; i < records.size(); ++i) {
+            size_t size = records[i].size();
+            if (size >= TASK_BYTES) {
+                if (run_start < i) {
+                    tasks.push_back({run_start, i, 0, 0});
+                }
+                for (size_t pos = 0; pos < size; pos += TASK_BYTES) {
+                    tasks.push_back({i, i + 1, pos, std::min(size, pos + TASK_BYTES)});
+                }
+                run_start = i + 1;
+                run_bytes = 0;
+            } else if ((run_bytes += size) >= TASK_BYTES) {
+                tasks.push_back({run_start, i + 1, 0, 0});
+                run_start = i + 1;
+                run_bytes = 0;
+            }
+        }
+        if (run_start < records.size()) {
+            tasks.push_back({run_start, records.size(), 0, 0});
+        }
+
+        vector<std::array<uint64_t, 256>> partial(threads);
+        std::atomic<size_t> next(0);
+        vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                ByteCounts local = {0};
+                for (size_t task = next++; task < tasks.size(); task = next++) {
+                    const Task& todo = tasks[task];
+                    if (todo.end) {
+                        count_bytes(records[todo.first_record].substr(todo.begin, todo.end - todo.begin), local);
+                    } else {
+                        for (size_t i = todo.first_record; i < todo.last_record; ++i) {
+                            count_bytes(records[i], local);
+                        }
+                    }
+                }
+                std::copy(std::begin(local), std::end(local), partial[t].begin());
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (const auto& local : partial) {
+            for (size_t c = 0; c < 256; ++c) {
+                counts[c] += local[c];
+            }
+        }
+    }
+
+    double entropy_bits(const ByteCounts& counts) {
+        uint64_t total = 0;
+        for (uint64_t n : counts) {
+            total += n;
+        }
+        double bits = 0;
+        for (uint64_t n : counts) {
+            if (n) {
+                bits -= n * std::log2(static_cast<double>(n) / total);
+            }
+        }
+        return bits;
+    }
+
+    double entropy_per_byte(const string_view& data) {
+        ByteCounts counts = {0};
+        count_bytes(data, counts);
+        return data.empty() ? 0.0 : entropy_bits(counts) / data.size();
+    }
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "codec.h"
+
+#include <cstdint>
+
+namespace Codecs {
+
+    using ByteCounts = uint64_t[256];
+
+    // Adds the number of occurrences of every byte value in `data` to `counts`.
+    // Bytes go to four interleaved 32-bit sub-histograms, 8 bytes per load, so runs of the same byte
+    // do not wait on the increment of the previous one; the sub-histograms are summed at the end.
+    void count_bytes(const string_view& data, ByteCounts& counts);
+
+    // The same over all records, split between `threads` threads (0 for one per core) when there is
+    // enough data. Records larger than a task are split too, so one huge record scales as well.
+    void count_bytes(const StringViewVector& records, ByteCounts& counts, size_t threads = 0);
+
+    // Shannon entropy of the byte distribution, total bits for all counted bytes
+    double entropy_bits(const ByteCounts& counts);
+
+    // order-0 entropy of `data` in bits per byte, 0 for empty data
+    double entropy_per_byte(const string_view& data);
+
+}
@@ -0,0 +1,156 @@
+#include "inspect.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Codecs {
+
+    string escape_bytes(const string& value) {
+        std::ostringstream out;
+        for (unsigned char c : value) {
+            if (c < 0x20 || c == 0x7F || c == '"' || c == '\\') {
+                out << "\\x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned>(c)
+                    << std::dec;
+            } else {
+                out << c;
+            }
+        }
+        return out.str();
+    }
+
+    size_t heap_bytes(const vector<bool>& bits) {
+        // libstdc++ keeps the bits in whole words
+        return (bits.capacity() + 63) / 64 * 8;
+    }
+
+    size_t heap_bytes(const string& value) {
+        // short strings live inside the object
+        return value.capacity() > 15 ? value.capacity() + 1 : 0;
+    }
+
+    void ModelInfo::add_structure(const string& name, size_t elements, size_t heap_bytes,
+                                  bool encode_path, bool decode_path) {
+        structures.push_back({name, elements, heap_bytes, encode_path, decode_path});
+    }
+
+    void ModelInfo::add_code(unsigned length) {
+        if (code_lengths.size() <= length) {
+            code_lengths.resize(length + 1, 0);
+        }
+        ++code_lengths[length];
+    }
+
+    size_t ModelInfo::heap_bytes() const {
+        size_t total = 0;
+        for (const auto& structure : structures) {
+            total += structure.heap_bytes;
+        }
+        return total;
+    }
+
+    size_t ModelInfo::encode_path_bytes() const {
+        size_t total = 0;
+        for (const auto& structure : structures) {
+            total += structure.encode_path ? structure.heap_bytes : 0;
+        }
+        return total;
+    }
+
+    size_t ModelInfo::decode_path_bytes() const {
+        size_t total = 0;
+        for (const auto& structure : structures) {
+            total += structure.decode_path ? structure.heap_bytes : 0;
+        }
+        return total;
+    }
+
+    unsigned ModelInfo::max_code_length() const {
+        for (size_t length = code_lengths.size(); length > 0; --length) {
+            if (code_lengths[length - 1]) {
+                return length - 1;
+            }
+        }
+        return 0;
+    }
+
+    vector<ModelInfo::Entry> ModelInfo::sorted_entries(EntryOrder order) const {
+        vector<Entry> sorted = entries;
+        std::stable_sort(sorted.begin(), sorted.end(), [order](const Entry& x, const Entry& y) {
+            if (order == EntryOrder::LENGTH && x.value.size() != y.value.size()) {
+                return x.value.size() > y.value.size();
+            }
+            if (x.frequency != y.frequency) {
+                return x.frequency > y.frequency;
+            }
+            return x.value.size() > y.value.size();
+        });
+        return sorted;
+    }
+
+    void ModelInfo::merge(const ModelInfo& other, const string& prefix) {
+        for (const auto& structure : other.structures) {
+            structures.push_back(structure);
+            structures.back().name = prefix + structure.name;
+        }
+        for (size_t length = 0; length < other.code_lengths.size(); ++length) {
+            if (code_lengths.size() < other.code_lengths.size()) {
+                code_lengths.resize(other.code_lengths.size(), 0);
+            }
+            code_lengths[length] += other.code_lengths[length];
+        }
+        entries.insert(entries.end(), other.entries.begin(), other.entries.end());
+    }
+
+    void ModelInfo::dump(std::ostream& out, size_t top_entries, EntryOrder order) const {
+        out << "Heap footprint:\n"
+            << std::setw(36) << std::left << "structure" << std::right
+            << std::setw(12) << "elements" << std::setw(14) << "bytes" << "  hot path\n";
+        for (const auto& structure : structures) {
+            string path = structure.encode_path ? (structure.decode_path ? "encode decode" : "encode")
+                                                : (structure.decode_path ? "decode" : "");
+            out << std::setw(36) << std::left << structure.name << std::right
+                << std::setw(12) << structure.elements << std::setw(14) << structure.heap_bytes
+                << (path.empty() ? "" : "  ") << path << '\n';
+        }
+        out << std::setw(36) << std::left << "total" << std::right << std::setw(26) << heap_bytes() << '\n'
+            << "encode path: " << encode_path_bytes() << " bytes, decode path: " << decode_path_bytes()
+            << " bytes\n";
+
+        if (!code_lengths.empty()) {
+            uint64_t codes = 0;
+            for (uint64_t count : code_lengths) {
+                codes += count;
+            }
+            out << "\nCode lengths (" << codes << " codes, max depth " << max_code_length() << "):\n";
+            for (size_t length = 0; length < code_lengths.size(); ++length) {
+                if (code_lengths[length]) {
+                    out << std::setw(6) << length << " bits" << std::setw(10) << code_lengths[length] << '\n';
+                }
+            }
+        }
+
+        if (!entries.empty() && top_entries) {
+            vector<Entry> sorted = sorted_entries(order);
+            size_t top = std::min(top_entries, sorted.size());
+            out << "\nDictionary entries, " << top << " of " << sorted.size() << " by "
+                << (order == EntryOrder::LENGTH ? "length" : "frequency") << ":\n"
+                << std::setw(14) << "frequency" << std::setw(6) << "bits" << std::setw(6) << "len" << "  entry\n";
+            for (size_t i = 0; i < top; ++i) {
+                out << std::setw(14) << sorted[i].frequency << std::setw(6) << sorted[i].code_length
+                    << std::setw(6) << sorted[i].value.size() << "  \"" << escape_bytes(sorted[i].value) << "\"\n";
+            }
+        }
+    }
+
+    double bits_per_byte(const CodecIFace& codec, const StringViewVector& records) {
+        uint64_t raw = 0, encoded_bytes = 0;
+        string encoded;
+        for (const auto& record : records) {
+            codec.encode(encoded, record);
+            raw += record.size();
+            encoded_bytes += encoded.size();
+        }
+        return raw ? 8.0 * encoded_bytes / raw : 0.0;
+    }
+
+}
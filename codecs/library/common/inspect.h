@@ -0,0 +1,72 @@
+#pragma once
+
+#include "codec.h"
+
+#include <cstdint>
+#include <ostream>
+
+namespace Codecs {
+
+    // What CodecIFace::inspect() reports about a loaded model.
+    struct ModelInfo {
+        struct Structure {
+            string name;
+            size_t elements;
+            size_t heap_bytes;  // bytes requested from the allocator, capacity included
+            bool encode_path;   // read for every encoded byte
+            bool decode_path;   // read for every decoded byte
+        };
+
+        struct Entry {
+            string value;
+            double frequency;     // in the training sample, 0 if the model does not keep it
+            unsigned code_length; // bits
+        };
+
+        enum class EntryOrder {
+            FREQUENCY,  // most frequent first, longer first among equal
+            LENGTH,     // longest first, more frequent first among equal
+        };
+
+        vector<Structure> structures;
+        vector<uint64_t> code_lengths; // code_lengths[l] is the number of codes of l bits
+        vector<Entry> entries;
+
+        void add_structure(const string& name, size_t elements, size_t heap_bytes,
+                           bool encode_path, bool decode_path);
+
+        void add_code(unsigned length);
+
+        size_t heap_bytes() const;
+
+        // footprint of the structures one side of the codec touches per byte
+        size_t encode_path_bytes() const;
+
+        size_t decode_path_bytes() const;
+
+        unsigned max_code_length() const;
+
+        vector<Entry> sorted_entries(EntryOrder order) const;
+
+        // names of nested structures get `prefix`, used by codecs built of other codecs
+        void merge(const ModelInfo& other, const string& prefix);
+
+        void dump(std::ostream& out, size_t top_entries = 20, EntryOrder order = EntryOrder::FREQUENCY) const;
+    };
+
+    template <typename T>
+    size_t heap_bytes(const vector<T>& values) {
+        return values.capacity() * sizeof(T);
+    }
+
+    size_t heap_bytes(const vector<bool>& bits);
+
+    size_t heap_bytes(const string& value);
+
+    // `value` with control characters, quotes and backslashes as \xNN, for printing dictionary entries
+    string escape_bytes(const string& value);
+
+    // bits per raw byte the codec spends on `records`, byte padding of every record included
+    double bits_per_byte(const CodecIFace& codec, const StringViewVector& records);
+
+}
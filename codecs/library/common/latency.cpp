@@ -0,0 +1,84 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Codecs {
+
+    const unsigned LatencyHistogram::SUB_BUCKET_BITS;
+
+    namespace {
+        const uint64_t SUB_BUCKETS = 1ULL << LatencyHistogram::SUB_BUCKET_BITS;
+
+        unsigned bit_length(uint64_t value) {
+            return value ? 64 - __builtin_clzll(value) : 0;
+        }
+    }
+
+    LatencyHistogram::LatencyHistogram() {
+        clear();
+    }
+
+    void LatencyHistogram::clear() {
+        buckets.assign((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS, 0);
+        total = 0;
+        sum = 0;
+        minimum = UINT64_MAX;
+        maximum = 0;
+    }
+
+    size_t LatencyHistogram::bucket_of(uint64_t value) {
+        // values below SUB_BUCKETS get a bucket of their own, above that every power of two
+        // range [2^k, 2^(k+1)) is split into SUB_BUCKETS equal parts
+        unsigned bits = bit_length(value);
+        if (bits <= SUB_BUCKET_BITS) {
+            return value;
+        }
+        unsigned shift = bits - SUB_BUCKET_BITS - 1;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+    }
+
+    uint64_t LatencyHistogram::bucket_upper_bound(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        unsigned shift = bucket / SUB_BUCKETS - 1;
+        uint64_t base = SUB_BUCKETS + bucket % SUB_BUCKETS;
+        return ((base + 1) << shift) - 1;
+    }
+
+    void LatencyHistogram::record(uint64_t nanoseconds) {
+        ++buckets[bucket_of(nanoseconds)];
+        ++total;
+        sum += nanoseconds;
+        minimum = std::min(minimum, nanoseconds);
+        maximum = std::max(maximum, nanoseconds);
+    }
+
+    void LatencyHistogram::merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    uint64_t LatencyHistogram::percentile(double p) const {
+        if (!total) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(total * std::min(std::max(p, 0.0), 100.0) / 100.0));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(std::max(bucket_upper_bound(i), min()), maximum);
+            }
+        }
+        return maximum;
+    }
+
+}
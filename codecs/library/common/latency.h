@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Codecs {
+
+    // Log-linear histogram of nanosecond latencies: every power of two range is split into
+    // 2^SUB_BUCKET_BITS buckets, so percentiles are exact up to ~3% at any scale and recording
+    // a value is a couple of bit operations. Histograms of different threads are merged afterwards.
+    class LatencyHistogram {
+    public:
+        static const unsigned SUB_BUCKET_BITS = 5;
+
+        LatencyHistogram();
+
+        void record(uint64_t nanoseconds);
+
+        void merge(const LatencyHistogram& other);
+
+        // p in [0, 100]
+        uint64_t percentile(double p) const;
+
+        uint64_t count() const {
+            return total;
+        }
+
+        uint64_t min() const {
+            return total ? minimum : 0;
+        }
+
+        uint64_t max() const {
+            return maximum;
+        }
+
+        double mean() const {
+            return total ? static_cast<double>(sum) / total : 0.0;
+        }
+
+        void clear();
+
+    private:
+        std::vector<uint64_t> buckets;
+        uint64_t total;
+        uint64_t sum;
+        uint64_t minimum;
+        uint64_t maximum;
+
+        static size_t bucket_of(uint64_t value);
+
+        static uint64_t bucket_upper_bound(size_t bucket);
+    };
+
+}
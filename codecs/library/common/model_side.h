@@ -0,0 +1,84 @@
+#pragma once
+
+#include "codec.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace Codecs {
+
+    // The encoder or decoder structures of a model, which load() builds now, on first use or never,
+    // depending on the LoadMode.
+    class ModelSide {
+    public:
+        enum State {
+            READY,
+            LAZY,
+            MISSING
+        };
+
+        ModelSide() : state(READY), once(new std::once_flag) { }
+
+        // a copy of a lazy side that is not built yet builds its own on first use
+        ModelSide(const ModelSide &other) : state(other.state.load()), once(new std::once_flag) { }
+
+        ModelSide &operator=(const ModelSide &other) {
+            reset(other.state.load());
+            return *this;
+        }
+
+        void reset(State new_state) {
+            state.store(new_state);
+            once.reset(new std::once_flag);
+        }
+
+        // the side of a mode, `encoder` telling which one this is
+        static State of(LoadMode mode, bool encoder) {
+            switch (mode) {
+                case LoadMode::BOTH:
+                    return READY;
+                case LoadMode::LAZY:
+                    return LAZY;
+                case LoadMode::ENCODE:
+                    return encoder ? READY : MISSING;
+                case LoadMode::DECODE:
+                    return encoder ? MISSING : READY;
+            }
+            return READY;
+        }
+
+        // makes sure the side is built, calling `build` on first use of a lazy side; throws if the
+        // model was loaded without it
+        template <typename Build>
+        void require(const char *side, Build build) const {
+            State current = state.load(std::memory_order_acquire);
+            if (current == READY) {
+                return;
+            }
+            if (current == MISSING) {
+                cthrow("the model was loaded without the " << side << " structures");
+            }
+            std::call_once(*once, [&] {
+                build();
+                state.store(READY, std::memory_order_release);
+            });
+        }
+
+        // the structures are built and won't change until the next load()
+        bool ready() const {
+            return state.load(std::memory_order_acquire) == READY;
+        }
+
+        // the model was loaded without the structures, require() throws
+        bool missing() const {
+            return state.load(std::memory_order_acquire) == MISSING;
+        }
+
+    private:
+        mutable std::atomic<State> state;
+        // a fresh flag for every load, std::once_flag itself can't be reset
+        std::unique_ptr<std::once_flag> once;
+    };
+
+}
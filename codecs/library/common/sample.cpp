@@ -1 +1,112 @@
 #include "sample.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Codecs {
+
+    ReservoirSampler::ReservoirSampler(const Options& options)
+        : options(options)
+        , generator(options.seed)
+    {}
+
+    void ReservoirSampler::add(const string_view& record, size_t source) {
+        add(record, source, !options.keep_views);
+    }
+
+    void ReservoirSampler::add(const string_view& record, size_t source, bool copy) {
+        ++seen_records;
+        seen_bytes += record.size();
+        if (!options.stratify) {
+            source = 0;
+        }
+        auto found = strata.find(source);
+        if (found == strata.end()) {
+            found = strata.emplace(source, Stratum()).first;
+            // the new source takes its share from the others
+            uint64_t budget = stratum_budget();
+            for (auto& stratum : strata) {
+                trim(stratum.second, budget);
+            }
+        }
+        Stratum& stratum = found->second;
+        uint64_t budget = stratum_budget();
+
+        size_t length = record.size();
+        if (options.max_piece_bytes) {
+            length = std::min(length, options.max_piece_bytes);
+        }
+        length = std::min<uint64_t>(length, budget);
+        if (!length) {
+            return;
+        }
+        // u in (0, 1], so the key is finite
+        double u = (static_cast<double>(generator() >> 11) + 1) / 9007199254740992.0;
+        double weight = options.weight_by_size ? static_cast<double>(record.size()) : 1.0;
+        double key = std::log(u) / weight;
+        auto later = [](const Item& a, const Item& b) { return a.key > b.key; };
+        // a record that would be the first to go is not copied at all
+        if (stratum.bytes + length > budget && !stratum.heap.empty() && key <= stratum.heap.front().key) {
+            return;
+        }
+        size_t offset = length < record.size() ? generator() % (record.size() - length + 1) : 0;
+        string_view piece = record.substr(offset, length);
+        stratum.heap.push_back({key, seen_records, piece, copy ? piece.to_string() : std::string()});
+        std::push_heap(stratum.heap.begin(), stratum.heap.end(), later);
+        stratum.bytes += length;
+        trim(stratum, budget);
+    }
+
+    void ReservoirSampler::add_lines(std::istream& in, size_t source) {
+        std::string line;
+        while (std::getline(in, line)) {
+            add(line, source, true);
+        }
+    }
+
+    StringViewVector ReservoirSampler::sample() const {
+        vector<const Item*> items;
+        for (const auto& stratum : strata) {
+            for (const auto& item : stratum.second.heap) {
+                items.push_back(&item);
+            }
+        }
+        std::sort(items.begin(), items.end(), [](const Item* a, const Item* b) { return a->sequence < b->sequence; });
+        StringViewVector result;
+        result.reserve(items.size());
+        for (const Item* item : items) {
+            result.push_back(item->piece());
+        }
+        return result;
+    }
+
+    size_t ReservoirSampler::size() const {
+        size_t result = 0;
+        for (const auto& stratum : strata) {
+            result += stratum.second.heap.size();
+        }
+        return result;
+    }
+
+    uint64_t ReservoirSampler::bytes() const {
+        uint64_t result = 0;
+        for (const auto& stratum : strata) {
+            result += stratum.second.bytes;
+        }
+        return result;
+    }
+
+    uint64_t ReservoirSampler::stratum_budget() const {
+        return options.budget_bytes / std::max<size_t>(1, strata.size());
+    }
+
+    void ReservoirSampler::trim(Stratum& stratum, uint64_t budget) {
+        auto later = [](const Item& a, const Item& b) { return a.key > b.key; };
+        while (stratum.bytes > budget) {
+            std::pop_heap(stratum.heap.begin(), stratum.heap.end(), later);
+            stratum.bytes -= stratum.heap.back().piece().size();
+            stratum.heap.pop_back();
+        }
+    }
+
+}
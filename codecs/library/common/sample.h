@@ -1,8 +1,11 @@
 #pragma once
 
-#include <experimental/algorithm>
 #include <experimental/string_view>
+#include <cstdint>
+#include <istream>
+#include <map>
 #include <random>
+#include <string>
 #include <vector>
 
 namespace Codecs {
@@ -11,13 +14,92 @@ namespace Codecs {
     using StringViewVector = vector<string_view>;
     using StringVector = vector<std::string>;
 
-    template <typename Iter>
-    static void select_sample(StringViewVector& sample, Iter begin, Iter end, size_t sample_size) {
-        std::experimental::sample(begin, end, std::back_inserter(sample), sample_size, std::mt19937());
-    }
+    struct ReservoirOptions {
+        // the sample holds at most this many bytes, whatever the size of the input
+        uint64_t budget_bytes = 16 << 20;
+        // pick records with a probability growing with their size, so the sample follows the bytes of
+        // the input rather than its records
+        bool weight_by_size = false;
+        // give every source an equal share of the budget, however many records it has
+        bool stratify = false;
+        // records longer than this contribute a random substring of this length, 0 for whole records;
+        // a record never takes more than the budget of its source
+        size_t max_piece_bytes = 0;
+        // the records given to add() outlive the sample, which then points into them, pieces included,
+        // instead of holding copies; add_lines() copies anyway
+        bool keep_views = false;
+        uint64_t seed = 5489;
+    };
 
-    template <typename Iter>
-    static void select_sample(StringVector& sample, Iter begin, Iter end, size_t sample_size) {
-        std::experimental::sample(begin, end, std::back_inserter(sample), sample_size, std::mt19937());
-    }
+    // Samples records in one pass, keeping copies of at most budget_bytes of them, so the input can be
+    // an input iterator or a stream and the memory of training is known before it starts. Records which
+    // stay in memory anyway, a mapped corpus say, are kept as views with ReservoirOptions::keep_views.
+    //
+    // Every record gets a random key, log(u) / weight (Efraimidis and Spirakis), and the sample is the
+    // records with the largest keys that fit into the budget. With equal weights that is a uniform sample
+    // of records; keys also make it cheap to shrink a stratum when a new source takes its share.
+    class ReservoirSampler {
+    public:
+        using Options = ReservoirOptions;
+
+        explicit ReservoirSampler(const Options& options = Options());
+
+        void add(const string_view& record, size_t source = 0);
+
+        template <typename Iter>
+        void add(Iter begin, Iter end, size_t source = 0) {
+            for (; begin != end; ++begin) {
+                add(*begin, source);
+            }
+        }
+
+        // one record a line
+        void add_lines(std::istream& in, size_t source = 0);
+
+        // the sampled records in input order, valid until the next add()
+        StringViewVector sample() const;
+
+        size_t size() const;
+
+        uint64_t bytes() const;
+
+        uint64_t records_seen() const {
+            return seen_records;
+        }
+
+        uint64_t bytes_seen() const {
+            return seen_bytes;
+        }
+
+    private:
+        struct Item {
+            double key;
+            uint64_t sequence;
+            // `data` holds a copy, or is empty and `view` points into the record
+            string_view view;
+            std::string data;
+
+            string_view piece() const {
+                return data.empty() ? view : string_view(data);
+            }
+        };
+
+        // a min heap by key, the first record to go is at the front
+        struct Stratum {
+            vector<Item> heap;
+            uint64_t bytes = 0;
+        };
+
+        Options options;
+        std::mt19937_64 generator;
+        std::map<size_t, Stratum> strata;
+        uint64_t seen_records = 0;
+        uint64_t seen_bytes = 0;
+
+        uint64_t stratum_budget() const;
+
+        void add(const string_view& record, size_t source, bool copy);
+
+        static void trim(Stratum& stratum, uint64_t budget);
+    };
 }
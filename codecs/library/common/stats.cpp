@@ -0,0 +1,144 @@
+#include "stats.h"
+#include "inspect.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+
+namespace Codecs {
+
+    namespace {
+
+        const size_t CODEC_TYPES = 256;
+
+        struct ThreadCounters;
+
+        struct SharedCounters {
+            std::mutex mutex;
+            std::set<ThreadCounters*> live;
+            CodecStats retired[CODEC_TYPES];
+        };
+
+        // never destroyed, threads may exit after static destructors have run
+        SharedCounters& shared() {
+            static SharedCounters* counters = new SharedCounters();
+            return *counters;
+        }
+
+        struct ThreadCounters {
+            std::mutex mutex;
+            CodecStats stats[CODEC_TYPES];
+
+            ThreadCounters() {
+                std::lock_guard<std::mutex> lock(shared().mutex);
+                shared().live.insert(this);
+            }
+
+            ~ThreadCounters() {
+                std::lock_guard<std::mutex> lock(shared().mutex);
+                std::lock_guard<std::mutex> own(mutex);
+                for (size_t i = 0; i < CODEC_TYPES; ++i) {
+                    shared().retired[i].merge(stats[i]);
+                }
+                shared().live.erase(this);
+            }
+        };
+
+        ThreadCounters& thread_counters() {
+            thread_local ThreadCounters counters;
+            return counters;
+        }
+
+    }
+
+    void CodecStats::merge(const CodecStats& other) {
+        calls += other.calls;
+        input_bytes += other.input_bytes;
+        output_bits += other.output_bits;
+        symbols += other.symbols;
+        escapes += other.escapes;
+        trie_steps += other.trie_steps;
+        fallbacks += other.fallbacks;
+        if (dict_usage.size() < other.dict_usage.size()) {
+            dict_usage.resize(other.dict_usage.size(), 0);
+        }
+        for (size_t i = 0; i < other.dict_usage.size(); ++i) {
+            dict_usage[i] += other.dict_usage[i];
+        }
+    }
+
+    void CodecStats::dump(std::ostream& out, const StringVector* dictionary, size_t top_entries) const {
+        out << "calls: " << calls << "\tinput bytes: " << input_bytes << "\toutput bits: " << output_bits
+            << "\tsymbols: " << symbols
+            << "\nbits per byte: " << bits_per_byte() << "\tbits per symbol: " << bits_per_symbol()
+            << "\tbytes per symbol: " << (symbols ? static_cast<double>(input_bytes) / symbols : 0.0) << '\n';
+        if (escapes) {
+            out << "escapes: " << escapes << " (" << 100.0 * escapes / std::max<uint64_t>(symbols, 1)
+                << "% of symbols)\n";
+        }
+        if (trie_steps || fallbacks) {
+            out << "trie steps: " << trie_steps << " ("
+                << (input_bytes ? static_cast<double>(trie_steps) / input_bytes : 0.0) << " per byte)"
+                << "\tfallbacks: " << fallbacks << '\n';
+        }
+        if (dict_usage.empty()) {
+            return;
+        }
+        vector<size_t> used;
+        for (size_t i = 0; i < dict_usage.size(); ++i) {
+            if (dict_usage[i]) {
+                used.push_back(i);
+            }
+        }
+        out << "dictionary entries used: " << used.size() << " of " << dict_usage.size() << '\n';
+        size_t top = std::min(top_entries, used.size());
+        std::partial_sort(used.begin(), used.begin() + top, used.end(), [this](size_t x, size_t y) {
+            return dict_usage[x] > dict_usage[y] || (dict_usage[x] == dict_usage[y] && x < y);
+        });
+        for (size_t i = 0; i < top; ++i) {
+            out << std::setw(12) << dict_usage[used[i]] << std::setw(10) << std::fixed << std::setprecision(3)
+                << 100.0 * dict_usage[used[i]] / std::max<uint64_t>(symbols, 1) << '%';
+            out.unsetf(std::ios::floatfield);
+            out << std::setprecision(6) << std::setw(8) << used[i];
+            if (dictionary && used[i] < dictionary->size()) {
+                out << "  \"" << escape_bytes((*dictionary)[used[i]]) << '"';
+            }
+            out << '\n';
+        }
+    }
+
+    StatsRegistry::Local::Local(CodecType type)
+        : guard(thread_counters().mutex)
+        , counters(thread_counters().stats[static_cast<size_t>(type)])
+    {}
+
+    void StatsRegistry::add(CodecType type, const CodecStats& stats) {
+        Local local(type);
+        local.stats().merge(stats);
+    }
+
+    CodecStats StatsRegistry::snapshot(CodecType type) {
+        size_t i = static_cast<size_t>(type);
+        std::lock_guard<std::mutex> lock(shared().mutex);
+        CodecStats result = shared().retired[i];
+        for (ThreadCounters* thread : shared().live) {
+            std::lock_guard<std::mutex> own(thread->mutex);
+            result.merge(thread->stats[i]);
+        }
+        return result;
+    }
+
+    void StatsRegistry::reset() {
+        std::lock_guard<std::mutex> lock(shared().mutex);
+        for (ThreadCounters* thread : shared().live) {
+            std::lock_guard<std::mutex> own(thread->mutex);
+            for (auto& stats : thread->stats) {
+                stats.clear();
+            }
+        }
+        for (auto& stats : shared().retired) {
+            stats.clear();
+        }
+    }
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "frame.h"
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+// Build with -DCODECS_STATS=ON to count hot path events of every encode call into thread-local
+// counters. When it is off the counting code is not compiled into the plain encode() at all;
+// the encode() overloads taking a CodecStats* count for that call only, in any build.
+#ifndef CODECS_STATS
+#define CODECS_STATS 0
+#endif
+
+namespace Codecs {
+
+    constexpr bool STATS_ENABLED = CODECS_STATS;
+
+    struct CodecStats {
+        uint64_t calls = 0;
+        uint64_t input_bytes = 0;
+        uint64_t output_bits = 0;
+        uint64_t symbols = 0;        // codes written
+        uint64_t escapes = 0;        // Huffman: bytes written after the escape code
+        uint64_t trie_steps = 0;     // DictHuffman: search trie transitions
+        uint64_t fallbacks = 0;      // DictHuffman: matches cut short by the record end or backed off to a shorter entry;
+                                     // WordHuffman: tokens spelled by characters
+        vector<uint64_t> dict_usage; // DictHuffman: codes written per dictionary entry
+
+        void merge(const CodecStats& other);
+
+        void clear() {
+            *this = CodecStats();
+        }
+
+        double bits_per_byte() const {
+            return input_bytes ? static_cast<double>(output_bits) / input_bytes : 0.0;
+        }
+
+        double bits_per_symbol() const {
+            return symbols ? static_cast<double>(output_bits) / symbols : 0.0;
+        }
+
+        // `dictionary` names the entries of dict_usage, the `top_entries` most used ones are listed
+        void dump(std::ostream& out, const StringVector* dictionary = nullptr, size_t top_entries = 20) const;
+    };
+
+    // Per-thread counters of every codec type. A thread only takes its own uncontended lock once
+    // per encode call; snapshot() sums the counters of live threads and of threads that exited.
+    class StatsRegistry {
+    public:
+        // locked counters of the calling thread
+        class Local {
+        public:
+            explicit Local(CodecType type);
+
+            CodecStats& stats() {
+                return counters;
+            }
+
+        private:
+            std::unique_lock<std::mutex> guard;
+            CodecStats& counters;
+        };
+
+        static void add(CodecType type, const CodecStats& stats);
+
+        static CodecStats snapshot(CodecType type);
+
+        static void reset();
+    };
+
+}
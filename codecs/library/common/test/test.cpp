@@ -0,0 +1,501 @@
+#include <library/common/canonical_huffman.h>
+#include <library/common/hash.h>
+#include <library/common/histogram.h>
+#include <library/common/inspect.h>
+#include <library/common/latency.h>
+#include <library/common/sample.h>
+#include <library/common/stats.h>
+#include <library/common/thread_pool.h>
+#include <library/tests_common/tests_common.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+TEST(LatencyHistogramTest, ExactForSmallValues) {
+    Codecs::LatencyHistogram histogram;
+    for (uint64_t i = 1; i <= 20; ++i) {
+        histogram.record(i);
+    }
+    ASSERT_EQ(20u, histogram.count());
+    ASSERT_EQ(1u, histogram.min());
+    ASSERT_EQ(20u, histogram.max());
+    ASSERT_EQ(10u, histogram.percentile(50));
+    ASSERT_EQ(20u, histogram.percentile(100));
+    ASSERT_DOUBLE_EQ(10.5, histogram.mean());
+}
+
+TEST(LatencyHistogramTest, BoundedRelativeError) {
+    Codecs::LatencyHistogram histogram;
+    for (uint64_t i = 1; i <= 100000; ++i) {
+        histogram.record(i * 1000);
+    }
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        double exact = p * 1000 * 1000;
+        double reported = histogram.percentile(p);
+        ASSERT_NEAR(exact, reported, exact * 0.04) << p;
+    }
+}
+
+TEST(LatencyHistogramTest, Merge) {
+    Codecs::LatencyHistogram first, second;
+    first.record(100);
+    second.record(1000000);
+    second.record(5);
+    first.merge(second);
+    ASSERT_EQ(3u, first.count());
+    ASSERT_EQ(5u, first.min());
+    ASSERT_EQ(1000000u, first.max());
+    ASSERT_NEAR(100, first.percentile(50), 4);
+}
+
+TEST(StatsRegistryTest, SumsLiveAndExitedThreads) {
+    Codecs::StatsRegistry::reset();
+    Codecs::CodecStats call;
+    call.calls = 1;
+    call.input_bytes = 10;
+    call.dict_usage = {0, 2, 1};
+    Codecs::StatsRegistry::add(Codecs::CodecType::DICT_HUFFMAN, call);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&call]() {
+            for (int i = 0; i < 10; ++i) {
+                Codecs::StatsRegistry::add(Codecs::CodecType::DICT_HUFFMAN, call);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    Codecs::CodecStats total = Codecs::StatsRegistry::snapshot(Codecs::CodecType::DICT_HUFFMAN);
+    ASSERT_EQ(41u, total.calls);
+    ASSERT_EQ(410u, total.input_bytes);
+    ASSERT_EQ((std::vector<uint64_t>{0, 82, 41}), total.dict_usage);
+    ASSERT_EQ(0u, Codecs::StatsRegistry::snapshot(Codecs::CodecType::HUFFMAN).calls);
+
+    Codecs::StatsRegistry::reset();
+    ASSERT_EQ(0u, Codecs::StatsRegistry::snapshot(Codecs::CodecType::DICT_HUFFMAN).calls);
+}
+
+TEST(StatsRegistryTest, Dump) {
+    Codecs::CodecStats stats;
+    stats.input_bytes = 12;
+    stats.output_bits = 24;
+    stats.symbols = 4;
+    stats.dict_usage = {0, 3, 1};
+    Codecs::StringVector dictionary = {"", "abc", "\n"};
+    std::ostringstream out;
+    stats.dump(out, &dictionary);
+    ASSERT_NE(std::string::npos, out.str().find("bits per byte: 2"));
+    ASSERT_NE(std::string::npos, out.str().find("dictionary entries used: 2 of 3"));
+    ASSERT_LT(out.str().find("\"abc\""), out.str().find("\"\\x5cn\""));
+}
+
+TEST(ModelInfoTest, CodesAndEntries) {
+    Codecs::ModelInfo info;
+    info.add_structure("tree", 10, 640, false, true);
+    info.add_structure("codes", 10, 100, true, false);
+    info.add_structure("dict", 3, 96, true, true);
+    ASSERT_EQ(836u, info.heap_bytes());
+    ASSERT_EQ(196u, info.encode_path_bytes());
+    ASSERT_EQ(736u, info.decode_path_bytes());
+
+    for (unsigned length : {3, 3, 5, 12}) {
+        info.add_code(length);
+    }
+    ASSERT_EQ(12u, info.max_code_length());
+    ASSERT_EQ(2u, info.code_lengths[3]);
+
+    info.entries = {{"ab", 0.5, 3}, {"abcd", 0.1, 5}, {"x", 0.5, 3}, {"abc", 0.1, 12}};
+    auto by_frequency = info.sorted_entries(Codecs::ModelInfo::EntryOrder::FREQUENCY);
+    ASSERT_EQ("ab", by_frequency[0].value);
+    ASSERT_EQ("x", by_frequency[1].value);
+    ASSERT_EQ("abcd", by_frequency[2].value);
+    auto by_length = info.sorted_entries(Codecs::ModelInfo::EntryOrder::LENGTH);
+    ASSERT_EQ("abcd", by_length[0].value);
+    ASSERT_EQ("x", by_length[3].value);
+
+    Codecs::ModelInfo outer;
+    outer.add_code(1);
+    outer.merge(info, "inner/");
+    ASSERT_EQ("inner/tree", outer.structures[0].name);
+    ASSERT_EQ(5u, outer.code_lengths[1] + outer.code_lengths[3] + outer.code_lengths[5] + outer.code_lengths[12]);
+
+    std::ostringstream out;
+    info.dump(out, 2, Codecs::ModelInfo::EntryOrder::LENGTH);
+    ASSERT_NE(std::string::npos, out.str().find("max depth 12"));
+    ASSERT_NE(std::string::npos, out.str().find("\"abcd\""));
+    ASSERT_EQ(std::string::npos, out.str().find("\"x\""));
+}
+
+TEST(ModelInfoTest, HeapBytes) {
+    std::vector<uint32_t> values;
+    values.reserve(100);
+    ASSERT_EQ(400u, Codecs::heap_bytes(values));
+    ASSERT_EQ(0u, Codecs::heap_bytes(std::string("short")));
+    ASSERT_GE(Codecs::heap_bytes(std::string(100, 'x')), 101u);
+    ASSERT_EQ("a\\x0ab\\x22", Codecs::escape_bytes("a\nb\""));
+}
+
+namespace {
+
+    void naive_count(const std::string& data, uint64_t (&counts)[256]) {
+        for (unsigned char c : data) {
+            ++counts[c];
+        }
+    }
+
+}
+
+TEST(HistogramTest, MatchesNaiveCount) {
+    std::mt19937 generator(5);
+    for (size_t size : {0, 1, 15, 16, 17, 1000, 65537}) {
+        std::string data(size, 0);
+        for (auto& c : data) {
+            // skewed, with long runs of the same byte
+            c = static_cast<char>(generator() % 3 ? 'a' : generator());
+        }
+        uint64_t expected[256] = {0}, actual[256] = {0};
+        naive_count(data, expected);
+        Codecs::count_bytes(data, actual);
+        ASSERT_TRUE(std::equal(std::begin(expected), std::end(expected), std::begin(actual))) << size;
+    }
+}
+
+TEST(HistogramTest, ParallelMatchesSerial) {
+    std::mt19937 generator(7);
+    std::vector<std::string> storage;
+    // many small records around a few records larger than a parallel task
+    for (size_t i = 0; i < 3000; ++i) {
+        size_t size = i % 1000 == 999 ? (3 << 20) + i : generator() % 2000;
+        storage.emplace_back(size, 0);
+        for (auto& c : storage.back()) {
+            c = static_cast<char>(generator() % 97);
+        }
+    }
+    Codecs::StringViewVector records(storage.begin(), storage.end());
+    uint64_t expected[256] = {0};
+    for (const auto& record : storage) {
+        naive_count(record, expected);
+    }
+    for (size_t threads : {1, 2, 8}) {
+        uint64_t actual[256] = {0};
+        Codecs::count_bytes(records, actual, threads);
+        ASSERT_TRUE(std::equal(std::begin(expected), std::end(expected), std::begin(actual))) << threads;
+    }
+}
+
+TEST(HistogramTest, Entropy) {
+    std::string all;
+    for (int i = 0; i < 256 * 4; ++i) {
+        all.push_back(static_cast<char>(i));
+    }
+    ASSERT_NEAR(8.0, Codecs::entropy_per_byte(all), 1e-9);
+    ASSERT_NEAR(0.0, Codecs::entropy_per_byte(std::string(100, 'x')), 1e-9);
+    ASSERT_NEAR(1.0, Codecs::entropy_per_byte("abababab"), 1e-9);
+    ASSERT_EQ(0.0, Codecs::entropy_per_byte(""));
+}
+
+TEST(CanonicalHuffmanTest, LimitsLengths) {
+    // Fibonacci frequencies make the deepest possible Huffman tree
+    std::vector<uint64_t> frequencies = {1, 1};
+    while (frequencies.size() < 40) {
+        frequencies.push_back(frequencies[frequencies.size() - 1] + frequencies[frequencies.size() - 2]);
+    }
+    frequencies.push_back(0);
+    auto lengths = Codecs::CanonicalHuffman::build_lengths(frequencies, 10);
+    uint64_t kraft = 0;
+    for (size_t symbol = 0; symbol + 1 < frequencies.size(); ++symbol) {
+        ASSERT_GE(lengths[symbol], 1u);
+        ASSERT_LE(lengths[symbol], 10u);
+        kraft += uint64_t(1) << (10 - lengths[symbol]);
+    }
+    ASSERT_EQ(0u, lengths.back());
+    ASSERT_LE(kraft, 1u << 10);
+    ASSERT_LE(lengths[39], lengths[0]);
+
+    lengths = Codecs::CanonicalHuffman::build_lengths({5, 5, 5, 5});
+    ASSERT_EQ(std::vector<uint8_t>(4, 2), lengths);
+    lengths = Codecs::CanonicalHuffman::build_lengths({0, 7, 0});
+    ASSERT_EQ(1u, lengths[1]);
+    ASSERT_THROW(Codecs::CanonicalHuffman(std::vector<uint8_t>{1, 1, 1}), Codecs::CodecException);
+}
+
+TEST(CanonicalHuffmanTest, Roundtrip) {
+    std::mt19937 random(3);
+    std::vector<uint64_t> frequencies(300);
+    for (auto& frequency : frequencies) {
+        frequency = random() % 1000 + (random() % 10 ? 0 : 100000);
+    }
+    Codecs::CanonicalHuffman code(Codecs::CanonicalHuffman::build_lengths(frequencies));
+
+    std::string saved;
+    code.save(saved);
+    size_t pos = 0;
+    Codecs::CanonicalHuffman loaded = Codecs::CanonicalHuffman::load(saved, pos);
+    ASSERT_EQ(saved.size(), pos);
+    ASSERT_EQ(code.code_lengths(), loaded.code_lengths());
+
+    struct Written {
+        unsigned symbol;
+        unsigned extra;
+        uint32_t bits;
+    };
+    std::vector<Written> written;
+    std::string encoded;
+    Codecs::BitWriter out(encoded);
+    for (int i = 0; i < 10000; ++i) {
+        unsigned symbol = random() % frequencies.size();
+        unsigned extra = random() % 25;
+        uint32_t bits = random() & ((1u << extra) - 1);
+        written.push_back({symbol, extra, bits});
+        code.write(out, symbol);
+        out.write(bits, extra);
+    }
+    out.flush();
+
+    Codecs::BitReader in(encoded.data(), encoded.data() + encoded.size());
+    for (const auto& item : written) {
+        in.refill();
+        ASSERT_EQ(item.symbol, loaded.read(in));
+        ASSERT_EQ(item.bits, in.read(item.extra));
+    }
+    ASSERT_FALSE(in.overrun_input());
+}
+
+TEST(MsbWindowTest, MatchesBitByBit) {
+    std::mt19937 random(4);
+    std::string bytes;
+    for (int i = 0; i < 20; ++i) {
+        bytes.push_back(static_cast<char>(random()));
+    }
+    Codecs::string_view bits(bytes);
+    for (size_t bit = 0; bit < bytes.size() * 8; ++bit) {
+        uint64_t expected = 0;
+        for (size_t i = bit; i < bit + 57; ++i) {
+            unsigned value = i < bytes.size() * 8 ? (static_cast<unsigned char>(bytes[i >> 3]) >> (7 - (i & 7))) & 1 : 0;
+            expected = (expected << 1) | value;
+        }
+        ASSERT_EQ(expected, Codecs::msb_window(bits, bit) >> 7) << bit;
+    }
+    ASSERT_EQ(Codecs::msb_window(bits, 8), Codecs::peek_msb(bytes.data() + 1));
+}
+
+TEST(WorkStealingPoolTest, RunsEveryTask) {
+    Codecs::WorkStealingPool pool(3, 1);
+    std::vector<int> done(1000, 0);
+    for (size_t i = 0; i < done.size(); ++i) {
+        pool.submit([&done, i]() {
+            if (i % 100 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            ++done[i];
+        });
+    }
+    pool.wait();
+    ASSERT_EQ(done.size(), static_cast<size_t>(std::count(done.begin(), done.end(), 1)));
+    Codecs::WorkStealingPool::Stats stats = pool.stats();
+    ASSERT_EQ(done.size(), stats.tasks);
+    // three workers hold at most three tasks, the submitter had to wait
+    ASSERT_GT(stats.submit_stalls, 0u);
+}
+
+TEST(WorkStealingPoolTest, ManyShortTasks) {
+    // workers race each other for the tasks they claimed, a claim always ends with a task
+    Codecs::WorkStealingPool pool(64, 1);
+    std::atomic<size_t> done(0);
+    const size_t tasks = 300000;
+    for (size_t i = 0; i < tasks; ++i) {
+        pool.submit([&done]() { ++done; });
+    }
+    pool.wait();
+    ASSERT_EQ(tasks, done.load());
+    ASSERT_EQ(tasks, pool.stats().tasks);
+}
+
+TEST(WorkStealingPoolTest, RethrowsTaskErrors) {
+    Codecs::WorkStealingPool pool(2);
+    std::atomic<int> finished(0);
+    for (int i = 0; i < 10; ++i) {
+        pool.submit([&finished, i]() {
+            if (i == 3) {
+                throw std::runtime_error("task failed");
+            }
+            ++finished;
+        });
+    }
+    ASSERT_THROW(pool.wait(), std::runtime_error);
+    ASSERT_EQ(9, finished.load());
+    pool.submit([&finished]() { ++finished; });
+    pool.wait();
+    ASSERT_EQ(10, finished.load());
+}
+
+TEST(ReservoirSamplerTest, UniformWithinBudget) {
+    Codecs::ReservoirOptions options;
+    options.budget_bytes = 10000;
+    Codecs::ReservoirSampler sampler(options);
+    for (size_t i = 0; i < 10000; ++i) {
+        std::string record = std::to_string(i);
+        record.resize(100, ' ');
+        sampler.add(record);
+    }
+    ASSERT_EQ(10000u, sampler.records_seen());
+    ASSERT_EQ(1000000u, sampler.bytes_seen());
+    ASSERT_EQ(10000u, sampler.bytes());
+    Codecs::StringViewVector sample = sampler.sample();
+    ASSERT_EQ(100u, sample.size());
+    // in input order and spread over all of it
+    double sum = 0;
+    size_t previous = 0;
+    for (const auto &record : sample) {
+        size_t index = std::stoul(record.to_string());
+        ASSERT_TRUE(&record == &sample[0] || index > previous);
+        previous = index;
+        sum += index;
+    }
+    ASSERT_NEAR(5000.0, sum / sample.size(), 1000.0);
+}
+
+TEST(ReservoirSamplerTest, WeightBySize) {
+    std::string small(10, 's'), large(1000, 'l');
+    double large_share[2];
+    for (bool weighted : {false, true}) {
+        Codecs::ReservoirOptions options;
+        options.budget_bytes = 100000;
+        options.weight_by_size = weighted;
+        Codecs::ReservoirSampler sampler(options);
+        for (size_t i = 0; i < 20000; ++i) {
+            sampler.add(i % 2 ? large : small);
+        }
+        size_t large_records = 0;
+        Codecs::StringViewVector sample = sampler.sample();
+        for (const auto &record : sample) {
+            large_records += record.size() == large.size();
+        }
+        large_share[weighted] = static_cast<double>(large_records) / sample.size();
+    }
+    // the bytes of the input are 99% large records, its records half of them
+    ASSERT_GT(large_share[true], 0.85);
+    ASSERT_LT(large_share[false], 0.6);
+}
+
+TEST(ReservoirSamplerTest, Stratify) {
+    Codecs::ReservoirOptions options;
+    options.budget_bytes = 10000;
+    options.stratify = true;
+    Codecs::ReservoirSampler sampler(options);
+    for (size_t i = 0; i < 10000; ++i) {
+        sampler.add(std::string(50, i % 10 ? 'a' : 'b'), i % 10 ? 0 : 1);
+    }
+    ASSERT_LE(sampler.bytes(), 10000u);
+    Codecs::StringViewVector sample = sampler.sample();
+    size_t rare = 0;
+    for (const auto &record : sample) {
+        rare += record[0] == 'b';
+    }
+    // each source gets half of the budget although one has 10% of the records
+    ASSERT_EQ(100u, rare);
+    ASSERT_EQ(200u, sample.size());
+}
+
+TEST(ReservoirSamplerTest, PiecesOfLongRecords) {
+    std::string record;
+    for (size_t i = 0; record.size() < 100000; ++i) {
+        record += std::to_string(i) + ' ';
+    }
+    Codecs::ReservoirOptions options;
+    options.budget_bytes = 5000;
+    options.max_piece_bytes = 1000;
+    Codecs::ReservoirSampler sampler(options);
+    std::istringstream lines(record + '\n' + record + '\n' + "short\n");
+    sampler.add_lines(lines);
+    ASSERT_EQ(3u, sampler.records_seen());
+    Codecs::StringViewVector sample = sampler.sample();
+    ASSERT_EQ(3u, sample.size());
+    ASSERT_EQ(1000u, sample[0].size());
+    ASSERT_NE(std::string::npos, record.find(sample[0].to_string()));
+    ASSERT_EQ("short", sample[2]);
+
+    // a record never takes more than the budget
+    options.max_piece_bytes = 0;
+    Codecs::ReservoirSampler whole(options);
+    whole.add(record);
+    ASSERT_EQ(5000u, whole.bytes());
+}
+
+TEST(ReservoirSamplerTest, KeepsViews) {
+    std::vector<std::string> records;
+    for (size_t i = 0; i < 1000; ++i) {
+        records.push_back(std::string(50 + i % 200, static_cast<char>('a' + i % 26)));
+    }
+    Codecs::ReservoirOptions options;
+    options.budget_bytes = 20000;
+    options.max_piece_bytes = 100;
+    options.keep_views = true;
+    Codecs::ReservoirSampler sampler(options);
+    sampler.add(records.begin(), records.end());
+    Codecs::ReservoirOptions copy_options = options;
+    copy_options.keep_views = false;
+    Codecs::ReservoirSampler copies(copy_options);
+    copies.add(records.begin(), records.end());
+    // the same picks, pointing into the records
+    Codecs::StringViewVector sample = sampler.sample();
+    ASSERT_EQ(copies.sample(), sample);
+    ASSERT_EQ(copies.bytes(), sampler.bytes());
+    ASSERT_LE(sampler.bytes(), 20000u);
+    for (const auto& piece : sample) {
+        ASSERT_LE(piece.size(), 100u);
+        ASSERT_TRUE(std::any_of(records.begin(), records.end(), [&piece](const std::string& record) {
+            return piece.data() >= record.data() && piece.data() + piece.size() <= record.data() + record.size();
+        }));
+    }
+
+    // lines don't outlive add_lines(), they are copied
+    std::istringstream lines("first\nsecond\n");
+    sampler.add_lines(lines);
+    sample = sampler.sample();
+    ASSERT_EQ("second", sample.back());
+}
+
+TEST(Hash128Test, SpreadsInputs) {
+    std::string text = Codecs::LOREM_IPSUM;
+    ASSERT_EQ(Codecs::hash128(text), Codecs::hash128(std::string(text)));
+    ASSERT_NE(Codecs::hash128(text), Codecs::hash128(text, 1));
+    // zero padding of the tail and trailing zero bytes
+    ASSERT_NE(Codecs::hash128("a"), Codecs::hash128(std::string("a\0", 2)));
+    ASSERT_NE(Codecs::hash128(""), Codecs::hash128(std::string(16, '\0')));
+
+    // every single bit flip changes about half of the bits of both halves
+    Codecs::Hash128 base = Codecs::hash128(text);
+    double flipped = 0;
+    size_t trials = 0;
+    for (size_t byte = 0; byte < text.size(); byte += 7) {
+        for (int bit = 0; bit < 8; ++bit, ++trials) {
+            std::string changed = text;
+            changed[byte] ^= 1 << bit;
+            Codecs::Hash128 hash = Codecs::hash128(changed);
+            flipped += __builtin_popcountll(hash.low ^ base.low) + __builtin_popcountll(hash.high ^ base.high);
+        }
+    }
+    ASSERT_NEAR(64.0, flipped / trials, 4.0);
+}
+
+TEST(Hash128Test, NoBlockZeroesTheState) {
+    // each of these blocks made one factor of both lane products zero, so they hashed the same
+    std::string first("\xf4\x4c\x09\xd8\xb5\x63\x75\x47\x91\x57\xe2\x83\x97\x35\x03\x0e", 16);
+    std::string second("\x2f\x64\xbd\x78\x64\x1d\x76\xa0\xe3\xc6\x88\x9c\xf0\x6a\xbc\x8e", 16);
+    ASSERT_NE(Codecs::hash128(first), Codecs::hash128(second));
+    ASSERT_NE(Codecs::hash128(first + "tail"), Codecs::hash128(second + "tail"));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Codecs {
+
+    WorkStealingPool::WorkStealingPool(size_t threads, size_t queue_capacity) {
+        if (!threads) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        capacity = std::max<size_t>(1, queue_capacity) * threads;
+        for (size_t t = 0; t < threads; ++t) {
+            queues.emplace_back(new Queue());
+        }
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back(&WorkStealingPool::run, this, t);
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        has_work.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void WorkStealingPool::submit(Task task) {
+        size_t target;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (pending >= capacity) {
+                auto start = std::chrono::steady_clock::now();
+                has_space.wait(guard, [this]() { return pending < capacity; });
+                ++counters.submit_stalls;
+                counters.submit_stall_seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+            }
+            ++pending;
+            target = next_queue++ % queues.size();
+        }
+        {
+            std::lock_guard<std::mutex> guard(queues[target]->lock);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ++queued;
+        }
+        has_work.notify_one();
+    }
+
+    void WorkStealingPool::wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this]() { return pending == 0; });
+        if (error) {
+            std::exception_ptr thrown = error;
+            error = nullptr;
+            std::rethrow_exception(thrown);
+        }
+    }
+
+    WorkStealingPool::Stats WorkStealingPool::stats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return counters;
+    }
+
+    WorkStealingPool::Task WorkStealingPool::take(size_t worker) {
+        // There are at least as many queued tasks as claims, but another worker may take the task of
+        // this claim from a queue after the scan passed the queue a newer task went to; the scan goes
+        // round until it finds one.
+        for (size_t i = 0;; ++i) {
+            if (i && i % queues.size() == 0) {
+                std::this_thread::yield();
+            }
+            Queue& queue = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.tasks.empty()) {
+                Task task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                if (i % queues.size()) {
+                    std::lock_guard<std::mutex> counters_guard(lock);
+                    ++counters.steals;
+                }
+                return task;
+            }
+        }
+    }
+
+    void WorkStealingPool::run(size_t worker) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                has_work.wait(guard, [this]() { return queued > 0 || stopping; });
+                if (!queued) {
+                    return;
+                }
+                --queued;
+            }
+            Task task = take(worker);
+            std::exception_ptr thrown;
+            try {
+                task();
+            } catch (...) {
+                thrown = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (thrown && !error) {
+                    error = thrown;
+                }
+                ++counters.tasks;
+                --pending;
+                if (!pending) {
+                    finished.notify_all();
+                }
+            }
+            has_space.notify_one();
+        }
+    }
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "codec.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Codecs {
+
+    // Fixed set of workers, each with its own task queue. submit() deals tasks round robin; a worker
+    // whose queue is empty takes the oldest task of another queue, so one slow task does not hold
+    // back the tasks queued behind it. The pool holds at most `queue_capacity` tasks a worker that
+    // are not finished yet: submit() blocks while it is full, and the time spent there is reported
+    // as stalls, which tells a producer that outruns the workers apart from one that starves them.
+    class WorkStealingPool {
+    public:
+        using Task = std::function<void()>;
+
+        struct Stats {
+            uint64_t tasks;
+            uint64_t steals;
+            uint64_t submit_stalls;
+            double submit_stall_seconds;
+        };
+
+        // `threads` == 0 starts one worker per core
+        explicit WorkStealingPool(size_t threads = 0, size_t queue_capacity = 4);
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        // runs the queued tasks and joins the workers
+        ~WorkStealingPool();
+
+        void submit(Task task);
+
+        // Waits until all submitted tasks are finished; rethrows the first exception a task threw.
+        void wait();
+
+        size_t threads() const {
+            return workers.size();
+        }
+
+        Stats stats() const;
+
+    private:
+        struct Queue {
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+
+        vector<std::unique_ptr<Queue>> queues;
+        vector<std::thread> workers;
+        size_t capacity;
+
+        mutable std::mutex lock;
+        std::condition_variable has_work;
+        std::condition_variable has_space;
+        std::condition_variable finished;
+        // submitted and not finished, queued and not yet claimed by a worker
+        size_t pending = 0;
+        size_t queued = 0;
+        size_t next_queue = 0;
+        bool stopping = false;
+        std::exception_ptr error;
+        Stats counters = Stats();
+
+        void run(size_t worker);
+
+        Task take(size_t worker);
+    };
+
+}
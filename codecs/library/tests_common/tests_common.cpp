@@ -0,0 +1,115 @@
+#include "tests_common.h"
+
+#include <library/Huffman/Huffman.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace Codecs {
+
+    const char* const LOREM_IPSUM =
+            "Lorem ipsum dolor sit amet, consectetur adipisicing elit, "
+            "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. "
+            "Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris "
+            "nisi ut aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in "
+            "voluptate velit esse cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat "
+            "non proident, sunt in culpa qui officia deserunt mollit anim id est laborum.";
+
+    StringVector lorem_records() {
+        StringVector records;
+        string text(LOREM_IPSUM);
+        size_t start = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '.' || text[i] == ',') {
+                records.push_back(text.substr(start, i + 1 - start));
+                start = i + 1;
+            }
+        }
+        records.push_back("Съешь же ещё этих мягких французских булок, да выпей чаю.");
+        records.push_back(string("\x00\x01\xff\xfe binary \x7f", 13));
+        records.push_back("");
+        return records;
+    }
+
+    void test_roundtrip(const CodecIFace& codec, const string_view& raw) {
+        string encoded;
+        string decoded;
+        codec.encode(encoded, raw);
+        codec.decode(decoded, encoded);
+        ASSERT_EQ(raw.to_string(), decoded);
+    }
+
+    void test_simple(CodecIFace& codec) {
+        StringVector records = lorem_records();
+        StringViewVector sample(records.begin(), records.end());
+        sample.push_back(LOREM_IPSUM);
+
+        codec.reset();
+        codec.learn(sample);
+        for (const auto& record : sample) {
+            test_roundtrip(codec, record);
+        }
+
+        string saved = codec.save();
+        vector<string> encoded(sample.size());
+        for (size_t i = 0; i < sample.size(); ++i) {
+            codec.encode(encoded[i], sample[i]);
+        }
+        codec.reset();
+        codec.load(saved);
+        for (size_t i = 0; i < sample.size(); ++i) {
+            string decoded;
+            codec.decode(decoded, encoded[i]);
+            ASSERT_EQ(sample[i].to_string(), decoded);
+        }
+    }
+
+    StringVector test_corpus(TextKind kind, size_t count) {
+        CorpusGenerator::Options options;
+        options.kind = kind;
+        options.sizes = SizeDistribution::log_normal(256, 1.0, 1, 8192);
+        return CorpusGenerator(options).records(count);
+    }
+
+    void test_corrupted_payloads(const CodecIFace& codec, const string_view& raw, size_t header) {
+        string encoded;
+        codec.encode(encoded, raw);
+        ASSERT_LT(header, encoded.size());
+        for (size_t i = header; i < encoded.size(); i += 7) {
+            string broken = encoded;
+            broken[i] ^= 0x5A;
+            string decoded;
+            try {
+                codec.decode(decoded, broken);
+            } catch (const CodecException&) {
+                continue;
+            }
+            ASSERT_EQ(raw.size(), decoded.size()) << "byte " << i;
+        }
+        string decoded;
+        ASSERT_THROW(codec.decode(decoded, encoded.substr(0, encoded.size() / 2)), CodecException);
+    }
+
+    std::unique_ptr<CodecIFace> make_huffman_codec(CodecType type) {
+        if (type == CodecType::HUFFMAN) {
+            return std::unique_ptr<CodecIFace>(new HuffmanCodec());
+        }
+        return nullptr;
+    }
+
+    TempDir::TempDir(const string& prefix) {
+        string pattern = "/tmp/" + prefix + "-XXXXXX";
+        if (!mkdtemp(&pattern[0])) {
+            cthrow("can't create a directory like " << pattern);
+        }
+        dir = pattern;
+    }
+
+    TempDir::~TempDir() {
+        // children first
+        nftw(dir.c_str(), [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); }, 16,
+             FTW_DEPTH | FTW_PHYS);
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <external/gtest/gtest.h>
+#include <library/Synthetic/Synthetic.h>
+#include <library/common/codec.h>
+#include <library/common/frame.h>
+
+#include <memory>
+
+namespace Codecs {
+
+    extern const char* const LOREM_IPSUM;
+
+    StringVector lorem_records();
+
+    void test_roundtrip(const CodecIFace& codec, const string_view& raw);
+
+    void test_simple(CodecIFace& codec);
+
+    // records 0..count-1 of synthetic `kind` text, log-normal sizes around 256 bytes; a longer corpus
+    // of a kind starts with the shorter ones, so records past a sample are new to a model learned on it
+    StringVector test_corpus(TextKind kind, size_t count);
+
+    // encodes `raw` and decodes it with every 7th byte past the first `header` ones flipped in turn:
+    // decode() either throws CodecException or gives as many bytes as the untouched header declares,
+    // and a payload cut in half throws
+    void test_corrupted_payloads(const CodecIFace& codec, const string_view& raw, size_t header);
+
+    // HuffmanCodec for CodecType::HUFFMAN and nothing for the other types, a factory for model stores
+    std::unique_ptr<CodecIFace> make_huffman_codec(CodecType type);
+
+    // a new directory under /tmp, removed with its files when the object goes
+    class TempDir {
+    public:
+        explicit TempDir(const string& prefix);
+
+        TempDir(const TempDir&) = delete;
+        TempDir& operator=(const TempDir&) = delete;
+
+        ~TempDir();
+
+        const string& path() const {
+            return dir;
+        }
+
+        string file(const string& name) const {
+            return dir + "/" + name;
+        }
+
+    private:
+        string dir;
+    };
+
+}
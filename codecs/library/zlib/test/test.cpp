@@ -1,11 +1,67 @@
 #include <library/zlib/zlib.h>
+#include <library/common/frame.h>
 #include <library/tests_common/tests_common.h>
 
+#include <thread>
+
 TEST(ZlibNoDictCodecTest, Works) {
     Codecs::ZlibNoDictCodec codec;
     Codecs::test_simple(codec);
 };
 
+TEST(ZlibDictCodecTest, Works) {
+    Codecs::ZlibDictCodec codec;
+    Codecs::test_simple(codec);
+    ASSERT_FALSE(codec.dictionary().empty());
+    ASSERT_LE(codec.dictionary().size(), Codecs::ZlibDictCodec::MAX_DICT_SIZE);
+};
+
+TEST(ZlibDictCodecTest, DictionaryHelpsSmallRecords) {
+    Codecs::ZlibDictCodec dict_codec(9);
+    Codecs::ZlibNoDictCodec plain_codec;
+    dict_codec.learn({Codecs::LOREM_IPSUM});
+
+    std::string raw = "Duis aute irure dolor in reprehenderit in voluptate velit esse cillum dolore";
+    std::string with_dict, without_dict;
+    dict_codec.encode(with_dict, raw);
+    plain_codec.encode(without_dict, raw);
+    ASSERT_LT(with_dict.size(), without_dict.size());
+    Codecs::test_roundtrip(dict_codec, raw);
+};
+
+TEST(ZlibDictCodecTest, StreamsArePerThread) {
+    Codecs::ZlibDictCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&codec]() {
+            for (const auto& record : Codecs::lorem_records()) {
+                for (int i = 0; i < 50; ++i) {
+                    Codecs::test_roundtrip(codec, record);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+};
+
+TEST(ZlibDictCodecTest, RejectsCorruptedInput) {
+    Codecs::ZlibDictCodec codec;
+    codec.learn({Codecs::LOREM_IPSUM});
+    std::string encoded, decoded;
+    codec.encode(encoded, Codecs::LOREM_IPSUM);
+    encoded.resize(encoded.size() / 2);
+    ASSERT_THROW(codec.decode(decoded, encoded), Codecs::CodecException);
+
+    // a size no stream of this length inflates to is rejected before anything is allocated
+    std::string huge;
+    Codecs::write_varint(huge, uint64_t(1) << 62);
+    huge += encoded.substr(2);
+    ASSERT_THROW(codec.decode(decoded, huge), Codecs::CodecException);
+};
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
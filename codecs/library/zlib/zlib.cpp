@@ -1,53 +1,239 @@
 #include "zlib.h"
 
+#include <library/Bor/Bor.h>
+#include <library/common/frame.h>
+#include <library/common/inspect.h>
+
 #include <external/zlib/zlib.h>
 
+#include <algorithm>
+#include <climits>
+#include <unordered_set>
+
 namespace Codecs {
 
-    void ZlibNoDictCodec::encode(string& encoded, const string_view& raw) const {
+    namespace {
+
+        const int WINDOW_BITS = -15; // raw deflate: no zlib header and no adler32 trailer
+        const int MEM_LEVEL = 8;
+        // deflate never writes more than this many output bytes per input byte, see zlib's FAQ
+        const uint64_t MAX_EXPANSION = 1032;
+        // z_stream counts in uInt, longer buffers go through in pieces
+        const size_t MAX_CHUNK = UINT_MAX;
+
+        class DeflateStream {
+            z_stream strm;
+            bool initialized = false;
+
+        public:
+            z_stream& get(int level) {
+                if (!initialized) {
+                    strm = z_stream();
+                    if (Z_OK != deflateInit2(&strm, level, Z_DEFLATED, WINDOW_BITS, MEM_LEVEL, Z_DEFAULT_STRATEGY)) {
+                        cthrow("deflateInit2 failed");
+                    }
+                    initialized = true;
+                } else if (Z_OK != deflateReset(&strm)) {
+                    cthrow("deflateReset failed");
+                }
+                return strm;
+            }
+
+            ~DeflateStream() {
+                if (initialized) {
+                    deflateEnd(&strm);
+                }
+            }
+        };
+
+        class InflateStream {
+            z_stream strm;
+            bool initialized = false;
+
+        public:
+            z_stream& get() {
+                if (!initialized) {
+                    strm = z_stream();
+                    if (Z_OK != inflateInit2(&strm, WINDOW_BITS)) {
+                        cthrow("inflateInit2 failed");
+                    }
+                    initialized = true;
+                } else if (Z_OK != inflateReset(&strm)) {
+                    cthrow("inflateReset failed");
+                }
+                return strm;
+            }
+
+            ~InflateStream() {
+                if (initialized) {
+                    inflateEnd(&strm);
+                }
+            }
+        };
+
+        // one deflater per compression level, since changing the level of a live stream is not free
+        thread_local DeflateStream deflaters[Z_BEST_COMPRESSION + 1];
+        thread_local InflateStream inflater;
+    }
+
+    const size_t ZlibDictCodec::WINDOW_SIZE;
+    const size_t ZlibDictCodec::MAX_DICT_SIZE;
+    const size_t ZlibDictCodec::MIN_ENTRY_SIZE;
+
+    ZlibDictCodec::ZlibDictCodec(int level)
+        : level(level < Z_NO_COMPRESSION || level > Z_BEST_COMPRESSION ? 6 : level)
+    {}
+
+    void ZlibDictCodec::encode(string& encoded, const string_view& raw) const {
         encoded.clear();
-        size_t raw_size = raw.size();
+        write_varint(encoded, raw.size());
 
-        while (raw_size) {
-            encoded.push_back((char)((raw_size > 0x7F ? 0x80 : 0) | (raw_size & 0x7F)));
-            raw_size >>= 7;
+        z_stream& strm = deflaters[level].get(level);
+        if (!dict.empty() &&
+            Z_OK != deflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dict.data()), dict.size())) {
+            cthrow("deflateSetDictionary failed");
         }
 
-        size_t res_size_max = compressBound(raw.size());
-        size_t old_res_size = encoded.size();
-        encoded.resize(old_res_size + res_size_max);
-        uLongf destLen = 0;
+        size_t header_size = encoded.size();
+        encoded.resize(header_size + deflateBound(&strm, raw.size()));
+        const Bytef* in = reinterpret_cast<const Bytef*>(raw.data());
+        size_t in_left = raw.size();
+        Bytef* out = reinterpret_cast<Bytef*>(&encoded[header_size]);
+        size_t out_left = encoded.size() - header_size;
+        size_t written = 0;
+        int res = Z_OK;
+        while (res == Z_OK) {
+            strm.next_in = const_cast<Bytef*>(in);
+            strm.avail_in = std::min(in_left, MAX_CHUNK);
+            strm.next_out = out;
+            strm.avail_out = std::min(out_left, MAX_CHUNK);
+            uInt given_in = strm.avail_in;
+            uInt given_out = strm.avail_out;
+            res = deflate(&strm, in_left > given_in ? Z_NO_FLUSH : Z_FINISH);
+            in += given_in - strm.avail_in;
+            in_left -= given_in - strm.avail_in;
+            out += given_out - strm.avail_out;
+            out_left -= given_out - strm.avail_out;
+            written += given_out - strm.avail_out;
+        }
+        if (Z_STREAM_END != res) {
+            cthrow("badly encoded: res=" << res);
+        }
+        encoded.resize(header_size + written);
+    }
 
-        int res = compress((Bytef*)&*(encoded.begin() + old_res_size), &destLen, (const Bytef *) &*raw.begin(), raw.size());
+    void ZlibDictCodec::decode(string& raw, const string_view& encoded) const {
+        uint64_t raw_size;
+        size_t offset = read_varint(raw_size, encoded);
 
-        if (Z_OK != res) {
-            cthrow("badly encoded: res=" << res);
+        z_stream& strm = inflater.get();
+        if (!dict.empty() &&
+            Z_OK != inflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dict.data()), dict.size())) {
+            cthrow("inflateSetDictionary failed");
         }
 
-        encoded.resize(destLen + old_res_size);
+        // the size comes from the payload, it can't be more than the stream can inflate to
+        if (raw_size > (encoded.size() - offset) * MAX_EXPANSION) {
+            cthrow("corrupted zlib payload, size " << raw_size);
+        }
+        raw.resize(raw_size);
+        const Bytef* in = reinterpret_cast<const Bytef*>(encoded.data() + offset);
+        size_t in_left = encoded.size() - offset;
+        Bytef* out = reinterpret_cast<Bytef*>(&raw[0]);
+        size_t out_left = raw_size;
+        int res = Z_OK;
+        while (res == Z_OK) {
+            strm.next_in = const_cast<Bytef*>(in);
+            strm.avail_in = std::min(in_left, MAX_CHUNK);
+            strm.next_out = out;
+            strm.avail_out = std::min(out_left, MAX_CHUNK);
+            uInt given_in = strm.avail_in;
+            uInt given_out = strm.avail_out;
+            res = inflate(&strm, Z_NO_FLUSH);
+            in += given_in - strm.avail_in;
+            in_left -= given_in - strm.avail_in;
+            out += given_out - strm.avail_out;
+            out_left -= given_out - strm.avail_out;
+            // no progress: the input ended early or the output is full before the stream end
+            if (res == Z_OK && given_in == strm.avail_in && given_out == strm.avail_out) {
+                break;
+            }
+        }
+        if (Z_STREAM_END != res || out_left) {
+            cthrow("badly decoded: res=" << res);
+        }
+    }
+
+    string ZlibDictCodec::save() const {
+        return dict;
+    }
+
+    void ZlibDictCodec::load(const string& saved) {
+        if (saved.size() > WINDOW_SIZE) {
+            cthrow("zlib dictionary is too big: " << saved.size());
+        }
+        dict = saved;
+    }
+
+    size_t ZlibDictCodec::sample_bytes() const {
+        return 16 << 20;
     }
 
-    void ZlibNoDictCodec::decode(string& raw, const string_view& encoded) const {
-        raw.clear();
-        size_t res_size_max = 0;
-        const char* enc_beg = encoded.cbegin();
-        const char* enc_end = encoded.cend();
-        while (enc_beg < enc_end) {
-            res_size_max <<= 7;
-            char c = *enc_beg;
-            res_size_max |= (c & 0x7F);
-            enc_beg++;
-            if (!(c & 0x80)) {
+    void ZlibDictCodec::learn(const StringViewVector& samples) {
+        BOR explorer;
+        explorer.learn(samples);
+        std::vector<BOR::dict_entry> stat = explorer.move();
+
+        // a substring saves roughly its own length every time deflate finds it in the dictionary
+        auto score = [](const BOR::dict_entry& entry) {
+            return entry.second * entry.first.size();
+        };
+        stat.erase(std::remove_if(stat.begin(), stat.end(), [](const BOR::dict_entry& entry) {
+            return entry.first.size() < MIN_ENTRY_SIZE || entry.second <= 0;
+        }), stat.end());
+        std::sort(stat.begin(), stat.end(), [&score](const BOR::dict_entry& x, const BOR::dict_entry& y) {
+            return score(x) > score(y);
+        });
+
+        // BOR output is prefix closed, so most candidates are already covered by longer picked ones;
+        // `covered` has every substring of the picked ones which is long enough to be a candidate
+        std::vector<const string*> picked;
+        std::unordered_set<string_view> covered;
+        size_t total = 0;
+        for (const auto& entry : stat) {
+            if (total + entry.first.size() > MAX_DICT_SIZE) {
+                continue;
+            }
+            string_view text(entry.first);
+            if (covered.count(text)) {
+                continue;
+            }
+            picked.push_back(&entry.first);
+            for (size_t begin = 0; begin + MIN_ENTRY_SIZE <= text.size(); ++begin) {
+                for (size_t length = MIN_ENTRY_SIZE; begin + length <= text.size(); ++length) {
+                    covered.insert(text.substr(begin, length));
+                }
+            }
+            total += entry.first.size();
+            if (total + MIN_ENTRY_SIZE > MAX_DICT_SIZE) {
                 break;
             }
         }
 
-        raw.resize(res_size_max);
-        uLongf destLen = 0;
-
-        if (Z_OK != uncompress((Bytef*)&*(raw.begin()), &destLen,
-                               (const Bytef*)enc_beg, enc_end - enc_beg) || destLen != res_size_max) {
-            throw CodecException("badly decoded");
+        dict.clear();
+        dict.reserve(total);
+        for (auto It = picked.rbegin(); It != picked.rend(); ++It) {
+            dict.append(**It);
         }
     }
+
+    void ZlibDictCodec::reset() {
+        dict.clear();
+    }
+
+    bool ZlibDictCodec::inspect(ModelInfo& info) const {
+        // deflate hashes the whole dictionary into its window on every call
+        info.add_structure("dict", dict.size(), heap_bytes(dict), true, true);
+        return true;
+    }
 }
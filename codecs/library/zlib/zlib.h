@@ -4,25 +4,59 @@
 
 namespace Codecs {
 
-    class ZlibNoDictCodec : public CodecIFace {
+    // Raw deflate with a preset dictionary.
+    //
+    // learn() builds up to MAX_DICT_SIZE bytes of dictionary out of the most valuable substrings found
+    // by BOR; the most valuable ones are placed at the end, where match distances are the shortest.
+    // Deflate reaches at most WINDOW_SIZE - 262 bytes back, so a longer dictionary would have a head
+    // no match can use.
+    // Compression state lives in per-thread z_streams which are reset, not reallocated, on every call.
+    class ZlibDictCodec : public CodecIFace {
     public:
+        static const size_t WINDOW_SIZE = 32768;
+        static const size_t MAX_DICT_SIZE = WINDOW_SIZE - 262;
+        static const size_t MIN_ENTRY_SIZE = 3;
+
+        explicit ZlibDictCodec(int level = 6);
+
         void encode(string& encoded, const string_view& raw) const override;
         void decode(string& raw, const string_view& encoded) const override;
 
+        string save() const override;
+
+        void load(const string&) override;
+
+        size_t sample_bytes() const override;
+
+        void learn(const StringViewVector& samples) override;
+
+        void reset() override;
+
+        bool inspect(ModelInfo& info) const override;
+
+        const string& dictionary() const {
+            return dict;
+        }
+
+    protected:
+        int level;
+        string dict;
+    };
+
+    class ZlibNoDictCodec : public ZlibDictCodec {
+    public:
         string save() const override {
             return string();
         }
 
-        void load(const string_view&) override {}
+        void load(const string&) override {}
 
-        size_t sample_size(size_t) const override {
+        size_t sample_bytes() const override {
             return 0;
         }
 
-        void learn(const StringViewVector&) {
+        void learn(const StringViewVector&) override {
         }
-
-        void reset() {}
     };
 
 }
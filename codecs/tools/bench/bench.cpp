@@ -0,0 +1,258 @@
+#include <external/gbench/gbench.h>
+#include <library/Auto/Auto.h>
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/DictSearch/DictSearch.h>
+#include <library/Huffman/Huffman.h>
+#include <library/Lz77/Lz77.h>
+#include <library/Synthetic/Synthetic.h>
+#include <library/WordHuffman/WordHuffman.h>
+#include <library/common/histogram.h>
+#include <library/zlib/zlib.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Every benchmark runs on a corpus generated from a fixed seed, so numbers are comparable between
+// machines and builds. Arguments: record size in bytes (range_x) and training sample size in
+// bytes (range_y), which is what drives the dictionary size of the trained codecs.
+
+namespace {
+
+    const uint32_t CORPUS_SEED = 20160501;
+
+    template <Codecs::TextKind Kind>
+    struct SyntheticText {
+        static const char* name() {
+            return Codecs::text_kind_name(Kind);
+        }
+
+        // records of the sample are log-normally distributed around 1KB, like typical log lines
+        static const Codecs::CorpusGenerator& generator() {
+            static const Codecs::CorpusGenerator generator = [] {
+                Codecs::CorpusGenerator::Options options;
+                options.kind = Kind;
+                options.seed = CORPUS_SEED;
+                options.sizes = Codecs::SizeDistribution::log_normal(1024, 1.0, 16, 64 << 10);
+                return Codecs::CorpusGenerator(options);
+            }();
+            return generator;
+        }
+    };
+
+    using Ascii = SyntheticText<Codecs::TextKind::ASCII>;
+    using Mixed = SyntheticText<Codecs::TextKind::MIXED>;
+    using Json = SyntheticText<Codecs::TextKind::JSON>;
+
+    template <typename Text>
+    const std::string& record(size_t size) {
+        static std::map<size_t, std::string> records;
+        auto It = records.find(size);
+        if (It == records.end()) {
+            It = records.emplace(size, Text::generator().generate(size, CORPUS_SEED + 1)).first;
+        }
+        return It->second;
+    }
+
+    template <typename Text>
+    Codecs::StringViewVector sample(size_t bytes) {
+        static std::map<size_t, std::vector<std::string>> samples;
+        auto It = samples.find(bytes);
+        if (It == samples.end()) {
+            std::vector<std::string> records = Text::generator().records_of_total_size(bytes);
+            It = samples.emplace(bytes, std::move(records)).first;
+        }
+        return Codecs::StringViewVector(It->second.begin(), It->second.end());
+    }
+
+    // training is by far the slowest step, so every (codec, text, sample size) is trained once
+    template <typename Codec, typename Text>
+    const Codec& trained(size_t sample_bytes) {
+        static std::map<size_t, std::unique_ptr<Codec>> codecs;
+        auto It = codecs.find(sample_bytes);
+        if (It == codecs.end()) {
+            std::unique_ptr<Codec> codec(new Codec());
+            codec->learn(sample<Text>(sample_bytes));
+            It = codecs.emplace(sample_bytes, std::move(codec)).first;
+        }
+        return *It->second;
+    }
+
+    template <typename Codec, typename Text>
+    void BM_Learn(benchmark::State& state) {
+        Codecs::StringViewVector data = sample<Text>(state.range_x());
+        Codec codec;
+        while (state.KeepRunning()) {
+            codec.reset();
+            codec.learn(data);
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range_x());
+        state.SetLabel(std::string(Text::name()) + " model:" + std::to_string(codec.save().size()));
+    }
+
+    template <typename Codec, typename Text>
+    void BM_Load(benchmark::State& state) {
+        std::string saved = trained<Codec, Text>(state.range_x()).save();
+        Codec codec;
+        while (state.KeepRunning()) {
+            codec.reset();
+            codec.load(saved);
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * saved.size());
+        state.SetLabel(std::string(Text::name()) + " model:" + std::to_string(saved.size()));
+    }
+
+    template <typename Codec, typename Text>
+    void BM_Encode(benchmark::State& state) {
+        const Codec& codec = trained<Codec, Text>(state.range_y());
+        const std::string& raw = record<Text>(state.range_x());
+        std::string encoded;
+        while (state.KeepRunning()) {
+            codec.encode(encoded, raw);
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * raw.size());
+        state.SetLabel(std::string(Text::name()) + " ratio:" +
+                       std::to_string(static_cast<double>(encoded.size()) / std::max<size_t>(raw.size(), 1)));
+    }
+
+    template <typename Codec, typename Text>
+    void BM_Decode(benchmark::State& state) {
+        const Codec& codec = trained<Codec, Text>(state.range_y());
+        const std::string& raw = record<Text>(state.range_x());
+        std::string encoded, decoded;
+        codec.encode(encoded, raw);
+        while (state.KeepRunning()) {
+            decoded.clear();
+            codec.decode(decoded, encoded);
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * raw.size());
+        state.SetLabel(std::string(Text::name()) + (decoded == raw ? "" : " DECODED INCORRECTLY"));
+    }
+
+    // a phrase from the middle of the record; range_x: record size, range_y: sample size
+    std::string search_pattern(const std::string& raw) {
+        return raw.substr(raw.size() / 2, std::min<size_t>(raw.size() / 2, 12));
+    }
+
+    // scans the payload with a compiled pattern, compare with BM_DecodeAndFind
+    template <typename Text>
+    void BM_Search(benchmark::State& state) {
+        const auto& codec = trained<Codecs::DictHuffmanCodec, Text>(state.range_y());
+        const std::string& raw = record<Text>(state.range_x());
+        std::string encoded;
+        codec.encode(encoded, raw);
+        Codecs::DictHuffmanSearch search(codec, search_pattern(raw));
+        std::vector<uint64_t> found;
+        while (state.KeepRunning()) {
+            found.clear();
+            search.find(encoded, found);
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * raw.size());
+        state.SetLabel(std::string(Text::name()) + " found:" + std::to_string(found.size()));
+    }
+
+    template <typename Text>
+    void BM_DecodeAndFind(benchmark::State& state) {
+        const auto& codec = trained<Codecs::DictHuffmanCodec, Text>(state.range_y());
+        const std::string& raw = record<Text>(state.range_x());
+        std::string encoded, decoded;
+        codec.encode(encoded, raw);
+        std::string pattern = search_pattern(raw);
+        std::vector<uint64_t> found;
+        while (state.KeepRunning()) {
+            found.clear();
+            decoded.clear();
+            codec.decode(decoded, encoded);
+            for (size_t pos = decoded.find(pattern); pos != std::string::npos; pos = decoded.find(pattern, pos + 1)) {
+                found.push_back(pos);
+            }
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * raw.size());
+        state.SetLabel(std::string(Text::name()) + " found:" + std::to_string(found.size()));
+    }
+
+    void SampleSizes(benchmark::internal::Benchmark* b) {
+        for (int bytes : {16 << 10, 128 << 10, 512 << 10}) {
+            b->Arg(bytes);
+        }
+    }
+
+    void RecordAndSampleSizes(benchmark::internal::Benchmark* b) {
+        for (int record = 64; record <= (8 << 20); record *= 8) {
+            for (int bytes : {16 << 10, 512 << 10}) {
+                b->ArgPair(record, bytes);
+            }
+        }
+        b->ArgPair(8 << 20, 128 << 10);
+    }
+
+    // range_x: buffer size, range_y: threads, the buffer is one record so it has to be split
+    void BM_CountBytes(benchmark::State& state) {
+        const std::string& data = record<Mixed>(state.range_x());
+        Codecs::StringViewVector records(1, data);
+        uint64_t counts[256] = {0};
+        while (state.KeepRunning()) {
+            Codecs::count_bytes(records, counts, state.range_y());
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * data.size());
+    }
+
+    // the single histogram loop count_bytes replaces, for comparison
+    void BM_CountBytesScalar(benchmark::State& state) {
+        const std::string& data = record<Mixed>(state.range_x());
+        std::vector<unsigned long long> counts(256, 0);
+        while (state.KeepRunning()) {
+            for (char c : data) {
+                counts[static_cast<unsigned char>(c)] += 1;
+            }
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * data.size());
+        state.SetLabel(std::to_string(counts[' ']));
+    }
+
+    void HistogramSizes(benchmark::internal::Benchmark* b) {
+        for (int size : {64 << 10, 8 << 20, 64 << 20}) {
+            for (int threads : {1, 4}) {
+                b->ArgPair(size, threads);
+            }
+        }
+    }
+
+}
+
+BENCHMARK(BM_CountBytes)->Apply(HistogramSizes);
+BENCHMARK(BM_CountBytesScalar)->Arg(64 << 10)->Arg(8 << 20);
+
+#define CODEC_BENCHMARKS(Codec, Text)                                         \
+    BENCHMARK_TEMPLATE2(BM_Learn, Codec, Text)->Apply(SampleSizes);           \
+    BENCHMARK_TEMPLATE2(BM_Load, Codec, Text)->Apply(SampleSizes);            \
+    BENCHMARK_TEMPLATE2(BM_Encode, Codec, Text)->Apply(RecordAndSampleSizes); \
+    BENCHMARK_TEMPLATE2(BM_Decode, Codec, Text)->Apply(RecordAndSampleSizes);
+
+CODEC_BENCHMARKS(Codecs::HuffmanCodec, Ascii)
+CODEC_BENCHMARKS(Codecs::HuffmanCodec, Mixed)
+CODEC_BENCHMARKS(Codecs::HuffmanCodec, Json)
+CODEC_BENCHMARKS(Codecs::DictHuffmanCodec, Ascii)
+CODEC_BENCHMARKS(Codecs::DictHuffmanCodec, Mixed)
+CODEC_BENCHMARKS(Codecs::DictHuffmanCodec, Json)
+BENCHMARK_TEMPLATE(BM_Search, Ascii)->Apply(RecordAndSampleSizes);
+BENCHMARK_TEMPLATE(BM_DecodeAndFind, Ascii)->Apply(RecordAndSampleSizes);
+BENCHMARK_TEMPLATE(BM_Search, Json)->Apply(RecordAndSampleSizes);
+BENCHMARK_TEMPLATE(BM_DecodeAndFind, Json)->Apply(RecordAndSampleSizes);
+CODEC_BENCHMARKS(Codecs::ZlibDictCodec, Ascii)
+CODEC_BENCHMARKS(Codecs::ZlibDictCodec, Mixed)
+CODEC_BENCHMARKS(Codecs::ZlibDictCodec, Json)
+CODEC_BENCHMARKS(Codecs::Lz77Codec, Ascii)
+CODEC_BENCHMARKS(Codecs::Lz77Codec, Mixed)
+CODEC_BENCHMARKS(Codecs::Lz77Codec, Json)
+CODEC_BENCHMARKS(Codecs::WordHuffmanCodec, Ascii)
+CODEC_BENCHMARKS(Codecs::WordHuffmanCodec, Mixed)
+CODEC_BENCHMARKS(Codecs::WordHuffmanCodec, Json)
+CODEC_BENCHMARKS(Codecs::AutoCodec, Ascii)
+CODEC_BENCHMARKS(Codecs::AutoCodec, Mixed)
+CODEC_BENCHMARKS(Codecs::AutoCodec, Json)
+
+BENCHMARK_MAIN()
@@ -0,0 +1,114 @@
+#include <external/optionparser/optionparser.h>
+#include <library/Synthetic/Synthetic.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+enum optionIndex {
+    UNKNOWN, HELP, KIND, SEED, RECORDS, BYTES, SIZES, INPUT_TYPE, OUTPUT
+};
+const option::Descriptor usage[] =
+        {
+                {UNKNOWN,    0, "",  "",        option::Arg::None,     ""},
+                {HELP,       0, "h", "help",    option::Arg::None,     ""},
+                {KIND,       0, "",  "kind",    option::Arg::Optional, ""},
+                {SEED,       0, "",  "seed",    option::Arg::Optional, ""},
+                {RECORDS,    0, "",  "records", option::Arg::Optional, ""},
+                {BYTES,      0, "",  "bytes",   option::Arg::Optional, ""},
+                {SIZES,      0, "",  "sizes",   option::Arg::Optional, ""},
+                {INPUT_TYPE, 0, "t", "",        option::Arg::Optional, ""},
+                {OUTPUT,     0, "o", "output",  option::Arg::Optional, ""},
+                {0,          0, 0,   0,         0,                     0}
+        };
+
+int main(int argc, char *argv[]) {
+    argc -= (argc > 0);
+    argv += (argc > 0); // skip program name argv[0] if present
+    option::Stats stats(usage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, argc, argv, options, buffer);
+
+    if (parse.error())
+        return 1;
+
+    if (options[UNKNOWN]) {
+        std::cerr << "Unknown option '" << options[UNKNOWN].name << "' use --help for help.\n";
+        return 1;
+    }
+    if (options[HELP] || !options[OUTPUT] || options[OUTPUT].arg == nullptr) {
+        std::cout << "USAGE: ./codecs-corpusgen --output=test.txt [options]\n"
+                "Writes a synthetic corpus. The same options always give the same file.\n"
+                "Options:\n-h, --help\n\t\tThis help page\n\n"
+                "-o, --output=<path>\n\t\tFile to write, '-' for the standard output\n\n"
+                "--kind=ascii|cyrillic|cjk|mixed|json|binary\n\t\tContent of the records, ascii by default\n\n"
+                "--seed=<number>\n\t\tSeed of the corpus, 1 by default\n\n"
+                "--records=<number>\n\t\tNumber of records, 10000 by default\n\n"
+                "--bytes=<number>\n\t\tWrite records until they reach <number> bytes instead of a fixed count\n\n"
+                "--sizes=<distribution>\n\t\tRecord sizes: fixed:N, uniform:MIN:MAX or lognormal:MEDIAN:SIGMA[:MIN:MAX],\n"
+                "\t\tlognormal:1024:1:16:1048576 by default\n\n"
+                "-t\n\t\tType of file encoding. use -tLE to write 'LE uint32 size + entry' records instead of lines\n";
+        return options[HELP] ? 0 : 1;
+    }
+
+    Codecs::CorpusGenerator::Options generator_options;
+    if (options[KIND] && options[KIND].arg != nullptr &&
+            !Codecs::parse_text_kind(options[KIND].arg, generator_options.kind)) {
+        std::cerr << "Unknown kind '" << options[KIND].arg << "' use --help for the list of kinds.\n";
+        return 1;
+    }
+
+    Codecs::CorpusFormat format = Codecs::CorpusFormat::LINES;
+    if (options[INPUT_TYPE].arg != nullptr && std::string(options[INPUT_TYPE].arg) == "LE") {
+        format = Codecs::CorpusFormat::LE_UINT32;
+    }
+    // binary records may contain line breaks only when they are not split by lines
+    generator_options.line_safe = format == Codecs::CorpusFormat::LINES;
+
+    uint64_t records_number = 10000;
+    uint64_t bytes = 0;
+    try {
+        if (options[SEED].arg != nullptr) {
+            generator_options.seed = std::stoull(options[SEED].arg);
+        }
+        if (options[RECORDS].arg != nullptr) {
+            records_number = std::stoull(options[RECORDS].arg);
+        }
+        if (options[BYTES].arg != nullptr) {
+            bytes = std::stoull(options[BYTES].arg);
+        }
+        generator_options.sizes = options[SIZES].arg != nullptr
+                                  ? Codecs::SizeDistribution::parse(options[SIZES].arg)
+                                  : Codecs::SizeDistribution::log_normal(1024, 1.0, 16, 1 << 20);
+    } catch (const std::exception &e) {
+        std::cerr << "Bad option value: " << e.what() << '\n';
+        return 1;
+    }
+
+    std::ofstream file;
+    std::string path = options[OUTPUT].arg;
+    if (path != "-") {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Can't write to " << path << '\n';
+            return 1;
+        }
+    }
+    std::ostream &out = path == "-" ? std::cout : file;
+
+    Codecs::CorpusGenerator generator(generator_options);
+    uint64_t written = 0, records = 0;
+    while (bytes ? written < bytes : records < records_number) {
+        std::string record = generator.record(records++);
+        Codecs::write_record(out, record, format);
+        written += std::max<size_t>(record.size(), 1);
+    }
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed to write " << path << '\n';
+        return 1;
+    }
+    std::cerr << "Wrote " << records << " " << Codecs::text_kind_name(generator_options.kind) << " records, "
+              << written << " bytes\n";
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <external/optionparser/optionparser.h>
+#include <library/DictHuffman/DictHuffman.h>
+#include <library/Embedded/generate.h>
+#include <library/common/frame.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+enum optionIndex {
+    UNKNOWN, HELP, MODEL, NAME, OUTPUT
+};
+const option::Descriptor usage[] =
+        {
+                {UNKNOWN, 0, "",  "",       option::Arg::None,     ""},
+                {HELP,    0, "h", "help",   option::Arg::None,     ""},
+                {MODEL,   0, "",  "model",  option::Arg::Optional, ""},
+                {NAME,    0, "",  "name",   option::Arg::Optional, ""},
+                {OUTPUT,  0, "",  "output", option::Arg::Optional, ""},
+                {0,       0, 0,   0,        0,                     0}
+        };
+
+int main(int argc, char *argv[]) {
+    argc -= (argc > 0);
+    argv += (argc > 0); // skip program name argv[0] if present
+    option::Stats stats(usage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, argc, argv, options, buffer);
+
+    if (parse.error())
+        return 1;
+
+    if (options[UNKNOWN]) {
+        std::cerr << "Unknown option '" << options[UNKNOWN].name << "' use --help for help.\n";
+        return 1;
+    }
+    if (options[HELP] || !options[MODEL].arg || !options[NAME].arg || !options[OUTPUT].arg) {
+        std::cout << "USAGE: ./codecs-embed --model=model.bin --name=MyModel --output=<dir>\n"
+                "Compiles a DictHuffman model into <dir>/MyModel.h and <dir>/MyModel.cpp: static tables and\n"
+                "MyModelCodec, an EmbeddedDictHuffmanCodec which needs no load(). See TARGET_EMBEDDED_MODEL\n"
+                "in cmake/common.cmake for the build step.\n"
+                "Options:\n-h, --help\n\t\tThis help page\n\n"
+                "--model=<path>\n\t\tThe model, as written by ModelCache or the tester's --save-models\n\n"
+                "--name=<identifier>\n\t\tName of the generated struct\n\n"
+                "--output=<dir>\n\t\tDirectory for the generated files\n";
+        return options[HELP] ? 0 : 1;
+    }
+
+    std::ifstream in(options[MODEL].arg, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Can't open " << options[MODEL].arg << '\n';
+        return 1;
+    }
+    std::string model((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (model.empty() || static_cast<Codecs::CodecType>(static_cast<uint8_t>(model[0])) != Codecs::CodecType::DICT_HUFFMAN) {
+        std::cerr << options[MODEL].arg << " is not a dict-huffman model\n";
+        return 1;
+    }
+
+    std::string name = options[NAME].arg;
+    std::string header_path = std::string(options[OUTPUT].arg) + "/" + name + ".h";
+    std::string source_path = std::string(options[OUTPUT].arg) + "/" + name + ".cpp";
+    try {
+        Codecs::DictHuffmanCodec codec;
+        codec.load(model.substr(1));
+        std::ofstream header(header_path, std::ios::trunc);
+        std::ofstream source(source_path, std::ios::trunc);
+        Codecs::write_embedded_model(codec, name, name + ".h", header, source);
+        if (!header.good() || !source.good()) {
+            std::cerr << "Can't write " << header_path << " and " << source_path << '\n';
+            return 1;
+        }
+    } catch (const Codecs::CodecException &e) {
+        std::cerr << "Can't compile the model: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <external/optionparser/optionparser.h>
+#include <library/Corpus/Corpus.h>
+#include <library/Registry/Registry.h>
+#include <library/common/inspect.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+enum optionIndex {
+    UNKNOWN, HELP, MODEL, CODEC, INPUT_FILE, INPUT_TYPE, ENTRIES, SORT
+};
+const option::Descriptor usage[] =
+        {
+                {UNKNOWN,    0, "",  "",          option::Arg::None,     ""},
+                {HELP,       0, "h", "help",      option::Arg::None,     ""},
+                {MODEL,      0, "",  "model",     option::Arg::Optional, ""},
+                {CODEC,      0, "",  "codec",     option::Arg::Optional, ""},
+                {INPUT_FILE, 0, "",  "test-file", option::Arg::Optional, ""},
+                {INPUT_TYPE, 0, "t", "",          option::Arg::Optional, ""},
+                {ENTRIES,    0, "",  "entries",   option::Arg::Optional, ""},
+                {SORT,       0, "",  "sort",      option::Arg::Optional, ""},
+                {0,          0, 0,   0,           0,                     0}
+        };
+
+// the smallest data cache level the structures fit in
+void print_cache_fit(const char *side, size_t bytes) {
+    std::cout << side << " path: " << bytes << " bytes, ";
+    const std::pair<const char *, long> levels[] = {
+            {"L1", sysconf(_SC_LEVEL1_DCACHE_SIZE)},
+            {"L2", sysconf(_SC_LEVEL2_CACHE_SIZE)},
+            {"L3", sysconf(_SC_LEVEL3_CACHE_SIZE)}};
+    for (const auto &level : levels) {
+        if (level.second > 0 && bytes <= static_cast<size_t>(level.second)) {
+            std::cout << "fits " << level.first << " (" << level.second << " bytes)\n";
+            return;
+        }
+    }
+    std::cout << "does not fit the data caches\n";
+}
+
+int main(int argc, char *argv[]) {
+    argc -= (argc > 0);
+    argv += (argc > 0); // skip program name argv[0] if present
+    option::Stats stats(usage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, argc, argv, options, buffer);
+
+    if (parse.error())
+        return 1;
+
+    auto &registry = Codecs::CodecRegistry::instance();
+
+    if (options[UNKNOWN]) {
+        std::cerr << "Unknown option '" << options[UNKNOWN].name << "' use --help for help.\n";
+        return 1;
+    }
+    if (options[HELP] || !options[MODEL] || options[MODEL].arg == nullptr) {
+        std::cout << "USAGE: ./codecs-inspect --model=model.bin [options]\n"
+                "Loads a saved model and reports its memory footprint, codes and dictionary.\n"
+                "Options:\n-h, --help\n\t\tThis help page\n\n"
+                "--model=<path>\n\t\tThe model, as written by ModelCache or the tester's --save-models:\n"
+                "\t\tthe codec type byte followed by the saved model\n\n"
+                "--codec=<name>\n\t\tThe file holds only the output of save() of this codec. Known codecs:";
+        for (const auto &name : registry.names()) {
+            std::cout << ' ' << name;
+        }
+        std::cout << "\n\n--test-file=<path>\n\t\tAlso report bits per byte the model spends on the records of the file\n\n"
+                "-t\n\t\tType of file encoding. use -tLE if data file's entry looks like 'LE uint32 size + entry'\n\n"
+                "--entries=<number>\n\t\tNumber of dictionary entries to list, 20 by default\n\n"
+                "--sort=frequency|length\n\t\tOrder of the listed entries, frequency by default\n";
+        return options[HELP] ? 0 : 1;
+    }
+
+    std::ifstream in(options[MODEL].arg, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Can't open " << options[MODEL].arg << '\n';
+        return 1;
+    }
+    std::string model((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::string codec_name;
+    try {
+        if (options[CODEC] && options[CODEC].arg != nullptr) {
+            codec_name = options[CODEC].arg;
+        } else if (!model.empty()) {
+            codec_name = registry.name_of(static_cast<Codecs::CodecType>(static_cast<uint8_t>(model[0])));
+            model.erase(0, 1);
+        } else {
+            std::cerr << "The model file is empty\n";
+            return 1;
+        }
+    } catch (const Codecs::CodecException &e) {
+        std::cerr << "Can't tell the codec of the model, use --codec: " << e.what() << '\n';
+        return 1;
+    }
+    if (!registry.contains(codec_name)) {
+        std::cerr << "Unknown codec '" << codec_name << "' use --help for the list of codecs.\n";
+        return 1;
+    }
+
+    size_t top_entries = 20;
+    Codecs::ModelInfo::EntryOrder order = Codecs::ModelInfo::EntryOrder::FREQUENCY;
+    if (options[ENTRIES].arg != nullptr) {
+        top_entries = std::stoul(options[ENTRIES].arg);
+    }
+    if (options[SORT].arg != nullptr) {
+        std::string sort = options[SORT].arg;
+        if (sort == "length") {
+            order = Codecs::ModelInfo::EntryOrder::LENGTH;
+        } else if (sort != "frequency") {
+            std::cerr << "Unknown order '" << sort << "', use frequency or length.\n";
+            return 1;
+        }
+    }
+
+    std::unique_ptr<Codecs::CodecIFace> codec = registry.create(codec_name);
+    try {
+        codec->load(model);
+    } catch (const Codecs::CodecException &e) {
+        std::cerr << "Can't load the model: " << e.what() << '\n';
+        return 1;
+    }
+
+    std::cout << "Codec: " << codec_name << "\nSaved model: " << model.size() << " bytes\n\n";
+    Codecs::ModelInfo info;
+    if (codec->inspect(info)) {
+        info.dump(std::cout, top_entries, order);
+        std::cout << '\n';
+        print_cache_fit("Encode", info.encode_path_bytes());
+        print_cache_fit("Decode", info.decode_path_bytes());
+    } else {
+        std::cout << "The codec does not describe its model\n";
+    }
+
+    if (options[INPUT_FILE] && options[INPUT_FILE].arg != nullptr) {
+        bool LE_encoding = options[INPUT_TYPE].arg != nullptr && std::string(options[INPUT_TYPE].arg) == "LE";
+        try {
+            Codecs::Corpus corpus(options[INPUT_FILE].arg,
+                                  LE_encoding ? Codecs::CorpusFormat::LE_UINT32 : Codecs::CorpusFormat::LINES,
+                                  std::max(1u, std::thread::hardware_concurrency()));
+            double bits = Codecs::bits_per_byte(*codec, corpus.records());
+            std::cout << "\nOn " << corpus.size() << " records of " << options[INPUT_FILE].arg << ": "
+                      << bits << " bits per byte, ratio " << bits / 8 << '\n';
+        } catch (const Codecs::CodecException &e) {
+            std::cerr << "Can't read the file " << options[INPUT_FILE].arg << ": " << e.what() << '\n';
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,372 @@
+#include <external/optionparser/optionparser.h>
+#include <library/Archive/Archive.h>
+#include <library/Corpus/Corpus.h>
+#include <library/Registry/Registry.h>
+#include <library/common/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// for cthrow
+using Codecs::CodecException;
+
+enum optionIndex {
+    UNKNOWN, HELP, MODEL, INPUT_FILE, INPUT_TYPE, OUTPUT, UNPACK, THREADS, QUEUE, BATCH
+};
+const option::Descriptor usage[] =
+        {
+                {UNKNOWN,    0, "",  "",        option::Arg::None,     ""},
+                {HELP,       0, "h", "help",    option::Arg::None,     ""},
+                {MODEL,      0, "",  "model",   option::Arg::Optional, ""},
+                {INPUT_FILE, 0, "",  "input",   option::Arg::Optional, ""},
+                {INPUT_TYPE, 0, "t", "",        option::Arg::Optional, ""},
+                {OUTPUT,     0, "",  "output",  option::Arg::Optional, ""},
+                {UNPACK,     0, "u", "unpack",  option::Arg::None,     ""},
+                {THREADS,    0, "",  "threads", option::Arg::Optional, ""},
+                {QUEUE,      0, "",  "queue",   option::Arg::Optional, ""},
+                {BATCH,      0, "",  "batch",   option::Arg::Optional, ""},
+                {0,          0, 0,   0,         0,                     0}
+        };
+
+struct PipelineStats {
+    double seconds;
+    // the reader waited for a free worker queue, i.e. the workers are the bottleneck
+    uint64_t submit_stalls;
+    double submit_stall_seconds;
+    // the reader waited for the writer to free a batch of the window, i.e. the output is the bottleneck
+    uint64_t window_stalls;
+    double window_stall_seconds;
+    // the writer waited for the next batch in order
+    uint64_t writer_stalls;
+    double writer_stall_seconds;
+    uint64_t steals;
+};
+
+// Runs `work(batch, output)` for batches 0..batches-1 on the pool and `write(batch, output)` on a
+// writer thread in batch order. At most `window` batches are between the reader and the writer,
+// which bounds the memory a slow disk or a slow batch can pile up.
+template <typename Work, typename Write>
+PipelineStats run_ordered(Codecs::WorkStealingPool &pool, size_t batches, size_t window, Work work, Write write) {
+    struct Slot {
+        std::vector<std::string> output;
+        bool done = false;
+    };
+    std::vector<Slot> slots(window);
+    std::mutex lock;
+    std::condition_variable batch_done;
+    std::condition_variable batch_written;
+    size_t written = 0;
+    bool failed = false;
+    std::exception_ptr error;
+    PipelineStats stats = PipelineStats();
+    Codecs::WorkStealingPool::Stats pool_before = pool.stats();
+
+    auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto fail = [&](std::exception_ptr thrown) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!failed) {
+            failed = true;
+            error = thrown;
+        }
+        batch_done.notify_all();
+        batch_written.notify_all();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer([&]() {
+        try {
+            for (size_t batch = 0; batch < batches; ++batch) {
+                Slot &slot = slots[batch % window];
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    if (!slot.done && !failed) {
+                        auto wait_start = std::chrono::steady_clock::now();
+                        batch_done.wait(guard, [&]() { return slot.done || failed; });
+                        ++stats.writer_stalls;
+                        stats.writer_stall_seconds += seconds_since(wait_start);
+                    }
+                    if (failed) {
+                        return;
+                    }
+                }
+                write(batch, slot.output);
+                std::lock_guard<std::mutex> guard(lock);
+                slot.output.clear();
+                slot.done = false;
+                ++written;
+                batch_written.notify_one();
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    for (size_t batch = 0; batch < batches; ++batch) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (batch - written >= window && !failed) {
+                auto wait_start = std::chrono::steady_clock::now();
+                batch_written.wait(guard, [&]() { return batch - written < window || failed; });
+                ++stats.window_stalls;
+                stats.window_stall_seconds += seconds_since(wait_start);
+            }
+            if (failed) {
+                break;
+            }
+        }
+        pool.submit([&, batch]() {
+            Slot &slot = slots[batch % window];
+            try {
+                work(batch, slot.output);
+            } catch (...) {
+                fail(std::current_exception());
+                return;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            slot.done = true;
+            batch_done.notify_one();
+        });
+    }
+    pool.wait();
+    writer.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    stats.seconds = seconds_since(start);
+    Codecs::WorkStealingPool::Stats pool_after = pool.stats();
+    stats.submit_stalls = pool_after.submit_stalls - pool_before.submit_stalls;
+    stats.submit_stall_seconds = pool_after.submit_stall_seconds - pool_before.submit_stall_seconds;
+    stats.steals = pool_after.steals - pool_before.steals;
+    return stats;
+}
+
+// batch boundaries of about `batch_bytes` each, `sizes(i)` is the size of record i
+template <typename Sizes>
+std::vector<size_t> split_batches(size_t records, size_t batch_bytes, Sizes sizes) {
+    std::vector<size_t> bounds{0};
+    size_t bytes = 0;
+    for (size_t i = 0; i < records; ++i) {
+        bytes += sizes(i);
+        if (bytes >= batch_bytes) {
+            bounds.push_back(i + 1);
+            bytes = 0;
+        }
+    }
+    if (bounds.back() != records) {
+        bounds.push_back(records);
+    }
+    return bounds;
+}
+
+// the codec type byte followed by the model, the format of ModelCache and the tester's --save-models;
+// `mode` says which side the codec is built for
+std::unique_ptr<Codecs::CodecIFace> load_model(const std::string &path, Codecs::LoadMode mode,
+                                               Codecs::CodecType &type) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        cthrow("can't open " << path);
+    }
+    std::string model((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (model.empty()) {
+        cthrow("the model file " << path << " is empty");
+    }
+    type = static_cast<Codecs::CodecType>(static_cast<uint8_t>(model[0]));
+    std::unique_ptr<Codecs::CodecIFace> codec = Codecs::CodecRegistry::instance().create(type);
+    codec->set_load_mode(mode);
+    codec->load(model.substr(1));
+    return codec;
+}
+
+double mb_per_second(uint64_t bytes, double seconds) {
+    return seconds > 0 ? (double) bytes / (1 << 20) / seconds : 0.0;
+}
+
+void print_report(const char *mode, size_t records, uint64_t raw, uint64_t packed, size_t threads,
+                  const PipelineStats &stats) {
+    std::cout << mode << ' ' << records << " records, " << raw << " bytes raw, " << packed << " bytes packed, ratio "
+              << (raw ? (double) packed / raw : 0.0) << '\n'
+              << std::fixed << std::setprecision(3)
+              << threads << " threads, " << stats.seconds << " seconds, " << mb_per_second(raw, stats.seconds)
+              << " MB/s raw, " << mb_per_second(packed, stats.seconds) << " MB/s packed\n"
+              << "Queue stalls: reader on full worker queues " << stats.submit_stalls << " ("
+              << stats.submit_stall_seconds << " s), reader on the writer " << stats.window_stalls << " ("
+              << stats.window_stall_seconds << " s), writer on the next batch " << stats.writer_stalls << " ("
+              << stats.writer_stall_seconds << " s), steals " << stats.steals << '\n';
+}
+
+int main(int argc, char *argv[]) {
+    argc -= (argc > 0);
+    argv += (argc > 0); // skip program name argv[0] if present
+    option::Stats stats(usage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, argc, argv, options, buffer);
+
+    if (parse.error())
+        return 1;
+
+    if (options[UNKNOWN]) {
+        std::cerr << "Unknown option '" << options[UNKNOWN].name << "' use --help for help.\n";
+        return 1;
+    }
+    bool unpack = options[UNPACK];
+    if (options[HELP] || !options[INPUT_FILE].arg || !options[OUTPUT].arg || (!unpack && !options[MODEL].arg)) {
+        std::cout << "USAGE: ./codecs-pack --model=model.bin --input=records.txt --output=records.cda [options]\n"
+                "       ./codecs-pack --unpack --input=records.cda --output=records.txt [options]\n"
+                "Encodes the records of a file into an archive with the model embedded, see library/Archive,\n"
+                "or decodes an archive back. Records are encoded in batches on all cores and written in order.\n"
+                "Options:\n-h, --help\n\t\tThis help page\n\n"
+                "--model=<path>\n\t\tThe model, as written by ModelCache or the tester's --save-models.\n"
+                "\t\tWhen unpacking, needed only for archives without an embedded model\n\n"
+                "--input=<path>\n\t\tThe records to pack or the archive to unpack\n\n"
+                "--output=<path>\n\t\tThe archive or the records\n\n"
+                "-t\n\t\tType of the records file. use -tLE if an entry looks like 'LE uint32 size + entry'\n\n"
+                "-u, --unpack\n\t\tDecode an archive\n\n"
+                "--threads=<number>\n\t\tWorker threads, one per core by default\n\n"
+                "--queue=<number>\n\t\tBatches queued a worker, 4 by default\n\n"
+                "--batch=<bytes>\n\t\tRecords are processed in batches of about this size, 1MB by default\n";
+        return options[HELP] ? 0 : 1;
+    }
+
+    bool LE_encoding = options[INPUT_TYPE].arg != nullptr && std::string(options[INPUT_TYPE].arg) == "LE";
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t queue = 4;
+    size_t batch_bytes = 1 << 20;
+    try {
+        if (options[THREADS].arg) {
+            threads = std::stoul(options[THREADS].arg);
+        }
+        if (options[QUEUE].arg) {
+            queue = std::stoul(options[QUEUE].arg);
+        }
+        if (options[BATCH].arg) {
+            batch_bytes = std::stoul(options[BATCH].arg);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Bad option value (" << e.what() << "): --threads, --queue and --batch take a number, "
+                  << "use --help for help.\n";
+        return 1;
+    }
+    threads = std::max<size_t>(threads, 1);
+    queue = std::max<size_t>(queue, 1);
+    // every queued batch and every batch being encoded can be done and waiting for the writer
+    size_t window = threads * (queue + 1);
+
+    try {
+        Codecs::WorkStealingPool pool(threads, queue);
+        if (!unpack) {
+            Codecs::CodecType type;
+            std::unique_ptr<Codecs::CodecIFace> codec = load_model(options[MODEL].arg, Codecs::LoadMode::ENCODE, type);
+            // one sequential pass over the mapping, the kernel reads ahead in large chunks
+            Codecs::Corpus corpus(options[INPUT_FILE].arg,
+                                  LE_encoding ? Codecs::CorpusFormat::LE_UINT32 : Codecs::CorpusFormat::LINES,
+                                  threads);
+            const Codecs::StringViewVector &records = corpus.records();
+            std::vector<size_t> bounds = split_batches(records.size(), batch_bytes,
+                                                       [&](size_t i) { return records[i].size(); });
+
+            Codecs::ArchiveWriter writer(options[OUTPUT].arg, type, *codec);
+            uint64_t packed = 0;
+            PipelineStats result = run_ordered(
+                    pool, bounds.size() - 1, window,
+                    [&](size_t batch, std::vector<std::string> &encoded) {
+                        encoded.resize(bounds[batch + 1] - bounds[batch]);
+                        for (size_t i = bounds[batch]; i < bounds[batch + 1]; ++i) {
+                            codec->encode(encoded[i - bounds[batch]], records[i]);
+                        }
+                    },
+                    [&](size_t, const std::vector<std::string> &encoded) {
+                        for (const auto &record : encoded) {
+                            writer.add_encoded(record);
+                            packed += record.size();
+                        }
+                    });
+            writer.finish();
+            print_report("Packed", records.size(), corpus.total_bytes(), packed, threads, result);
+        } else {
+            Codecs::ArchiveReader reader(options[INPUT_FILE].arg);
+            reader.advise_sequential();
+            auto &registry = Codecs::CodecRegistry::instance();
+            Codecs::ArchiveReader::CodecPtr codec;
+            if (reader.has_model()) {
+                codec = reader.codec([&registry](Codecs::CodecType type) {
+                    std::unique_ptr<Codecs::CodecIFace> created = registry.create(type);
+                    created->set_load_mode(Codecs::LoadMode::DECODE);
+                    return created;
+                });
+            } else if (options[MODEL].arg) {
+                Codecs::CodecType type;
+                codec = load_model(options[MODEL].arg, Codecs::LoadMode::DECODE, type);
+                if (Codecs::model_fingerprint(type, codec->save()) != reader.fingerprint()) {
+                    cthrow("the archive was not packed with the model " << options[MODEL].arg);
+                }
+            } else {
+                cthrow("the archive has no embedded model, use --model");
+            }
+            std::vector<size_t> bounds = split_batches(reader.size(), batch_bytes,
+                                                       [&](size_t i) { return reader.record(i).size(); });
+
+            std::vector<char> write_buffer(1 << 20);
+            std::ofstream out;
+            out.rdbuf()->pubsetbuf(write_buffer.data(), write_buffer.size());
+            out.open(options[OUTPUT].arg, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                cthrow("can't create " << options[OUTPUT].arg);
+            }
+            uint64_t raw = 0;
+            uint64_t packed = 0;
+            PipelineStats result = run_ordered(
+                    pool, bounds.size() - 1, window,
+                    [&](size_t batch, std::vector<std::string> &decoded) {
+                        decoded.resize(bounds[batch + 1] - bounds[batch]);
+                        for (size_t i = bounds[batch]; i < bounds[batch + 1]; ++i) {
+                            reader.decode(decoded[i - bounds[batch]], i, *codec);
+                        }
+                    },
+                    [&](size_t batch, const std::vector<std::string> &decoded) {
+                        for (size_t i = 0; i < decoded.size(); ++i) {
+                            const std::string &record = decoded[i];
+                            if (LE_encoding) {
+                                char size[4];
+                                for (int j = 0; j < 4; ++j) {
+                                    size[j] = static_cast<char>((record.size() >> (8 * j)) & 0xFF);
+                                }
+                                out.write(size, 4);
+                                out.write(record.data(), record.size());
+                            } else {
+                                if (record.find('\n') != std::string::npos) {
+                                    cthrow("record " << bounds[batch] + i << " has a line break, use -tLE");
+                                }
+                                out.write(record.data(), record.size());
+                                out.put('\n');
+                            }
+                            raw += record.size();
+                            packed += reader.record(bounds[batch] + i).size();
+                        }
+                        if (!out) {
+                            cthrow("can't write " << options[OUTPUT].arg);
+                        }
+                    });
+            out.close();
+            if (!out) {
+                cthrow("can't write " << options[OUTPUT].arg);
+            }
+            print_report("Unpacked", reader.size(), raw, packed, threads, result);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -1,13 +1,22 @@
 #include <external/optionparser/optionparser.h>
+#include <library/Auto/Auto.h>
+#include <library/Corpus/Corpus.h>
 #include <library/DictHuffman/DictHuffman.h>
+#include <library/Registry/Registry.h>
+#include <library/common/latency.h>
 #include <library/common/sample.h>
+#include <library/common/stats.h>
 
 #include <experimental/string_view>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <thread>
 #include <fstream>
 #include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
 #include <map>
 #include <chrono>
 #include <random>
@@ -17,52 +26,305 @@
 #include <string>
 
 enum optionIndex {
-    UNKNOWN, HELP, INPUT_FILE, INPUT_TYPE, RECORDS, S_SIZE, SAVE
+    UNKNOWN, HELP, INPUT_FILE, INPUT_TYPE, RECORDS, S_BYTES, S_WEIGHTED, SAVE, THREADS, CODEC, FORMAT, OUTPUT, SAVE_MODELS
 };
 const option::Descriptor usage[] =
         {
-                {UNKNOWN,    0, "",  "",            option::Arg::None,     ""},
-                {HELP,       0, "h", "help",        option::Arg::None,     ""},
-                {INPUT_FILE, 0, "",  "test-file",   option::Arg::Optional, ""},
-                {INPUT_TYPE, 0, "t", "",            option::Arg::Optional, ""},
-                {RECORDS,    0, "",  "records",     option::Arg::Optional, ""},
-                {S_SIZE,     0, "",  "sample-size", option::Arg::Optional, ""},
-                {SAVE,       0, "s", "save-test",   option::Arg::None,     ""},
-                {0,          0, 0,   0,             0,                     0}
+                {UNKNOWN,     0, "",  "",               option::Arg::None,     ""},
+                {HELP,        0, "h", "help",           option::Arg::None,     ""},
+                {INPUT_FILE,  0, "",  "test-file",      option::Arg::Optional, ""},
+                {INPUT_TYPE,  0, "t", "",               option::Arg::Optional, ""},
+                {RECORDS,     0, "",  "records",        option::Arg::Optional, ""},
+                {S_BYTES,     0, "",  "sample-bytes",   option::Arg::Optional, ""},
+                {S_WEIGHTED,  0, "",  "sample-by-size", option::Arg::None,     ""},
+                {SAVE,        0, "s", "save-test",      option::Arg::None,     ""},
+                {THREADS,     0, "",  "threads",        option::Arg::Optional, ""},
+                {CODEC,       0, "",  "codec",          option::Arg::Optional, ""},
+                {FORMAT,      0, "",  "format",         option::Arg::Optional, ""},
+                {OUTPUT,      0, "",  "output",         option::Arg::Optional, ""},
+                {SAVE_MODELS, 0, "",  "save-models",    option::Arg::Optional, ""},
+                {0,           0, 0,   0,                0,                     0}
         };
 
-size_t read_entries(std::istream &in, std::vector<std::string> &data, int_fast64_t n, bool LE_type = false) {
-    size_t readed = 0;
-    if (LE_type) {
-        in.seekg(0, in.end);
-        long length = in.tellg();
-        in.seekg(0, in.beg);
-
-        char *char_buff = new char[length];
-        in.read(char_buff, length);
-
-        int_fast64_t i = 0;
-        uint_fast32_t entry_size;
-        while (i < length && i != n) {
-            entry_size = 0;
-            for (int j = 0; j < 4; ++j) {
-                entry_size += (static_cast<unsigned char>(char_buff[i + j]) << (j * 8));
+struct ThroughputResult {
+    size_t threads;
+    double encode_seconds;
+    double decode_seconds;
+    Codecs::LatencyHistogram encode_latency;
+    Codecs::LatencyHistogram decode_latency;
+    uintmax_t total_raw;
+    uintmax_t total_encoded;
+    double min_ratio;
+    double max_ratio;
+    bool correct;
+};
+
+struct CodecReport {
+    std::string name;
+    size_t model_bytes;
+    double learn_seconds;
+    std::vector<ThroughputResult> runs;
+    bool save_tested;
+    bool save_correct;
+    // hot path counters of the codecs that did the work, see library/common/stats.h
+    std::vector<std::pair<Codecs::CodecType, Codecs::CodecStats>> stats;
+    const Codecs::StringVector *dictionary;
+};
+
+// the dictionary the DictHuffman counters refer to, if the codec has one
+const Codecs::StringVector *dict_huffman_dictionary(const Codecs::CodecIFace &codec) {
+    if (auto dict_huffman = dynamic_cast<const Codecs::DictHuffmanCodec *>(&codec)) {
+        return &dict_huffman->dictionary();
+    }
+    if (auto automatic = dynamic_cast<const Codecs::AutoCodec *>(&codec)) {
+        for (const auto &candidate : automatic->candidates()) {
+            if (auto dictionary = dict_huffman_dictionary(*candidate.codec)) {
+                return dictionary;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Encodes and then decodes the first `records_number` records with `threads` workers sharing the codec.
+// Workers take records from a common counter, so slow records do not leave other workers idle.
+ThroughputResult run_parallel(const Codecs::CodecIFace &codec, const Codecs::StringViewVector &data,
+                              size_t records_number, size_t threads) {
+    ThroughputResult result;
+    result.threads = threads;
+    result.total_raw = 0;
+    result.total_encoded = 0;
+    result.min_ratio = std::numeric_limits<double>::infinity();
+    result.max_ratio = -std::numeric_limits<double>::infinity();
+    result.correct = true;
+    std::vector<std::string> encoded(records_number);
+    std::vector<Codecs::LatencyHistogram> latencies(threads);
+    std::vector<char> correct(threads, 1);
+
+    auto run_phase = [&](bool encode) {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                std::string decoded;
+                for (size_t i = next++; i < records_number; i = next++) {
+                    auto record_start = std::chrono::high_resolution_clock::now();
+                    if (encode) {
+                        codec.encode(encoded[i], data[i]);
+                    } else {
+                        decoded.clear();
+                        codec.decode(decoded, encoded[i]);
+                    }
+                    auto record_finish = std::chrono::high_resolution_clock::now();
+                    latencies[t].record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            record_finish - record_start).count());
+                    if (!encode && decoded != data[i]) {
+                        correct[t] = 0;
+                    }
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        auto finish = std::chrono::high_resolution_clock::now();
+        Codecs::LatencyHistogram &merged = encode ? result.encode_latency : result.decode_latency;
+        for (auto &latency : latencies) {
+            merged.merge(latency);
+            latency.clear();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count() / 1e9;
+    };
+
+    result.encode_seconds = run_phase(true);
+    result.decode_seconds = run_phase(false);
+    for (char c : correct) {
+        result.correct = result.correct && c;
+    }
+    for (size_t i = 0; i < records_number; ++i) {
+        result.total_raw += data[i].size();
+        result.total_encoded += encoded[i].size();
+        if (data[i].size()) {
+            double ratio = (double) 1.0 - (double) encoded[i].size() / (double) data[i].size();
+            result.min_ratio = std::min(result.min_ratio, ratio);
+            result.max_ratio = std::max(result.max_ratio, ratio);
+        }
+    }
+    return result;
+}
+
+bool test_save_load(Codecs::CodecIFace &codec, const Codecs::StringViewVector &data, std::mt19937 &generator) {
+    size_t to_test = std::min((size_t)3000, data.size());
+    std::set<size_t> test_numbers;
+    while (test_numbers.size() < to_test) {
+        test_numbers.insert(generator() % data.size());
+    }
+    std::vector<std::string> previous(to_test);
+    size_t i = 0;
+    for (auto It = test_numbers.begin(); It != test_numbers.end(); ++i, ++It) {
+        codec.encode(previous[i], data[*It]);
+    }
+
+    codec.load(codec.save());
+    i = 0;
+    std::string plain;
+    bool good = true;
+    for (auto It = test_numbers.begin(); It != test_numbers.end(); ++i, ++It) {
+        plain.clear();
+        codec.decode(plain, previous[i]);
+        if (plain != data[*It]) {
+            good = false;
+        }
+    }
+    return good;
+}
+
+double mb_per_second(uintmax_t bytes, double seconds) {
+    return seconds > 0 ? (double) bytes / (1 << 20) / seconds : 0.0;
+}
+
+void print_percentiles(std::ostream &out, const Codecs::LatencyHistogram &latency) {
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        out << std::setw(10) << static_cast<double>(latency.percentile(p)) / 1000;
+    }
+}
+
+void print_text(std::ostream &out, const CodecReport &report) {
+    const ThroughputResult &serial = report.runs[0];
+    const auto &enc = serial.encode_latency;
+    const auto &dec = serial.decode_latency;
+    out << "\n=== " << report.name << " ===\n"
+    << "Learning finished in " << report.learn_seconds << " seconds. Model size is " << report.model_bytes
+    << " bytes.\n"
+    << (serial.correct ? "" : "Records were encoded/decoded incorrectly!\n")
+    << "\nCompression ratio:\nMin: " << serial.min_ratio
+    << "\tMax: " << serial.max_ratio
+    << "\tAverage: "
+    << (double) 1.0 - (double) serial.total_encoded / (double) serial.total_raw
+    << "\nOn whole file (including dictionary):\t"
+    << (double) 1 - (double) (serial.total_encoded + report.model_bytes) / (double) serial.total_raw
+    << "\n\nCompression time:\nMin: " << (long double) enc.min() / 1000000
+    << "\tMax: " << (long double) enc.max() / 1000000
+    << "\tAverage: " << (long double) enc.mean() / 1000000 << " milliseconds"
+    << "\nTime spent on whole file encoding: " << serial.encode_seconds << " seconds\n"
+    << "\nDecompression time:\nMin: " << (long double) dec.min() / 1000000
+    << "\tMax: " << (long double) dec.max() / 1000000
+    << "\tAverage: " << (long double) dec.mean() / 1000000 << " milliseconds"
+    << "\nTime spent on whole file decoding: " << serial.decode_seconds << " seconds\n"
+    << "\nLatency percentiles, microseconds:   p50       p90       p99     p99.9\nEncoding:\t\t";
+    print_percentiles(out, enc);
+    out << "\nDecoding:\t\t";
+    print_percentiles(out, dec);
+    out << '\n';
+
+    if (report.runs.size() > 1) {
+        out << "\nThroughput (MB/s of raw data) and per-record latency (microseconds):\n"
+                  << std::setw(8) << "threads"
+                  << std::setw(12) << "enc MB/s" << std::setw(9) << "scaling"
+                  << std::setw(12) << "dec MB/s" << std::setw(9) << "scaling"
+                  << std::setw(10) << "enc p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+                  << std::setw(10) << "p99.9"
+                  << std::setw(10) << "dec p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+                  << std::setw(10) << "p99.9" << '\n';
+        std::ios::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(2);
+        for (const auto &result : report.runs) {
+            out << std::setw(8) << result.threads
+                << std::setw(12) << mb_per_second(result.total_raw, result.encode_seconds)
+                << std::setw(9) << serial.encode_seconds / result.encode_seconds
+                << std::setw(12) << mb_per_second(result.total_raw, result.decode_seconds)
+                << std::setw(9) << serial.decode_seconds / result.decode_seconds;
+            print_percentiles(out, result.encode_latency);
+            print_percentiles(out, result.decode_latency);
+            out << (result.correct ? "" : "  decoded incorrectly") << '\n';
+        }
+        out.flags(flags);
+    }
+    for (const auto &stats : report.stats) {
+        out << "\nCounters of " << Codecs::CodecRegistry::instance().name_of(stats.first) << ":\n";
+        stats.second.dump(out, stats.first == Codecs::CodecType::DICT_HUFFMAN ? report.dictionary : nullptr);
+    }
+    if (report.save_tested) {
+        out << "\nSave/Load process finished " << (report.save_correct ? "correctly" : "incorrectly") << '\n';
+    }
+}
+
+void print_json(std::ostream &out, const std::vector<CodecReport> &reports) {
+    auto percentiles = [&out](const Codecs::LatencyHistogram &latency) {
+        out << "{\"p50\": " << latency.percentile(50) / 1000.0
+            << ", \"p90\": " << latency.percentile(90) / 1000.0
+            << ", \"p99\": " << latency.percentile(99) / 1000.0
+            << ", \"p999\": " << latency.percentile(99.9) / 1000.0 << "}";
+    };
+    out << "[";
+    for (size_t i = 0; i < reports.size(); ++i) {
+        const CodecReport &report = reports[i];
+        const ThroughputResult &serial = report.runs[0];
+        out << (i ? ",\n " : "\n ") << "{\"codec\": \"" << report.name << "\""
+            << ", \"ratio\": " << (double) serial.total_encoded / (double) serial.total_raw
+            << ", \"ratio_with_model\": "
+            << (double) (serial.total_encoded + report.model_bytes) / (double) serial.total_raw
+            << ", \"model_bytes\": " << report.model_bytes
+            << ", \"learn_seconds\": " << report.learn_seconds
+            << ", \"raw_bytes\": " << serial.total_raw
+            << ", \"encoded_bytes\": " << serial.total_encoded
+            << ", \"correct\": " << (serial.correct ? "true" : "false");
+        if (report.save_tested) {
+            out << ", \"save_load_correct\": " << (report.save_correct ? "true" : "false");
+        }
+        if (Codecs::STATS_ENABLED) {
+            out << ", \"counters\": {";
+            for (size_t j = 0; j < report.stats.size(); ++j) {
+                const Codecs::CodecStats &stats = report.stats[j].second;
+                size_t used = std::count_if(stats.dict_usage.begin(), stats.dict_usage.end(),
+                                            [](uint64_t count) { return count > 0; });
+                out << (j ? ", " : "") << "\"" << Codecs::CodecRegistry::instance().name_of(report.stats[j].first)
+                    << "\": {\"calls\": " << stats.calls << ", \"input_bytes\": " << stats.input_bytes
+                    << ", \"output_bits\": " << stats.output_bits << ", \"symbols\": " << stats.symbols
+                    << ", \"escapes\": " << stats.escapes << ", \"trie_steps\": " << stats.trie_steps
+                    << ", \"fallbacks\": " << stats.fallbacks << ", \"dict_entries_used\": " << used
+                    << ", \"bits_per_symbol\": " << stats.bits_per_symbol() << "}";
             }
-            i += 4;
-            data.push_back(std::string(char_buff + i, entry_size));
-            readed += entry_size;
-            i += entry_size;
+            out << "}";
         }
-        delete[] char_buff;
-    } else {
-        std::string buff;
-        for (int_fast64_t i = 0; i != n && getline(in, buff); ++i) {
-            data.push_back(buff);
-            readed += buff.size();
-            buff.clear();
+        out << ", \"runs\": [";
+        for (size_t j = 0; j < report.runs.size(); ++j) {
+            const ThroughputResult &run = report.runs[j];
+            out << (j ? ", " : "") << "{\"threads\": " << run.threads
+                << ", \"encode_mb_per_s\": " << mb_per_second(run.total_raw, run.encode_seconds)
+                << ", \"decode_mb_per_s\": " << mb_per_second(run.total_raw, run.decode_seconds)
+                << ", \"encode_latency_us\": ";
+            percentiles(run.encode_latency);
+            out << ", \"decode_latency_us\": ";
+            percentiles(run.decode_latency);
+            out << "}";
+        }
+        out << "]}";
+    }
+    out << "\n]\n";
+}
+
+void print_csv(std::ostream &out, const std::vector<CodecReport> &reports) {
+    out << "codec,threads,ratio,ratio_with_model,model_bytes,learn_seconds,encode_mb_per_s,decode_mb_per_s,"
+           "encode_p50_us,encode_p90_us,encode_p99_us,encode_p999_us,"
+           "decode_p50_us,decode_p90_us,decode_p99_us,decode_p999_us,correct\n";
+    for (const auto &report : reports) {
+        for (const auto &run : report.runs) {
+            out << report.name << ',' << run.threads
+                << ',' << (double) run.total_encoded / (double) run.total_raw
+                << ',' << (double) (run.total_encoded + report.model_bytes) / (double) run.total_raw
+                << ',' << report.model_bytes << ',' << report.learn_seconds
+                << ',' << mb_per_second(run.total_raw, run.encode_seconds)
+                << ',' << mb_per_second(run.total_raw, run.decode_seconds);
+            for (const auto *latency : {&run.encode_latency, &run.decode_latency}) {
+                for (double p : {50.0, 90.0, 99.0, 99.9}) {
+                    out << ',' << latency->percentile(p) / 1000.0;
+                }
+            }
+            out << ',' << (run.correct ? 1 : 0) << '\n';
         }
     }
-    return readed;
 }
 
 int main(int argc, char *argv[]) {
@@ -75,6 +337,8 @@ int main(int argc, char *argv[]) {
     if (parse.error())
         return 1;
 
+    auto &registry = Codecs::CodecRegistry::instance();
+
     if (options[UNKNOWN]) {
         std::cout << "Unknown option '" << options[UNKNOWN].name << "' use --help for help.\n";
         return 0;
@@ -85,8 +349,20 @@ int main(int argc, char *argv[]) {
                 "--test-file=<path>\n\t\tfull path to the file with test data\n\n"
                 "-t\n\t\tType of file encoding. use -tLE if data file's entry looks like 'LE uint32 size + entry'\n\n"
                 "--records=<number>\n\t\tCodec will encode only first <number> records from test file.\n\n"
-                "--sample-size=<new size>\n\t\tTester will use <new size> entries to train codec\n\n"
-                "-s, --save-test\n\t\tTest the save/load function of codec\n";
+                "--sample-bytes=<bytes>\n\t\tTrain on a sample of about <bytes> bytes instead of what the codecs ask for\n\n"
+                "--sample-by-size\n\t\tPick longer records for the sample more often, so it follows the bytes\n"
+                "\t\tof the test file rather than its records\n\n"
+                "-s, --save-test\n\t\tTest the save/load function of codec\n\n"
+                "--threads=<number>\n\t\tAlso run encode/decode with 1, 2, 4, ... <number> threads sharing the codec\n"
+                "\t\tand report throughput scaling and latency percentiles\n\n"
+                "--codec=<name>[,<name>...]\n\t\tCodecs to compare on the same sample and records, dict-huffman by default.\n"
+                "\t\tKnown codecs:";
+        for (const auto &name : registry.names()) {
+            std::cout << ' ' << name;
+        }
+        std::cout << "\n\n--format=text|json|csv\n\t\tFormat of the report, text by default\n\n"
+                "--output=<path>\n\t\tWrite the report to <path> instead of the standard output\n\n"
+                "--save-models=<dir>\n\t\tWrite every trained model to <dir>/<codec>.model, see codecs-inspect\n";
         return 0;
     }
 
@@ -101,12 +377,12 @@ int main(int argc, char *argv[]) {
         LE_encoding = (tmp == "LE");
     }
 
-    size_t sample_size = 0;
-    if (options[S_SIZE]) {
-        if (options[S_SIZE].arg != nullptr) {
-            sample_size = std::stoi(options[S_SIZE].arg);
+    size_t sample_bytes = 0;
+    if (options[S_BYTES]) {
+        if (options[S_BYTES].arg != nullptr) {
+            sample_bytes = std::stoull(options[S_BYTES].arg);
         } else {
-            std::cout << "After --sample-size you should enter new size of sample. Ex.: --sample-size=100\n";
+            std::cout << "After --sample-bytes you should enter the size of the sample. Ex.: --sample-bytes=1000000\n";
         }
     }
 
@@ -119,133 +395,154 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    std::cout << "Preparing test file. It can take some time\n";
-
-    Codecs::DictHuffmanCodec codec;
+    size_t threads_number = 0;
+    if (options[THREADS]) {
+        if (options[THREADS].arg != nullptr) {
+            threads_number = std::stoi(options[THREADS].arg);
+        } else {
+            std::cout << "Enter the number of threads. Ex.: --threads=8\n";
+        }
+    }
 
-    sample_size = (sample_size ? sample_size : codec.sample_size());
-    std::string sample;
-    std::ifstream inp;
-    inp.open(options[INPUT_FILE].arg);
-    if (!inp.is_open()) {
-        std::cout << "the file " << options[INPUT_FILE].arg << " does not exist.\n";
+    std::vector<std::string> codec_names;
+    {
+        std::string list = options[CODEC] && options[CODEC].arg != nullptr ? options[CODEC].arg : "dict-huffman";
+        std::istringstream names(list);
+        std::string name;
+        while (getline(names, name, ',')) {
+            if (!registry.contains(name)) {
+                std::cout << "Unknown codec '" << name << "' use --help for the list of codecs.\n";
+                return 1;
+            }
+            codec_names.push_back(name);
+        }
     }
 
-    std::vector<std::string> data;
-    read_entries(inp, data, -1, LE_encoding);
-    inp.close();
-    inp.clear();
+    std::string format = options[FORMAT] && options[FORMAT].arg != nullptr ? options[FORMAT].arg : "text";
+    if (format != "text" && format != "json" && format != "csv") {
+        std::cout << "Unknown report format '" << format << "', use text, json or csv.\n";
+        return 1;
+    }
+    std::ofstream output_file;
+    if (options[OUTPUT] && options[OUTPUT].arg != nullptr) {
+        output_file.open(options[OUTPUT].arg, std::ios::trunc);
+        if (!output_file.is_open()) {
+            std::cout << "Can't write the report to " << options[OUTPUT].arg << '\n';
+            return 1;
+        }
+    }
+    std::ostream &report_out = output_file.is_open() ? output_file : std::cout;
+    // progress goes out of the way of a machine readable report on the standard output
+    std::ostream &log = (format != "text" && !output_file.is_open()) ? std::cerr : std::cout;
+
+    log << "Preparing test file. It can take some time\n";
+
+    Codecs::Corpus corpus;
+    try {
+        corpus = Codecs::Corpus(options[INPUT_FILE].arg,
+                                LE_encoding ? Codecs::CorpusFormat::LE_UINT32 : Codecs::CorpusFormat::LINES,
+                                std::max(1u, std::thread::hardware_concurrency()));
+    } catch (const Codecs::CodecException &e) {
+        log << "Can't read the file " << options[INPUT_FILE].arg << ": " << e.what() << '\n';
+        return 1;
+    }
+    const Codecs::StringViewVector &data = corpus.records();
+    if (data.empty()) {
+        log << "The file " << options[INPUT_FILE].arg << " has no records.\n";
+        return 1;
+    }
     int64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
     std::mt19937 generator(seed);
 
+    if (!sample_bytes) {
+        for (const auto &name : codec_names) {
+            sample_bytes = std::max(sample_bytes, registry.create(name)->sample_bytes());
+        }
+    }
     records_number = ((records_number && records_number < data.size()) ? records_number : data.size());
-    sample_size = std::min(sample_size, data.size());
 
-    std::set<size_t> record_indexes;
-    while (record_indexes.size() < sample_size) {
-        record_indexes.insert(generator() % data.size());
-    }
-    for (auto n : record_indexes) {
-        sample.append(std::string(data[n].data(), data[n].size()));
-    }
+    // every codec learns on the same sample, which points into the mapped corpus
+    Codecs::ReservoirOptions sample_options;
+    sample_options.budget_bytes = sample_bytes;
+    sample_options.keep_views = true;
+    sample_options.weight_by_size = options[S_WEIGHTED];
+    sample_options.seed = seed;
+    Codecs::ReservoirSampler sampler(sample_options);
+    sampler.add(data.begin(), data.end());
+    Codecs::StringViewVector sample = sampler.sample();
+    log << "Sampled " << sample.size() << " records, " << sampler.bytes() << " bytes\n";
+
+    std::vector<CodecReport> reports;
+    for (const auto &name : codec_names) {
+        CodecReport report;
+        report.name = name;
+        std::unique_ptr<Codecs::CodecIFace> codec = registry.create(name);
+
+        log << "Start learning " << name << '\n';
+        auto start = std::chrono::high_resolution_clock::now();
+        codec->learn(sample);
+        auto finish = std::chrono::high_resolution_clock::now();
+        report.learn_seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count() / 1e9;
+        std::string model = codec->save();
+        report.model_bytes = model.size();
+        if (options[SAVE_MODELS] && options[SAVE_MODELS].arg != nullptr) {
+            // the codec type byte and the model, the format of ModelCache
+            std::string path = std::string(options[SAVE_MODELS].arg) + "/" + name + ".model";
+            std::ofstream model_file(path, std::ios::binary | std::ios::trunc);
+            model_file.put(static_cast<char>(registry.type_of(name)));
+            model_file.write(model.data(), model.size());
+            if (!model_file.good()) {
+                log << "Can't write the model to " << path << '\n';
+            }
+        }
+        report.dictionary = dict_huffman_dictionary(*codec);
+        Codecs::StatsRegistry::reset();
+
+        log << "Start encoding test on " << records_number << " records\n";
+        report.runs.push_back(run_parallel(*codec, data, records_number, 1));
+        if (threads_number > 1) {
+            for (size_t threads = 2; ; threads = std::min(threads * 2, threads_number)) {
+                report.runs.push_back(run_parallel(*codec, data, records_number, threads));
+                if (threads == threads_number) {
+                    break;
+                }
+            }
+        }
+
+        for (unsigned type = 0; type < 256; ++type) {
+            Codecs::CodecStats stats = Codecs::StatsRegistry::snapshot(static_cast<Codecs::CodecType>(type));
+            if (stats.calls) {
+                report.stats.emplace_back(static_cast<Codecs::CodecType>(type), std::move(stats));
+            }
+        }
 
-    std::cout << "Start learning test\n";
+        report.save_tested = options[SAVE];
+        report.save_correct = report.save_tested && test_save_load(*codec, data, generator);
 
-    auto start = std::chrono::high_resolution_clock::now();
-    codec.learn({sample});
-    auto finish = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
-    std::cout << "Learning finished in " << static_cast<long double>(duration) / 1000000000 << " seconds.\n";
+        if (format == "text") {
+            print_text(report_out, report);
+        }
+        // belongs to the codec destroyed with this iteration
+        report.dictionary = nullptr;
+        reports.push_back(std::move(report));
+    }
 
-    uintmax_t total_encoded = 0;
-    uintmax_t total_raw = 0;
+    if (format == "text" && !Codecs::STATS_ENABLED) {
+        report_out << "\nHot path counters are off, configure with -DCODECS_STATS=ON to see them.\n";
+    }
 
-    decltype(duration) enc_time[3], dec_time[3];
-    enc_time[1] = enc_time[2] = dec_time[1] = dec_time[2] = 0;
-    enc_time[0] = dec_time[0] = UINT32_MAX;
-    double min_ratio, max_ratio;
-    max_ratio = 0.0;
-    min_ratio = std::numeric_limits<double>::infinity();
+    if (format == "json") {
+        print_json(report_out, reports);
+    } else if (format == "csv") {
+        print_csv(report_out, reports);
+    }
 
-    std::cout << "\nStart encoding test on " << records_number << " records\n";
-    std::string enc, decoded;
-    for (size_t i = 0; i < records_number; ++i) {
-        enc.clear();
-        decoded.clear();
-        start = std::chrono::high_resolution_clock::now();
-        codec.encode(enc, data[i]);
-        finish = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
-
-        enc_time[1] += duration;
-        enc_time[0] = std::min(enc_time[0], duration);
-        enc_time[2] = std::max(enc_time[2], duration);
-
-        start = std::chrono::high_resolution_clock::now();
-        codec.decode(decoded, enc);
-        finish = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
-
-        dec_time[1] += duration;
-        dec_time[0] = std::min(dec_time[0], duration);
-        dec_time[2] = std::max(dec_time[2], duration);
-
-        if (decoded != data[i]) {
-            std::cout << "Encoded/Decodec incorrectly on the " << i << " record in file "
-            << options[INPUT_FILE].arg << '\n';
-            break;
-        }
-
-        total_encoded += enc.size();
-        total_raw += data[i].size();
-        min_ratio = std::min(min_ratio, (double) 1.0 - (double) enc.size() / (double) data[i].size());
-        max_ratio = std::max(min_ratio, (double) 1.0 - (double) enc.size() / (double) data[i].size());
-    }
-    std::string saved = codec.save();
-    std::cout << "\nCompression ratio:\nMin: " << min_ratio
-    << "\tMax: " << max_ratio
-    << "\tAverage: "
-    << (double) 1.0 - (double) total_encoded / (double) total_raw
-    << "\nOn whole file (including dictionary):\t"
-    << (double) 1 - (double) (total_encoded + saved.size()) / (double) total_raw
-    << "\n\nCompression time:\nMin: " << (long double) enc_time[0] / 1000000
-    << "\tMax: " << (long double) enc_time[2] / 1000000
-    << "\tAverage: " << (long double) enc_time[1] / ((uint64_t) 1000000 * records_number) << " milliseconds"
-    << "\nTime spent on whole file encoding: " << (double) enc_time[1] / 1000000000 << " seconds\n"
-    << "\nDecompression time:\nMin: " << (long double) dec_time[0] / 1000000
-    << "\tMax: " << (long double) dec_time[2] / 1000000
-    << "\tAverage: " << (long double) dec_time[1] / ((uint64_t) 1000000 * records_number) << " milliseconds"
-    << "\nTime spent on whole file encoding: " << (double) dec_time[1] / 1000000000 << " seconds\n";
-
-    if (options[SAVE]) {
-        size_t to_test = std::min((size_t)3000, data.size());
-
-        std::cout << "\nStart serializing test:\nDictionary size is "
-        << std::fixed << std::setprecision(2) << (double)saved.size() / ((uint32_t)1 << 20) << " MB\n";
-        std::set<size_t> test_numbers;
-        while (test_numbers.size() < to_test) {
-            test_numbers.insert(generator() % data.size());
-        }
-        std::vector<std::string> previous(to_test);
-        size_t i = 0;
-        for (auto It = test_numbers.begin(); It != test_numbers.end(); ++i, ++It) {
-            codec.encode(previous[i], data[*It]);
-        }
-
-        codec.load(saved);
-        i = 0;
-        std::string plain;
-        bool good = true;
-        for (auto It = test_numbers.begin(); It != test_numbers.end(); ++i, ++It) {
-            plain.clear();
-            codec.decode(plain, previous[i]);
-            if (plain != data[*It]) {
-                good = false;
+    for (const auto &report : reports) {
+        for (const auto &run : report.runs) {
+            if (!run.correct || (report.save_tested && !report.save_correct)) {
+                return 2;
             }
         }
-        std::cout << "Save/Load process finished " << (good ? "correctly" : "incorrectly") << '\n';
     }
-
-
     return 0;
-}
\ No newline at end of file
+}